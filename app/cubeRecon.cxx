@@ -1,6 +1,11 @@
 #include "CubeEvent.hxx"
 #include "CubeMakeHits3D.hxx"
 #include "CubeRecon.hxx"
+#include "CubeAlgorithmTrace.hxx"
+#include "CubeAlgorithmSummary.hxx"
+#include "CubeMemoryAccount.hxx"
+#include "CubeTrackFit.hxx"
+#include "CubeTrackFitBatch.hxx"
 
 #include <TFile.h>
 #include <TTree.h>
@@ -19,9 +24,11 @@ int main(int argc, char **argv) {
     std::cout << "CubeRecon: Hello World" << std::endl;
     int maxEntries = 1E+8; // Maximum to process.
     int firstEntry = 0;
+    std::string traceName;
+    std::string summaryName;
 
     while (true) {
-        int c = getopt(argc,argv,"n:s:");
+        int c = getopt(argc,argv,"n:s:t:r:mj:");
         if (c<0) break;
         switch (c) {
         case 'n': {
@@ -34,6 +41,25 @@ int main(int argc, char **argv) {
             tmp >> firstEntry;
             break;
         }
+        case 't': {
+            traceName = optarg;
+            break;
+        }
+        case 'r': {
+            summaryName = optarg;
+            break;
+        }
+        case 'm': {
+            Cube::MemoryAccount::Enable();
+            break;
+        }
+        case 'j': {
+            std::istringstream tmp(optarg);
+            int threads = 1;
+            tmp >> threads;
+            Cube::TrackFitBatch::SetDefaultThreadCount(threads);
+            break;
+        }
         default: {
             std::cout << "Usage: " << std::endl;
             std::cout << "   "
@@ -41,6 +67,19 @@ int main(int argc, char **argv) {
                       << std::endl
                       << "-n <number>  : Process no more than"
                       << " <number> events."
+                      << std::endl
+                      << "-t <file>    : Write a trace of the algorithms"
+                      << " to <file> (Chrome trace format)."
+                      << std::endl
+                      << "-r <file>    : Write the run summary to <file>"
+                      << " (JSON format)."
+                      << std::endl
+                      << "-m           : Record the net and peak heap used"
+                      << " by each algorithm, and the resident memory"
+                      << " for each event."
+                      << std::endl
+                      << "-j <number>  : Fit the tracks with <number>"
+                      << " threads (0 for all of the hardware threads)."
                       << std::endl;
             exit(1);
         }
@@ -91,10 +130,20 @@ int main(int argc, char **argv) {
         geom->Write();
     }
 
+    // Record the algorithm calls.
+    if (!traceName.empty()) {
+        std::cout << "Trace Name " << traceName << std::endl;
+        Cube::AlgorithmTrace::Open(traceName);
+    }
+
+    // Keep the time used by each algorithm for the run summary.
+    Cube::AlgorithmSummary::Enable();
+
     // Loop through the events.
     int totalEntries = inputTree->GetEntries();
     totalEntries = std::min(totalEntries,firstEntry+maxEntries);
     for (int entry = firstEntry; entry < totalEntries; ++entry) {
+        Cube::MemoryAccount::StartEvent();
         inputTree->GetEntry(entry);
         gOutputEvent = inputEvent;
         gOutputEvent->MakeCurrentEvent();
@@ -115,7 +164,9 @@ int main(int argc, char **argv) {
         if (!makeHits3D) {
             std::unique_ptr<Cube::MakeHits3D>
                 algoMakeHits3D(new Cube::MakeHits3D);
-            makeHits3D = algoMakeHits3D->Process(*gOutputEvent);
+            Cube::AlgorithmTrace::Scope trace(*algoMakeHits3D,*gOutputEvent);
+            makeHits3D
+                = trace.Finish(algoMakeHits3D->Process(*gOutputEvent));
             gOutputEvent->AddAlgorithmResult(makeHits3D);
             gOutputEvent->AddHitSelection(makeHits3D->GetHitSelection());
         }
@@ -128,8 +179,10 @@ int main(int argc, char **argv) {
         if (hits3D) {
             std::unique_ptr<Cube::Recon>
                 algoRecon(new Cube::Recon);
+            Cube::AlgorithmResult input(*hits3D);
+            Cube::AlgorithmTrace::Scope trace(*algoRecon,input);
             Cube::Handle<Cube::AlgorithmResult>
-                recon = algoRecon->Process(*hits3D);
+                recon = trace.Finish(algoRecon->Process(input));
             gOutputEvent->AddAlgorithmResult(recon);
             Cube::Handle<Cube::ReconObjectContainer> finalObjects
                 = recon->GetObjectContainer("final");
@@ -139,10 +192,28 @@ int main(int argc, char **argv) {
 
         CUBE_LOG(0) << "Finished event " << gOutputEvent->GetRunId()
                     << "/" << gOutputEvent->GetEventId() << std::endl;
+        Cube::AlgorithmSummary::FinishEvent();
         outputTree->Fill();
+
+        // Clear the event (and the fit cache) so any object that is still
+        // alive has leaked.
+        int runId = gOutputEvent->GetRunId();
+        int eventId = gOutputEvent->GetEventId();
+        Cube::TrackFit::ClearCache();
+        gOutputEvent->Initialize();
+        Cube::MemoryAccount::FinishEvent(runId,eventId);
     }
 
     outputFile->Write();
+    Cube::AlgorithmTrace::Close();
+
+    // Summarize the run.
+    if (!summaryName.empty()) {
+        std::cout << "Summary Name " << summaryName << std::endl;
+        Cube::AlgorithmSummary::Write(summaryName);
+    }
+    Cube::AlgorithmSummary::Print(std::cout);
+    Cube::MemoryAccount::Print(std::cout);
 
 }
 
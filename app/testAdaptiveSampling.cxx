@@ -0,0 +1,235 @@
+#include <CubeEvent.hxx>
+#include <CubeReconTrack.hxx>
+#include <CubeReconNode.hxx>
+#include <CubeTrackState.hxx>
+#include <CubeHandle.hxx>
+
+#include <CubeTrackFit.hxx>
+
+#include <TFile.h>
+#include <TTree.h>
+#include <TVector3.h>
+#include <TLorentzVector.h>
+
+#include <iostream>
+#include <sstream>
+#include <memory>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+/// Check the adaptive sampling in the stochastic track fit.  Every track is
+/// fit twice through Cube::TrackFit (with the Kalman filter turned off so
+/// the stochastic fitter is used): once with a fixed number of samples, and
+/// once with adaptive sampling.  The sample count for each node of the
+/// adaptive fit must be inside the limits, and (since the count starts at
+/// the fixed count and is only doubled or halved) must be the fixed count
+/// times a power of two unless it was clamped to a limit.  The node
+/// positions of the two fits must agree within the fit uncertainty.
+namespace {
+    // The sample count for the fixed fit, and the adaptive limits.
+    const int gFixedCount = 1000;
+    const int gMinimumCount = 250;
+    const int gMaximumCount = 4000;
+
+    // The largest allowed position difference (in standard deviations),
+    // and the largest fraction of nodes that are allowed to exceed it.
+    const double gMaximumPull = 5.0;
+    const double gMaximumPullFraction = 0.01;
+
+    long gTracks = 0;
+    long gSkippedTracks = 0;
+    long gNodes = 0;
+    long gBadCounts = 0;
+    long gGrownNodes = 0;
+    long gShrunkNodes = 0;
+    long gLargePulls = 0;
+    double gFixedSamples = 0.0;
+    double gAdaptiveSamples = 0.0;
+}
+
+/// Check that a sample count could have been made by starting from the
+/// fixed count, and then doubling or halving it inside of the limits.
+bool ValidCount(int count) {
+    if (count < gMinimumCount || count > gMaximumCount) return false;
+    if (count == gMinimumCount || count == gMaximumCount) return true;
+    int power = gFixedCount;
+    while (power > count) power /= 2;
+    while (power < count) power *= 2;
+    return power == count;
+}
+
+/// Fit a copy of the track.
+Cube::Handle<Cube::ReconTrack> FitTrack(Cube::TrackFit& fitter,
+                                        Cube::Handle<Cube::ReconTrack> track) {
+    Cube::Handle<Cube::ReconTrack> input(new Cube::ReconTrack(*track));
+    return fitter(input);
+}
+
+/// Check that the track was fit by the stochastic fitter (the other fitters
+/// don't fill the sample count).
+bool StochasticFit(Cube::Handle<Cube::ReconTrack> track) {
+    if (!track) return false;
+    Cube::ReconNodeContainer& nodes = track->GetNodes();
+    for (Cube::ReconNodeContainer::iterator n = nodes.begin();
+         n != nodes.end(); ++n) {
+        Cube::Handle<Cube::TrackState> state = (*n)->GetState();
+        if (!state || state->GetSampleCount() < 1) return false;
+    }
+    return !nodes.empty();
+}
+
+/// Fit the tracks in the event with fixed and adaptive sampling, and compare
+/// the results.
+void AnalyzeEvent(Cube::Event& event,
+                  Cube::TrackFit& fixed, Cube::TrackFit& adaptive) {
+    Cube::Handle<Cube::ReconObjectContainer> objects
+        = event.GetObjectContainer();
+    if (!objects) return;
+
+    for (Cube::ReconObjectContainer::iterator o = objects->begin();
+         o != objects->end(); ++o) {
+        Cube::Handle<Cube::ReconTrack> track = *o;
+        if (!track) continue;
+        if (track->GetNodes().size() < 3) continue;
+        ++gTracks;
+        Cube::Handle<Cube::ReconTrack> fixedFit = FitTrack(fixed,track);
+        Cube::Handle<Cube::ReconTrack> adaptiveFit = FitTrack(adaptive,track);
+        if (!StochasticFit(fixedFit) || !StochasticFit(adaptiveFit)
+            || fixedFit->GetNodes().size()
+            != adaptiveFit->GetNodes().size()) {
+            ++gSkippedTracks;
+            continue;
+        }
+        Cube::ReconNodeContainer& fixedNodes = fixedFit->GetNodes();
+        Cube::ReconNodeContainer& adaptiveNodes = adaptiveFit->GetNodes();
+        for (std::size_t n = 0; n < fixedNodes.size(); ++n) {
+            Cube::Handle<Cube::TrackState> f = fixedNodes[n]->GetState();
+            Cube::Handle<Cube::TrackState> a = adaptiveNodes[n]->GetState();
+            ++gNodes;
+            gFixedSamples += f->GetSampleCount();
+            gAdaptiveSamples += a->GetSampleCount();
+            if (f->GetSampleCount() != gFixedCount
+                || !ValidCount(a->GetSampleCount())) {
+                ++gBadCounts;
+                std::cout << "Node " << n << " has " << a->GetSampleCount()
+                          << " adaptive and " << f->GetSampleCount()
+                          << " fixed samples" << std::endl;
+            }
+            if (a->GetSampleCount() > gFixedCount) ++gGrownNodes;
+            if (a->GetSampleCount() < gFixedCount) ++gShrunkNodes;
+            TVector3 diff = a->GetPosition().Vect() - f->GetPosition().Vect();
+            TLorentzVector fVar = f->GetPositionVariance();
+            TLorentzVector aVar = a->GetPositionVariance();
+            double pull = 0.0;
+            for (int i = 0; i < 3; ++i) {
+                double var = fVar[i] + aVar[i];
+                if (!(var > 0.0)) continue;
+                pull = std::max(pull, std::abs(diff[i])/std::sqrt(var));
+            }
+            if (pull > gMaximumPull) ++gLargePulls;
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    int maxEntries = 1E+8; // Maximum to process.
+    int firstEntry = 0;
+
+    while (true) {
+        int c = getopt(argc,argv,"n:s:");
+        if (c<0) break;
+        switch (c) {
+        case 'n': {
+            std::istringstream tmp(optarg);
+            tmp >> maxEntries;
+            break;
+        }
+        case 's': {
+            std::istringstream tmp(optarg);
+            tmp >> firstEntry;
+            break;
+        }
+        default: {
+            std::cout << "Usage: " << std::endl;
+            std::cout << "   "
+                      << "-s <number>  : Skip <number> entries"
+                      << std::endl
+                      << "-n <number>  : Process no more than"
+                      << " <number> events."
+                      << std::endl;
+            exit(1);
+        }
+        }
+    }
+
+    if (argc <= optind) throw std::runtime_error("Missing input file");
+    std::string inputName(argv[optind++]);
+    std::cout << "Input Name " << inputName << std::endl;
+
+    // Attach to the input tree.
+    std::unique_ptr<TFile> inputFile(new TFile(inputName.c_str(),"old"));
+    if (!inputFile->IsOpen()) throw std::runtime_error("Input file not open");
+
+    /// Attach to the input tree.
+    TTree* inputTree = (TTree*) inputFile->Get("CubeEvents");
+    if (!inputTree) throw std::runtime_error("Missing the event tree");
+    Cube::Event *inputEvent = NULL;
+    inputTree->SetBranchAddress("Event",&inputEvent);
+
+    // The fitters only differ by the adaptive sampling.  The cache is turned
+    // off so every track is really fit.
+    Cube::TrackFit fixed;
+    fixed.SetUseKalman(false);
+    fixed.SetUseCache(false);
+    Cube::TrackFit adaptive;
+    adaptive.SetUseKalman(false);
+    adaptive.SetUseCache(false);
+    adaptive.SetAdaptiveSampling(true);
+    adaptive.SetSampleCountLimits(gMinimumCount,gMaximumCount);
+
+    // Loop through the events.
+    int totalEntries = inputTree->GetEntries();
+    totalEntries = std::min(totalEntries,firstEntry+maxEntries);
+    for (int entry = firstEntry; entry < totalEntries; ++entry) {
+        inputTree->GetEntry(entry);
+        std::cout << "Process event " << inputEvent->GetRunId()
+                    << "/" << inputEvent->GetEventId() << std::endl;
+        inputEvent->MakeCurrentEvent();
+        AnalyzeEvent(*inputEvent,fixed,adaptive);
+    }
+
+    std::cout << "Compared " << gTracks << " tracks ("
+              << gSkippedTracks << " not fit by the stochastic fitter), "
+              << gNodes << " nodes" << std::endl;
+    std::cout << "Nodes with more samples " << gGrownNodes
+              << ", with fewer samples " << gShrunkNodes
+              << ", with bad sample counts " << gBadCounts << std::endl;
+    if (gNodes > 0) {
+        std::cout << "Average samples per node: fixed "
+                  << gFixedSamples/gNodes << ", adaptive "
+                  << gAdaptiveSamples/gNodes << std::endl;
+    }
+    std::cout << "Nodes with position pulls over " << gMaximumPull
+              << ": " << gLargePulls << std::endl;
+
+    bool failed = false;
+    if (gBadCounts > 0) {
+        std::cout << "FAIL: The sample counts are outside of the limits"
+                  << " or weren't doubled or halved" << std::endl;
+        failed = true;
+    }
+    if (gLargePulls > gMaximumPullFraction*gNodes) {
+        std::cout << "FAIL: The adaptive fit is different from the fixed fit"
+                  << std::endl;
+        failed = true;
+    }
+    if (failed) return 1;
+    return 0;
+}
+
+// Local Variables:
+// mode:c++
+// c-basic-offset:4
+// compile-command:"$(git rev-parse --show-toplevel)/build/cube-build.sh force"
+// End:
@@ -0,0 +1,253 @@
+#include <CubeEvent.hxx>
+#include <CubeReconTrack.hxx>
+#include <CubeReconCluster.hxx>
+#include <CubeHandle.hxx>
+#include <CubeUnits.hxx>
+
+#include <CubeCreateTrack.hxx>
+
+#include <TFile.h>
+#include <TTree.h>
+#include <TH1F.h>
+
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+/// Compare the node states from CreateTrackFromClusters using the default
+/// window to the states found by averaging over every cluster.  The tracks
+/// that curl back (some clusters are closer than the window, but further
+/// than the window along the track) are counted separately since those are
+/// the tracks where the window drops clusters that are nearby.
+namespace {
+    int gMinimumNodes = 50;
+    TH1F* histDirectionDifference = NULL;
+    TH1F* histPositionDifference = NULL;
+    double gAngleSum = 0.0;
+    double gMaxAngle = 0.0;
+    double gMaxDistance = 0.0;
+    double gCurlMaxAngle = 0.0;
+    double gCurlMaxDistance = 0.0;
+    double gDefaultWindow = 600.0*unit::mm;
+    int gCurlTracks = 0;
+    int gLargeAngles = 0;
+    double gWindowTime = 0.0;
+    double gFullTime = 0.0;
+    int gTracks = 0;
+    int gNodes = 0;
+}
+
+/// Check if a track curls back so that clusters that are further than the
+/// window along the track are closer than the window.
+bool CurlsBack(const std::vector< Cube::Handle<Cube::ReconCluster> >& clusters,
+               double window) {
+    std::vector<double> travel(clusters.size());
+    travel[0] = 0.0;
+    for (std::size_t i = 1; i < clusters.size(); ++i) {
+        travel[i] = travel[i-1]
+            + (clusters[i]->GetPosition().Vect()
+               - clusters[i-1]->GetPosition().Vect()).Mag();
+    }
+    for (std::size_t i = 0; i < clusters.size(); ++i) {
+        for (std::size_t j = i+1; j < clusters.size(); ++j) {
+            if (travel[j] - travel[i] < window) continue;
+            double dist = (clusters[j]->GetPosition().Vect()
+                           - clusters[i]->GetPosition().Vect()).Mag();
+            if (dist < window) return true;
+        }
+    }
+    return false;
+}
+
+/// Rebuild the long tracks in the event from their clusters with and
+/// without the window.
+void AnalyzeEvent(Cube::Event& event) {
+    Cube::Handle<Cube::ReconObjectContainer> objects
+        = event.GetObjectContainer();
+    if (!objects) return;
+
+    for (Cube::ReconObjectContainer::iterator o = objects->begin();
+         o != objects->end(); ++o) {
+        Cube::Handle<Cube::ReconTrack> track = *o;
+        if (!track) continue;
+        if ((int) track->GetNodes().size() < gMinimumNodes) continue;
+
+        std::vector< Cube::Handle<Cube::ReconCluster> > clusters;
+        for (Cube::ReconNodeContainer::iterator n = track->GetNodes().begin();
+             n != track->GetNodes().end(); ++n) {
+            clusters.push_back((*n)->GetObject());
+        }
+
+        std::chrono::high_resolution_clock::time_point start
+            = std::chrono::high_resolution_clock::now();
+        Cube::Handle<Cube::ReconTrack> windowTrack
+            = Cube::CreateTrackFromClusters("window",
+                                            clusters.begin(), clusters.end());
+        std::chrono::high_resolution_clock::time_point middle
+            = std::chrono::high_resolution_clock::now();
+        Cube::Handle<Cube::ReconTrack> fullTrack
+            = Cube::CreateTrackFromClusters("full",
+                                            clusters.begin(), clusters.end(),
+                                            true, 1E+12*unit::mm);
+        std::chrono::high_resolution_clock::time_point stop
+            = std::chrono::high_resolution_clock::now();
+        gWindowTime
+            += std::chrono::duration<double,std::milli>(middle-start).count();
+        gFullTime
+            += std::chrono::duration<double,std::milli>(stop-middle).count();
+        if (!windowTrack || !fullTrack) continue;
+        ++gTracks;
+        bool curls = CurlsBack(clusters, gDefaultWindow);
+        if (curls) ++gCurlTracks;
+
+        for (std::size_t i = 0; i < windowTrack->GetNodes().size(); ++i) {
+            Cube::Handle<Cube::TrackState> windowState
+                = windowTrack->GetNodes()[i]->GetState();
+            Cube::Handle<Cube::TrackState> fullState
+                = fullTrack->GetNodes()[i]->GetState();
+            double cosAngle
+                = windowState->GetDirection()*fullState->GetDirection();
+            cosAngle = std::max(-1.0,std::min(1.0,cosAngle));
+            double angle = std::acos(cosAngle);
+            double dist = (windowState->GetPosition().Vect()
+                           - fullState->GetPosition().Vect()).Mag();
+            histDirectionDifference->Fill(angle);
+            histPositionDifference->Fill(dist);
+            gMaxAngle = std::max(gMaxAngle,angle);
+            gMaxDistance = std::max(gMaxDistance,dist);
+            gAngleSum += angle;
+            if (angle > 1E-3) ++gLargeAngles;
+            if (curls) {
+                gCurlMaxAngle = std::max(gCurlMaxAngle,angle);
+                gCurlMaxDistance = std::max(gCurlMaxDistance,dist);
+            }
+            ++gNodes;
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    int maxEntries = 1E+8; // Maximum to process.
+    int firstEntry = 0;
+
+    while (true) {
+        int c = getopt(argc,argv,"n:s:m:");
+        if (c<0) break;
+        switch (c) {
+        case 'n': {
+            std::istringstream tmp(optarg);
+            tmp >> maxEntries;
+            break;
+        }
+        case 's': {
+            std::istringstream tmp(optarg);
+            tmp >> firstEntry;
+            break;
+        }
+        case 'm': {
+            std::istringstream tmp(optarg);
+            tmp >> gMinimumNodes;
+            break;
+        }
+        default: {
+            std::cout << "Usage: " << std::endl;
+            std::cout << "   "
+                      << "-s <number>  : Skip <number> entries"
+                      << std::endl
+                      << "-n <number>  : Process no more than"
+                      << " <number> events."
+                      << std::endl
+                      << "-m <number>  : Minimum number of nodes in"
+                      << " a track (default 50)."
+                      << std::endl;
+            exit(1);
+        }
+        }
+    }
+
+    if (argc <= optind) throw std::runtime_error("Missing input file");
+    std::string inputName(argv[optind++]);
+    std::cout << "Input Name " << inputName << std::endl;
+
+    std::string outputName;
+    if (argc > optind) {
+        outputName = argv[optind++];
+    }
+    else {
+        std::cout << "NO OUTPUT FILE!!!!" << std::endl;
+    }
+
+    // Attach to the input tree.
+    std::unique_ptr<TFile> inputFile(new TFile(inputName.c_str(),"old"));
+    if (!inputFile->IsOpen()) throw std::runtime_error("Input file not open");
+
+    /// Attach to the input tree.
+    TTree* inputTree = (TTree*) inputFile->Get("CubeEvents");
+    if (!inputTree) throw std::runtime_error("Missing the event tree");
+    Cube::Event *inputEvent = NULL;
+    inputTree->SetBranchAddress("Event",&inputEvent);
+
+    // Open the output file
+    std::unique_ptr<TFile> outputFile;
+    if (!outputName.empty()) {
+        std::cout << "Open Output File: " << outputName << std::endl;
+        outputFile.reset(new TFile(outputName.c_str(),"recreate"));
+    }
+
+    histDirectionDifference = new TH1F("directionDifference",
+                                       "Angle between window and full"
+                                       " node directions",
+                                       100, 0.0, 0.01);
+    histDirectionDifference->SetXTitle("Angle (rad)");
+    histPositionDifference = new TH1F("positionDifference",
+                                      "Distance between window and full"
+                                      " node positions",
+                                      100, 0.0, 0.1);
+    histPositionDifference->SetXTitle("Distance (mm)");
+
+    // Loop through the events.
+    int totalEntries = inputTree->GetEntries();
+    totalEntries = std::min(totalEntries,firstEntry+maxEntries);
+    for (int entry = firstEntry; entry < totalEntries; ++entry) {
+        inputTree->GetEntry(entry);
+        std::cout << "Process event " << inputEvent->GetRunId()
+                    << "/" << inputEvent->GetEventId() << std::endl;
+        inputEvent->MakeCurrentEvent();
+        AnalyzeEvent(*inputEvent);
+    }
+
+    std::cout << "Compared " << gNodes << " nodes on " << gTracks
+              << " tracks with at least " << gMinimumNodes << " nodes"
+              << std::endl;
+    std::cout << "Maximum direction difference " << gMaxAngle << " rad"
+              << ", maximum position difference " << gMaxDistance << " mm"
+              << std::endl;
+    if (gNodes > 0) {
+        std::cout << "Mean direction difference " << gAngleSum/gNodes
+                  << " rad, " << gLargeAngles
+                  << " nodes differ by more than 1 mrad" << std::endl;
+    }
+    std::cout << "Tracks that curl back: " << gCurlTracks
+              << ", maximum direction difference " << gCurlMaxAngle << " rad"
+              << ", maximum position difference " << gCurlMaxDistance << " mm"
+              << std::endl;
+    std::cout << "Window time " << gWindowTime << " ms"
+              << ", full time " << gFullTime << " ms" << std::endl;
+
+    if (outputFile) {
+        outputFile->Write();
+        outputFile->Close();
+    }
+
+    return 0;
+}
+
+// Local Variables:
+// mode:c++
+// c-basic-offset:4
+// compile-command:"$(git rev-parse --show-toplevel)/build/cube-build.sh force"
+// End:
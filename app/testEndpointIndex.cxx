@@ -0,0 +1,216 @@
+#include <CubeEvent.hxx>
+#include <CubeReconTrack.hxx>
+#include <CubeHandle.hxx>
+#include <CubeAlgorithmResult.hxx>
+#include <CubeHitSelection.hxx>
+
+#include <CubeBuildPairwiseVertices.hxx>
+#include <CubeGrowTracks.hxx>
+
+#include <TFile.h>
+#include <TTree.h>
+#include <TProfile.h>
+
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <memory>
+#include <map>
+
+/// The candidate pairs and time for each number of tracks, with and without
+/// the track end index.  Index 0 is without the index, and 1 is with it.
+namespace {
+    TProfile* histVertexCandidates[2] = {NULL, NULL};
+    TProfile* histVertexTime[2] = {NULL, NULL};
+    TProfile* histGrowCandidates[2] = {NULL, NULL};
+    TProfile* histGrowTime[2] = {NULL, NULL};
+    std::map<int,double> gVertexCandidates[2];
+    std::map<int,double> gVertexTime[2];
+    std::map<int,double> gGrowCandidates[2];
+    std::map<int,double> gGrowTime[2];
+    std::map<int,int> gTotalRuns;
+}
+
+/// Return the time between two points in milliseconds.
+double Milliseconds(std::chrono::high_resolution_clock::time_point start,
+                    std::chrono::high_resolution_clock::time_point stop) {
+    return std::chrono::duration<double,std::milli>(stop - start).count();
+}
+
+/// Run BuildPairwiseVertices and GrowTracks on the first N tracks of the
+/// event for a growing N, with and without the track end index, and record
+/// the number of track pairs checked and the time.
+void AnalyzeEvent(Cube::Event& event) {
+    Cube::Handle<Cube::ReconObjectContainer> objects
+        = event.GetObjectContainer();
+    if (!objects) return;
+    Cube::Handle<Cube::HitSelection> hits = event.GetHitSelection();
+    if (!hits) return;
+
+    Cube::ReconObjectContainer tracks;
+    for (Cube::ReconObjectContainer::iterator o = objects->begin();
+         o != objects->end(); ++o) {
+        Cube::Handle<Cube::ReconTrack> track = *o;
+        if (!track) continue;
+        tracks.push_back(track);
+    }
+
+    for (std::size_t n = 2; n <= tracks.size(); ++n) {
+        Cube::AlgorithmResult input;
+        input.AddHitSelection(hits);
+        Cube::Handle<Cube::ReconObjectContainer>
+            subset(new Cube::ReconObjectContainer("final"));
+        std::copy(tracks.begin(), tracks.begin()+n,
+                  std::back_inserter(*subset));
+        input.AddObjectContainer(subset);
+
+        for (int useIndex = 0; useIndex < 2; ++useIndex) {
+            Cube::BuildPairwiseVertices builder;
+            builder.SetUseEndpointIndex(useIndex);
+            std::chrono::high_resolution_clock::time_point start
+                = std::chrono::high_resolution_clock::now();
+            builder.Process(input);
+            double ms = Milliseconds(
+                start, std::chrono::high_resolution_clock::now());
+            histVertexCandidates[useIndex]->Fill(
+                n, builder.GetPairCandidateCount());
+            histVertexTime[useIndex]->Fill(n, ms);
+            gVertexCandidates[useIndex][n] += builder.GetPairCandidateCount();
+            gVertexTime[useIndex][n] += ms;
+
+            Cube::GrowTracks grower;
+            grower.SetUseEndpointIndex(useIndex);
+            start = std::chrono::high_resolution_clock::now();
+            grower.Process(input);
+            ms = Milliseconds(start, std::chrono::high_resolution_clock::now());
+            histGrowCandidates[useIndex]->Fill(
+                n, grower.GetMatchCandidateCount());
+            histGrowTime[useIndex]->Fill(n, ms);
+            gGrowCandidates[useIndex][n] += grower.GetMatchCandidateCount();
+            gGrowTime[useIndex][n] += ms;
+        }
+        ++gTotalRuns[n];
+    }
+}
+
+int main(int argc, char** argv) {
+    int maxEntries = 1E+8; // Maximum to process.
+    int firstEntry = 0;
+
+    while (true) {
+        int c = getopt(argc,argv,"n:s:");
+        if (c<0) break;
+        switch (c) {
+        case 'n': {
+            std::istringstream tmp(optarg);
+            tmp >> maxEntries;
+            break;
+        }
+        case 's': {
+            std::istringstream tmp(optarg);
+            tmp >> firstEntry;
+            break;
+        }
+        default: {
+            std::cout << "Usage: " << std::endl;
+            std::cout << "   "
+                      << "-s <number>  : Skip <number> entries"
+                      << std::endl
+                      << "-n <number>  : Process no more than"
+                      << " <number> events."
+                      << std::endl;
+            exit(1);
+        }
+        }
+    }
+
+    if (argc <= optind) throw std::runtime_error("Missing input file");
+    std::string inputName(argv[optind++]);
+    std::cout << "Input Name " << inputName << std::endl;
+
+    std::string outputName;
+    if (argc > optind) {
+        outputName = argv[optind++];
+    }
+    else {
+        std::cout << "NO OUTPUT FILE!!!!" << std::endl;
+    }
+
+    // Attach to the input tree.
+    std::unique_ptr<TFile> inputFile(new TFile(inputName.c_str(),"old"));
+    if (!inputFile->IsOpen()) throw std::runtime_error("Input file not open");
+
+    /// Attach to the input tree.
+    TTree* inputTree = (TTree*) inputFile->Get("CubeEvents");
+    if (!inputTree) throw std::runtime_error("Missing the event tree");
+    Cube::Event *inputEvent = NULL;
+    inputTree->SetBranchAddress("Event",&inputEvent);
+
+    // Open the output file
+    std::unique_ptr<TFile> outputFile;
+    if (!outputName.empty()) {
+        std::cout << "Open Output File: " << outputName << std::endl;
+        outputFile.reset(new TFile(outputName.c_str(),"recreate"));
+    }
+
+    const char* suffix[2] = {"AllPairs", "Indexed"};
+    for (int i = 0; i < 2; ++i) {
+        std::string name = std::string("vertexCandidates") + suffix[i];
+        histVertexCandidates[i] = new TProfile(
+            name.c_str(), "Vertex track pairs versus number of tracks",
+            50, 0.5, 50.5);
+        name = std::string("vertexTime") + suffix[i];
+        histVertexTime[i] = new TProfile(
+            name.c_str(), "Vertex building time versus tracks (ms)",
+            50, 0.5, 50.5);
+        name = std::string("growCandidates") + suffix[i];
+        histGrowCandidates[i] = new TProfile(
+            name.c_str(), "Track merge pairs versus number of tracks",
+            50, 0.5, 50.5);
+        name = std::string("growTime") + suffix[i];
+        histGrowTime[i] = new TProfile(
+            name.c_str(), "Track growing time versus tracks (ms)",
+            50, 0.5, 50.5);
+    }
+
+    // Loop through the events.
+    int totalEntries = inputTree->GetEntries();
+    totalEntries = std::min(totalEntries,firstEntry+maxEntries);
+    for (int entry = firstEntry; entry < totalEntries; ++entry) {
+        inputTree->GetEntry(entry);
+        std::cout << "Process event " << inputEvent->GetRunId()
+                    << "/" << inputEvent->GetEventId() << std::endl;
+        inputEvent->MakeCurrentEvent();
+        AnalyzeEvent(*inputEvent);
+    }
+
+    // Summarize the scaling.
+    for (std::map<int,int>::iterator r = gTotalRuns.begin();
+         r != gTotalRuns.end(); ++r) {
+        int n = r->first;
+        double runs = r->second;
+        std::cout << "Tracks " << n
+                  << ": vertex pairs " << gVertexCandidates[0][n]/runs
+                  << " -> " << gVertexCandidates[1][n]/runs
+                  << " (" << gVertexTime[0][n]/runs
+                  << " -> " << gVertexTime[1][n]/runs << " ms)"
+                  << ", merge pairs " << gGrowCandidates[0][n]/runs
+                  << " -> " << gGrowCandidates[1][n]/runs
+                  << " (" << gGrowTime[0][n]/runs
+                  << " -> " << gGrowTime[1][n]/runs << " ms)"
+                  << std::endl;
+    }
+
+    if (outputFile) {
+        outputFile->Write();
+        outputFile->Close();
+    }
+
+    return 0;
+}
+
+// Local Variables:
+// mode:c++
+// c-basic-offset:4
+// compile-command:"$(git rev-parse --show-toplevel)/build/cube-build.sh force"
+// End:
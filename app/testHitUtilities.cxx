@@ -0,0 +1,232 @@
+#include <CubeEvent.hxx>
+#include <CubeHandle.hxx>
+#include <CubeHitSelection.hxx>
+#include <CubeReconObject.hxx>
+#include <CubeHit.hxx>
+
+#include <CubeHitUtilities.hxx>
+
+#include <TFile.h>
+#include <TTree.h>
+#include <TProfile.h>
+
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <memory>
+#include <algorithm>
+#include <set>
+
+/// The time to collect the all, composite and simple hits for the
+/// reconstructed objects versus the number of hits in the event.  Index 0
+/// is the set based collection used before the hit collectors were added,
+/// and 1 is the Cube hit selection functions.
+namespace {
+    TProfile* histCollectTime[2] = {NULL, NULL};
+    double gTotalTime[2] = {0.0, 0.0};
+    int gEvents = 0;
+    int gDifferentEvents = 0;
+}
+
+/// Add a hit to the set, unpacking composite hits for simple hits.
+void SetHit(const Cube::Handle<Cube::Hit>& hit, bool composite, bool simple,
+            std::set< Cube::Handle<Cube::Hit> >& hitSet) {
+    if (hit->GetConstituentCount() < 1) {
+        if (!composite) hitSet.insert(hit);
+        return;
+    }
+    if (!simple) {
+        hitSet.insert(hit);
+        return;
+    }
+    // Unpack the composite hits into a local set, and then copy it.
+    std::set< Cube::Handle<Cube::Hit> > localSet;
+    for (int i=0; i < hit->GetConstituentCount(); ++i) {
+        SetHit(hit->GetConstituent(i), composite, simple, localSet);
+    }
+    hitSet.insert(localSet.begin(), localSet.end());
+}
+
+/// Add the hits for the objects (and their constituents) to a set.  The
+/// simple hits are found by unpacking the composite hits.  This is the way
+/// the hit selection functions used to work, and is kept here as the
+/// reference.
+void SetHits(Cube::ReconObjectContainer& input, bool composite, bool simple,
+             std::set< Cube::Handle<Cube::Hit> >& hitSet) {
+    for (Cube::ReconObjectContainer::iterator o = input.begin();
+         o != input.end(); ++o) {
+        Cube::Handle<Cube::HitSelection> objHits = (*o)->GetHitSelection();
+        if (objHits) {
+            for (Cube::HitSelection::iterator hit = objHits->begin();
+                 hit != objHits->end(); ++hit) {
+                SetHit(*hit, composite, simple, hitSet);
+            }
+        }
+        Cube::Handle<Cube::ReconObjectContainer> parts
+            = (*o)->GetConstituents();
+        if (!parts) continue;
+        std::set< Cube::Handle<Cube::Hit> > partSet;
+        SetHits(*parts, composite, simple, partSet);
+        hitSet.insert(partSet.begin(), partSet.end());
+    }
+}
+
+/// Check that a set has the same hits as a selection.
+bool SameHits(const std::set< Cube::Handle<Cube::Hit> >& hitSet,
+              Cube::HitSelection& hits) {
+    if (hitSet.size() != hits.size()) return false;
+    Cube::HitSelection sorted(hits);
+    std::sort(sorted.begin(), sorted.end());
+    std::size_t i = 0;
+    for (std::set< Cube::Handle<Cube::Hit> >::const_iterator h
+             = hitSet.begin();
+         h != hitSet.end(); ++h, ++i) {
+        if (!(*h == sorted[i])) return false;
+    }
+    return true;
+}
+
+/// Collect the all, composite and simple hits for the reconstructed objects
+/// with sets and with the hit selection functions, and record the time
+/// against the number of hits.  The results are compared as sets since the
+/// collectors keep the order the hits are found.
+void AnalyzeEvent(Cube::Event& event) {
+    Cube::Handle<Cube::ReconObjectContainer> objects
+        = event.GetObjectContainer();
+    if (!objects) return;
+    Cube::Handle<Cube::HitSelection> hits = event.GetHitSelection();
+    if (!hits) return;
+
+    std::set< Cube::Handle<Cube::Hit> > sets[3];
+    std::chrono::high_resolution_clock::time_point start
+        = std::chrono::high_resolution_clock::now();
+    SetHits(*objects, false, false, sets[0]);
+    SetHits(*objects, true, false, sets[1]);
+    SetHits(*objects, false, true, sets[2]);
+    std::chrono::high_resolution_clock::time_point stop
+        = std::chrono::high_resolution_clock::now();
+    double ms = std::chrono::duration<double,std::milli>(
+        stop - start).count();
+    histCollectTime[0]->Fill(hits->size(), ms);
+    gTotalTime[0] += ms;
+
+    Cube::HitSelection selections[3];
+    start = std::chrono::high_resolution_clock::now();
+    Cube::AllHitSelection(*objects, selections[0]);
+    Cube::CompositeHitSelection(*objects, selections[1]);
+    Cube::SimpleHitSelection(*objects, selections[2]);
+    stop = std::chrono::high_resolution_clock::now();
+    ms = std::chrono::duration<double,std::milli>(stop - start).count();
+    histCollectTime[1]->Fill(hits->size(), ms);
+    gTotalTime[1] += ms;
+
+    ++gEvents;
+    for (int i = 0; i < 3; ++i) {
+        if (SameHits(sets[i], selections[i])) continue;
+        std::cout << "Different hits for event " << event.GetEventId()
+                  << std::endl;
+        ++gDifferentEvents;
+        break;
+    }
+}
+
+int main(int argc, char** argv) {
+    int maxEntries = 1E+8; // Maximum to process.
+    int firstEntry = 0;
+
+    while (true) {
+        int c = getopt(argc,argv,"n:s:");
+        if (c<0) break;
+        switch (c) {
+        case 'n': {
+            std::istringstream tmp(optarg);
+            tmp >> maxEntries;
+            break;
+        }
+        case 's': {
+            std::istringstream tmp(optarg);
+            tmp >> firstEntry;
+            break;
+        }
+        default: {
+            std::cout << "Usage: " << std::endl;
+            std::cout << "   "
+                      << "-s <number>  : Skip <number> entries"
+                      << std::endl
+                      << "-n <number>  : Process no more than"
+                      << " <number> events."
+                      << std::endl;
+            exit(1);
+        }
+        }
+    }
+
+    if (argc <= optind) throw std::runtime_error("Missing input file");
+    std::string inputName(argv[optind++]);
+    std::cout << "Input Name " << inputName << std::endl;
+
+    std::string outputName;
+    if (argc > optind) {
+        outputName = argv[optind++];
+    }
+    else {
+        std::cout << "NO OUTPUT FILE!!!!" << std::endl;
+    }
+
+    // Attach to the input tree.
+    std::unique_ptr<TFile> inputFile(new TFile(inputName.c_str(),"old"));
+    if (!inputFile->IsOpen()) throw std::runtime_error("Input file not open");
+
+    /// Attach to the input tree.
+    TTree* inputTree = (TTree*) inputFile->Get("CubeEvents");
+    if (!inputTree) throw std::runtime_error("Missing the event tree");
+    Cube::Event *inputEvent = NULL;
+    inputTree->SetBranchAddress("Event",&inputEvent);
+
+    // Open the output file
+    std::unique_ptr<TFile> outputFile;
+    if (!outputName.empty()) {
+        std::cout << "Open Output File: " << outputName << std::endl;
+        outputFile.reset(new TFile(outputName.c_str(),"recreate"));
+    }
+
+    histCollectTime[0] = new TProfile("setTime",
+                                      "Set hit selection time (ms)",
+                                      50, 0.0, 50000.0);
+    histCollectTime[1] = new TProfile("collectorTime",
+                                      "Collector hit selection time (ms)",
+                                      50, 0.0, 50000.0);
+
+    // Loop through the events.
+    int totalEntries = inputTree->GetEntries();
+    totalEntries = std::min(totalEntries,firstEntry+maxEntries);
+    for (int entry = firstEntry; entry < totalEntries; ++entry) {
+        inputTree->GetEntry(entry);
+        std::cout << "Process event " << inputEvent->GetRunId()
+                    << "/" << inputEvent->GetEventId() << std::endl;
+        inputEvent->MakeCurrentEvent();
+        AnalyzeEvent(*inputEvent);
+    }
+
+    // Summarize the comparison.
+    std::cout << "Collected hits for " << gEvents << " events"
+              << " (" << gDifferentEvents << " different)" << std::endl;
+    std::cout << "Set: " << gTotalTime[0] << " ms" << std::endl;
+    std::cout << "Collector: " << gTotalTime[1] << " ms" << std::endl;
+    if (gTotalTime[1] > 0.0) {
+        std::cout << "Speedup " << gTotalTime[0]/gTotalTime[1] << std::endl;
+    }
+
+    if (outputFile) {
+        outputFile->Write();
+        outputFile->Close();
+    }
+
+    return 0;
+}
+
+// Local Variables:
+// mode:c++
+// c-basic-offset:4
+// compile-command:"$(git rev-parse --show-toplevel)/build/cube-build.sh force"
+// End:
@@ -0,0 +1,231 @@
+#include <CubeEvent.hxx>
+#include <CubeHandle.hxx>
+#include <CubeAlgorithmResult.hxx>
+#include <CubeHitSelection.hxx>
+
+#include <CubeMakeUsed.hxx>
+#include <CubeHitUtilities.hxx>
+
+#include <TFile.h>
+#include <TTree.h>
+#include <TProfile.h>
+
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <memory>
+#include <algorithm>
+
+/// The time to find the used and unused hits versus the number of hits in
+/// the event.  Index 0 is the sorted selection used before the generation
+/// stamps were added to Cube::MakeUsed, and 1 is Cube::MakeUsed.
+namespace {
+    TProfile* histUsedTime[2] = {NULL, NULL};
+    double gTotalTime[2] = {0.0, 0.0};
+    int gEvents = 0;
+    int gDifferentEvents = 0;
+}
+
+/// Find the used and unused hits by collecting every hit in the final
+/// objects, sorting them, and then doing a binary search for each of the
+/// input hits.  This is the way Cube::MakeUsed used to work, and is kept
+/// here as the reference.
+void SortedMakeUsed(Cube::HitSelection& allHits,
+                    Cube::ReconObjectContainer& finalObjects,
+                    Cube::HitSelection& usedHits,
+                    Cube::HitSelection& unusedHits) {
+    Cube::Handle<Cube::HitSelection> hits
+        = Cube::AllHitSelection(finalObjects);
+    if (hits) {
+        std::copy(hits->begin(), hits->end(), std::back_inserter(usedHits));
+    }
+    Cube::HitSelection::iterator end
+        = std::unique(usedHits.begin(), usedHits.end());
+    usedHits.erase(end, usedHits.end());
+
+    Cube::HitSelection everyLastHit;
+    std::copy(usedHits.begin(), usedHits.end(),
+              std::back_inserter(everyLastHit));
+    Cube::Handle<Cube::HitSelection> allTheSimpleHits
+        = Cube::SimpleHitSelection(everyLastHit);
+    std::copy(allTheSimpleHits->begin(), allTheSimpleHits->end(),
+              std::back_inserter(everyLastHit));
+    end = std::unique(everyLastHit.begin(), everyLastHit.end());
+    everyLastHit.erase(end, everyLastHit.end());
+    std::sort(everyLastHit.begin(),everyLastHit.end());
+
+    for (Cube::HitSelection::iterator hit = allHits.begin();
+         hit != allHits.end(); ++hit) {
+        if (std::binary_search(
+                everyLastHit.begin(),everyLastHit.end(),*hit)) {
+            continue;
+        }
+        unusedHits.push_back(*hit);
+    }
+    end = std::unique(unusedHits.begin(), unusedHits.end());
+    unusedHits.erase(end, unusedHits.end());
+}
+
+/// Check that two hit selections have the same hits in the same order.
+bool SameHits(const Cube::HitSelection& a, const Cube::HitSelection& b) {
+    if (a.size() != b.size()) return false;
+    for (std::size_t i = 0; i < a.size(); ++i) {
+        if (!(a[i] == b[i])) return false;
+    }
+    return true;
+}
+
+/// Find the used and unused hits for all of the objects in the event using
+/// the sorted selection and Cube::MakeUsed, and record the time against the
+/// number of hits.  The used hits are compared as sets since the order
+/// isn't the same (and the sorted selection can have duplicates), and the
+/// unused hits must match exactly.
+void AnalyzeEvent(Cube::Event& event) {
+    Cube::Handle<Cube::ReconObjectContainer> objects
+        = event.GetObjectContainer();
+    if (!objects) return;
+    Cube::Handle<Cube::HitSelection> hits = event.GetHitSelection();
+    if (!hits) return;
+
+    Cube::Handle<Cube::ReconObjectContainer>
+        finalObjects(new Cube::ReconObjectContainer("final"));
+    std::copy(objects->begin(), objects->end(),
+              std::back_inserter(*finalObjects));
+
+    Cube::HitSelection sortedUsed;
+    Cube::HitSelection sortedUnused;
+    std::chrono::high_resolution_clock::time_point start
+        = std::chrono::high_resolution_clock::now();
+    SortedMakeUsed(*hits, *finalObjects, sortedUsed, sortedUnused);
+    std::chrono::high_resolution_clock::time_point stop
+        = std::chrono::high_resolution_clock::now();
+    double ms = std::chrono::duration<double,std::milli>(
+        stop - start).count();
+    histUsedTime[0]->Fill(hits->size(), ms);
+    gTotalTime[0] += ms;
+
+    Cube::Handle<Cube::AlgorithmResult> result(new Cube::AlgorithmResult);
+    result->AddObjectContainer(finalObjects);
+    start = std::chrono::high_resolution_clock::now();
+    Cube::MakeUsed makeUsed(*hits);
+    makeUsed(result);
+    stop = std::chrono::high_resolution_clock::now();
+    ms = std::chrono::duration<double,std::milli>(stop - start).count();
+    histUsedTime[1]->Fill(hits->size(), ms);
+    gTotalTime[1] += ms;
+
+    ++gEvents;
+    Cube::HitSelection stampedUsed(*result->GetHitSelection("used"));
+    Cube::HitSelection stampedUnused(*result->GetHitSelection("unused"));
+    std::sort(sortedUsed.begin(), sortedUsed.end());
+    std::sort(stampedUsed.begin(), stampedUsed.end());
+    sortedUsed.erase(std::unique(sortedUsed.begin(), sortedUsed.end()),
+                     sortedUsed.end());
+    if (!SameHits(sortedUsed,stampedUsed)
+        || !SameHits(sortedUnused,stampedUnused)) {
+        std::cout << "Different hits for event " << event.GetEventId()
+                  << std::endl;
+        ++gDifferentEvents;
+    }
+}
+
+int main(int argc, char** argv) {
+    int maxEntries = 1E+8; // Maximum to process.
+    int firstEntry = 0;
+
+    while (true) {
+        int c = getopt(argc,argv,"n:s:");
+        if (c<0) break;
+        switch (c) {
+        case 'n': {
+            std::istringstream tmp(optarg);
+            tmp >> maxEntries;
+            break;
+        }
+        case 's': {
+            std::istringstream tmp(optarg);
+            tmp >> firstEntry;
+            break;
+        }
+        default: {
+            std::cout << "Usage: " << std::endl;
+            std::cout << "   "
+                      << "-s <number>  : Skip <number> entries"
+                      << std::endl
+                      << "-n <number>  : Process no more than"
+                      << " <number> events."
+                      << std::endl;
+            exit(1);
+        }
+        }
+    }
+
+    if (argc <= optind) throw std::runtime_error("Missing input file");
+    std::string inputName(argv[optind++]);
+    std::cout << "Input Name " << inputName << std::endl;
+
+    std::string outputName;
+    if (argc > optind) {
+        outputName = argv[optind++];
+    }
+    else {
+        std::cout << "NO OUTPUT FILE!!!!" << std::endl;
+    }
+
+    // Attach to the input tree.
+    std::unique_ptr<TFile> inputFile(new TFile(inputName.c_str(),"old"));
+    if (!inputFile->IsOpen()) throw std::runtime_error("Input file not open");
+
+    /// Attach to the input tree.
+    TTree* inputTree = (TTree*) inputFile->Get("CubeEvents");
+    if (!inputTree) throw std::runtime_error("Missing the event tree");
+    Cube::Event *inputEvent = NULL;
+    inputTree->SetBranchAddress("Event",&inputEvent);
+
+    // Open the output file
+    std::unique_ptr<TFile> outputFile;
+    if (!outputName.empty()) {
+        std::cout << "Open Output File: " << outputName << std::endl;
+        outputFile.reset(new TFile(outputName.c_str(),"recreate"));
+    }
+
+    histUsedTime[0] = new TProfile("sortedTime",
+                                   "Sorted used hits time versus hits (ms)",
+                                   50, 0.0, 50000.0);
+    histUsedTime[1] = new TProfile("stampedTime",
+                                   "Stamped used hits time versus hits (ms)",
+                                   50, 0.0, 50000.0);
+
+    // Loop through the events.
+    int totalEntries = inputTree->GetEntries();
+    totalEntries = std::min(totalEntries,firstEntry+maxEntries);
+    for (int entry = firstEntry; entry < totalEntries; ++entry) {
+        inputTree->GetEntry(entry);
+        std::cout << "Process event " << inputEvent->GetRunId()
+                    << "/" << inputEvent->GetEventId() << std::endl;
+        inputEvent->MakeCurrentEvent();
+        AnalyzeEvent(*inputEvent);
+    }
+
+    // Summarize the comparison.
+    std::cout << "Found used hits in " << gEvents << " events"
+              << " (" << gDifferentEvents << " different)" << std::endl;
+    std::cout << "Sorted: " << gTotalTime[0] << " ms" << std::endl;
+    std::cout << "Stamped: " << gTotalTime[1] << " ms" << std::endl;
+    if (gTotalTime[1] > 0.0) {
+        std::cout << "Speedup " << gTotalTime[0]/gTotalTime[1] << std::endl;
+    }
+
+    if (outputFile) {
+        outputFile->Write();
+        outputFile->Close();
+    }
+
+    return 0;
+}
+
+// Local Variables:
+// mode:c++
+// c-basic-offset:4
+// compile-command:"$(git rev-parse --show-toplevel)/build/cube-build.sh force"
+// End:
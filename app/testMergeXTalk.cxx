@@ -0,0 +1,187 @@
+#include <CubeEvent.hxx>
+#include <CubeReconTrack.hxx>
+#include <CubeHandle.hxx>
+#include <CubeAlgorithmResult.hxx>
+#include <CubeHitSelection.hxx>
+
+#include <CubeMergeXTalk.hxx>
+
+#include <TFile.h>
+#include <TTree.h>
+#include <TProfile.h>
+
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <memory>
+
+/// The time to merge the cross talk versus the number of hits in the event,
+/// with and without the neighbor index.  Index 0 is without the neighbor
+/// index, and 1 is with it.
+namespace {
+    TProfile* histMergeTime[2] = {NULL, NULL};
+    double gTotalTime[2] = {0.0, 0.0};
+    int gEvents = 0;
+    int gDifferentEvents = 0;
+}
+
+/// Check that two results have the same objects with the same hits.
+bool SameResult(Cube::Handle<Cube::AlgorithmResult> a,
+                Cube::Handle<Cube::AlgorithmResult> b) {
+    if (!a || !b) return (!a && !b);
+    Cube::Handle<Cube::ReconObjectContainer> aObjects
+        = a->GetObjectContainer();
+    Cube::Handle<Cube::ReconObjectContainer> bObjects
+        = b->GetObjectContainer();
+    if (!aObjects || !bObjects) return (!aObjects && !bObjects);
+    if (aObjects->size() != bObjects->size()) return false;
+    for (std::size_t i = 0; i < aObjects->size(); ++i) {
+        Cube::Handle<Cube::HitSelection> aHits
+            = (*aObjects)[i]->GetHitSelection();
+        Cube::Handle<Cube::HitSelection> bHits
+            = (*bObjects)[i]->GetHitSelection();
+        if (!aHits || !bHits) {
+            if (aHits || bHits) return false;
+            continue;
+        }
+        if (aHits->size() != bHits->size()) return false;
+        for (std::size_t j = 0; j < aHits->size(); ++j) {
+            if (!((*aHits)[j] == (*bHits)[j])) return false;
+        }
+    }
+    return true;
+}
+
+/// Run MergeXTalk on the reconstructed objects with and without the
+/// neighbor index, and record the time against the number of hits.
+void AnalyzeEvent(Cube::Event& event) {
+    Cube::Handle<Cube::ReconObjectContainer> objects
+        = event.GetObjectContainer();
+    if (!objects) return;
+    Cube::Handle<Cube::HitSelection> hits = event.GetHitSelection();
+    if (!hits) return;
+
+    Cube::AlgorithmResult input;
+    input.AddHitSelection(hits);
+    input.AddObjectContainer(objects);
+
+    Cube::Handle<Cube::AlgorithmResult> results[2];
+    for (int useIndex = 0; useIndex < 2; ++useIndex) {
+        Cube::MergeXTalk mergeXTalk;
+        mergeXTalk.SetUseNeighborIndex(useIndex);
+        std::chrono::high_resolution_clock::time_point start
+            = std::chrono::high_resolution_clock::now();
+        results[useIndex] = mergeXTalk.Process(input);
+        std::chrono::high_resolution_clock::time_point stop
+            = std::chrono::high_resolution_clock::now();
+        double ms = std::chrono::duration<double,std::milli>(
+            stop - start).count();
+        histMergeTime[useIndex]->Fill(hits->size(), ms);
+        gTotalTime[useIndex] += ms;
+    }
+
+    ++gEvents;
+    if (!SameResult(results[0],results[1])) {
+        std::cout << "Different result for event " << event.GetEventId()
+                  << std::endl;
+        ++gDifferentEvents;
+    }
+}
+
+int main(int argc, char** argv) {
+    int maxEntries = 1E+8; // Maximum to process.
+    int firstEntry = 0;
+
+    while (true) {
+        int c = getopt(argc,argv,"n:s:");
+        if (c<0) break;
+        switch (c) {
+        case 'n': {
+            std::istringstream tmp(optarg);
+            tmp >> maxEntries;
+            break;
+        }
+        case 's': {
+            std::istringstream tmp(optarg);
+            tmp >> firstEntry;
+            break;
+        }
+        default: {
+            std::cout << "Usage: " << std::endl;
+            std::cout << "   "
+                      << "-s <number>  : Skip <number> entries"
+                      << std::endl
+                      << "-n <number>  : Process no more than"
+                      << " <number> events."
+                      << std::endl;
+            exit(1);
+        }
+        }
+    }
+
+    if (argc <= optind) throw std::runtime_error("Missing input file");
+    std::string inputName(argv[optind++]);
+    std::cout << "Input Name " << inputName << std::endl;
+
+    std::string outputName;
+    if (argc > optind) {
+        outputName = argv[optind++];
+    }
+    else {
+        std::cout << "NO OUTPUT FILE!!!!" << std::endl;
+    }
+
+    // Attach to the input tree.
+    std::unique_ptr<TFile> inputFile(new TFile(inputName.c_str(),"old"));
+    if (!inputFile->IsOpen()) throw std::runtime_error("Input file not open");
+
+    /// Attach to the input tree.
+    TTree* inputTree = (TTree*) inputFile->Get("CubeEvents");
+    if (!inputTree) throw std::runtime_error("Missing the event tree");
+    Cube::Event *inputEvent = NULL;
+    inputTree->SetBranchAddress("Event",&inputEvent);
+
+    // Open the output file
+    std::unique_ptr<TFile> outputFile;
+    if (!outputName.empty()) {
+        std::cout << "Open Output File: " << outputName << std::endl;
+        outputFile.reset(new TFile(outputName.c_str(),"recreate"));
+    }
+
+    histMergeTime[0] = new TProfile("mergeTimeAllHits",
+                                    "Cross talk merge time versus hits (ms)",
+                                    50, 0.0, 5000.0);
+    histMergeTime[1] = new TProfile("mergeTimeIndexed",
+                                    "Cross talk merge time versus hits"
+                                    " with the neighbor index (ms)",
+                                    50, 0.0, 5000.0);
+
+    // Loop through the events.
+    int totalEntries = inputTree->GetEntries();
+    totalEntries = std::min(totalEntries,firstEntry+maxEntries);
+    for (int entry = firstEntry; entry < totalEntries; ++entry) {
+        inputTree->GetEntry(entry);
+        std::cout << "Process event " << inputEvent->GetRunId()
+                    << "/" << inputEvent->GetEventId() << std::endl;
+        inputEvent->MakeCurrentEvent();
+        AnalyzeEvent(*inputEvent);
+    }
+
+    std::cout << "Events " << gEvents
+              << ", different results " << gDifferentEvents << std::endl;
+    std::cout << "All hits " << gTotalTime[0] << " ms"
+              << ", neighbor index " << gTotalTime[1] << " ms" << std::endl;
+
+    if (outputFile) {
+        outputFile->Write();
+        outputFile->Close();
+    }
+
+    return 0;
+}
+
+// Local Variables:
+// mode:c++
+// c-basic-offset:4
+// compile-command:"$(git rev-parse --show-toplevel)/build/cube-build.sh force"
+// End:
@@ -0,0 +1,314 @@
+#include <CubeEvent.hxx>
+#include <CubeReconTrack.hxx>
+#include <CubeReconNode.hxx>
+#include <CubeHandle.hxx>
+#include <CubeUnits.hxx>
+
+#include <CubeNodeTimeFit.hxx>
+#include <CubeTrackMeasurements.hxx>
+
+#include <TFile.h>
+#include <TTree.h>
+
+#include <Math/Minimizer.h>
+#include <Math/Factory.h>
+#include <Math/Functor.h>
+
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+/// Compare the closed form fit of the node times (Cube::NodeTimeFit) to a
+/// Minuit (Migrad) minimization of the same chi-squared on the same nodes.
+/// The chi-squared is the plain weighted least squares with the quadratic
+/// penalty for positive inverse velocities.  The fitted time offset and
+/// inverse velocity must agree to within a small fraction of the time
+/// offset uncertainty, and the uncertainties must agree.  The difference
+/// from the truncated chi-squared that was used by the old Minuit fit is
+/// reported (but isn't checked), and the time per track is reported for
+/// the closed form and Minuit fits.
+namespace {
+    // The allowed difference as a fraction of the T0 uncertainty.
+    double gTolerance = 1E-3;
+
+    // The number of times the closed form fit is repeated for the timing.
+    int gRepeats = 100;
+
+    long gTracks = 0;
+    long gDifferentTracks = 0;
+    long gFailedFits = 0;
+    double gMaxT0Pull = 0.0;
+    double gMaxInvBetaPull = 0.0;
+    double gTruncatedT0Sum = 0.0;
+    double gTruncatedT0Max = 0.0;
+    double gClosedTime = 0.0;
+    double gMinuitTime = 0.0;
+
+    // The penalty for positive inverse velocities (the same as the default
+    // for Cube::NodeTimeFit).
+    const double kPenalty = 4.0;
+
+    // The times and weights of the nodes on a track.
+    struct NodeTimes {
+        std::vector<double> fTravel;
+        std::vector<double> fTimes;
+        std::vector<double> fWeights;
+    };
+
+    // The chi-squared minimized by Cube::NodeTimeFit.
+    struct PlainChi2 {
+        explicit PlainChi2(const NodeTimes& n): fNodes(&n) {}
+        double operator () (const double* par) const {
+            double invBeta = std::max(0.0, par[0]);
+            double chi2 = kPenalty*invBeta*invBeta;
+            for (std::size_t i = 0; i < fNodes->fTimes.size(); ++i) {
+                double tExp = par[0]*fNodes->fTravel[i] + par[1];
+                double diff = tExp - fNodes->fTimes[i];
+                chi2 += fNodes->fWeights[i]*diff*diff;
+            }
+            return chi2;
+        }
+        const NodeTimes* fNodes;
+    };
+
+    // The truncated chi-squared that was minimized by the old Minuit fit.
+    struct TruncatedChi2 {
+        explicit TruncatedChi2(const NodeTimes& n): fNodes(&n) {}
+        double operator () (const double* par) const {
+            double invBeta = std::max(0.0, par[0]);
+            double chi2 = kPenalty*invBeta*invBeta;
+            const double eps = 1E-6;
+            const double chi2Cut = 9.0;
+            for (std::size_t i = 0; i < fNodes->fTimes.size(); ++i) {
+                double tExp = par[0]*fNodes->fTravel[i] + par[1];
+                double diff = tExp - fNodes->fTimes[i];
+                double cc = fNodes->fWeights[i]*diff*diff;
+                cc = 1.0/(1.0/(cc+eps) + 1.0/chi2Cut)
+                    - 1.0/(1.0/eps + 1.0/chi2Cut);
+                chi2 += cc;
+            }
+            return chi2;
+        }
+        const NodeTimes* fNodes;
+    };
+
+    // Minimize a chi-squared with Migrad.  The values are the inverse
+    // velocity and time offset, and the errors are the uncertainties.
+    template <typename Chi2>
+    bool MinuitFit(const Chi2& chi2, double startT0,
+                   double values[2], double errors[2]) {
+        std::unique_ptr<ROOT::Math::Minimizer>
+            minimizer(ROOT::Math::Factory::CreateMinimizer("Minuit",
+                                                           "Migrad"));
+        if (!minimizer) return false;
+        ROOT::Math::Functor functor(chi2,2);
+        minimizer->SetFunction(functor);
+        minimizer->SetVariable(0,"invBeta",0.0,1.0);
+        minimizer->SetVariable(1,"T0",startT0,1.0);
+        minimizer->SetTolerance(1E-6);
+        minimizer->SetPrintLevel(0);
+        minimizer->Minimize();
+        for (int i = 0; i < 2; ++i) {
+            values[i] = minimizer->X()[i];
+            errors[i] = minimizer->Errors()[i];
+        }
+        return true;
+    }
+}
+
+/// Fill the node times and weights, and the travel along the track.  This
+/// returns false if the nodes can't be used.
+bool FillNodeTimes(Cube::ReconNodeContainer& nodes, NodeTimes& nodeTimes) {
+    Cube::TrackMeasurements measurements;
+    if (!measurements.Fill(nodes)) return false;
+    Cube::NodeTravel(nodes,nodeTimes.fTravel);
+    nodeTimes.fTimes.clear();
+    nodeTimes.fWeights.clear();
+    for (std::size_t i = 0; i < measurements.size(); ++i) {
+        nodeTimes.fTimes.push_back(measurements[i].GetPosition(3));
+        nodeTimes.fWeights.push_back(1.0/measurements[i].GetVariance(3));
+    }
+    return true;
+}
+
+/// Compare the closed form and Minuit fits for every track in the event.
+void AnalyzeEvent(Cube::Event& event) {
+    Cube::Handle<Cube::ReconObjectContainer> objects
+        = event.GetObjectContainer();
+    if (!objects) return;
+
+    for (Cube::ReconObjectContainer::iterator o = objects->begin();
+         o != objects->end(); ++o) {
+        Cube::Handle<Cube::ReconTrack> track = *o;
+        if (!track) continue;
+        if (track->GetNodes().size() < 3) continue;
+        NodeTimes nodeTimes;
+        if (!FillNodeTimes(track->GetNodes(),nodeTimes)) continue;
+        ++gTracks;
+
+        // The closed form fit.  It's repeated to get a measurable time.
+        std::chrono::high_resolution_clock::time_point start
+            = std::chrono::high_resolution_clock::now();
+        Cube::NodeTimeFit timeFit;
+        bool solved = false;
+        for (int r = 0; r < gRepeats; ++r) {
+            timeFit.Clear();
+            for (std::size_t i = 0; i < nodeTimes.fTimes.size(); ++i) {
+                timeFit.Add(nodeTimes.fTravel[i],nodeTimes.fTimes[i],
+                            nodeTimes.fWeights[i]);
+            }
+            solved = timeFit.Solve();
+        }
+        std::chrono::high_resolution_clock::time_point middle
+            = std::chrono::high_resolution_clock::now();
+
+        // The same chi-squared minimized by Minuit.
+        std::vector<double> sorted(nodeTimes.fTimes);
+        std::sort(sorted.begin(), sorted.end());
+        double median = sorted[sorted.size()/2];
+        double values[2];
+        double errors[2];
+        PlainChi2 plain(nodeTimes);
+        bool minimized = MinuitFit(plain,median,values,errors);
+        std::chrono::high_resolution_clock::time_point stop
+            = std::chrono::high_resolution_clock::now();
+        gClosedTime += std::chrono::duration<double,std::micro>(
+            middle-start).count()/gRepeats;
+        gMinuitTime += std::chrono::duration<double,std::micro>(
+            stop-middle).count();
+
+        if (!solved || !minimized) {
+            ++gFailedFits;
+            continue;
+        }
+
+        double sigma = std::sqrt(timeFit.GetT0Variance());
+        double t0Pull = std::abs(values[1] - timeFit.GetT0())/sigma;
+        double invBetaPull = std::abs(values[0] - timeFit.GetInvBeta())
+            /std::max(errors[0], 1E-6);
+        double errorDiff = std::abs(errors[1] - sigma)/sigma;
+        gMaxT0Pull = std::max(gMaxT0Pull, t0Pull);
+        gMaxInvBetaPull = std::max(gMaxInvBetaPull, invBetaPull);
+        if (t0Pull > gTolerance || invBetaPull > gTolerance
+            || errorDiff > 1E-2) {
+            ++gDifferentTracks;
+            std::cout << "Track " << track->GetUniqueID()
+                      << " in event " << event.GetRunId()
+                      << "/" << event.GetEventId()
+                      << " T0 " << timeFit.GetT0()
+                      << " (Minuit " << values[1] << ")"
+                      << " invBeta " << timeFit.GetInvBeta()
+                      << " (Minuit " << values[0] << ")"
+                      << " sigma " << sigma
+                      << " (Minuit " << errors[1] << ")"
+                      << std::endl;
+        }
+
+        // The difference from the old truncated chi-squared.
+        TruncatedChi2 truncated(nodeTimes);
+        if (!MinuitFit(truncated,median,values,errors)) continue;
+        double diff = std::abs(values[1] - timeFit.GetT0());
+        gTruncatedT0Sum += diff;
+        gTruncatedT0Max = std::max(gTruncatedT0Max, diff);
+    }
+}
+
+int main(int argc, char** argv) {
+    int maxEntries = 1E+8; // Maximum to process.
+    int firstEntry = 0;
+
+    while (true) {
+        int c = getopt(argc,argv,"n:s:r:");
+        if (c<0) break;
+        switch (c) {
+        case 'n': {
+            std::istringstream tmp(optarg);
+            tmp >> maxEntries;
+            break;
+        }
+        case 's': {
+            std::istringstream tmp(optarg);
+            tmp >> firstEntry;
+            break;
+        }
+        case 'r': {
+            std::istringstream tmp(optarg);
+            tmp >> gRepeats;
+            gRepeats = std::max(1, gRepeats);
+            break;
+        }
+        default: {
+            std::cout << "Usage: " << std::endl;
+            std::cout << "   "
+                      << "-s <number>  : Skip <number> entries"
+                      << std::endl
+                      << "-n <number>  : Process no more than"
+                      << " <number> events."
+                      << std::endl
+                      << "-r <number>  : Repeat the closed form fit"
+                      << " <number> times for the timing (default 100)."
+                      << std::endl;
+            exit(1);
+        }
+        }
+    }
+
+    if (argc <= optind) throw std::runtime_error("Missing input file");
+    std::string inputName(argv[optind++]);
+    std::cout << "Input Name " << inputName << std::endl;
+
+    // Attach to the input tree.
+    std::unique_ptr<TFile> inputFile(new TFile(inputName.c_str(),"old"));
+    if (!inputFile->IsOpen()) throw std::runtime_error("Input file not open");
+
+    /// Attach to the input tree.
+    TTree* inputTree = (TTree*) inputFile->Get("CubeEvents");
+    if (!inputTree) throw std::runtime_error("Missing the event tree");
+    Cube::Event *inputEvent = NULL;
+    inputTree->SetBranchAddress("Event",&inputEvent);
+
+    // Loop through the events.
+    int totalEntries = inputTree->GetEntries();
+    totalEntries = std::min(totalEntries,firstEntry+maxEntries);
+    for (int entry = firstEntry; entry < totalEntries; ++entry) {
+        inputTree->GetEntry(entry);
+        std::cout << "Process event " << inputEvent->GetRunId()
+                    << "/" << inputEvent->GetEventId() << std::endl;
+        inputEvent->MakeCurrentEvent();
+        AnalyzeEvent(*inputEvent);
+    }
+
+    std::cout << "Compared " << gTracks << " tracks, "
+              << gDifferentTracks << " different, "
+              << gFailedFits << " failed fits" << std::endl;
+    std::cout << "Maximum difference from Minuit: T0 " << gMaxT0Pull
+              << " sigma, invBeta " << gMaxInvBetaPull << " sigma"
+              << std::endl;
+    if (gTracks > 0) {
+        std::cout << "Difference from the truncated chi-squared fit:"
+                  << " mean " << gTruncatedT0Sum/gTracks/unit::ns << " ns"
+                  << ", maximum " << gTruncatedT0Max/unit::ns << " ns"
+                  << std::endl;
+        std::cout << "Time per track: closed form "
+                  << gClosedTime/gTracks << " us"
+                  << ", Minuit " << gMinuitTime/gTracks << " us"
+                  << std::endl;
+    }
+
+    if (gDifferentTracks > 0 || gFailedFits > 0) {
+        std::cout << "FAIL: The closed form doesn't match Minuit"
+                  << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Local Variables:
+// mode:c++
+// c-basic-offset:4
+// compile-command:"$(git rev-parse --show-toplevel)/build/cube-build.sh force"
+// End:
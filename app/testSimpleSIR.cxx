@@ -0,0 +1,185 @@
+#include <SimpleSIR.hh>
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cmath>
+
+/// Check the systematic resampling in SimpleSIR with fixed random offsets.
+/// The weights are set by the likelihood, and the filter is told to
+/// resample on every update.  Each sample holds its original index, so the
+/// number of copies of each sample can be counted after the resampling.
+/// This checks that
+///
+///  - the number of copies of each sample is exactly what is expected for
+///    the offset, and is within one of the sample count times the weight,
+///  - samples with zero weight are never copied,
+///  - the copies are in the same order as the input (the resampler doesn't
+///    sort the samples by weight),
+///  - averaged over offsets spread uniformly over the step, the number of
+///    copies is the sample count times the weight,
+///  - the weights are reset to uniform when the likelihood is zero for
+///    every sample.
+namespace {
+    // The unnormalized weights.  They aren't in order, so a resampler that
+    // sorted the samples by weight would change the output order.
+    const int kSamples = 10;
+    const double kWeights[kSamples] = {3, 0, 1, 7, 2, 0, 5, 1, 0, 1};
+
+    // The offset returned by the random number generator.
+    double gOffset = 0.0;
+
+    // The likelihood to apply (scaled by the weights).
+    double gLikelihoodScale = 1.0;
+
+    struct TestMeasure {};
+
+    typedef SimpleSIRSamples<1> TestSamples;
+
+    struct TestPropagate {
+        void operator () (TestSamples&, const TestMeasure&) {}
+    };
+
+    struct TestLikelihood {
+        void operator () (const TestSamples& samples, const TestMeasure&,
+                          double* likelihood) {
+            for (std::size_t s = 0; s < samples.size(); ++s) {
+                int index = (int) samples[0][s];
+                likelihood[s] = gLikelihoodScale*kWeights[index];
+            }
+        }
+    };
+
+    struct TestRandom {
+        double operator () () {return gOffset;}
+    };
+
+    typedef SimpleSIR<1, TestPropagate, TestMeasure,
+                      TestLikelihood, TestRandom> TestSIR;
+
+    int gFailures = 0;
+
+    void Fail(const std::string& message) {
+        std::cout << "FAIL: " << message << std::endl;
+        ++gFailures;
+    }
+}
+
+/// Fill the samples so each sample holds its index and has a unit weight.
+void FillSamples(TestSamples& samples) {
+    samples.resize(kSamples);
+    for (int s = 0; s < kSamples; ++s) {
+        samples[0][s] = s;
+        samples.Weight[s] = 1.0;
+    }
+}
+
+/// Resample with a fixed offset and return the number of copies of each
+/// input sample.  The output order is checked.
+std::vector<int> CountCopies(double offset) {
+    gOffset = offset;
+    gLikelihoodScale = 1.0;
+    TestSIR filter;
+    filter.SetResampleFraction(1.0);
+    TestSamples samples;
+    FillSamples(samples);
+    std::vector<int> copies(kSamples,0);
+    if (!filter.UpdateSamples(samples,TestMeasure())) {
+        Fail("The samples were not resampled");
+        return copies;
+    }
+    if ((int) samples.size() != kSamples) Fail("Wrong number of samples");
+    int previous = -1;
+    for (std::size_t s = 0; s < samples.size(); ++s) {
+        int index = (int) samples[0][s];
+        if (index < previous) Fail("The resampled order changed");
+        previous = index;
+        ++copies[index];
+        if (std::abs(samples.Weight[s] - 1.0/kSamples) > 1E-12) {
+            Fail("The resampled weight isn't uniform");
+        }
+    }
+    return copies;
+}
+
+int main(int argc, char** argv) {
+    double total = 0.0;
+    for (int i = 0; i < kSamples; ++i) total += kWeights[i];
+
+    // The expected number of copies for a fixed offset.  Sample i is chosen
+    // for the steps k where C(i-1) < (k+offset)/N <= C(i), and C(i) is the
+    // cumulative weight.
+    const int kOffsets = 4;
+    const double offsets[kOffsets] = {0.05, 0.3, 0.65, 0.95};
+    for (int o = 0; o < kOffsets; ++o) {
+        std::vector<int> copies = CountCopies(offsets[o]);
+        double cumulative = 0.0;
+        int sum = 0;
+        for (int i = 0; i < kSamples; ++i) {
+            double low = kSamples*cumulative/total - offsets[o];
+            cumulative += kWeights[i];
+            double high = kSamples*cumulative/total - offsets[o];
+            int expected = (int) std::floor(high) - (int) std::floor(low);
+            double mean = kSamples*kWeights[i]/total;
+            std::cout << "offset " << offsets[o]
+                      << " sample " << i
+                      << " copies " << copies[i]
+                      << " expected " << expected
+                      << " (N*w " << mean << ")" << std::endl;
+            if (copies[i] != expected) Fail("Wrong number of copies");
+            if (std::abs(copies[i] - mean) >= 1.0) {
+                Fail("Copies not within one of N*w");
+            }
+            if (kWeights[i] <= 0.0 && copies[i] > 0) {
+                Fail("A zero weight sample was copied");
+            }
+            sum += copies[i];
+        }
+        if (sum != kSamples) Fail("The copies don't add up");
+    }
+
+    // Average over offsets spread uniformly over the step.  The mean number
+    // of copies must be N*w to within the spacing of the offsets.
+    const int kSteps = 1000;
+    std::vector<double> average(kSamples,0.0);
+    for (int j = 0; j < kSteps; ++j) {
+        std::vector<int> copies = CountCopies((j+0.5)/kSteps);
+        for (int i = 0; i < kSamples; ++i) average[i] += 1.0*copies[i]/kSteps;
+    }
+    for (int i = 0; i < kSamples; ++i) {
+        double mean = kSamples*kWeights[i]/total;
+        std::cout << "sample " << i << " average copies " << average[i]
+                  << " N*w " << mean << std::endl;
+        if (std::abs(average[i] - mean) > 2.0/kSteps) {
+            Fail("The average copies are not N*w");
+        }
+    }
+
+    // A likelihood of zero for every sample resets the weights.
+    gOffset = 0.5;
+    gLikelihoodScale = 0.0;
+    TestSIR filter;
+    filter.SetResampleFraction(0.0);
+    TestSamples samples;
+    FillSamples(samples);
+    filter.UpdateSamples(samples,TestMeasure());
+    for (std::size_t s = 0; s < samples.size(); ++s) {
+        if (std::abs(samples.Weight[s] - 1.0/kSamples) > 1E-12) {
+            Fail("The weights weren't reset for a zero likelihood");
+            break;
+        }
+    }
+
+    if (gFailures > 0) {
+        std::cout << "FAIL: " << gFailures << " failures" << std::endl;
+        return 1;
+    }
+    std::cout << "SimpleSIR resampling is correct" << std::endl;
+    return 0;
+}
+
+// Local Variables:
+// mode:c++
+// c-basic-offset:4
+// compile-command:"$(git rev-parse --show-toplevel)/build/cube-build.sh force"
+// End:
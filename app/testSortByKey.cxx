@@ -0,0 +1,225 @@
+#include <CubeEvent.hxx>
+#include <CubeHandle.hxx>
+#include <CubeHitSelection.hxx>
+#include <CubeReconObject.hxx>
+#include <CubeHit.hxx>
+
+#include <CubeSortByKey.hxx>
+#include <CubeCompareReconObjects.hxx>
+
+#include <TFile.h>
+#include <TTree.h>
+#include <TProfile.h>
+
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <memory>
+#include <algorithm>
+
+/// The time to sort the hits by time, the hits by Z, and the reconstructed
+/// objects versus the number of hits in the event.  The second index is 0
+/// for std::sort with a comparator, and 1 for Cube::SortByKey.
+namespace {
+    const int kSorts = 3;
+    TProfile* histSortTime[kSorts][2];
+    double gTotalTime[kSorts][2];
+    int gEvents = 0;
+    int gDifferentEvents = 0;
+
+    struct CompareTime {
+        bool operator () (const Cube::Handle<Cube::Hit>& lhs,
+                          const Cube::Handle<Cube::Hit>& rhs) const {
+            return lhs->GetTime() < rhs->GetTime();
+        }
+    };
+
+    struct KeyTime {
+        double operator () (const Cube::Handle<Cube::Hit>& hit) const {
+            return hit->GetTime();
+        }
+    };
+
+    struct CompareZ {
+        bool operator () (const Cube::Handle<Cube::Hit>& lhs,
+                          const Cube::Handle<Cube::Hit>& rhs) const {
+            return lhs->GetPosition().Z() < rhs->GetPosition().Z();
+        }
+    };
+
+    struct KeyZ {
+        double operator () (const Cube::Handle<Cube::Hit>& hit) const {
+            return hit->GetPosition().Z();
+        }
+    };
+}
+
+/// Sort a copy of the input with std::sort and with Cube::SortByKey, and
+/// record the times.  The sorts must give the same order of keys (the
+/// order of elements with equal keys can be different).
+template <typename Container, typename Compare, typename Key>
+bool TimeSorts(const Container& input, Compare compare, Key key,
+               int sort, double hits) {
+    Container byCompare(input);
+    std::chrono::high_resolution_clock::time_point start
+        = std::chrono::high_resolution_clock::now();
+    std::sort(byCompare.begin(), byCompare.end(), compare);
+    std::chrono::high_resolution_clock::time_point stop
+        = std::chrono::high_resolution_clock::now();
+    double ms = std::chrono::duration<double,std::milli>(
+        stop - start).count();
+    histSortTime[sort][0]->Fill(hits, ms);
+    gTotalTime[sort][0] += ms;
+
+    Container byKey(input);
+    start = std::chrono::high_resolution_clock::now();
+    Cube::SortByKey(byKey.begin(), byKey.end(), key);
+    stop = std::chrono::high_resolution_clock::now();
+    ms = std::chrono::duration<double,std::milli>(stop - start).count();
+    histSortTime[sort][1]->Fill(hits, ms);
+    gTotalTime[sort][1] += ms;
+
+    for (std::size_t i = 0; i < byKey.size(); ++i) {
+        if (compare(byKey[i],byCompare[i])) return false;
+        if (compare(byCompare[i],byKey[i])) return false;
+    }
+    return true;
+}
+
+/// Sort the event hits by time and Z, and the reconstructed objects, with a
+/// comparator and with the extracted keys.
+void AnalyzeEvent(Cube::Event& event) {
+    Cube::Handle<Cube::HitSelection> hits = event.GetHitSelection();
+    if (!hits) return;
+
+    bool same = true;
+    same = TimeSorts(*hits, CompareTime(), KeyTime(), 0, hits->size())
+        && same;
+    same = TimeSorts(*hits, CompareZ(), KeyZ(), 1, hits->size()) && same;
+
+    Cube::Handle<Cube::ReconObjectContainer> objects
+        = event.GetObjectContainer();
+    if (objects) {
+        same = TimeSorts(*objects, Cube::CompareReconObjects(),
+                         Cube::ReconObjectSortKey(), 2, hits->size())
+            && same;
+    }
+
+    ++gEvents;
+    if (!same) {
+        std::cout << "Different order for event " << event.GetEventId()
+                  << std::endl;
+        ++gDifferentEvents;
+    }
+}
+
+int main(int argc, char** argv) {
+    int maxEntries = 1E+8; // Maximum to process.
+    int firstEntry = 0;
+
+    while (true) {
+        int c = getopt(argc,argv,"n:s:");
+        if (c<0) break;
+        switch (c) {
+        case 'n': {
+            std::istringstream tmp(optarg);
+            tmp >> maxEntries;
+            break;
+        }
+        case 's': {
+            std::istringstream tmp(optarg);
+            tmp >> firstEntry;
+            break;
+        }
+        default: {
+            std::cout << "Usage: " << std::endl;
+            std::cout << "   "
+                      << "-s <number>  : Skip <number> entries"
+                      << std::endl
+                      << "-n <number>  : Process no more than"
+                      << " <number> events."
+                      << std::endl;
+            exit(1);
+        }
+        }
+    }
+
+    if (argc <= optind) throw std::runtime_error("Missing input file");
+    std::string inputName(argv[optind++]);
+    std::cout << "Input Name " << inputName << std::endl;
+
+    std::string outputName;
+    if (argc > optind) {
+        outputName = argv[optind++];
+    }
+    else {
+        std::cout << "NO OUTPUT FILE!!!!" << std::endl;
+    }
+
+    // Attach to the input tree.
+    std::unique_ptr<TFile> inputFile(new TFile(inputName.c_str(),"old"));
+    if (!inputFile->IsOpen()) throw std::runtime_error("Input file not open");
+
+    /// Attach to the input tree.
+    TTree* inputTree = (TTree*) inputFile->Get("CubeEvents");
+    if (!inputTree) throw std::runtime_error("Missing the event tree");
+    Cube::Event *inputEvent = NULL;
+    inputTree->SetBranchAddress("Event",&inputEvent);
+
+    // Open the output file
+    std::unique_ptr<TFile> outputFile;
+    if (!outputName.empty()) {
+        std::cout << "Open Output File: " << outputName << std::endl;
+        outputFile.reset(new TFile(outputName.c_str(),"recreate"));
+    }
+
+    const char* names[kSorts] = {"time", "z", "objects"};
+    for (int s = 0; s < kSorts; ++s) {
+        std::string name = std::string(names[s]) + "ComparatorTime";
+        std::string title = std::string("Comparator sort time for ")
+            + names[s] + " (ms)";
+        histSortTime[s][0] = new TProfile(name.c_str(), title.c_str(),
+                                          50, 0.0, 50000.0);
+        name = std::string(names[s]) + "KeyTime";
+        title = std::string("Key sort time for ") + names[s] + " (ms)";
+        histSortTime[s][1] = new TProfile(name.c_str(), title.c_str(),
+                                          50, 0.0, 50000.0);
+    }
+
+    // Loop through the events.
+    int totalEntries = inputTree->GetEntries();
+    totalEntries = std::min(totalEntries,firstEntry+maxEntries);
+    for (int entry = firstEntry; entry < totalEntries; ++entry) {
+        inputTree->GetEntry(entry);
+        std::cout << "Process event " << inputEvent->GetRunId()
+                    << "/" << inputEvent->GetEventId() << std::endl;
+        inputEvent->MakeCurrentEvent();
+        AnalyzeEvent(*inputEvent);
+    }
+
+    // Summarize the comparison.
+    std::cout << "Sorted " << gEvents << " events"
+              << " (" << gDifferentEvents << " different)" << std::endl;
+    for (int s = 0; s < kSorts; ++s) {
+        std::cout << names[s] << ":"
+                  << " comparator " << gTotalTime[s][0] << " ms"
+                  << ", key " << gTotalTime[s][1] << " ms";
+        if (gTotalTime[s][1] > 0.0) {
+            std::cout << ", speedup " << gTotalTime[s][0]/gTotalTime[s][1];
+        }
+        std::cout << std::endl;
+    }
+
+    if (outputFile) {
+        outputFile->Write();
+        outputFile->Close();
+    }
+
+    return 0;
+}
+
+// Local Variables:
+// mode:c++
+// c-basic-offset:4
+// compile-command:"$(git rev-parse --show-toplevel)/build/cube-build.sh force"
+// End:
@@ -0,0 +1,263 @@
+#include <CubeEvent.hxx>
+#include <CubeHandle.hxx>
+#include <CubeHit.hxx>
+#include <CubeHitSelection.hxx>
+#include <CubeReconObject.hxx>
+#include <CubeReconNode.hxx>
+#include <CubeReconState.hxx>
+#include <CubeAlgorithmResult.hxx>
+
+#include <CubeRecon.hxx>
+#include <CubeTrackFitBatch.hxx>
+
+#include <TFile.h>
+#include <TTree.h>
+#include <TBufferFile.h>
+
+#include <iostream>
+#include <sstream>
+#include <memory>
+#include <vector>
+#include <thread>
+#include <cstdlib>
+#include <algorithm>
+
+/// Run the reconstruction three times on each event and check that the
+/// output is identical.  The first pass uses one thread.  Before the second
+/// pass, the heap is scrambled by keeping a set of random size allocations
+/// alive, and the track fits are run with the hardware threads (at least
+/// two).  The third pass repeats the second without scrambling the heap so
+/// the threads are scheduled differently.  The output of each pass is
+/// compared two ways: the final objects are serialized into a ROOT buffer
+/// (the bytes that would be written to the output file), and every state
+/// value and covariance is written as text with full precision using the
+/// stable identifiers (never the pointers).  The text is used to find which
+/// objects are different when the buffers don't match.
+namespace {
+    int gEvents = 0;
+    int gDifferentEvents = 0;
+    int gDifferentBuffers = 0;
+    int gDifferentText = 0;
+
+    // The output of one reconstruction pass.
+    struct ReconOutput {
+        std::string fBuffer;
+        std::string fText;
+    };
+}
+
+/// Write the hits in a hit selection using the stable identifiers.
+void DumpHits(std::ostream& out, Cube::Handle<Cube::HitSelection> hits) {
+    if (!hits) {
+        out << " no-hits";
+        return;
+    }
+    out << " hits " << hits->size() << ":";
+    for (Cube::HitSelection::iterator h = hits->begin();
+         h != hits->end(); ++h) {
+        out << " " << (*h)->GetUniqueID();
+    }
+}
+
+/// Write the state values.  The values are written with full precision.
+void DumpState(std::ostream& out, Cube::Handle<Cube::ReconState> state) {
+    if (!state) {
+        out << " no-state";
+        return;
+    }
+    out << " " << state->GetDimensions() << ":";
+    for (int i = 0; i < state->GetDimensions(); ++i) {
+        out << " " << state->GetValue(i);
+        for (int j = 0; j <= i; ++j) {
+            out << "/" << state->GetCovarianceValue(i,j);
+        }
+    }
+}
+
+/// Write the objects in a container using the stable identifiers, and
+/// recurse into the constituents.
+void DumpObjects(std::ostream& out,
+                 Cube::Handle<Cube::ReconObjectContainer> objects,
+                 int depth) {
+    if (!objects) return;
+    for (Cube::ReconObjectContainer::iterator o = objects->begin();
+         o != objects->end(); ++o) {
+        out << depth << " " << (*o)->GetUniqueID()
+            << " " << (*o)->ClassName()
+            << " " << (*o)->GetAlgorithmName()
+            << " " << (*o)->GetStatus()
+            << " " << (*o)->GetQuality()
+            << " " << (*o)->GetNDOF();
+        DumpState(out,(*o)->GetReconState());
+        DumpHits(out,(*o)->GetHitSelection());
+        out << std::endl;
+        Cube::ReconNodeContainer& nodes = (*o)->GetNodes();
+        for (Cube::ReconNodeContainer::iterator n = nodes.begin();
+             n != nodes.end(); ++n) {
+            out << depth << " node";
+            DumpState(out,(*n)->GetState());
+            Cube::Handle<Cube::ReconObject> object = (*n)->GetObject();
+            if (object) out << " object " << object->GetUniqueID();
+            out << std::endl;
+        }
+        DumpObjects(out,(*o)->GetConstituents(),depth+1);
+    }
+}
+
+/// Run the reconstruction and return the serialized final objects and the
+/// output as text.  The identifier counters are reset to the values they
+/// had before the first pass, so every pass makes objects with the same
+/// identifiers.
+ReconOutput RunRecon(Cube::Event& event,
+                     Cube::Handle<Cube::HitSelection> hits,
+                     UInt_t hitId, UInt_t objectId) {
+    event.SetLastIds(hitId,objectId);
+    std::unique_ptr<Cube::Recon> algoRecon(new Cube::Recon);
+    Cube::Handle<Cube::AlgorithmResult> recon = algoRecon->Process(*hits);
+    Cube::Handle<Cube::ReconObjectContainer> finalObjects
+        = recon->GetObjectContainer("final");
+    ReconOutput output;
+    if (finalObjects) {
+        TBufferFile buffer(TBuffer::kWrite);
+        buffer.WriteObject(Cube::GetPointer(finalObjects));
+        output.fBuffer.assign(buffer.Buffer(), buffer.Length());
+    }
+    std::ostringstream out;
+    out.precision(17);
+    DumpObjects(out,finalObjects,0);
+    output.fText = out.str();
+    return output;
+}
+
+/// Compare the output of a pass to the first pass.  This returns true if
+/// they are identical.
+bool SameOutput(const ReconOutput& first, const ReconOutput& other) {
+    bool same = true;
+    if (first.fBuffer != other.fBuffer) {
+        ++gDifferentBuffers;
+        same = false;
+    }
+    if (first.fText != other.fText) {
+        ++gDifferentText;
+        same = false;
+        // Show the first line that is different.
+        std::istringstream firstLines(first.fText);
+        std::istringstream otherLines(other.fText);
+        std::string firstLine;
+        std::string otherLine;
+        while (std::getline(firstLines,firstLine)) {
+            std::getline(otherLines,otherLine);
+            if (firstLine == otherLine) continue;
+            std::cout << "   First pass: " << firstLine << std::endl;
+            std::cout << "   This pass:  " << otherLine << std::endl;
+            break;
+        }
+    }
+    return same;
+}
+
+void AnalyzeEvent(Cube::Event& event) {
+    Cube::Handle<Cube::HitSelection> hits = event.GetHitSelection();
+    if (!hits) return;
+
+    UInt_t hitId = event.GetLastHitId();
+    UInt_t objectId = event.GetLastObjectId();
+
+    Cube::TrackFitBatch::SetDefaultThreadCount(1);
+    ReconOutput first = RunRecon(event,hits,hitId,objectId);
+
+    // Move the second pass to a different part of the heap.
+    std::vector< std::unique_ptr<char[]> > scramble;
+    for (int i = 0; i < 1000; ++i) {
+        scramble.push_back(
+            std::unique_ptr<char[]>(new char[1 + std::rand()%4096]));
+    }
+    Cube::TrackFitBatch::SetDefaultThreadCount(
+        std::max(2,(int) std::thread::hardware_concurrency()));
+    ReconOutput second = RunRecon(event,hits,hitId,objectId);
+    scramble.clear();
+    ReconOutput third = RunRecon(event,hits,hitId,objectId);
+    Cube::TrackFitBatch::SetDefaultThreadCount(1);
+
+    ++gEvents;
+    bool same = SameOutput(first,second);
+    same = SameOutput(first,third) && same;
+    if (!same) {
+        ++gDifferentEvents;
+        std::cout << "Event " << event.GetRunId()
+                  << "/" << event.GetEventId()
+                  << " is not reproducible" << std::endl;
+    }
+}
+
+int main(int argc, char** argv) {
+    int maxEntries = 1E+8; // Maximum to process.
+    int firstEntry = 0;
+
+    while (true) {
+        int c = getopt(argc,argv,"n:s:");
+        if (c<0) break;
+        switch (c) {
+        case 'n': {
+            std::istringstream tmp(optarg);
+            tmp >> maxEntries;
+            break;
+        }
+        case 's': {
+            std::istringstream tmp(optarg);
+            tmp >> firstEntry;
+            break;
+        }
+        default: {
+            std::cout << "Usage: " << std::endl;
+            std::cout << "   "
+                      << "-s <number>  : Skip <number> entries"
+                      << std::endl
+                      << "-n <number>  : Process no more than"
+                      << " <number> events."
+                      << std::endl;
+            exit(1);
+        }
+        }
+    }
+
+    if (argc <= optind) throw std::runtime_error("Missing input file");
+    std::string inputName(argv[optind++]);
+    std::cout << "Input Name " << inputName << std::endl;
+
+    // Attach to the input tree.
+    std::unique_ptr<TFile> inputFile(new TFile(inputName.c_str(),"old"));
+    if (!inputFile->IsOpen()) throw std::runtime_error("Input file not open");
+
+    /// Attach to the input tree.
+    TTree* inputTree = (TTree*) inputFile->Get("CubeEvents");
+    if (!inputTree) throw std::runtime_error("Missing the event tree");
+    Cube::Event *inputEvent = NULL;
+    inputTree->SetBranchAddress("Event",&inputEvent);
+
+    // Loop through the events.
+    int totalEntries = inputTree->GetEntries();
+    totalEntries = std::min(totalEntries,firstEntry+maxEntries);
+    for (int entry = firstEntry; entry < totalEntries; ++entry) {
+        inputTree->GetEntry(entry);
+        std::cout << "Process event " << inputEvent->GetRunId()
+                    << "/" << inputEvent->GetEventId() << std::endl;
+        inputEvent->MakeCurrentEvent();
+        AnalyzeEvent(*inputEvent);
+    }
+
+    // Summarize the comparison.
+    std::cout << "Compared " << gEvents << " events" << std::endl;
+    std::cout << "Events that are not reproducible: " << gDifferentEvents
+              << " (" << gDifferentBuffers << " serialized buffers and "
+              << gDifferentText << " text dumps were different)"
+              << std::endl;
+
+    return (gDifferentEvents > 0) ? 1 : 0;
+}
+
+// Local Variables:
+// mode:c++
+// c-basic-offset:4
+// compile-command:"$(git rev-parse --show-toplevel)/build/cube-build.sh force"
+// End:
@@ -0,0 +1,254 @@
+#include <CubeEvent.hxx>
+#include <CubeHandle.hxx>
+#include <CubeReconObject.hxx>
+#include <CubeReconNode.hxx>
+#include <CubeCorrValues.hxx>
+#include <CubeTrackState.hxx>
+#include <CubeClusterState.hxx>
+#include <CubeShowerState.hxx>
+#include <CubeVertexState.hxx>
+
+#include <TFile.h>
+#include <TTree.h>
+#include <TH1F.h>
+#include <TBufferFile.h>
+
+#include <iostream>
+#include <sstream>
+#include <memory>
+#include <new>
+#include <cstdlib>
+
+/// Count every allocation made by the program.  The count is read before and
+/// after copying the states in an event.
+namespace {
+    long gAllocations = 0;
+}
+
+void* operator new(std::size_t size) {
+    ++gAllocations;
+    void* p = std::malloc(size);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](std::size_t size) {
+    ++gAllocations;
+    void* p = std::malloc(size);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept {std::free(p);}
+void operator delete[](void* p) noexcept {std::free(p);}
+
+/// The allocations per event for copying the states, and for copying the
+/// same values in a Cube::CorrValues object (the way the values were kept in
+/// the state before they were moved into fixed size arrays).  The size of
+/// the serialized states is also compared.
+namespace {
+    TH1F* histStateAllocations = NULL;
+    TH1F* histCorrAllocations = NULL;
+    long gStateAllocations = 0;
+    long gCorrAllocations = 0;
+    long gStateBytes = 0;
+    long gCorrBytes = 0;
+    long gStates = 0;
+    int gEvents = 0;
+}
+
+/// Copy a state using the copy constructor of the derived class, and return
+/// the number of allocations.  The copy is made on the stack so the only
+/// allocations are made by the state.
+long CopyState(Cube::Handle<Cube::ReconState> state) {
+    Cube::Handle<Cube::TrackState> track = state;
+    Cube::Handle<Cube::ClusterState> cluster = state;
+    Cube::Handle<Cube::ShowerState> shower = state;
+    Cube::Handle<Cube::VertexState> vertex = state;
+    long before = 0;
+    long after = 0;
+    if (track) {
+        before = gAllocations;
+        Cube::TrackState copy(*track);
+        after = gAllocations;
+    }
+    else if (cluster) {
+        before = gAllocations;
+        Cube::ClusterState copy(*cluster);
+        after = gAllocations;
+    }
+    else if (shower) {
+        before = gAllocations;
+        Cube::ShowerState copy(*shower);
+        after = gAllocations;
+    }
+    else if (vertex) {
+        before = gAllocations;
+        Cube::VertexState copy(*vertex);
+        after = gAllocations;
+    }
+    return after - before;
+}
+
+/// Copy the state values as a Cube::CorrValues object, and return the
+/// number of allocations.
+long CopyCorrValues(Cube::Handle<Cube::ReconState> state) {
+    Cube::CorrValues values = Cube::ReconState::ProjectState(state);
+    long before = gAllocations;
+    Cube::CorrValues copy(values);
+    return gAllocations - before;
+}
+
+/// Add the number of bytes needed to serialize the state, and to serialize
+/// the same values as a Cube::CorrValues object, to the totals.  This is
+/// before the file compression.
+void CountBytes(Cube::Handle<Cube::ReconState> state) {
+    TBufferFile stateBuffer(TBuffer::kWrite);
+    state->Streamer(stateBuffer);
+    gStateBytes += stateBuffer.Length();
+    Cube::CorrValues values = Cube::ReconState::ProjectState(state);
+    TBufferFile corrBuffer(TBuffer::kWrite);
+    values.Streamer(corrBuffer);
+    gCorrBytes += corrBuffer.Length();
+}
+
+/// Copy the state of every object, and the states of the object nodes.
+void AnalyzeEvent(Cube::Event& event) {
+    Cube::Handle<Cube::ReconObjectContainer> objects
+        = event.GetObjectContainer();
+    if (!objects) return;
+
+    long stateAllocations = 0;
+    long corrAllocations = 0;
+    for (Cube::ReconObjectContainer::iterator o = objects->begin();
+         o != objects->end(); ++o) {
+        stateAllocations += CopyState((*o)->GetReconState());
+        corrAllocations += CopyCorrValues((*o)->GetReconState());
+        CountBytes((*o)->GetReconState());
+        ++gStates;
+        Cube::ReconNodeContainer& nodes = (*o)->GetNodes();
+        for (Cube::ReconNodeContainer::iterator n = nodes.begin();
+             n != nodes.end(); ++n) {
+            Cube::Handle<Cube::ReconState> state = (*n)->GetState();
+            if (!state) continue;
+            stateAllocations += CopyState(state);
+            corrAllocations += CopyCorrValues(state);
+            CountBytes(state);
+            ++gStates;
+        }
+    }
+
+    ++gEvents;
+    histStateAllocations->Fill(stateAllocations);
+    histCorrAllocations->Fill(corrAllocations);
+    gStateAllocations += stateAllocations;
+    gCorrAllocations += corrAllocations;
+}
+
+int main(int argc, char** argv) {
+    int maxEntries = 1E+8; // Maximum to process.
+    int firstEntry = 0;
+
+    while (true) {
+        int c = getopt(argc,argv,"n:s:");
+        if (c<0) break;
+        switch (c) {
+        case 'n': {
+            std::istringstream tmp(optarg);
+            tmp >> maxEntries;
+            break;
+        }
+        case 's': {
+            std::istringstream tmp(optarg);
+            tmp >> firstEntry;
+            break;
+        }
+        default: {
+            std::cout << "Usage: " << std::endl;
+            std::cout << "   "
+                      << "-s <number>  : Skip <number> entries"
+                      << std::endl
+                      << "-n <number>  : Process no more than"
+                      << " <number> events."
+                      << std::endl;
+            exit(1);
+        }
+        }
+    }
+
+    if (argc <= optind) throw std::runtime_error("Missing input file");
+    std::string inputName(argv[optind++]);
+    std::cout << "Input Name " << inputName << std::endl;
+
+    std::string outputName;
+    if (argc > optind) {
+        outputName = argv[optind++];
+    }
+    else {
+        std::cout << "NO OUTPUT FILE!!!!" << std::endl;
+    }
+
+    // Attach to the input tree.
+    std::unique_ptr<TFile> inputFile(new TFile(inputName.c_str(),"old"));
+    if (!inputFile->IsOpen()) throw std::runtime_error("Input file not open");
+
+    /// Attach to the input tree.
+    TTree* inputTree = (TTree*) inputFile->Get("CubeEvents");
+    if (!inputTree) throw std::runtime_error("Missing the event tree");
+    Cube::Event *inputEvent = NULL;
+    inputTree->SetBranchAddress("Event",&inputEvent);
+
+    // Open the output file
+    std::unique_ptr<TFile> outputFile;
+    if (!outputName.empty()) {
+        std::cout << "Open Output File: " << outputName << std::endl;
+        outputFile.reset(new TFile(outputName.c_str(),"recreate"));
+    }
+
+    histStateAllocations = new TH1F("stateAllocations",
+                                    "Allocations to copy the states",
+                                    100, 0.0, 10000.0);
+    histCorrAllocations = new TH1F("corrAllocations",
+                                   "Allocations to copy the CorrValues",
+                                   100, 0.0, 10000.0);
+
+    // Loop through the events.
+    int totalEntries = inputTree->GetEntries();
+    totalEntries = std::min(totalEntries,firstEntry+maxEntries);
+    for (int entry = firstEntry; entry < totalEntries; ++entry) {
+        inputTree->GetEntry(entry);
+        std::cout << "Process event " << inputEvent->GetRunId()
+                    << "/" << inputEvent->GetEventId() << std::endl;
+        inputEvent->MakeCurrentEvent();
+        AnalyzeEvent(*inputEvent);
+    }
+
+    // Summarize the allocations.
+    std::cout << "Copied " << gStates << " states in " << gEvents
+              << " events" << std::endl;
+    if (gEvents > 0) {
+        std::cout << "State allocations per event: "
+                  << 1.0*gStateAllocations/gEvents << std::endl;
+        std::cout << "CorrValues allocations per event: "
+                  << 1.0*gCorrAllocations/gEvents << std::endl;
+    }
+    if (gStates > 0) {
+        std::cout << "Serialized bytes per state: "
+                  << 1.0*gStateBytes/gStates
+                  << " (CorrValues " << 1.0*gCorrBytes/gStates << ")"
+                  << std::endl;
+    }
+
+    if (outputFile) {
+        outputFile->Write();
+        outputFile->Close();
+    }
+
+    return 0;
+}
+
+// Local Variables:
+// mode:c++
+// c-basic-offset:4
+// compile-command:"$(git rev-parse --show-toplevel)/build/cube-build.sh force"
+// End:
@@ -0,0 +1,233 @@
+#include <CubeEvent.hxx>
+#include <CubeReconTrack.hxx>
+#include <CubeReconNode.hxx>
+#include <CubeReconState.hxx>
+#include <CubeHandle.hxx>
+
+#include <CubeStochTrackFit.hxx>
+#include <CubePhiloxRandom.hxx>
+
+#include <TFile.h>
+#include <TTree.h>
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <memory>
+#include <vector>
+#include <random>
+#include <algorithm>
+
+/// Check that the stochastic track fit doesn't depend on the order that the
+/// tracks are fit, or on whether the forward and backward passes are run
+/// concurrently.  The tracks in each event are fit in the original order
+/// with the passes run one after the other, and then fit again in a
+/// shuffled order with concurrent passes.  Every value and covariance of
+/// every node state must be identical.  Before the events are read, the
+/// Philox generator is checked against the published known answer values.
+namespace {
+    long gTracks = 0;
+    long gDifferentTracks = 0;
+    long gFailedFits = 0;
+}
+
+/// Check Cube::PhiloxRandom::Block against the Philox4x32-10 known answer
+/// values from the Random123 distribution.  Return true if they all match.
+bool CheckKnownAnswers() {
+    uint32_t counters[3][4] = {
+        {0x00000000U, 0x00000000U, 0x00000000U, 0x00000000U},
+        {0xFFFFFFFFU, 0xFFFFFFFFU, 0xFFFFFFFFU, 0xFFFFFFFFU},
+        {0x243F6A88U, 0x85A308D3U, 0x13198A2EU, 0x03707344U}};
+    const uint32_t keys[3][2] = {
+        {0x00000000U, 0x00000000U},
+        {0xFFFFFFFFU, 0xFFFFFFFFU},
+        {0xA4093822U, 0x299F31D0U}};
+    const uint32_t answers[3][4] = {
+        {0x6627E8D5U, 0xE169C58DU, 0xBC57AC4CU, 0x9B00DBD8U},
+        {0x408F276DU, 0x41C83B0EU, 0xA20BC7C6U, 0x6D5451FDU},
+        {0xD16CFE09U, 0x94FDCCEBU, 0x5001E420U, 0x24126EA1U}};
+    bool good = true;
+    for (int i = 0; i < 3; ++i) {
+        Cube::PhiloxRandom::Block(counters[i], keys[i]);
+        for (int j = 0; j < 4; ++j) {
+            if (counters[i][j] == answers[i][j]) continue;
+            std::cout << "Philox known answer " << i << " word " << j
+                      << " is " << std::hex << counters[i][j]
+                      << " expected " << answers[i][j] << std::dec
+                      << std::endl;
+            good = false;
+        }
+    }
+    return good;
+}
+
+/// Check that two values are identical.  Two NaN values are the same.
+bool SameValue(double lhs, double rhs) {
+    if (lhs != lhs && rhs != rhs) return true;
+    return lhs == rhs;
+}
+
+/// Check that two states have identical values and covariances.
+bool SameState(Cube::Handle<Cube::ReconState> lhs,
+               Cube::Handle<Cube::ReconState> rhs) {
+    if (!lhs || !rhs) return !lhs && !rhs;
+    if (lhs->GetDimensions() != rhs->GetDimensions()) return false;
+    for (int i = 0; i < lhs->GetDimensions(); ++i) {
+        if (!SameValue(lhs->GetValue(i),rhs->GetValue(i))) return false;
+        for (int j = 0; j < lhs->GetDimensions(); ++j) {
+            if (!SameValue(lhs->GetCovarianceValue(i,j),
+                           rhs->GetCovarianceValue(i,j))) return false;
+        }
+    }
+    return true;
+}
+
+/// Check that two fitted tracks have identical states.
+bool SameTrack(Cube::Handle<Cube::ReconTrack> lhs,
+               Cube::Handle<Cube::ReconTrack> rhs) {
+    if (!lhs || !rhs) return !lhs && !rhs;
+    if (!SameState(lhs->GetState(),rhs->GetState())) return false;
+    if (!SameState(lhs->GetBack(),rhs->GetBack())) return false;
+    if (lhs->GetNodes().size() != rhs->GetNodes().size()) return false;
+    for (std::size_t i = 0; i < lhs->GetNodes().size(); ++i) {
+        if (!SameState(lhs->GetNodes()[i]->GetState(),
+                       rhs->GetNodes()[i]->GetState())) return false;
+    }
+    return true;
+}
+
+/// Fit copies of the tracks in the order given by the index.  The fitted
+/// tracks are returned in the original order.
+std::vector< Cube::Handle<Cube::ReconTrack> > FitTracks(
+    const std::vector< Cube::Handle<Cube::ReconTrack> >& tracks,
+    const std::vector<int>& order, bool concurrent) {
+    std::vector< Cube::Handle<Cube::ReconTrack> > result(tracks.size());
+    Cube::StochTrackFit fitter;
+    fitter.SetConcurrentPasses(concurrent);
+    for (std::vector<int>::const_iterator i = order.begin();
+         i != order.end(); ++i) {
+        Cube::Handle<Cube::ReconTrack> input(
+            new Cube::ReconTrack(*tracks[*i]));
+        result[*i] = fitter.Apply(input);
+    }
+    return result;
+}
+
+/// Fit the tracks in the event in two orders, and compare the results.
+void AnalyzeEvent(Cube::Event& event, int entry) {
+    Cube::Handle<Cube::ReconObjectContainer> objects
+        = event.GetObjectContainer();
+    if (!objects) return;
+
+    std::vector< Cube::Handle<Cube::ReconTrack> > tracks;
+    for (Cube::ReconObjectContainer::iterator o = objects->begin();
+         o != objects->end(); ++o) {
+        Cube::Handle<Cube::ReconTrack> track = *o;
+        if (!track) continue;
+        if (track->GetNodes().size() < 3) continue;
+        tracks.push_back(track);
+    }
+    if (tracks.empty()) return;
+
+    std::vector<int> order;
+    for (std::size_t i = 0; i < tracks.size(); ++i) order.push_back(i);
+    std::vector< Cube::Handle<Cube::ReconTrack> > serial
+        = FitTracks(tracks, order, false);
+
+    // The shuffle is seeded by the entry so a failure can be repeated.
+    std::mt19937 engine(entry);
+    std::shuffle(order.begin(), order.end(), engine);
+    std::vector< Cube::Handle<Cube::ReconTrack> > shuffled
+        = FitTracks(tracks, order, true);
+
+    for (std::size_t i = 0; i < tracks.size(); ++i) {
+        ++gTracks;
+        if (!serial[i] || !shuffled[i]) ++gFailedFits;
+        if (SameTrack(serial[i],shuffled[i])) continue;
+        ++gDifferentTracks;
+        std::cout << "Track " << i << " in event " << event.GetRunId()
+                  << "/" << event.GetEventId() << " is different"
+                  << std::endl;
+    }
+}
+
+int main(int argc, char** argv) {
+    int maxEntries = 1E+8; // Maximum to process.
+    int firstEntry = 0;
+
+    while (true) {
+        int c = getopt(argc,argv,"n:s:");
+        if (c<0) break;
+        switch (c) {
+        case 'n': {
+            std::istringstream tmp(optarg);
+            tmp >> maxEntries;
+            break;
+        }
+        case 's': {
+            std::istringstream tmp(optarg);
+            tmp >> firstEntry;
+            break;
+        }
+        default: {
+            std::cout << "Usage: " << std::endl;
+            std::cout << "   "
+                      << "-s <number>  : Skip <number> entries"
+                      << std::endl
+                      << "-n <number>  : Process no more than"
+                      << " <number> events."
+                      << std::endl;
+            exit(1);
+        }
+        }
+    }
+
+    if (!CheckKnownAnswers()) {
+        std::cout << "FAIL: Philox doesn't match the known answers"
+                  << std::endl;
+        return 1;
+    }
+    std::cout << "Philox known answers match" << std::endl;
+
+    if (argc <= optind) throw std::runtime_error("Missing input file");
+    std::string inputName(argv[optind++]);
+    std::cout << "Input Name " << inputName << std::endl;
+
+    // Attach to the input tree.
+    std::unique_ptr<TFile> inputFile(new TFile(inputName.c_str(),"old"));
+    if (!inputFile->IsOpen()) throw std::runtime_error("Input file not open");
+
+    /// Attach to the input tree.
+    TTree* inputTree = (TTree*) inputFile->Get("CubeEvents");
+    if (!inputTree) throw std::runtime_error("Missing the event tree");
+    Cube::Event *inputEvent = NULL;
+    inputTree->SetBranchAddress("Event",&inputEvent);
+
+    // Loop through the events.
+    int totalEntries = inputTree->GetEntries();
+    totalEntries = std::min(totalEntries,firstEntry+maxEntries);
+    for (int entry = firstEntry; entry < totalEntries; ++entry) {
+        inputTree->GetEntry(entry);
+        std::cout << "Process event " << inputEvent->GetRunId()
+                    << "/" << inputEvent->GetEventId() << std::endl;
+        inputEvent->MakeCurrentEvent();
+        AnalyzeEvent(*inputEvent,entry);
+    }
+
+    std::cout << "Compared " << gTracks << " tracks, "
+              << gDifferentTracks << " different, "
+              << gFailedFits << " failed fits" << std::endl;
+
+    if (gDifferentTracks > 0) {
+        std::cout << "FAIL: The fit depends on the order or the passes"
+                  << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Local Variables:
+// mode:c++
+// c-basic-offset:4
+// compile-command:"$(git rev-parse --show-toplevel)/build/cube-build.sh force"
+// End:
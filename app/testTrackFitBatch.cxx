@@ -0,0 +1,195 @@
+#include <CubeEvent.hxx>
+#include <CubeReconTrack.hxx>
+#include <CubeHandle.hxx>
+
+#include <CubeTrackFitBatch.hxx>
+
+#include <TFile.h>
+#include <TTree.h>
+#include <TH1F.h>
+
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <thread>
+
+/// The timing for each number of threads.  Index zero is not used.
+namespace {
+    int gMaxThreads = 0;
+    int gMinimumTracks = 10;
+    std::vector<double> gTotalTime;
+    int gBusyEvents = 0;
+    int gTotalTracks = 0;
+    TH1F* histBatchTime = NULL;
+}
+
+/// Refit the tracks in busy events as a batch using 1 to gMaxThreads threads
+/// and record the time for each number of threads.  The fit cache is turned
+/// off so that every batch does the full fits.
+void AnalyzeEvent(Cube::Event& event) {
+    Cube::Handle<Cube::ReconObjectContainer> objects
+        = event.GetObjectContainer();
+    if (!objects) return;
+
+    Cube::TrackFitBatch::TrackVector tracks;
+    for (Cube::ReconObjectContainer::iterator o = objects->begin();
+         o != objects->end(); ++o) {
+        Cube::Handle<Cube::ReconTrack> track = *o;
+        if (!track) continue;
+        if (track->GetNodes().size() < 3) continue;
+        tracks.push_back(track);
+    }
+    if ((int) tracks.size() < gMinimumTracks) return;
+
+    ++gBusyEvents;
+    gTotalTracks += tracks.size();
+
+    for (int threads = 1; threads <= gMaxThreads; ++threads) {
+        // Fit copies so that every batch sees the same input.
+        Cube::TrackFitBatch::TrackVector input;
+        for (Cube::TrackFitBatch::TrackVector::iterator t = tracks.begin();
+             t != tracks.end(); ++t) {
+            input.push_back(
+                Cube::Handle<Cube::ReconTrack>(new Cube::ReconTrack(**t)));
+        }
+        Cube::TrackFitBatch fitBatch(threads);
+        fitBatch.SetUseCache(false);
+        std::chrono::high_resolution_clock::time_point start
+            = std::chrono::high_resolution_clock::now();
+        Cube::TrackFitBatch::TrackVector output = fitBatch(input);
+        std::chrono::high_resolution_clock::time_point stop
+            = std::chrono::high_resolution_clock::now();
+        double ms = std::chrono::duration<double,std::milli>(
+            stop - start).count();
+        gTotalTime[threads] += ms;
+        histBatchTime->Fill(threads,ms);
+    }
+}
+
+int main(int argc, char** argv) {
+    int maxEntries = 1E+8; // Maximum to process.
+    int firstEntry = 0;
+
+    while (true) {
+        int c = getopt(argc,argv,"n:s:t:m:");
+        if (c<0) break;
+        switch (c) {
+        case 'n': {
+            std::istringstream tmp(optarg);
+            tmp >> maxEntries;
+            break;
+        }
+        case 's': {
+            std::istringstream tmp(optarg);
+            tmp >> firstEntry;
+            break;
+        }
+        case 't': {
+            std::istringstream tmp(optarg);
+            tmp >> gMaxThreads;
+            break;
+        }
+        case 'm': {
+            std::istringstream tmp(optarg);
+            tmp >> gMinimumTracks;
+            break;
+        }
+        default: {
+            std::cout << "Usage: " << std::endl;
+            std::cout << "   "
+                      << "-s <number>  : Skip <number> entries"
+                      << std::endl
+                      << "-n <number>  : Process no more than"
+                      << " <number> events."
+                      << std::endl
+                      << "-t <number>  : Maximum number of threads"
+                      << " (default is the hardware threads)."
+                      << std::endl
+                      << "-m <number>  : Minimum number of tracks in"
+                      << " an event (default 10)."
+                      << std::endl;
+            exit(1);
+        }
+        }
+    }
+
+    if (gMaxThreads < 1) gMaxThreads = std::thread::hardware_concurrency();
+    if (gMaxThreads < 1) gMaxThreads = 1;
+    gTotalTime.resize(gMaxThreads+1);
+
+    if (argc <= optind) throw std::runtime_error("Missing input file");
+    std::string inputName(argv[optind++]);
+    std::cout << "Input Name " << inputName << std::endl;
+
+    std::string outputName;
+    if (argc > optind) {
+        outputName = argv[optind++];
+    }
+    else {
+        std::cout << "NO OUTPUT FILE!!!!" << std::endl;
+    }
+
+    // Attach to the input tree.
+    std::unique_ptr<TFile> inputFile(new TFile(inputName.c_str(),"old"));
+    if (!inputFile->IsOpen()) throw std::runtime_error("Input file not open");
+
+    /// Attach to the input tree.
+    TTree* inputTree = (TTree*) inputFile->Get("CubeEvents");
+    if (!inputTree) throw std::runtime_error("Missing the event tree");
+    Cube::Event *inputEvent = NULL;
+    inputTree->SetBranchAddress("Event",&inputEvent);
+
+    // Open the output file
+    std::unique_ptr<TFile> outputFile;
+    if (!outputName.empty()) {
+        std::cout << "Open Output File: " << outputName << std::endl;
+        outputFile.reset(new TFile(outputName.c_str(),"recreate"));
+    }
+
+    histBatchTime = new TH1F("batchTime",
+                             "Batch fit time versus threads (ms)",
+                             gMaxThreads, 0.5, gMaxThreads+0.5);
+
+    // Loop through the events.
+    int totalEntries = inputTree->GetEntries();
+    totalEntries = std::min(totalEntries,firstEntry+maxEntries);
+    for (int entry = firstEntry; entry < totalEntries; ++entry) {
+        inputTree->GetEntry(entry);
+        std::cout << "Process event " << inputEvent->GetRunId()
+                    << "/" << inputEvent->GetEventId() << std::endl;
+        inputEvent->MakeCurrentEvent();
+        AnalyzeEvent(*inputEvent);
+    }
+
+    // Summarize the scaling.
+    std::cout << "Batch fits for " << gBusyEvents << " events with at least "
+              << gMinimumTracks << " tracks (" << gTotalTracks << " tracks)"
+              << std::endl;
+    for (int threads = 1; threads <= gMaxThreads; ++threads) {
+        if (gBusyEvents < 1) break;
+        double speedup = 0.0;
+        if (gTotalTime[threads] > 0.0) {
+            speedup = gTotalTime[1]/gTotalTime[threads];
+        }
+        std::cout << "Threads " << threads
+                  << ": " << gTotalTime[threads]/gBusyEvents << " ms/event"
+                  << ", speedup " << speedup
+                  << ", efficiency " << speedup/threads
+                  << std::endl;
+    }
+
+    if (outputFile) {
+        outputFile->Write();
+        outputFile->Close();
+    }
+
+    return 0;
+}
+
+// Local Variables:
+// mode:c++
+// c-basic-offset:4
+// compile-command:"$(git rev-parse --show-toplevel)/build/cube-build.sh force"
+// End:
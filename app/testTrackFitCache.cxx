@@ -0,0 +1,210 @@
+#include <CubeEvent.hxx>
+#include <CubeReconTrack.hxx>
+#include <CubeReconNode.hxx>
+#include <CubeReconState.hxx>
+#include <CubeHandle.hxx>
+
+#include <CubeTrackFit.hxx>
+
+#include <TFile.h>
+#include <TTree.h>
+
+#include <iostream>
+#include <sstream>
+#include <memory>
+#include <vector>
+
+/// Check that a track fit found in the Cube::TrackFit cache is bit for bit
+/// identical to a new fit of the same track.  The tracks in each event are
+/// fit without the cache, then fit twice with the cache (the first pass
+/// fills the cache and the second pass restores the saved fits), and then
+/// fit with the cache check turned on.  Every value and covariance of the
+/// track and node states, and the fit quality, must be identical, every
+/// track in the second pass must be found in the cache, and the cache check
+/// must not find any mismatches.
+namespace {
+    long gTracks = 0;
+    long gDifferentTracks = 0;
+    long gCacheMisses = 0;
+    long gCacheMismatches = 0;
+}
+
+/// Check that two values are identical.  Two NaN values are the same.
+bool SameValue(double lhs, double rhs) {
+    if (lhs != lhs && rhs != rhs) return true;
+    return lhs == rhs;
+}
+
+/// Check that two states have identical values and covariances.
+bool SameState(Cube::Handle<Cube::ReconState> lhs,
+               Cube::Handle<Cube::ReconState> rhs) {
+    if (!lhs || !rhs) return !lhs && !rhs;
+    if (lhs->GetDimensions() != rhs->GetDimensions()) return false;
+    for (int i = 0; i < lhs->GetDimensions(); ++i) {
+        if (!SameValue(lhs->GetValue(i),rhs->GetValue(i))) return false;
+        for (int j = 0; j < lhs->GetDimensions(); ++j) {
+            if (!SameValue(lhs->GetCovarianceValue(i,j),
+                           rhs->GetCovarianceValue(i,j))) return false;
+        }
+    }
+    return true;
+}
+
+/// Check that two fitted tracks are identical.  The node objects must be
+/// in the same order.
+bool SameTrack(Cube::Handle<Cube::ReconTrack> lhs,
+               Cube::Handle<Cube::ReconTrack> rhs) {
+    if (!lhs || !rhs) return !lhs && !rhs;
+    if (!SameValue(lhs->GetQuality(),rhs->GetQuality())) return false;
+    if (!SameValue(lhs->GetNDOF(),rhs->GetNDOF())) return false;
+    if (lhs->GetStatus() != rhs->GetStatus()) return false;
+    if (!SameState(lhs->GetState(),rhs->GetState())) return false;
+    if (!SameState(lhs->GetBack(),rhs->GetBack())) return false;
+    if (lhs->GetNodes().size() != rhs->GetNodes().size()) return false;
+    for (std::size_t i = 0; i < lhs->GetNodes().size(); ++i) {
+        if (!(lhs->GetNodes()[i]->GetObject()
+              == rhs->GetNodes()[i]->GetObject())) return false;
+        if (!SameState(lhs->GetNodes()[i]->GetState(),
+                       rhs->GetNodes()[i]->GetState())) return false;
+    }
+    return true;
+}
+
+/// Fit copies of the tracks with a fitter.
+std::vector< Cube::Handle<Cube::ReconTrack> > FitTracks(
+    Cube::TrackFit& fitter,
+    const std::vector< Cube::Handle<Cube::ReconTrack> >& tracks) {
+    std::vector< Cube::Handle<Cube::ReconTrack> > result;
+    for (std::vector< Cube::Handle<Cube::ReconTrack> >::const_iterator t
+             = tracks.begin(); t != tracks.end(); ++t) {
+        Cube::Handle<Cube::ReconTrack> input(new Cube::ReconTrack(**t));
+        result.push_back(fitter.Apply(input));
+    }
+    return result;
+}
+
+/// Fit the tracks in the event with and without the cache, and compare the
+/// results.
+void AnalyzeEvent(Cube::Event& event) {
+    Cube::Handle<Cube::ReconObjectContainer> objects
+        = event.GetObjectContainer();
+    if (!objects) return;
+
+    std::vector< Cube::Handle<Cube::ReconTrack> > tracks;
+    for (Cube::ReconObjectContainer::iterator o = objects->begin();
+         o != objects->end(); ++o) {
+        Cube::Handle<Cube::ReconTrack> track = *o;
+        if (!track) continue;
+        if (track->GetNodes().size() < 3) continue;
+        tracks.push_back(track);
+    }
+    if (tracks.empty()) return;
+
+    Cube::TrackFit::ClearCache();
+
+    Cube::TrackFit freshFitter;
+    freshFitter.SetUseCache(false);
+    std::vector< Cube::Handle<Cube::ReconTrack> > fresh
+        = FitTracks(freshFitter, tracks);
+
+    Cube::TrackFit cacheFitter;
+    std::vector< Cube::Handle<Cube::ReconTrack> > saved
+        = FitTracks(cacheFitter, tracks);
+    int misses = Cube::TrackFit::GetCacheMisses();
+    std::vector< Cube::Handle<Cube::ReconTrack> > restored
+        = FitTracks(cacheFitter, tracks);
+    // Every track in the second pass should have been found.
+    gCacheMisses += Cube::TrackFit::GetCacheMisses() - misses;
+
+    Cube::TrackFit checkFitter;
+    checkFitter.SetCheckCache(true);
+    FitTracks(checkFitter, tracks);
+    gCacheMismatches += Cube::TrackFit::GetCacheMismatches();
+
+    for (std::size_t i = 0; i < tracks.size(); ++i) {
+        ++gTracks;
+        if (SameTrack(fresh[i],saved[i])
+            && SameTrack(fresh[i],restored[i])) continue;
+        ++gDifferentTracks;
+        std::cout << "Track " << tracks[i]->GetUniqueID()
+                  << " in event " << event.GetRunId()
+                  << "/" << event.GetEventId() << " is different"
+                  << std::endl;
+    }
+}
+
+int main(int argc, char** argv) {
+    int maxEntries = 1E+8; // Maximum to process.
+    int firstEntry = 0;
+
+    while (true) {
+        int c = getopt(argc,argv,"n:s:");
+        if (c<0) break;
+        switch (c) {
+        case 'n': {
+            std::istringstream tmp(optarg);
+            tmp >> maxEntries;
+            break;
+        }
+        case 's': {
+            std::istringstream tmp(optarg);
+            tmp >> firstEntry;
+            break;
+        }
+        default: {
+            std::cout << "Usage: " << std::endl;
+            std::cout << "   "
+                      << "-s <number>  : Skip <number> entries"
+                      << std::endl
+                      << "-n <number>  : Process no more than"
+                      << " <number> events."
+                      << std::endl;
+            exit(1);
+        }
+        }
+    }
+
+    if (argc <= optind) throw std::runtime_error("Missing input file");
+    std::string inputName(argv[optind++]);
+    std::cout << "Input Name " << inputName << std::endl;
+
+    // Attach to the input tree.
+    std::unique_ptr<TFile> inputFile(new TFile(inputName.c_str(),"old"));
+    if (!inputFile->IsOpen()) throw std::runtime_error("Input file not open");
+
+    /// Attach to the input tree.
+    TTree* inputTree = (TTree*) inputFile->Get("CubeEvents");
+    if (!inputTree) throw std::runtime_error("Missing the event tree");
+    Cube::Event *inputEvent = NULL;
+    inputTree->SetBranchAddress("Event",&inputEvent);
+
+    // Loop through the events.
+    int totalEntries = inputTree->GetEntries();
+    totalEntries = std::min(totalEntries,firstEntry+maxEntries);
+    for (int entry = firstEntry; entry < totalEntries; ++entry) {
+        inputTree->GetEntry(entry);
+        std::cout << "Process event " << inputEvent->GetRunId()
+                    << "/" << inputEvent->GetEventId() << std::endl;
+        inputEvent->MakeCurrentEvent();
+        AnalyzeEvent(*inputEvent);
+    }
+
+    std::cout << "Compared " << gTracks << " tracks, "
+              << gDifferentTracks << " different, "
+              << gCacheMisses << " not found in the cache, "
+              << gCacheMismatches << " cache check mismatches"
+              << std::endl;
+
+    if (gDifferentTracks > 0 || gCacheMisses > 0 || gCacheMismatches > 0) {
+        std::cout << "FAIL: The cached fits are not the same as new fits"
+                  << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Local Variables:
+// mode:c++
+// c-basic-offset:4
+// compile-command:"$(git rev-parse --show-toplevel)/build/cube-build.sh force"
+// End:
@@ -0,0 +1,276 @@
+#include <CubeEvent.hxx>
+#include <CubeReconTrack.hxx>
+#include <CubeReconCluster.hxx>
+#include <CubeReconNode.hxx>
+#include <CubeHandle.hxx>
+
+#include <CubeTrackFitBase.hxx>
+#include <CubePCATrackFit.hxx>
+#include <CubeStochTrackFit.hxx>
+#include <CubeKalmanTrackFit.hxx>
+
+#include <ToolMainTrajectory.hxx>
+#include <ToolTrueDirection.hxx>
+
+#include <TFile.h>
+#include <TTree.h>
+#include <TH1F.h>
+#include <TH2F.h>
+
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <memory>
+#include <algorithm>
+
+/// The fitters being compared, and the histograms for each of them.
+namespace {
+    // The "sequential" fitter is the stochastic fitter with the forward and
+    // backward passes run one after the other.  It's used to check that the
+    // concurrent passes give the same result.
+    enum {kPCA = 0, kStochastic, kSequential, kKalman, kFitters};
+    const char* gFitterName[kFitters] = {
+        "pca", "stochastic", "sequential", "kalman"};
+    Cube::TrackFitBase* gFitter[kFitters] = {NULL, NULL, NULL, NULL};
+
+    TH1F* histFitTime[kFitters];
+    TH2F* histFitTimeNodes[kFitters];
+    TH1F* histResidual[kFitters];
+    TH1F* histDirection[kFitters];
+    TH1F* histChi2[kFitters];
+
+    double gTotalTime[kFitters] = {0,0,0,0};
+    int gTotalFits[kFitters] = {0,0,0,0};
+    int gFailedFits[kFitters] = {0,0,0,0};
+    double gTotalResidual[kFitters] = {0,0,0,0};
+    int gTotalNodes[kFitters] = {0,0,0,0};
+
+    // The difference between the concurrent and sequential stochastic fits.
+    TH1F* histPassDifference = NULL;
+    int gComparedFits = 0;
+    int gDifferentFits = 0;
+}
+
+/// Refit every reconstructed track with each of the fitters, and record the
+/// fit time, the distance between the fitted node positions and the node
+/// clusters, and the angle to the true direction.
+void AnalyzeEvent(Cube::Event& event) {
+
+    if (!gFitter[kPCA]) {
+        std::cout << "Create the fitters and histograms" << std::endl;
+        gFitter[kPCA] = new Cube::PCATrackFit;
+        Cube::StochTrackFit* concurrent = new Cube::StochTrackFit;
+        concurrent->SetConcurrentPasses(true);
+        gFitter[kStochastic] = concurrent;
+        Cube::StochTrackFit* sequential = new Cube::StochTrackFit;
+        sequential->SetConcurrentPasses(false);
+        gFitter[kSequential] = sequential;
+        gFitter[kKalman] = new Cube::KalmanTrackFit;
+        for (int f = 0; f < kFitters; ++f) {
+            std::string name(gFitterName[f]);
+            histFitTime[f] = new TH1F(
+                (name+"FitTime").c_str(),
+                ("Fit time for " + name + " (ms)").c_str(),
+                100, 0.0, 50.0);
+            histFitTimeNodes[f] = new TH2F(
+                (name+"FitTimeNodes").c_str(),
+                ("Fit time versus nodes for " + name + " (ms)").c_str(),
+                50, 0.0, 250.0, 100, 0.0, 50.0);
+            histResidual[f] = new TH1F(
+                (name+"Residual").c_str(),
+                ("Node to cluster distance for " + name + " (mm)").c_str(),
+                100, 0.0, 20.0);
+            histDirection[f] = new TH1F(
+                (name+"Direction").c_str(),
+                ("Cosine to true direction for " + name).c_str(),
+                100, 0.9, 1.0);
+            histChi2[f] = new TH1F(
+                (name+"Chi2").c_str(),
+                ("Chi2 per DOF for " + name).c_str(),
+                100, 0.0, 10.0);
+        }
+        histPassDifference = new TH1F(
+            "passDifference",
+            "Node distance between concurrent and sequential passes (mm)",
+            100, 0.0, 1.0);
+    }
+
+    Cube::Handle<Cube::ReconObjectContainer> objects
+        = event.GetObjectContainer();
+    if (!objects) return;
+
+    for (Cube::ReconObjectContainer::iterator o = objects->begin();
+         o != objects->end(); ++o) {
+        Cube::Handle<Cube::ReconTrack> track = *o;
+        if (!track) continue;
+        if (track->GetNodes().size() < 3) continue;
+        int mainTraj = Cube::Tool::MainTrajectory(event,*track);
+        TVector3 trueD;
+        if (mainTraj >= 0) {
+            trueD = Cube::Tool::ObjectTrueDirection(event,*track);
+        }
+        Cube::Handle<Cube::ReconTrack> results[kFitters];
+        for (int f = 0; f < kFitters; ++f) {
+            // Fit a copy so that every fitter sees the same input.
+            Cube::Handle<Cube::ReconTrack> input(
+                new Cube::ReconTrack(*track));
+            std::chrono::high_resolution_clock::time_point start
+                = std::chrono::high_resolution_clock::now();
+            Cube::Handle<Cube::ReconTrack> result = gFitter[f]->Apply(input);
+            std::chrono::high_resolution_clock::time_point stop
+                = std::chrono::high_resolution_clock::now();
+            double ms = std::chrono::duration<double,std::milli>(
+                stop - start).count();
+            ++gTotalFits[f];
+            gTotalTime[f] += ms;
+            histFitTime[f]->Fill(ms);
+            histFitTimeNodes[f]->Fill(track->GetNodes().size(),ms);
+            if (!result) {
+                ++gFailedFits[f];
+                continue;
+            }
+            results[f] = result;
+            if (result->GetNDOF() > 0) {
+                histChi2[f]->Fill(result->GetQuality()/result->GetNDOF());
+            }
+            Cube::ReconNodeContainer& nodes = result->GetNodes();
+            for (Cube::ReconNodeContainer::iterator n = nodes.begin();
+                 n != nodes.end(); ++n) {
+                Cube::Handle<Cube::TrackState> state = (*n)->GetState();
+                Cube::Handle<Cube::ReconCluster> cluster = (*n)->GetObject();
+                double r = (state->GetPosition().Vect()
+                            - cluster->GetPosition().Vect()).Mag();
+                histResidual[f]->Fill(r);
+                gTotalResidual[f] += r;
+                ++gTotalNodes[f];
+            }
+            if (trueD.Mag() > 0.0) {
+                histDirection[f]->Fill(
+                    std::abs(result->GetDirection()*trueD.Unit()));
+            }
+        }
+
+        // Compare the concurrent and sequential stochastic fits node by
+        // node.  The passes use separate random number streams, so the
+        // results should be the same.
+        if (!results[kStochastic] || !results[kSequential]) continue;
+        Cube::ReconNodeContainer& concurrentNodes
+            = results[kStochastic]->GetNodes();
+        Cube::ReconNodeContainer& sequentialNodes
+            = results[kSequential]->GetNodes();
+        if (concurrentNodes.size() != sequentialNodes.size()) continue;
+        double maxDiff = 0.0;
+        for (std::size_t n = 0; n < concurrentNodes.size(); ++n) {
+            Cube::Handle<Cube::TrackState> c = concurrentNodes[n]->GetState();
+            Cube::Handle<Cube::TrackState> s = sequentialNodes[n]->GetState();
+            double r = (c->GetPosition().Vect()
+                        - s->GetPosition().Vect()).Mag();
+            maxDiff = std::max(maxDiff,r);
+        }
+        histPassDifference->Fill(maxDiff);
+        ++gComparedFits;
+        if (maxDiff > 1E-3) ++gDifferentFits;
+    }
+}
+
+int main(int argc, char** argv) {
+    int maxEntries = 1E+8; // Maximum to process.
+    int firstEntry = 0;
+
+    while (true) {
+        int c = getopt(argc,argv,"n:s:");
+        if (c<0) break;
+        switch (c) {
+        case 'n': {
+            std::istringstream tmp(optarg);
+            tmp >> maxEntries;
+            break;
+        }
+        case 's': {
+            std::istringstream tmp(optarg);
+            tmp >> firstEntry;
+            break;
+        }
+        default: {
+            std::cout << "Usage: " << std::endl;
+            std::cout << "   "
+                      << "-s <number>  : Skip <number> entries"
+                      << std::endl
+                      << "-n <number>  : Process no more than"
+                      << " <number> events."
+                      << std::endl;
+            exit(1);
+        }
+        }
+    }
+
+    if (argc <= optind) throw std::runtime_error("Missing input file");
+    std::string inputName(argv[optind++]);
+    std::cout << "Input Name " << inputName << std::endl;
+
+    std::string outputName;
+    if (argc > optind) {
+        outputName = argv[optind++];
+    }
+    else {
+        std::cout << "NO OUTPUT FILE!!!!" << std::endl;
+    }
+
+    // Attach to the input tree.
+    std::unique_ptr<TFile> inputFile(new TFile(inputName.c_str(),"old"));
+    if (!inputFile->IsOpen()) throw std::runtime_error("Input file not open");
+
+    /// Attach to the input tree.
+    TTree* inputTree = (TTree*) inputFile->Get("CubeEvents");
+    if (!inputTree) throw std::runtime_error("Missing the event tree");
+    Cube::Event *inputEvent = NULL;
+    inputTree->SetBranchAddress("Event",&inputEvent);
+
+    // Open the output file
+    std::unique_ptr<TFile> outputFile;
+    if (!outputName.empty()) {
+        std::cout << "Open Output File: " << outputName << std::endl;
+        outputFile.reset(new TFile(outputName.c_str(),"recreate"));
+    }
+
+    // Loop through the events.
+    int totalEntries = inputTree->GetEntries();
+    totalEntries = std::min(totalEntries,firstEntry+maxEntries);
+    for (int entry = firstEntry; entry < totalEntries; ++entry) {
+        inputTree->GetEntry(entry);
+        std::cout << "Process event " << inputEvent->GetRunId()
+                    << "/" << inputEvent->GetEventId() << std::endl;
+        inputEvent->MakeCurrentEvent();
+        AnalyzeEvent(*inputEvent);
+    }
+
+    // Summarize the fitters.
+    for (int f = 0; f < kFitters; ++f) {
+        if (gTotalFits[f] < 1) continue;
+        std::cout << "Fitter " << gFitterName[f]
+                  << ": " << gTotalFits[f] << " fits"
+                  << ", " << gFailedFits[f] << " failed"
+                  << ", " << gTotalTime[f]/gTotalFits[f] << " ms/fit";
+        if (gTotalNodes[f] > 0) {
+            std::cout << ", " << gTotalResidual[f]/gTotalNodes[f]
+                      << " mm average residual";
+        }
+        std::cout << std::endl;
+    }
+    std::cout << "Concurrent and sequential passes: " << gComparedFits
+              << " fits compared, " << gDifferentFits << " different"
+              << std::endl;
+
+    if (outputFile) {
+        outputFile->Write();
+        outputFile->Close();
+    }
+
+    return 0;
+}
+
+// Local Variables:
+// mode:c++
+// c-basic-offset:4
+// compile-command:"$(git rev-parse --show-toplevel)/build/cube-build.sh force"
+// End:
@@ -0,0 +1,332 @@
+#include <CubeEvent.hxx>
+#include <CubeG4Trajectory.hxx>
+#include <CubeReconVertex.hxx>
+#include <CubeReconTrack.hxx>
+#include <CubeHandle.hxx>
+#include <CubeUnits.hxx>
+
+#include <CubeVertexFit.hxx>
+
+#include <ToolContained.hxx>
+
+#include <TFile.h>
+#include <TTree.h>
+#include <TH1F.h>
+
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <memory>
+#include <cmath>
+#include <algorithm>
+
+/// Histograms comparing the linear vertex fit to the Minuit vertex fit.
+namespace {
+    TH1F* histLinearTime = NULL;
+    TH1F* histMinuitTime = NULL;
+    TH1F* histFitDifference = NULL;
+    TH1F* histChi2Difference = NULL;
+    TH1F* histLinearPull[3] = {NULL, NULL, NULL};
+    TH1F* histMinuitPull[3] = {NULL, NULL, NULL};
+    double gLinearTime = 0.0;
+    double gMinuitTime = 0.0;
+    int gLinearFits = 0;
+    int gMinuitFits = 0;
+    int gComparedFits = 0;
+    int gFallbacks = 0;
+    int gWorseChi2 = 0;
+    double gMaxFitDifference = 0.0;
+    double gMaxPullDifference[3] = {0.0, 0.0, 0.0};
+    double gMaxSigmaRatio[3] = {0.0, 0.0, 0.0};
+}
+
+/// Make a new vertex with the same constituents as the input.  The starting
+/// position is the average of the track ends closest to the input vertex, so
+/// the fit doesn't start at the answer.
+Cube::Handle<Cube::ReconVertex> CopyVertex(
+    Cube::Handle<Cube::ReconVertex> input) {
+    Cube::Handle<Cube::ReconVertex> vtx(new Cube::ReconVertex());
+    TVector3 start(0,0,0);
+    int ends = 0;
+    Cube::Handle<Cube::ReconObjectContainer> constituents
+        = input->GetConstituents();
+    for (Cube::ReconObjectContainer::iterator o = constituents->begin();
+         o != constituents->end(); ++o) {
+        Cube::Handle<Cube::ReconTrack> track = *o;
+        if (!track) continue;
+        vtx->AddConstituent(track);
+        TVector3 front = track->GetFront()->GetPosition().Vect();
+        TVector3 back = track->GetBack()->GetPosition().Vect();
+        TVector3 pos = input->GetPosition().Vect();
+        if ((front-pos).Mag() < (back-pos).Mag()) start += front;
+        else start += back;
+        ++ends;
+    }
+    if (ends > 0) start = (1.0/ends)*start;
+    vtx->GetState()->SetPosition(start.X(), start.Y(), start.Z(),
+                                 input->GetPosition().T());
+    vtx->GetState()->SetPositionVariance(10.0,10.0,10.0,10.0);
+    return vtx;
+}
+
+/// Fit a vertex and return the time in milliseconds.
+double TimeFit(Cube::VertexFit& fitter,
+               Cube::Handle<Cube::ReconVertex>& input,
+               Cube::Handle<Cube::ReconVertex>& output) {
+    std::chrono::high_resolution_clock::time_point start
+        = std::chrono::high_resolution_clock::now();
+    output = fitter(input);
+    std::chrono::high_resolution_clock::time_point stop
+        = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double,std::milli>(stop - start).count();
+}
+
+/// Fill the pulls of a fitted vertex relative to the true vertex.
+void FillPulls(TH1F* hist[3], Cube::Handle<Cube::ReconVertex> vertex,
+               const TLorentzVector& primaryVertex) {
+    TLorentzVector pos = vertex->GetPosition();
+    TLorentzVector var = vertex->GetPositionVariance();
+    for (int i=0; i<3; ++i) {
+        if (!(var[i] > 0.0)) continue;
+        hist[i]->Fill((pos[i]-primaryVertex[i])/std::sqrt(var[i]));
+    }
+}
+
+/// Compare the linear and Minuit fits of the same vertex.  The chi2 of the
+/// linear fit should not be larger than the Minuit chi2, and the pulls and
+/// uncertainties should be the same.
+void CompareFits(Cube::Handle<Cube::ReconVertex> linearVertex,
+                 Cube::Handle<Cube::ReconVertex> minuitVertex,
+                 const TLorentzVector& primaryVertex) {
+    ++gComparedFits;
+    double dist = (linearVertex->GetPosition().Vect()
+                   - minuitVertex->GetPosition().Vect()).Mag();
+    histFitDifference->Fill(dist);
+    gMaxFitDifference = std::max(gMaxFitDifference, dist);
+    double dChi2 = linearVertex->GetQuality() - minuitVertex->GetQuality();
+    histChi2Difference->Fill(dChi2);
+    if (dChi2 > 1E-3) ++gWorseChi2;
+    TLorentzVector linearPos = linearVertex->GetPosition();
+    TLorentzVector linearVar = linearVertex->GetPositionVariance();
+    TLorentzVector minuitPos = minuitVertex->GetPosition();
+    TLorentzVector minuitVar = minuitVertex->GetPositionVariance();
+    for (int i=0; i<3; ++i) {
+        if (!(linearVar[i] > 0.0) || !(minuitVar[i] > 0.0)) continue;
+        double linearSigma = std::sqrt(linearVar[i]);
+        double minuitSigma = std::sqrt(minuitVar[i]);
+        double linearPull = (linearPos[i]-primaryVertex[i])/linearSigma;
+        double minuitPull = (minuitPos[i]-primaryVertex[i])/minuitSigma;
+        gMaxPullDifference[i] = std::max(gMaxPullDifference[i],
+                                         std::abs(linearPull-minuitPull));
+        double ratio = std::abs(linearSigma/minuitSigma - 1.0);
+        gMaxSigmaRatio[i] = std::max(gMaxSigmaRatio[i], ratio);
+    }
+}
+
+/// Refit the reconstructed vertex closest to the true primary vertex with
+/// the linear fit and with Minuit, and compare the time and pulls.
+void AnalyzeEvent(Cube::Event& event) {
+    // Find the primary vertex.
+    TLorentzVector primaryVertex;
+    Cube::Event::G4TrajectoryContainer& trajectories = event.G4Trajectories;
+    for (Cube::Event::G4TrajectoryContainer::iterator tr = trajectories.begin();
+         tr != trajectories.end(); ++tr) {
+        // only count primaries.
+        if (tr->second->GetParentId() >= 0) continue;
+        primaryVertex = tr->second->GetInitialPosition();
+        break;
+    }
+
+    // Only look at contained primary vertices.
+    double fid= Cube::Tool::ContainedPoint(primaryVertex.Vect());
+    if (fid < 0.0) return;
+
+    Cube::Handle<Cube::ReconObjectContainer> objects
+        = event.GetObjectContainer();
+    if (!objects) return;
+
+    Cube::Handle<Cube::ReconVertex> bestVertex;
+    double bestDist = 10.0*unit::cm;
+    for (Cube::ReconObjectContainer::iterator o = objects->begin();
+         o != objects->end(); ++o) {
+        Cube::Handle<Cube::ReconVertex> vertex = *o;
+        if (!vertex) continue;
+        if (!vertex->GetConstituents()) continue;
+        if (vertex->GetConstituents()->size() < 2) continue;
+        double newDist =  (vertex->GetPosition().Vect()
+                           -primaryVertex.Vect()).Mag();
+        if (newDist > bestDist) continue;
+        bestDist = newDist;
+        bestVertex = vertex;
+    }
+    if (!bestVertex) return;
+
+    Cube::VertexFit linearFit;
+    Cube::Handle<Cube::ReconVertex> linearInput = CopyVertex(bestVertex);
+    Cube::Handle<Cube::ReconVertex> linearVertex;
+    double linearTime = TimeFit(linearFit, linearInput, linearVertex);
+    gFallbacks += linearFit.GetMinuitFallbackCount();
+
+    Cube::VertexFit minuitFit;
+    minuitFit.SetUseMinuit(true);
+    Cube::Handle<Cube::ReconVertex> minuitInput = CopyVertex(bestVertex);
+    Cube::Handle<Cube::ReconVertex> minuitVertex;
+    double minuitTime = TimeFit(minuitFit, minuitInput, minuitVertex);
+
+    histLinearTime->Fill(linearTime);
+    histMinuitTime->Fill(minuitTime);
+    gLinearTime += linearTime;
+    gMinuitTime += minuitTime;
+
+    if (linearVertex) {
+        ++gLinearFits;
+        FillPulls(histLinearPull, linearVertex, primaryVertex);
+    }
+    if (minuitVertex) {
+        ++gMinuitFits;
+        FillPulls(histMinuitPull, minuitVertex, primaryVertex);
+    }
+    if (linearVertex && minuitVertex) {
+        CompareFits(linearVertex, minuitVertex, primaryVertex);
+    }
+}
+
+int main(int argc, char** argv) {
+    int maxEntries = 1E+8; // Maximum to process.
+    int firstEntry = 0;
+
+    while (true) {
+        int c = getopt(argc,argv,"n:s:");
+        if (c<0) break;
+        switch (c) {
+        case 'n': {
+            std::istringstream tmp(optarg);
+            tmp >> maxEntries;
+            break;
+        }
+        case 's': {
+            std::istringstream tmp(optarg);
+            tmp >> firstEntry;
+            break;
+        }
+        default: {
+            std::cout << "Usage: " << std::endl;
+            std::cout << "   "
+                      << "-s <number>  : Skip <number> entries"
+                      << std::endl
+                      << "-n <number>  : Process no more than"
+                      << " <number> events."
+                      << std::endl;
+            exit(1);
+        }
+        }
+    }
+
+    if (argc <= optind) throw std::runtime_error("Missing input file");
+    std::string inputName(argv[optind++]);
+    std::cout << "Input Name " << inputName << std::endl;
+
+    std::string outputName;
+    if (argc > optind) {
+        outputName = argv[optind++];
+    }
+    else {
+        std::cout << "NO OUTPUT FILE!!!!" << std::endl;
+    }
+
+    // Attach to the input tree.
+    std::unique_ptr<TFile> inputFile(new TFile(inputName.c_str(),"old"));
+    if (!inputFile->IsOpen()) throw std::runtime_error("Input file not open");
+
+    /// Attach to the input tree.
+    TTree* inputTree = (TTree*) inputFile->Get("CubeEvents");
+    if (!inputTree) throw std::runtime_error("Missing the event tree");
+    Cube::Event *inputEvent = NULL;
+    inputTree->SetBranchAddress("Event",&inputEvent);
+
+    // Open the output file
+    std::unique_ptr<TFile> outputFile;
+    if (!outputName.empty()) {
+        std::cout << "Open Output File: " << outputName << std::endl;
+        outputFile.reset(new TFile(outputName.c_str(),"recreate"));
+    }
+
+    histLinearTime = new TH1F("linearTime",
+                              "Linear vertex fit time (ms)",
+                              100, 0.0, 1.0);
+    histMinuitTime = new TH1F("minuitTime",
+                              "Minuit vertex fit time (ms)",
+                              100, 0.0, 10.0);
+    histFitDifference = new TH1F("fitDifference",
+                                 "Distance between linear and Minuit fits",
+                                 100, 0.0, 5.0);
+    histFitDifference->SetXTitle("Distance (mm)");
+    histChi2Difference = new TH1F("chi2Difference",
+                                  "Linear minus Minuit fit chi2",
+                                  100, -1.0, 1.0);
+    const char* axis[3] = {"X", "Y", "Z"};
+    for (int i=0; i<3; ++i) {
+        std::string name = std::string("linear") + axis[i] + "Pull";
+        std::string title = std::string("Linear vertex fit pull on ")
+            + axis[i];
+        histLinearPull[i] = new TH1F(name.c_str(), title.c_str(),
+                                     100, -10.0, 10.0);
+        name = std::string("minuit") + axis[i] + "Pull";
+        title = std::string("Minuit vertex fit pull on ") + axis[i];
+        histMinuitPull[i] = new TH1F(name.c_str(), title.c_str(),
+                                     100, -10.0, 10.0);
+    }
+
+    // Loop through the events.
+    int totalEntries = inputTree->GetEntries();
+    totalEntries = std::min(totalEntries,firstEntry+maxEntries);
+    for (int entry = firstEntry; entry < totalEntries; ++entry) {
+        inputTree->GetEntry(entry);
+        std::cout << "Process event " << inputEvent->GetRunId()
+                    << "/" << inputEvent->GetEventId() << std::endl;
+        inputEvent->MakeCurrentEvent();
+        AnalyzeEvent(*inputEvent);
+    }
+
+    // Summarize the comparison.
+    std::cout << "Linear fits: " << gLinearFits
+              << " (" << gFallbacks << " used Minuit)"
+              << ", " << gLinearTime << " ms" << std::endl;
+    std::cout << "Minuit fits: " << gMinuitFits
+              << ", " << gMinuitTime << " ms" << std::endl;
+    if (gLinearTime > 0.0) {
+        std::cout << "Speedup " << gMinuitTime/gLinearTime << std::endl;
+    }
+    for (int i=0; i<3; ++i) {
+        std::cout << axis[i] << " pull RMS:"
+                  << " linear " << histLinearPull[i]->GetRMS()
+                  << ", Minuit " << histMinuitPull[i]->GetRMS()
+                  << std::endl;
+    }
+    std::cout << "Compared " << gComparedFits << " fits, mean distance "
+              << histFitDifference->GetMean() << " mm"
+              << ", maximum " << gMaxFitDifference << " mm" << std::endl;
+    std::cout << "Linear minus Minuit chi2: mean "
+              << histChi2Difference->GetMean()
+              << ", " << gWorseChi2 << " linear fits with a larger chi2"
+              << std::endl;
+    for (int i=0; i<3; ++i) {
+        std::cout << axis[i] << " maximum pull difference "
+                  << gMaxPullDifference[i]
+                  << ", maximum uncertainty difference "
+                  << 100.0*gMaxSigmaRatio[i] << "%" << std::endl;
+    }
+
+    if (outputFile) {
+        outputFile->Write();
+        outputFile->Close();
+    }
+
+    return 0;
+}
+
+// Local Variables:
+// mode:c++
+// c-basic-offset:4
+// compile-command:"$(git rev-parse --show-toplevel)/build/cube-build.sh force"
+// End:
@@ -0,0 +1,169 @@
+#include <CubeEvent.hxx>
+#include <CubeReconTrack.hxx>
+#include <CubeHandle.hxx>
+#include <CubeAlgorithmResult.hxx>
+#include <CubeHitSelection.hxx>
+
+#include <CubeBuildPairwiseVertices.hxx>
+
+#include <TFile.h>
+#include <TTree.h>
+#include <TProfile.h>
+
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <memory>
+#include <map>
+
+/// The vertex fits and time for each number of tracks.
+namespace {
+    TProfile* histFits = NULL;
+    TProfile* histTime = NULL;
+    std::map<int,double> gTotalFits;
+    std::map<int,double> gTotalTime;
+    std::map<int,int> gTotalRuns;
+}
+
+/// Run BuildPairwiseVertices on the first N tracks of the event for a
+/// growing N, and record the number of vertex fits and the time.
+void AnalyzeEvent(Cube::Event& event) {
+    Cube::Handle<Cube::ReconObjectContainer> objects
+        = event.GetObjectContainer();
+    if (!objects) return;
+    Cube::Handle<Cube::HitSelection> hits = event.GetHitSelection();
+    if (!hits) return;
+
+    Cube::ReconObjectContainer tracks;
+    for (Cube::ReconObjectContainer::iterator o = objects->begin();
+         o != objects->end(); ++o) {
+        Cube::Handle<Cube::ReconTrack> track = *o;
+        if (!track) continue;
+        tracks.push_back(track);
+    }
+
+    for (std::size_t n = 2; n <= tracks.size(); ++n) {
+        Cube::AlgorithmResult input;
+        input.AddHitSelection(hits);
+        Cube::Handle<Cube::ReconObjectContainer>
+            subset(new Cube::ReconObjectContainer("final"));
+        std::copy(tracks.begin(), tracks.begin()+n,
+                  std::back_inserter(*subset));
+        input.AddObjectContainer(subset);
+
+        Cube::BuildPairwiseVertices builder;
+        std::chrono::high_resolution_clock::time_point start
+            = std::chrono::high_resolution_clock::now();
+        builder.Process(input);
+        std::chrono::high_resolution_clock::time_point stop
+            = std::chrono::high_resolution_clock::now();
+        double ms = std::chrono::duration<double,std::milli>(
+            stop - start).count();
+        histFits->Fill(n, builder.GetVertexFitCount());
+        histTime->Fill(n, ms);
+        gTotalFits[n] += builder.GetVertexFitCount();
+        gTotalTime[n] += ms;
+        ++gTotalRuns[n];
+    }
+}
+
+int main(int argc, char** argv) {
+    int maxEntries = 1E+8; // Maximum to process.
+    int firstEntry = 0;
+
+    while (true) {
+        int c = getopt(argc,argv,"n:s:");
+        if (c<0) break;
+        switch (c) {
+        case 'n': {
+            std::istringstream tmp(optarg);
+            tmp >> maxEntries;
+            break;
+        }
+        case 's': {
+            std::istringstream tmp(optarg);
+            tmp >> firstEntry;
+            break;
+        }
+        default: {
+            std::cout << "Usage: " << std::endl;
+            std::cout << "   "
+                      << "-s <number>  : Skip <number> entries"
+                      << std::endl
+                      << "-n <number>  : Process no more than"
+                      << " <number> events."
+                      << std::endl;
+            exit(1);
+        }
+        }
+    }
+
+    if (argc <= optind) throw std::runtime_error("Missing input file");
+    std::string inputName(argv[optind++]);
+    std::cout << "Input Name " << inputName << std::endl;
+
+    std::string outputName;
+    if (argc > optind) {
+        outputName = argv[optind++];
+    }
+    else {
+        std::cout << "NO OUTPUT FILE!!!!" << std::endl;
+    }
+
+    // Attach to the input tree.
+    std::unique_ptr<TFile> inputFile(new TFile(inputName.c_str(),"old"));
+    if (!inputFile->IsOpen()) throw std::runtime_error("Input file not open");
+
+    /// Attach to the input tree.
+    TTree* inputTree = (TTree*) inputFile->Get("CubeEvents");
+    if (!inputTree) throw std::runtime_error("Missing the event tree");
+    Cube::Event *inputEvent = NULL;
+    inputTree->SetBranchAddress("Event",&inputEvent);
+
+    // Open the output file
+    std::unique_ptr<TFile> outputFile;
+    if (!outputName.empty()) {
+        std::cout << "Open Output File: " << outputName << std::endl;
+        outputFile.reset(new TFile(outputName.c_str(),"recreate"));
+    }
+
+    histFits = new TProfile("vertexFits",
+                            "Vertex fits versus number of tracks",
+                            50, 0.5, 50.5);
+    histTime = new TProfile("vertexTime",
+                            "Vertex building time versus tracks (ms)",
+                            50, 0.5, 50.5);
+
+    // Loop through the events.
+    int totalEntries = inputTree->GetEntries();
+    totalEntries = std::min(totalEntries,firstEntry+maxEntries);
+    for (int entry = firstEntry; entry < totalEntries; ++entry) {
+        inputTree->GetEntry(entry);
+        std::cout << "Process event " << inputEvent->GetRunId()
+                    << "/" << inputEvent->GetEventId() << std::endl;
+        inputEvent->MakeCurrentEvent();
+        AnalyzeEvent(*inputEvent);
+    }
+
+    // Summarize the scaling.
+    for (std::map<int,int>::iterator r = gTotalRuns.begin();
+         r != gTotalRuns.end(); ++r) {
+        std::cout << "Tracks " << r->first
+                  << ": " << gTotalFits[r->first]/r->second << " fits"
+                  << ", " << gTotalTime[r->first]/r->second << " ms"
+                  << std::endl;
+    }
+
+    if (outputFile) {
+        outputFile->Write();
+        outputFile->Close();
+    }
+
+    return 0;
+}
+
+// Local Variables:
+// mode:c++
+// c-basic-offset:4
+// compile-command:"$(git rev-parse --show-toplevel)/build/cube-build.sh force"
+// End:
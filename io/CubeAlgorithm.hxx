@@ -5,6 +5,7 @@
 
 #include "CubeHitSelection.hxx"
 #include "CubeAlgorithmResult.hxx"
+#include "CubeAlgorithmTrace.hxx"
 
 namespace Cube {
     class Algorithm;
@@ -86,18 +87,27 @@ protected:
     }
 
     /// Templates to simplify calling sub-algorithms.  These handle the
-    /// Algorithm memory management.
+    /// Algorithm memory management, and record the call when the
+    /// Cube::AlgorithmTrace or Cube::AlgorithmSummary is on.
     template<typename T>
     Cube::Handle<Cube::AlgorithmResult> Run(const Cube::AlgorithmResult& in1) {
         std::unique_ptr<T> ptr(new T);
-        return ptr->Process(in1);
+        if (!Cube::AlgorithmTrace::IsRecording()) {
+            return ptr->Process(in1);
+        }
+        Cube::AlgorithmTrace::Scope trace(*ptr,in1);
+        return trace.Finish(ptr->Process(in1));
     }
 
     template<typename T>
     Cube::Handle<Cube::AlgorithmResult> Run(const Cube::AlgorithmResult& in1,
                                             const Cube::AlgorithmResult& in2) {
         std::unique_ptr<T> ptr(new T);
-        return ptr->Process(in1,in2);
+        if (!Cube::AlgorithmTrace::IsRecording()) {
+            return ptr->Process(in1,in2);
+        }
+        Cube::AlgorithmTrace::Scope trace(*ptr,in1,in2);
+        return trace.Finish(ptr->Process(in1,in2));
     }
 
     template<typename T>
@@ -105,7 +115,11 @@ protected:
                                             const Cube::AlgorithmResult& in2,
                                             const Cube::AlgorithmResult& in3) {
         std::unique_ptr<T> ptr(new T);
-        return ptr->Process(in1,in2,in3);
+        if (!Cube::AlgorithmTrace::IsRecording()) {
+            return ptr->Process(in1,in2,in3);
+        }
+        Cube::AlgorithmTrace::Scope trace(*ptr,in1,in2,in3);
+        return trace.Finish(ptr->Process(in1,in2,in3));
     }
 
 private:
@@ -0,0 +1,295 @@
+#include "CubeAlgorithmSummary.hxx"
+#include "CubeEvent.hxx"
+#include "CubeLog.hxx"
+
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+#include <algorithm>
+#include <vector>
+#include <map>
+#include <cmath>
+
+bool Cube::AlgorithmSummary::fEnabled = false;
+
+namespace {
+    // The times are histogrammed with logarithmic bins starting at
+    // kMinimumTime (in seconds).  The first bin is the underflow and the
+    // last bin is the overflow.
+    const double kMinimumTime = 1E-6;
+    const int kBinsPerDecade = 50;
+    const int kDecades = 11;
+    const int kBins = kBinsPerDecade*kDecades + 2;
+
+    // The statistics for one algorithm, or for the events.
+    struct TimeStats {
+        TimeStats()
+            : fCount(0), fTotal(0.0), fCPU(0.0), fMax(0.0),
+              fHitsIn(0), fHitsOut(0), fMaxNetHeap(0), fMaxPeakHeap(0),
+              fBins(kBins,0) {}
+
+        void Add(double wall, double cpu, int hitsIn, int hitsOut,
+                 long netHeap, long peakHeap) {
+            ++fCount;
+            fTotal += wall;
+            fCPU += cpu;
+            fMax = std::max(fMax,wall);
+            fHitsIn += hitsIn;
+            fHitsOut += hitsOut;
+            fMaxNetHeap = std::max(fMaxNetHeap,netHeap);
+            fMaxPeakHeap = std::max(fMaxPeakHeap,peakHeap);
+            int bin = 0;
+            if (wall >= kMinimumTime) {
+                bin = 1 + (int) (kBinsPerDecade
+                                 * std::log10(wall/kMinimumTime));
+                bin = std::min(bin,kBins-1);
+            }
+            ++fBins[bin];
+        }
+
+        // Find the quantile by interpolating inside of the bin.
+        double Quantile(double q) const {
+            if (fCount < 1) return 0.0;
+            double target = q*fCount;
+            long sum = 0;
+            for (int bin = 0; bin < kBins; ++bin) {
+                if (fBins[bin] < 1) continue;
+                sum += fBins[bin];
+                if (sum < target) continue;
+                if (bin == 0) return std::min(kMinimumTime,fMax);
+                if (bin == kBins-1) return fMax;
+                double low = kMinimumTime
+                    * std::pow(10.0, 1.0*(bin-1)/kBinsPerDecade);
+                double high = low * std::pow(10.0, 1.0/kBinsPerDecade);
+                double frac = (target - (sum - fBins[bin]))/fBins[bin];
+                return std::min(low*std::pow(high/low,frac), fMax);
+            }
+            return fMax;
+        }
+
+        long fCount;
+        double fTotal;
+        double fCPU;
+        double fMax;
+        long fHitsIn;
+        long fHitsOut;
+        long fMaxNetHeap;
+        long fMaxPeakHeap;
+        std::vector<long> fBins;
+    };
+
+    typedef std::map<std::string, TimeStats> AlgorithmMap;
+    AlgorithmMap gAlgorithms;
+    TimeStats gEvents;
+
+    // The totals for the current event.
+    double gEventWall = 0.0;
+    double gEventCPU = 0.0;
+    int gEventHitsIn = 0;
+    int gEventHitsOut = 0;
+    long gEventNetHeap = 0;
+    long gEventPeakHeap = 0;
+    bool gEventOversize = false;
+
+    // The oversize slices, and the (run, event) that had them.
+    long gOversizeSlices = 0;
+    long gOversizeHits = 0;
+    std::vector< std::pair<int,int> > gOversizeEvents;
+
+    // Order the algorithms with the most time first.
+    struct MostTimeFirst {
+        bool operator () (AlgorithmMap::const_iterator lhs,
+                          AlgorithmMap::const_iterator rhs) const {
+            if (lhs->second.fTotal != rhs->second.fTotal) {
+                return lhs->second.fTotal > rhs->second.fTotal;
+            }
+            return lhs->first < rhs->first;
+        }
+    };
+
+    std::vector<AlgorithmMap::const_iterator> SortedAlgorithms() {
+        std::vector<AlgorithmMap::const_iterator> sorted;
+        for (AlgorithmMap::const_iterator a = gAlgorithms.begin();
+             a != gAlgorithms.end(); ++a) {
+            sorted.push_back(a);
+        }
+        std::sort(sorted.begin(), sorted.end(), MostTimeFirst());
+        return sorted;
+    }
+
+    // Write a string with the JSON escapes.
+    void WriteString(std::ostream& out, const std::string& value) {
+        out << '"';
+        for (std::string::const_iterator c = value.begin();
+             c != value.end(); ++c) {
+            if (*c == '"' || *c == '\\') out << '\\' << *c;
+            else if (*c < ' ') out << ' ';
+            else out << *c;
+        }
+        out << '"';
+    }
+
+    // Write the fields for one set of statistics.
+    void WriteStats(std::ostream& out, const TimeStats& stats) {
+        out << "\"calls\":" << stats.fCount
+            << ",\"total_s\":" << stats.fTotal
+            << ",\"p50_s\":" << stats.Quantile(0.50)
+            << ",\"p99_s\":" << stats.Quantile(0.99)
+            << ",\"max_s\":" << stats.fMax
+            << ",\"cpu_s\":" << stats.fCPU
+            << ",\"hits_in\":" << stats.fHitsIn
+            << ",\"hits_out\":" << stats.fHitsOut
+            << ",\"max_net_heap_bytes\":" << stats.fMaxNetHeap
+            << ",\"max_peak_heap_bytes\":" << stats.fMaxPeakHeap;
+    }
+
+    // Print one row of the table.  The times are in milliseconds except for
+    // the total.
+    void PrintRow(std::ostream& out, const std::string& name,
+                  const TimeStats& stats) {
+        out << std::left << std::setw(20) << name.substr(0,20)
+            << std::right
+            << std::setw(9) << stats.fCount
+            << std::fixed << std::setprecision(2)
+            << std::setw(11) << stats.fTotal
+            << std::setw(10) << 1000.0*stats.Quantile(0.50)
+            << std::setw(10) << 1000.0*stats.Quantile(0.99)
+            << std::setw(10) << 1000.0*stats.fMax
+            << std::setw(11) << stats.fHitsIn
+            << std::setw(11) << stats.fHitsOut
+            << std::setw(10) << stats.fMaxNetHeap/1024.0/1024.0
+            << std::setw(10) << stats.fMaxPeakHeap/1024.0/1024.0
+            << std::endl;
+        out.unsetf(std::ios::floatfield);
+    }
+}
+
+void Cube::AlgorithmSummary::AddCall(const std::string& name, int depth,
+                                     double wall, double cpu,
+                                     int hitsIn, int hitsOut,
+                                     long netHeap, long peakHeap) {
+    gAlgorithms[name].Add(wall,cpu,hitsIn,hitsOut,netHeap,peakHeap);
+    if (depth > 0) return;
+    gEventWall += wall;
+    gEventCPU += cpu;
+    gEventHitsIn += hitsIn;
+    gEventHitsOut += hitsOut;
+    // The peak for the event is relative to the heap when the first call
+    // in the event started.
+    gEventPeakHeap = std::max(gEventPeakHeap, gEventNetHeap + peakHeap);
+    gEventNetHeap += netHeap;
+}
+
+void Cube::AlgorithmSummary::AddOversizeSlice(int hits) {
+    ++gOversizeSlices;
+    gOversizeHits += hits;
+    gEventOversize = true;
+}
+
+void Cube::AlgorithmSummary::FinishEvent() {
+    gEvents.Add(gEventWall,gEventCPU,gEventHitsIn,gEventHitsOut,
+                gEventNetHeap,gEventPeakHeap);
+    if (gEventOversize) {
+        int run = -1;
+        int event = -1;
+        Cube::Event* current = Cube::Event::CurrentEvent();
+        if (current) {
+            run = current->GetRunId();
+            event = current->GetEventId();
+        }
+        gOversizeEvents.push_back(std::make_pair(run,event));
+    }
+    gEventWall = 0.0;
+    gEventCPU = 0.0;
+    gEventHitsIn = 0;
+    gEventHitsOut = 0;
+    gEventNetHeap = 0;
+    gEventPeakHeap = 0;
+    gEventOversize = false;
+}
+
+void Cube::AlgorithmSummary::Reset() {
+    gAlgorithms.clear();
+    gEvents = TimeStats();
+    gEventWall = 0.0;
+    gEventCPU = 0.0;
+    gEventHitsIn = 0;
+    gEventHitsOut = 0;
+    gEventNetHeap = 0;
+    gEventPeakHeap = 0;
+    gEventOversize = false;
+    gOversizeSlices = 0;
+    gOversizeHits = 0;
+    gOversizeEvents.clear();
+}
+
+void Cube::AlgorithmSummary::Write(const std::string& fileName) {
+    std::ofstream out(fileName.c_str());
+    if (!out.is_open()) {
+        CUBE_ERROR << "Cannot open summary file " << fileName << std::endl;
+        throw std::runtime_error("Summary file not open");
+    }
+    out << std::setprecision(6);
+    out << "{" << std::endl;
+    out << "\"events\":{";
+    WriteStats(out,gEvents);
+    out << "}," << std::endl;
+    out << "\"oversize\":{\"slices\":" << gOversizeSlices
+        << ",\"hits\":" << gOversizeHits
+        << ",\"events\":[";
+    for (std::vector< std::pair<int,int> >::iterator e
+             = gOversizeEvents.begin();
+         e != gOversizeEvents.end(); ++e) {
+        if (e != gOversizeEvents.begin()) out << ",";
+        out << "{\"run\":" << e->first << ",\"event\":" << e->second << "}";
+    }
+    out << "]}," << std::endl;
+    out << "\"algorithms\":[";
+    std::vector<AlgorithmMap::const_iterator> sorted = SortedAlgorithms();
+    for (std::vector<AlgorithmMap::const_iterator>::iterator a
+             = sorted.begin();
+         a != sorted.end(); ++a) {
+        if (a != sorted.begin()) out << ",";
+        out << std::endl << "{\"name\":";
+        WriteString(out,(*a)->first);
+        out << ",";
+        WriteStats(out,(*a)->second);
+        out << "}";
+    }
+    out << std::endl << "]}" << std::endl;
+}
+
+void Cube::AlgorithmSummary::Print(std::ostream& out) {
+    out << std::left << std::setw(20) << "Algorithm"
+        << std::right
+        << std::setw(9) << "Calls"
+        << std::setw(11) << "Total(s)"
+        << std::setw(10) << "p50(ms)"
+        << std::setw(10) << "p99(ms)"
+        << std::setw(10) << "Max(ms)"
+        << std::setw(11) << "HitsIn"
+        << std::setw(11) << "HitsOut"
+        << std::setw(10) << "Net(MB)"
+        << std::setw(10) << "Peak(MB)"
+        << std::endl;
+    std::vector<AlgorithmMap::const_iterator> sorted = SortedAlgorithms();
+    for (std::vector<AlgorithmMap::const_iterator>::iterator a
+             = sorted.begin();
+         a != sorted.end(); ++a) {
+        PrintRow(out,(*a)->first,(*a)->second);
+    }
+    PrintRow(out,"Event",gEvents);
+    if (gEvents.fTotal > 0.0) {
+        out << "Events per second: "
+            << gEvents.fCount/gEvents.fTotal << std::endl;
+    }
+    out << "Oversize slices skipped: " << gOversizeSlices
+        << " (" << gOversizeHits << " hits in "
+        << gOversizeEvents.size() << " events)" << std::endl;
+}
+
+// Local Variables:
+// mode:c++
+// c-basic-offset:4
+// compile-command:"$(git rev-parse --show-toplevel)/build/cube-build.sh force"
+// End:
@@ -0,0 +1,88 @@
+#ifndef CubeAlgorithmSummary_hxx_seen
+#define CubeAlgorithmSummary_hxx_seen
+
+#include <string>
+#include <iostream>
+
+namespace Cube {
+    class AlgorithmSummary;
+}
+
+/// Accumulate the performance of each algorithm over a run.  For each
+/// algorithm name this keeps the number of calls, the total, median (p50),
+/// 99th percentile (p99) and maximum wall time, the total CPU time, the
+/// total number of hits going in and out, and (when Cube::MemoryAccount is
+/// enabled) the largest net change of the heap across a call and the
+/// largest peak heap during a call.  Both heap values are relative to the
+/// heap when the call started, and the peak is sampled at the start and end
+/// of the calls (see Cube::AlgorithmTrace).  A call that allocates and then
+/// frees a lot of memory has a small net change, but has a large peak if the
+/// memory is in use when one of the calls that it makes starts or finishes.
+/// In the table, "Net(MB)" and "Peak(MB)" are the largest values.  The same
+/// is kept for the total time of each event (the sum of the top level
+/// algorithm calls).  The slices that are skipped by Cube::Recon because
+/// they are too large are counted, and the events that had a skipped slice
+/// are listed.
+///
+/// The calls are recorded by Cube::AlgorithmTrace::Scope (i.e. everything
+/// run with Cube::Algorithm::Run<T>()) when the summary is enabled.  The
+/// time of a call includes the time of the algorithms that it calls.  The
+/// percentiles come from a histogram with logarithmic bins and are accurate
+/// to about 5%, so the memory doesn't grow with the number of calls.
+///
+/// \code
+/// Cube::AlgorithmSummary::Enable();
+/// for (each event) {
+///    ... run the algorithms ...
+///    Cube::AlgorithmSummary::FinishEvent();
+/// }
+/// Cube::AlgorithmSummary::Write("summary.json");
+/// Cube::AlgorithmSummary::Print(std::cout);
+/// \endcode
+///
+/// Like Cube::AlgorithmTrace, this should only be used from the thread
+/// running the reconstruction.
+class Cube::AlgorithmSummary {
+public:
+    /// Start accumulating the summary.
+    static void Enable() {fEnabled = true;}
+
+    /// True if the summary is being accumulated.
+    static bool IsEnabled() {return fEnabled;}
+
+    /// Add an algorithm call.  The times are in seconds, and the depth is
+    /// zero for a call that isn't made by another algorithm.  The netHeap is
+    /// the change in the heap used across the call in bytes, and the
+    /// peakHeap is the largest heap seen during the call less the heap when
+    /// the call started (see Cube::MemoryAccount).
+    static void AddCall(const std::string& name, int depth,
+                        double wall, double cpu, int hitsIn, int hitsOut,
+                        long netHeap = 0, long peakHeap = 0);
+
+    /// Count a time slice that wasn't reconstructed because it had too many
+    /// hits.  The slice is charged to the current event.
+    static void AddOversizeSlice(int hits);
+
+    /// Finish the current event and add its totals to the summary.
+    static void FinishEvent();
+
+    /// Write the summary as a JSON file.
+    static void Write(const std::string& fileName);
+
+    /// Print the summary as a table.
+    static void Print(std::ostream& out);
+
+    /// Remove everything from the summary.
+    static void Reset();
+
+private:
+    /// Set when the summary is enabled.
+    static bool fEnabled;
+};
+#endif
+
+// Local Variables:
+// mode:c++
+// c-basic-offset:4
+// compile-command:"$(git rev-parse --show-toplevel)/build/cube-build.sh force"
+// End:
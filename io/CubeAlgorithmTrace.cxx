@@ -0,0 +1,208 @@
+#include "CubeAlgorithmTrace.hxx"
+#include "CubeAlgorithm.hxx"
+#include "CubeAlgorithmResult.hxx"
+#include "CubeEvent.hxx"
+#include "CubeMemoryAccount.hxx"
+#include "CubeLog.hxx"
+
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+#include <chrono>
+#include <vector>
+#include <memory>
+#include <ctime>
+#include <algorithm>
+
+bool Cube::AlgorithmTrace::fOpen = false;
+int Cube::AlgorithmTrace::fSlice = -1;
+
+namespace {
+    // The information saved when an algorithm call starts.
+    struct OpenCall {
+        std::string fName;
+        std::chrono::steady_clock::time_point fWallStart;
+        std::clock_t fCPUStart;
+        int fRun;
+        int fEvent;
+        int fSlice;
+        int fHitsIn;
+        int fObjectsIn;
+        long fHeapStart;
+        // The largest heap seen during the call.  The heap is sampled when
+        // the calls made by this call start and finish.
+        long fHeapPeak;
+    };
+
+    // The calls that have started, but not finished.  The depth of a call
+    // is its position in the stack.
+    std::vector<OpenCall> gCallStack;
+
+    // The output file, and the time that the trace was opened.  The file
+    // starts with a metadata record, so every call record is preceded by a
+    // comma.
+    std::unique_ptr<std::ofstream> gTraceFile;
+    std::chrono::steady_clock::time_point gTraceStart;
+
+    // The number of hits in the last hit selection of a result.
+    int CountHits(const Cube::AlgorithmResult* result) {
+        if (!result) return 0;
+        Cube::Handle<Cube::HitSelection> hits = result->GetHitSelection();
+        if (!hits) return 0;
+        return hits->size();
+    }
+
+    // The number of objects in the last object container of a result.
+    int CountObjects(const Cube::AlgorithmResult* result) {
+        if (!result) return 0;
+        Cube::Handle<Cube::ReconObjectContainer> objects
+            = result->GetObjectContainer();
+        if (!objects) return 0;
+        return objects->size();
+    }
+
+    // Write a string with the JSON escapes.
+    void WriteString(std::ostream& out, const std::string& value) {
+        out << '"';
+        for (std::string::const_iterator c = value.begin();
+             c != value.end(); ++c) {
+            if (*c == '"' || *c == '\\') out << '\\' << *c;
+            else if (*c < ' ') out << ' ';
+            else out << *c;
+        }
+        out << '"';
+    }
+}
+
+void Cube::AlgorithmTrace::Open(const std::string& fileName) {
+    Close();
+    gTraceFile.reset(new std::ofstream(fileName.c_str()));
+    if (!gTraceFile->is_open()) {
+        CUBE_ERROR << "Cannot open trace file " << fileName << std::endl;
+        gTraceFile.reset();
+        throw std::runtime_error("Trace file not open");
+    }
+    gTraceStart = std::chrono::steady_clock::now();
+    *gTraceFile << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":["
+                << std::endl
+                << "{\"name\":\"process_name\",\"ph\":\"M\","
+                << "\"pid\":1,\"tid\":1,"
+                << "\"args\":{\"name\":\"cubeRecon\"}}";
+    fOpen = true;
+}
+
+void Cube::AlgorithmTrace::Close() {
+    if (!gTraceFile) return;
+    *gTraceFile << std::endl << "]}" << std::endl;
+    gTraceFile->close();
+    gTraceFile.reset();
+    fOpen = false;
+}
+
+void Cube::AlgorithmTrace::Scope::Begin(const Cube::Algorithm& algorithm,
+                                        const Cube::AlgorithmResult* input1,
+                                        const Cube::AlgorithmResult* input2,
+                                        const Cube::AlgorithmResult* input3) {
+    OpenCall call;
+    call.fName = algorithm.GetName();
+    call.fRun = -1;
+    call.fEvent = -1;
+    Cube::Event* event = Cube::Event::CurrentEvent();
+    if (event) {
+        call.fRun = event->GetRunId();
+        call.fEvent = event->GetEventId();
+    }
+    call.fSlice = Cube::AlgorithmTrace::GetSlice();
+    call.fHitsIn = CountHits(input1) + CountHits(input2) + CountHits(input3);
+    call.fObjectsIn = CountObjects(input1) + CountObjects(input2)
+        + CountObjects(input3);
+    call.fHeapStart = 0;
+    if (Cube::MemoryAccount::IsEnabled()) {
+        call.fHeapStart = Cube::MemoryAccount::GetHeapBytes();
+        if (!gCallStack.empty()) {
+            OpenCall& parent = gCallStack.back();
+            parent.fHeapPeak = std::max(parent.fHeapPeak, call.fHeapStart);
+        }
+    }
+    call.fHeapPeak = call.fHeapStart;
+    call.fCPUStart = std::clock();
+    call.fWallStart = std::chrono::steady_clock::now();
+    gCallStack.push_back(call);
+    fActive = true;
+}
+
+void Cube::AlgorithmTrace::Scope::End(const Cube::AlgorithmResult* result) {
+    fActive = false;
+    if (gCallStack.empty()) return;
+
+    std::chrono::steady_clock::time_point wallStop
+        = std::chrono::steady_clock::now();
+    std::clock_t cpuStop = std::clock();
+    OpenCall& call = gCallStack.back();
+    int depth = gCallStack.size() - 1;
+
+    typedef std::chrono::duration<double, std::micro> Microseconds;
+    double start = Microseconds(call.fWallStart - gTraceStart).count();
+    double wall = Microseconds(wallStop - call.fWallStart).count();
+    double cpu = 1E+6*(cpuStop - call.fCPUStart)/CLOCKS_PER_SEC;
+    int hitsOut = CountHits(result);
+    long netHeap = 0;
+    long peakHeap = 0;
+    if (Cube::MemoryAccount::IsEnabled()) {
+        long heapStop = Cube::MemoryAccount::GetHeapBytes();
+        call.fHeapPeak = std::max(call.fHeapPeak, heapStop);
+        netHeap = heapStop - call.fHeapStart;
+        peakHeap = call.fHeapPeak - call.fHeapStart;
+        // The peak of this call is also seen by the call that made it.
+        if (depth > 0) {
+            OpenCall& parent = gCallStack[depth-1];
+            parent.fHeapPeak = std::max(parent.fHeapPeak, call.fHeapPeak);
+        }
+    }
+
+    if (Cube::AlgorithmSummary::IsEnabled()) {
+        Cube::AlgorithmSummary::AddCall(call.fName, depth,
+                                        1E-6*wall, 1E-6*cpu,
+                                        call.fHitsIn, hitsOut,
+                                        netHeap, peakHeap);
+    }
+
+    // The trace file isn't open (e.g. only the summary is being kept).
+    if (!gTraceFile) {
+        gCallStack.pop_back();
+        return;
+    }
+
+    std::ostream& out = *gTraceFile;
+    out << ",\n{\"name\":";
+    WriteString(out,call.fName);
+    out << ",\"cat\":\"algorithm\",\"ph\":\"X\",\"pid\":1,\"tid\":1"
+        << std::fixed << std::setprecision(1)
+        << ",\"ts\":" << start
+        << ",\"dur\":" << wall
+        << ",\"args\":{"
+        << "\"cpu_us\":" << cpu
+        << ",\"depth\":" << depth
+        << ",\"run\":" << call.fRun
+        << ",\"event\":" << call.fEvent
+        << ",\"slice\":" << call.fSlice
+        << ",\"hits_in\":" << call.fHitsIn
+        << ",\"hits_out\":" << hitsOut
+        << ",\"objects_in\":" << call.fObjectsIn
+        << ",\"objects_out\":" << CountObjects(result)
+        << ",\"failed\":" << (result ? "false" : "true");
+    if (Cube::MemoryAccount::IsEnabled()) {
+        out << ",\"net_heap_bytes\":" << netHeap
+            << ",\"peak_heap_bytes\":" << peakHeap;
+    }
+    out << "}}";
+    out.unsetf(std::ios::floatfield);
+
+    gCallStack.pop_back();
+}
+
+// Local Variables:
+// mode:c++
+// c-basic-offset:4
+// compile-command:"$(git rev-parse --show-toplevel)/build/cube-build.sh force"
+// End:
@@ -0,0 +1,149 @@
+#ifndef CubeAlgorithmTrace_hxx_seen
+#define CubeAlgorithmTrace_hxx_seen
+
+#include "CubeHandle.hxx"
+#include "CubeAlgorithmSummary.hxx"
+
+#include <string>
+
+namespace Cube {
+    class AlgorithmTrace;
+    class Algorithm;
+    class AlgorithmResult;
+}
+
+/// Record the wall time, CPU time, and the number of hits and objects going
+/// into and out of every algorithm that is run.  When the
+/// Cube::MemoryAccount is enabled, the net change in the heap and the peak
+/// heap (both relative to the heap when the call started) are also
+/// recorded.  The heap is only sampled when an algorithm call starts or
+/// finishes, so the peak is the largest heap seen at the start or end of
+/// the call and of the calls that it makes.  Memory that is allocated and
+/// freed between those points isn't seen.
+/// The trace is written as a Chrome trace event file that can be loaded
+/// into chrome://tracing or https://ui.perfetto.dev.  Each algorithm call
+/// is a "complete" event with the call depth, the run and event number of
+/// the current event (see Cube::Event::MakeCurrentEvent()), and the time
+/// slice as arguments.
+///
+/// The trace is off by default, and is turned on with Open().  The calls
+/// are also added to the Cube::AlgorithmSummary when it is enabled.  When
+/// neither is on, the cost of a call is checking two flags.  The
+/// algorithms run with Cube::Algorithm::Run<T>() are recorded
+/// automatically.  An algorithm that is called directly can be recorded
+/// with a Cube::AlgorithmTrace::Scope.
+///
+/// \code
+/// Cube::AlgorithmTrace::Open("trace.json");
+/// ...
+/// Cube::AlgorithmTrace::Scope trace(*algorithm,input);
+/// result = trace.Finish(algorithm->Process(input));
+/// ...
+/// Cube::AlgorithmTrace::Close();
+/// \endcode
+///
+/// The trace isn't thread safe, and should only be used from the thread
+/// running the reconstruction.  The CPU time is for the whole process, so
+/// it includes any worker threads (e.g. in Cube::TrackFitBatch).
+class Cube::AlgorithmTrace {
+public:
+    /// Record one algorithm call.  The call is started when the scope is
+    /// constructed and finishes when Finish() is called (or the scope is
+    /// destroyed).  The hits and objects going into the call are summed
+    /// over all of the inputs.
+    class Scope {
+    public:
+        Scope(const Cube::Algorithm& algorithm,
+              const Cube::AlgorithmResult& input)
+            : fActive(false) {
+            if (Cube::AlgorithmTrace::IsRecording()) {
+                Begin(algorithm,&input,NULL,NULL);
+            }
+        }
+        Scope(const Cube::Algorithm& algorithm,
+              const Cube::AlgorithmResult& input1,
+              const Cube::AlgorithmResult& input2)
+            : fActive(false) {
+            if (Cube::AlgorithmTrace::IsRecording()) {
+                Begin(algorithm,&input1,&input2,NULL);
+            }
+        }
+        Scope(const Cube::Algorithm& algorithm,
+              const Cube::AlgorithmResult& input1,
+              const Cube::AlgorithmResult& input2,
+              const Cube::AlgorithmResult& input3)
+            : fActive(false) {
+            if (Cube::AlgorithmTrace::IsRecording()) {
+                Begin(algorithm,&input1,&input2,&input3);
+            }
+        }
+        ~Scope() {if (fActive) End(NULL);}
+
+        /// Finish the call and record the output.  The result is returned
+        /// so this can wrap the call to the algorithm.
+        Cube::Handle<Cube::AlgorithmResult>
+        Finish(Cube::Handle<Cube::AlgorithmResult> result) {
+            if (fActive) End(Cube::GetPointer(result));
+            return result;
+        }
+
+    private:
+        void Begin(const Cube::Algorithm& algorithm,
+                   const Cube::AlgorithmResult* input1,
+                   const Cube::AlgorithmResult* input2,
+                   const Cube::AlgorithmResult* input3);
+        void End(const Cube::AlgorithmResult* result);
+
+        /// True if this call is being recorded.
+        bool fActive;
+    };
+
+    /// Set the time slice that is being processed until the scope is
+    /// destroyed.  The slices are numbered from zero.
+    class SliceScope {
+    public:
+        explicit SliceScope(int slice)
+            : fPrevious(Cube::AlgorithmTrace::GetSlice()) {
+            Cube::AlgorithmTrace::SetSlice(slice);
+        }
+        ~SliceScope() {Cube::AlgorithmTrace::SetSlice(fPrevious);}
+    private:
+        int fPrevious;
+    };
+
+    /// Start writing the trace to a file.  An existing trace is closed.
+    static void Open(const std::string& fileName);
+
+    /// Finish the trace and close the file.
+    static void Close();
+
+    /// True if the trace is being recorded.
+    static bool IsOpen() {return fOpen;}
+
+    /// True if the algorithm calls are being recorded, either to the trace
+    /// file or to the Cube::AlgorithmSummary.
+    static bool IsRecording() {
+        return fOpen || Cube::AlgorithmSummary::IsEnabled();
+    }
+
+    /// Set the current time slice.  A negative value means the algorithms
+    /// aren't being run on a slice.
+    static void SetSlice(int slice) {fSlice = slice;}
+
+    /// Get the current time slice.
+    static int GetSlice() {return fSlice;}
+
+private:
+    /// Set when the trace is open.
+    static bool fOpen;
+
+    /// The current time slice.
+    static int fSlice;
+};
+#endif
+
+// Local Variables:
+// mode:c++
+// c-basic-offset:4
+// compile-command:"$(git rev-parse --show-toplevel)/build/cube-build.sh force"
+// End:
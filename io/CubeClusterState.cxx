@@ -3,12 +3,21 @@
 ///////////////////////////////////////////////////////
 ClassImp(Cube::ClusterState);
 
+namespace {
+    /// The field names shared by every cluster state.  These must be in the
+    /// same order as the STATE_DEFINITION macros in the constructor.
+    const char* const gFieldNames[] = {
+        POSITION_STATE_FIELDS,
+        ENERGY_DEPOSIT_STATE_FIELDS
+    };
+}
+
 Cube::ClusterState::ClusterState() {
 
     POSITION_STATE_DEFINITION;
     ENERGY_DEPOSIT_STATE_DEFINITION;
 
-    Init();
+    Init(gFieldNames, sizeof(gFieldNames)/sizeof(gFieldNames[0]));
 }
 
 Cube::ClusterState::~ClusterState() {}
@@ -18,17 +27,9 @@ Cube::ClusterState::ClusterState(const Cube::ClusterState& init) {
     POSITION_STATE_DEFINITION;
     ENERGY_DEPOSIT_STATE_DEFINITION;
 
-    Init();
+    Init(gFieldNames, sizeof(gFieldNames)/sizeof(gFieldNames[0]));
 
-    for (int i=0; i<GetDimensions(); ++i) {
-        SetValue(i,init.GetValue(i));
-    }
-
-    for (int i=0; i<GetDimensions(); ++i) {
-        for (int j=0; j<GetDimensions(); ++j) {
-            SetCovarianceValue(i,j,init.GetCovarianceValue(i,j));
-        }
-    }
+    CopyValues(init);
 
 }
 
@@ -36,15 +37,7 @@ Cube::ClusterState& Cube::ClusterState::operator=(
     const Cube::ClusterState& rhs) {
     if (this == &rhs) return *this;
 
-    for (int i=0; i<GetDimensions(); ++i) {
-        SetValue(i,rhs.GetValue(i));
-    }
-
-    for (int i=0; i<GetDimensions(); ++i) {
-        for (int j=0; j<GetDimensions(); ++j) {
-            SetCovarianceValue(i,j,rhs.GetCovarianceValue(i,j));
-        }
-    }
+    CopyValues(rhs);
 
     return *this;
 }
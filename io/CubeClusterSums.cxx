@@ -0,0 +1,212 @@
+#include "CubeClusterSums.hxx"
+#include "CubeCorrValues.hxx"
+#include "CubeHit.hxx"
+
+#include <TVector3.h>
+
+#include <cmath>
+
+Cube::ClusterSums::ClusterSums() {
+    Clear();
+}
+
+void Cube::ClusterSums::Clear() {
+    fHits = 0;
+    fCharge = 0.0;
+    fChargeFourth = 0.0;
+    for (int i = 0; i < kValues; ++i) {
+        fValue[i] = 0.0;
+        fNorm[i] = 0.0;
+        fHitWeight[i] = 0.0;
+        for (int j = 0; j < kValues; ++j) {
+            fWeight[i][j] = 0.0;
+            fWeight2[i][j] = 0.0;
+            fWeightI[i][j] = 0.0;
+            fWeightJ[i][j] = 0.0;
+            fWeightIJ[i][j] = 0.0;
+            fDOF[i][j] = 0.0;
+        }
+    }
+    for (int i = 0; i < 3; ++i) {
+        fPosition[i] = 0.0;
+        fSize2[i] = 0.0;
+        for (int j = 0; j < 3; ++j) fPosition2[i][j] = 0.0;
+    }
+}
+
+void Cube::ClusterSums::Accumulate(const Cube::Hit& hit, double sign) {
+    const TVector3& pos = hit.GetPosition();
+    const TVector3& unc = hit.GetUncertainty();
+    const TVector3& size = hit.GetSize();
+    double q = hit.GetCharge();
+
+    double vals[kValues]
+        = {q, pos.X(), pos.Y(), pos.Z(), hit.GetTime()};
+    double sigs[kValues]
+        = {1.0, unc.X(), unc.Y(), unc.Z(), hit.GetTimeUncertainty()};
+    double rms[kValues]
+        = {0.0, size.X(), size.Y(), size.Z(), hit.GetTimeUncertainty()};
+
+    fHits += (sign > 0) ? 1 : -1;
+    fCharge += sign*q;
+    fChargeFourth += sign*q*q*q*q;
+
+    // The averages are energy deposition weighted.  The energy deposit
+    // isn't averaged.
+    for (int i = 0; i < kValues; ++i) {
+        if (i == kEDeposit) continue;
+        fValue[i] += sign*q*vals[i]/(sigs[i]*sigs[i]);
+        fNorm[i] += sign*q/(sigs[i]*sigs[i]);
+    }
+
+    // The covariance uses the Poisson uncertainty for the charge.
+    sigs[kEDeposit] = std::sqrt(q);
+    for (int row = 0; row < kValues; ++row) {
+        for (int col = row; col < kValues; ++col) {
+            double weight = 1.0/(sigs[row]*sigs[col]);
+            fWeight[row][col] += sign*weight;
+            fWeight2[row][col] += sign*weight*weight;
+            fWeightI[row][col] += sign*weight*vals[row];
+            fWeightJ[row][col] += sign*weight*vals[col];
+            fWeightIJ[row][col] += sign*weight*vals[row]*vals[col];
+            double degrees = 4*rms[row]*rms[col]/(12*sigs[row]*sigs[col]);
+            if (row == kT && col == kT) degrees = 1.0;
+            fDOF[row][col] += sign*degrees;
+        }
+        fHitWeight[row] += sign/(sigs[row]*sigs[row]);
+    }
+
+    for (int row = 0; row < 3; ++row) {
+        fPosition[row] += sign*q*pos[row];
+        fSize2[row] += sign*q*size[row]*size[row];
+        for (int col = row; col < 3; ++col) {
+            fPosition2[row][col] += sign*q*pos[row]*pos[col];
+        }
+    }
+}
+
+void Cube::ClusterSums::Combine(const Cube::ClusterSums& rhs, double sign) {
+    fHits += (sign > 0) ? rhs.fHits : -rhs.fHits;
+    fCharge += sign*rhs.fCharge;
+    fChargeFourth += sign*rhs.fChargeFourth;
+    for (int i = 0; i < kValues; ++i) {
+        fValue[i] += sign*rhs.fValue[i];
+        fNorm[i] += sign*rhs.fNorm[i];
+        fHitWeight[i] += sign*rhs.fHitWeight[i];
+        for (int j = i; j < kValues; ++j) {
+            fWeight[i][j] += sign*rhs.fWeight[i][j];
+            fWeight2[i][j] += sign*rhs.fWeight2[i][j];
+            fWeightI[i][j] += sign*rhs.fWeightI[i][j];
+            fWeightJ[i][j] += sign*rhs.fWeightJ[i][j];
+            fWeightIJ[i][j] += sign*rhs.fWeightIJ[i][j];
+            fDOF[i][j] += sign*rhs.fDOF[i][j];
+        }
+    }
+    for (int i = 0; i < 3; ++i) {
+        fPosition[i] += sign*rhs.fPosition[i];
+        fSize2[i] += sign*rhs.fSize2[i];
+        for (int j = i; j < 3; ++j) {
+            fPosition2[i][j] += sign*rhs.fPosition2[i][j];
+        }
+    }
+}
+
+Cube::ClusterSums&
+Cube::ClusterSums::operator += (const Cube::ClusterSums& rhs) {
+    Combine(rhs,1.0);
+    return *this;
+}
+
+Cube::ClusterSums&
+Cube::ClusterSums::operator -= (const Cube::ClusterSums& rhs) {
+    Combine(rhs,-1.0);
+    return *this;
+}
+
+void Cube::ClusterSums::GetValues(double values[kValues]) const {
+    values[kEDeposit] = fCharge;
+    for (int i = 0; i < kValues; ++i) {
+        if (i == kEDeposit) continue;
+        values[i] = fValue[i];
+        if (fNorm[i] > 0) values[i] /= fNorm[i];
+    }
+}
+
+void Cube::ClusterSums::GetCovariance(double cov[kValues][kValues]) const {
+    double values[kValues];
+    GetValues(values);
+
+    for (int row = 0; row < kValues; ++row) {
+        for (int col = row; col < kValues; ++col) {
+            // Find the weighted RMS around the average values.
+            double c = 0.0;
+            double w = fWeight[row][col];
+            if (w > 0) {
+                c = fWeightIJ[row][col]
+                    - values[col]*fWeightI[row][col]
+                    - values[row]*fWeightJ[row][col]
+                    + values[row]*values[col]*w;
+                c /= w;
+            }
+            // Turn the RMS into a covariance of the mean.
+            if (fDOF[row][col] > 0.9) {
+#ifdef NEW_IMPLEMENTATION
+                c *= w*w / (w*w - fWeight2[row][col]);
+#else
+                c /= std::sqrt(fDOF[row][col]);
+#endif
+            }
+            else if (row == col) c = Cube::CorrValues::kFreeValue;
+            else c = 0.0;
+            cov[row][col] = c;
+            cov[col][row] = c;
+        }
+    }
+
+#ifndef NO_FINITE_SIZE_CORRECTION
+    // Add the correction for finite size of the hits.
+    for (int idx = 0; idx < kValues; ++idx) {
+        if (fHitWeight[idx] < 1E-8) continue;
+        cov[idx][idx] += 1.0/fHitWeight[idx];
+    }
+#endif
+
+    // The deposited energy is assumed to be Poisson distributed.
+    cov[kEDeposit][kEDeposit] = values[kEDeposit];
+}
+
+void Cube::ClusterSums::GetMoments(double moments[3][3]) const {
+    double values[kValues];
+    GetValues(values);
+    double center[3] = {values[kX], values[kY], values[kZ]};
+
+    for (int row = 0; row < 3; ++row) {
+        for (int col = row; col < 3; ++col) {
+            double m = 0.0;
+            // No divide by zero please!
+            if (fCharge > 1E-6) {
+                m = fPosition2[row][col]
+                    - center[col]*fPosition[row]
+                    - center[row]*fPosition[col]
+                    + center[row]*center[col]*fCharge;
+                // Correct for the finite size of the hit.
+                if (row == col) m += fSize2[row];
+                m /= fCharge;
+            }
+            else if (row == col) {
+                // There were no measurements on this axis so spread the
+                // charge over the entire range of the detector
+                // (i.e. +-"10 m + epsilon")
+                m = 1E+9;
+            }
+            moments[row][col] = m;
+            moments[col][row] = m;
+        }
+    }
+}
+
+// Local Variables:
+// mode:c++
+// c-basic-offset:4
+// compile-command:"$(git rev-parse --show-toplevel)/build/cube-build.sh force"
+// End:
@@ -0,0 +1,113 @@
+#ifndef CubeClusterSums_hxx_seen
+#define CubeClusterSums_hxx_seen
+
+namespace Cube {
+    class ClusterSums;
+    class Hit;
+}
+
+/// The running sums over the hits in a cluster that are needed to find the
+/// cluster state (the energy deposit, the average position and their
+/// covariance) and the moments of the charge distribution.  The sums for
+/// two sets of hits can be combined, so the sums for a cluster made by
+/// joining two clusters are found without looking at the hits again.  This
+/// is used by Cube::ReconCluster, and isn't saved to the output file.
+///
+/// The values are ordered as the energy deposit, then X, Y, Z and T.  The
+/// averages (other than the energy deposit, which is the sum of the charge)
+/// are weighted by the charge and the hit uncertainty.
+class Cube::ClusterSums {
+public:
+    enum {kEDeposit = 0, kX, kY, kZ, kT, kValues};
+
+    ClusterSums();
+
+    /// Remove all of the hits from the sums.
+    void Clear();
+
+    /// Add a hit to the sums.
+    void AddHit(const Cube::Hit& hit) {Accumulate(hit,1.0);}
+
+    /// Remove a hit that was added to the sums.
+    void RemoveHit(const Cube::Hit& hit) {Accumulate(hit,-1.0);}
+
+    /// Add the hits between the begin and end iterators to the sums.  The
+    /// iterators should resolve to Cube::Handle<Cube::Hit> objects.
+    template <typename T>
+    void AddHits(T begin, T end) {
+        for (T h = begin; h != end; ++h) AddHit(*(*h));
+    }
+
+    /// Add the hits from another set of sums.
+    Cube::ClusterSums& operator += (const Cube::ClusterSums& rhs);
+
+    /// Remove the hits from another set of sums.  The hits must have been
+    /// added to these sums.
+    Cube::ClusterSums& operator -= (const Cube::ClusterSums& rhs);
+
+    /// The number of hits in the sums.
+    int GetHitCount() const {return fHits;}
+
+    /// The total charge of the hits.
+    double GetCharge() const {return fCharge;}
+
+    /// The sum of the fourth power of the hit charges.
+    double GetChargeFourthSum() const {return fChargeFourth;}
+
+    /// Fill the values for the state.  The energy deposit is the total
+    /// charge, and the other values are weighted averages.
+    void GetValues(double values[kValues]) const;
+
+    /// Fill the covariance of the state values.
+    void GetCovariance(double cov[kValues][kValues]) const;
+
+    /// Fill the charge weighted moments of the hit positions around the
+    /// average position.  The moments include the size of the hits.
+    void GetMoments(double moments[3][3]) const;
+
+private:
+    /// Add (sign is 1) or remove (sign is -1) a hit.
+    void Accumulate(const Cube::Hit& hit, double sign);
+
+    /// Add (sign is 1) or remove (sign is -1) another set of sums.
+    void Combine(const Cube::ClusterSums& rhs, double sign);
+
+    /// The number of hits.
+    int fHits;
+
+    /// The sum of the charge, and of the fourth power of the charge.
+    double fCharge;
+    double fChargeFourth;
+
+    /// The sums for the weighted averages.  Each hit adds q*v/s^2 to the
+    /// value and q/s^2 to the norm.
+    double fValue[kValues];
+    double fNorm[kValues];
+
+    /// The sums for the covariance.  Each hit adds a weight w=1/(s_i*s_j),
+    /// and the weighted values.  The charge uncertainty is sqrt(q).  Only
+    /// the elements with i <= j are used.
+    double fWeight[kValues][kValues];
+    double fWeight2[kValues][kValues];
+    double fWeightI[kValues][kValues];
+    double fWeightJ[kValues][kValues];
+    double fWeightIJ[kValues][kValues];
+    double fDOF[kValues][kValues];
+
+    /// The sum of 1/s^2 for each value.  This corrects the covariance for
+    /// the finite size of the hits.
+    double fHitWeight[kValues];
+
+    /// The charge weighted sums of the hit positions, the products of the
+    /// positions (only i <= j are used), and the squared hit sizes.
+    double fPosition[3];
+    double fPosition2[3][3];
+    double fSize2[3];
+};
+#endif
+
+// Local Variables:
+// mode:c++
+// c-basic-offset:4
+// compile-command:"$(git rev-parse --show-toplevel)/build/cube-build.sh force"
+// End:
@@ -10,6 +10,12 @@ namespace Cube {
     Event* gCurrentEvent = NULL;
 };
 
+namespace {
+    // The identifiers used when there isn't a current event.
+    UInt_t gLastHitId = 0;
+    UInt_t gLastObjectId = 0;
+}
+
 Cube::Event* Cube::Event::CurrentEvent() {return Cube::gCurrentEvent;}
 
 void Cube::Event::MakeCurrentEvent() const {
@@ -18,7 +24,19 @@ void Cube::Event::MakeCurrentEvent() const {
 
 Cube::Event::Event() {Initialize();}
 
-Cube::Event::~Event() {}
+UInt_t Cube::Event::NewHitId() {
+    if (Cube::gCurrentEvent) return ++(Cube::gCurrentEvent->fLastHitId);
+    return ++gLastHitId;
+}
+
+UInt_t Cube::Event::NewObjectId() {
+    if (Cube::gCurrentEvent) return ++(Cube::gCurrentEvent->fLastObjectId);
+    return ++gLastObjectId;
+}
+
+Cube::Event::~Event() {
+    if (Cube::gCurrentEvent == this) Cube::gCurrentEvent = NULL;
+}
 
 // Local Variables:
 // mode:c++
@@ -29,6 +29,8 @@ public:
         fRunId = run;
         fEventId = event;
         fEDepSimEvent = TRef(evt);
+        fLastHitId = 0;
+        fLastObjectId = 0;
         G4Hits.clear();
         G4Trajectories.clear();
         Cube::AlgorithmResult::Initialize();
@@ -40,6 +42,34 @@ public:
     /// The event number.
     int GetEventId() const {return fEventId;}
 
+    /// Get a new stable identifier for a hit.  The identifier comes from
+    /// the current event (see MakeCurrentEvent()), and is saved in the hit
+    /// as the TObject::fUniqueID.  The identifiers are dense and assigned in
+    /// the order the hits are made, so they don't depend on where the hits
+    /// are in memory.  If there isn't a current event, the identifier comes
+    /// from a counter that is shared by the whole job.  This isn't thread
+    /// safe, so hits must be made on the main thread.
+    static UInt_t NewHitId();
+
+    /// Get a new stable identifier for a reconstruction object.  This
+    /// works the same way as NewHitId(), but has a separate sequence.
+    static UInt_t NewObjectId();
+
+    /// Get the last hit identifier assigned in this event.
+    UInt_t GetLastHitId() const {return fLastHitId;}
+
+    /// Get the last reconstruction object identifier assigned in this
+    /// event.
+    UInt_t GetLastObjectId() const {return fLastObjectId;}
+
+    /// Set the last identifiers assigned in this event.  This is used to
+    /// rerun the reconstruction on an event so that the new hits and
+    /// objects get the same identifiers.
+    void SetLastIds(UInt_t hitId, UInt_t objectId) {
+        fLastHitId = hitId;
+        fLastObjectId = objectId;
+    }
+
     void ls(Option_t *opt = "") const {
         TROOT::IndentLevel();
         std::cout << "%%% Event : " << fRunId << " / " << fEventId << std::endl;
@@ -60,6 +90,13 @@ private:
     /// The parent EDepSim event (if available).
     TRef fEDepSimEvent;
 
+    /// The last stable identifier assigned to a hit in this event.  This is
+    /// saved so hits added after the event is read continue the sequence.
+    UInt_t fLastHitId;
+
+    /// The last stable identifier assigned to a reconstruction object.
+    UInt_t fLastObjectId;
+
 public:
     /////////////////////////////////////////////////////////////////////////
     /// The stuff below this comment "doesn't exist".  This is a cheaters way
@@ -80,7 +117,7 @@ public:
     G4TrajectoryContainer;
     G4TrajectoryContainer G4Trajectories;
 
-    ClassDef(Event,1);
+    ClassDef(Event,2);
 };
 #endif
 
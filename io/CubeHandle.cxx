@@ -6,19 +6,19 @@
 #include <TClass.h>
 
 #include "CubeHandle.hxx"
+#include "CubeMemoryAccount.hxx"
 
 
 namespace {
-    int gHandleBaseCount = 0;
-    int gLastHandleCount = 0;
+    long gLastHandleCount = 0;
 }
 
 ClassImp(Cube::HandleBase)
 Cube::HandleBase::HandleBase() : fCount(0), fHandleCount(0) {
-    ++gHandleBaseCount;
+    Cube::MemoryAccount::Created(Cube::MemoryAccount::kHandleBase);
 }
 Cube::HandleBase::~HandleBase() {
-    --gHandleBaseCount;
+    Cube::MemoryAccount::Destroyed(Cube::MemoryAccount::kHandleBase);
 }
 
 ClassImp(Cube::HandleBaseDeletable)
@@ -48,13 +48,15 @@ void Cube::HandleBaseUndeletable::DeleteObject() {
 }
 
 bool Cube::CleanHandleRegistry(bool) {
-    bool result = (gHandleBaseCount==gLastHandleCount);
+    long handleBaseCount
+        = Cube::MemoryAccount::GetLiveCount(Cube::MemoryAccount::kHandleBase);
+    bool result = (handleBaseCount==gLastHandleCount);
     if (!result) {
         CUBE_ERROR << "CleanHandleRegistry::"
-                   << " Handle Count: " << gHandleBaseCount
-                   << " Change: " << gHandleBaseCount - gLastHandleCount
+                   << " Handle Count: " << handleBaseCount
+                   << " Change: " << handleBaseCount - gLastHandleCount
                    << std::endl;;
-        gLastHandleCount = gHandleBaseCount;
+        gLastHandleCount = handleBaseCount;
     }
     return result;
 }
@@ -1,4 +1,6 @@
 #include "CubeHit.hxx"
+#include "CubeEvent.hxx"
+#include "CubeMemoryAccount.hxx"
 #include "TUnitsTable.hxx"
 
 #include <TROOT.h>
@@ -11,7 +13,20 @@ ClassImp(Cube::WritableHit);
 
 Cube::Hit::Hit()
     : fIdentifier(0), fCharge(-9999), fChargeUncertainty(-9999),
-      fTime(-9999), fTimeUncertainty(-9999) {}
+      fTime(-9999), fTimeUncertainty(-9999) {
+    Cube::MemoryAccount::Created(Cube::MemoryAccount::kHit);
+}
+
+// The copy has the same stable identifier as the original hit.
+Cube::Hit::Hit(const Cube::Hit& h)
+    : TObject(h), fIdentifier(h.fIdentifier), fCharge(h.fCharge),
+      fChargeUncertainty(h.fChargeUncertainty),
+      fTime(h.fTime), fTimeUncertainty(h.fTimeUncertainty),
+      fPosition(h.fPosition), fUncertainty(h.fUncertainty), fSize(h.fSize),
+      fConstituents(h.fConstituents), fContributors(h.fContributors),
+      fProperties(h.fProperties) {
+    Cube::MemoryAccount::Created(Cube::MemoryAccount::kHit);
+}
 
 Cube::Hit::Hit(const Cube::WritableHit& h)
     : fIdentifier(h.fIdentifier), fCharge(h.fCharge),
@@ -19,9 +34,14 @@ Cube::Hit::Hit(const Cube::WritableHit& h)
       fTime(h.fTime), fTimeUncertainty(h.fTimeUncertainty),
       fPosition(h.fPosition), fUncertainty(h.fUncertainty), fSize(h.fSize),
       fConstituents(h.fConstituents), fContributors(h.fContributors),
-      fProperties(h.fProperties) {}
+      fProperties(h.fProperties) {
+    SetUniqueID(Cube::Event::NewHitId());
+    Cube::MemoryAccount::Created(Cube::MemoryAccount::kHit);
+}
 
-Cube::Hit::~Hit() { }
+Cube::Hit::~Hit() {
+    Cube::MemoryAccount::Destroyed(Cube::MemoryAccount::kHit);
+}
 
 int Cube::Hit::GetIdentifier(void) const {return fIdentifier;}
 
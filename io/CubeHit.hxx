@@ -26,7 +26,10 @@ namespace Cube {
 /// TReconCluster.
 ///
 /// The Hit class can't be directly instantiated.  It is created
-/// using the WritableHit class and is accessed as a Hit class.
+/// using the WritableHit class and is accessed as a Hit class.  Each Hit
+/// has it's TObject::fUniqueID set to a stable identifier that is assigned
+/// in the order the hits are made in the event (see
+/// Cube::Event::NewHitId()).
 class Cube::Hit : public TObject {
 public:
     /// Define the status bits used by the Hit object.  These can't collide
@@ -39,6 +42,7 @@ public:
     };
 
     Hit();
+    Hit(const Hit& val);
     Hit(const WritableHit& val);
     virtual ~Hit();
 
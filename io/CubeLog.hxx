@@ -1,12 +1,34 @@
 #include <iostream>
 #include <iomanip>
 
+#ifndef CubeLog_hxx_seen
+#define CubeLog_hxx_seen
+namespace Cube {
+    /// The stream that the log messages on this thread are written to.  If
+    /// this is NULL, the messages are written to std::cout.  A worker thread
+    /// (e.g. in Cube::TrackFitBatch) sets a buffer so that it doesn't write
+    /// to std::cout at the same time as the main thread, and the buffer is
+    /// written by the main thread when the work is finished.
+    inline std::ostream*& LogStreamPointer() {
+        static thread_local std::ostream* stream = NULL;
+        return stream;
+    }
+
+    /// Get the stream that the log messages on this thread are written to.
+    inline std::ostream& LogStream() {
+        std::ostream* stream = LogStreamPointer();
+        if (stream) return *stream;
+        return std::cout;
+    }
+}
+#endif
+
 #ifndef CUBE_LOG_LEVEL
 #define CUBE_LOG_LEVEL 1
 #endif
 
 #ifndef CUBE_LOG
-#define CUBE_LOG(level) if ((level) <= (CUBE_LOG_LEVEL)) std::cout << std::setfill('%') << std::setw(level+2) << " " << std::setfill(' ')
+#define CUBE_LOG(level) if ((level) <= (CUBE_LOG_LEVEL)) Cube::LogStream() << std::setfill('%') << std::setw(level+2) << " " << std::setfill(' ')
 #endif
 
 #ifndef CUBE_DEBUG_LEVEL
@@ -14,9 +36,9 @@
 #endif
 
 #ifndef CUBE_DEBUG
-#define CUBE_DEBUG(level) if ((level) <= (CUBE_DEBUG_LEVEL)) std::cout << std::setfill('#') << std::setw(level+2) << " " << std::setfill(' ') << "(" << __LINE__ << "):"
+#define CUBE_DEBUG(level) if ((level) <= (CUBE_DEBUG_LEVEL)) Cube::LogStream() << std::setfill('#') << std::setw(level+2) << " " << std::setfill(' ') << "(" << __LINE__ << "):"
 #endif
 
 #ifndef CUBE_ERROR
-#define CUBE_ERROR (std::cout <<__FILE__<<":: " << __LINE__ << ": " )
+#define CUBE_ERROR (Cube::LogStream() <<__FILE__<<":: " << __LINE__ << ": " )
 #endif
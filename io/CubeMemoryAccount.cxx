@@ -0,0 +1,171 @@
+#include "CubeMemoryAccount.hxx"
+#include "CubeLog.hxx"
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <atomic>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#include <sys/resource.h>
+
+bool Cube::MemoryAccount::fEnabled = false;
+
+namespace {
+    // The live objects.  The counters are atomic in case an object is made
+    // or deleted on a worker thread.  The track fitting threads (see
+    // Cube::TrackFitBatch) don't make objects or handles, and only copy the
+    // handles that belong to the track being fit.
+    std::atomic<long> gLiveCount[Cube::MemoryAccount::kCounters];
+
+    // The live objects at the start of the current event.
+    long gEventStart[Cube::MemoryAccount::kCounters];
+
+    // The totals for the job.
+    long gLeaked[Cube::MemoryAccount::kCounters];
+    long gLeakedEvents = 0;
+    long gEvents = 0;
+    long gPeakResident = -1;
+    int gPeakRun = -1;
+    int gPeakEvent = -1;
+
+    const char* gCounterNames[Cube::MemoryAccount::kCounters] = {
+        "Hit", "ReconCluster", "ReconTrack", "HandleBase"};
+
+    // Read a field (in kB) from /proc/self/status and return it in bytes.
+    long ReadProcStatus(const std::string& field) {
+        std::ifstream status("/proc/self/status");
+        if (!status.is_open()) return -1;
+        std::string line;
+        while (std::getline(status,line)) {
+            if (line.compare(0,field.size(),field) != 0) continue;
+            std::istringstream value(line.substr(field.size()));
+            long kilobytes = -1;
+            value >> kilobytes;
+            if (kilobytes < 0) return -1;
+            return 1024*kilobytes;
+        }
+        return -1;
+    }
+
+    double Megabytes(long bytes) {return bytes/1024.0/1024.0;}
+}
+
+void Cube::MemoryAccount::Created(Counter counter) {
+    gLiveCount[counter].fetch_add(1,std::memory_order_relaxed);
+}
+
+void Cube::MemoryAccount::Destroyed(Counter counter) {
+    gLiveCount[counter].fetch_sub(1,std::memory_order_relaxed);
+}
+
+long Cube::MemoryAccount::GetLiveCount(Counter counter) {
+    return gLiveCount[counter].load(std::memory_order_relaxed);
+}
+
+const char* Cube::MemoryAccount::GetCounterName(Counter counter) {
+    return gCounterNames[counter];
+}
+
+long Cube::MemoryAccount::GetHeapBytes() {
+#if defined(__GLIBC__) \
+    && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+#elif defined(__GLIBC__)
+    // The older interface overflows above 2 GB.
+    struct mallinfo info = mallinfo();
+    return (unsigned int) info.uordblks + (unsigned int) info.hblkhd;
+#else
+    return -1;
+#endif
+}
+
+long Cube::MemoryAccount::GetResidentBytes() {
+    return ReadProcStatus("VmRSS:");
+}
+
+long Cube::MemoryAccount::GetPeakResidentBytes() {
+    long peak = ReadProcStatus("VmHWM:");
+    if (peak >= 0) return peak;
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF,&usage) != 0) return -1;
+#ifdef __APPLE__
+    return usage.ru_maxrss;
+#else
+    return 1024*usage.ru_maxrss;
+#endif
+}
+
+bool Cube::MemoryAccount::ResetPeakResident() {
+    // Writing 5 to clear_refs resets the peak resident size (Linux 4.0).
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    if (!clearRefs.is_open()) return false;
+    clearRefs << "5" << std::endl;
+    return clearRefs.good();
+}
+
+void Cube::MemoryAccount::StartEvent() {
+    for (int i = 0; i < kCounters; ++i) {
+        gEventStart[i] = GetLiveCount(Counter(i));
+    }
+    if (IsEnabled()) ResetPeakResident();
+}
+
+long Cube::MemoryAccount::FinishEvent(int run, int event) {
+    ++gEvents;
+    if (IsEnabled()) {
+        long peak = GetPeakResidentBytes();
+        if (peak > gPeakResident) {
+            gPeakResident = peak;
+            gPeakRun = run;
+            gPeakEvent = event;
+        }
+        CUBE_LOG(0) << "Memory for event " << run << "/" << event
+                    << ": peak resident " << Megabytes(peak) << " MB"
+                    << ", resident " << Megabytes(GetResidentBytes())
+                    << " MB" << std::endl;
+    }
+
+    long leaked = 0;
+    std::ostringstream report;
+    for (int i = 0; i < kCounters; ++i) {
+        long extra = GetLiveCount(Counter(i)) - gEventStart[i];
+        if (extra <= 0) continue;
+        leaked += extra;
+        gLeaked[i] += extra;
+        report << " " << extra << " " << gCounterNames[i];
+    }
+
+    if (leaked > 0) {
+        ++gLeakedEvents;
+        CUBE_ERROR << "Objects leaked by event " << run << "/" << event
+                   << ":" << report.str() << std::endl;
+    }
+
+    return leaked;
+}
+
+void Cube::MemoryAccount::Print(std::ostream& out) {
+    if (IsEnabled()) {
+        out << "Peak resident memory: " << Megabytes(gPeakResident) << " MB"
+            << " (event " << gPeakRun << "/" << gPeakEvent << ")"
+            << std::endl;
+    }
+    out << "Events with leaked objects: " << gLeakedEvents
+        << " of " << gEvents << std::endl;
+    for (int i = 0; i < kCounters; ++i) {
+        out << "   " << gCounterNames[i]
+            << " leaked: " << gLeaked[i]
+            << " live: " << GetLiveCount(Counter(i))
+            << std::endl;
+    }
+}
+
+// Local Variables:
+// mode:c++
+// c-basic-offset:4
+// compile-command:"$(git rev-parse --show-toplevel)/build/cube-build.sh force"
+// End:
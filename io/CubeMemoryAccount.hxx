@@ -0,0 +1,108 @@
+#ifndef CubeMemoryAccount_hxx_seen
+#define CubeMemoryAccount_hxx_seen
+
+#include <iostream>
+
+namespace Cube {
+    class MemoryAccount;
+}
+
+/// Keep track of the memory used by the reconstruction.  This counts the
+/// live Cube::Hit, Cube::ReconCluster, Cube::ReconTrack and
+/// Cube::HandleBase objects (the counters are updated by the constructors
+/// and destructors), and reads the heap and resident memory used by the
+/// process.
+///
+/// The memory for each event is checked by calling StartEvent() before the
+/// event is read, and FinishEvent() after the event has been cleared.  Any
+/// counted object that is still alive after the event is cleared has
+/// leaked (e.g. it is held by a static cache or a reference cycle) and is
+/// reported.  The leak check is always done.  When the accounting is
+/// enabled, the peak resident memory for each event is also kept and
+/// logged.  On Linux, the peak is reset at the start of each event (see
+/// ResetPeakResident), otherwise it's the peak for the whole job.
+///
+/// \code
+/// for (each event) {
+///    Cube::MemoryAccount::StartEvent();
+///    ... read and reconstruct the event ...
+///    event->Initialize();
+///    Cube::MemoryAccount::FinishEvent(run,event);
+/// }
+/// Cube::MemoryAccount::Print(std::cout);
+/// \endcode
+///
+/// When the accounting is enabled (see Enable()), the net change and the
+/// peak of the heap used by each algorithm call are also recorded by
+/// Cube::AlgorithmTrace and Cube::AlgorithmSummary.  Reading the heap size
+/// has to look at all of the malloc arenas, so it's off by default.
+class Cube::MemoryAccount {
+public:
+    /// The types of objects that are counted.
+    enum Counter {
+        kHit = 0,
+        kReconCluster,
+        kReconTrack,
+        kHandleBase,
+        kCounters
+    };
+
+    /// Count an object that was created.  This is thread safe.
+    static void Created(Counter counter);
+
+    /// Count an object that was destroyed.  This is thread safe.
+    static void Destroyed(Counter counter);
+
+    /// Get the number of objects that are alive.
+    static long GetLiveCount(Counter counter);
+
+    /// Get the name of the counted objects (e.g. "Hit").
+    static const char* GetCounterName(Counter counter);
+
+    /// Record the heap used by each algorithm call, and the resident memory
+    /// for each event.
+    static void Enable() {fEnabled = true;}
+
+    /// True if the heap and resident memory are being recorded.
+    static bool IsEnabled() {return fEnabled;}
+
+    /// The number of bytes of the heap that are in use, or -1 if it isn't
+    /// available.
+    static long GetHeapBytes();
+
+    /// The resident memory used by the process in bytes, or -1 if it isn't
+    /// available.
+    static long GetResidentBytes();
+
+    /// The peak resident memory used by the process in bytes since the last
+    /// call to ResetPeakResident(), or -1 if it isn't available.
+    static long GetPeakResidentBytes();
+
+    /// Reset the peak resident memory.  This returns false if the peak can't
+    /// be reset (it only works on Linux).
+    static bool ResetPeakResident();
+
+    /// Save the live object counts before an event is read (and reset the
+    /// peak resident memory when the accounting is enabled).
+    static void StartEvent();
+
+    /// Check for objects that are still alive after the event has been
+    /// cleared, and record the peak memory for the event when the
+    /// accounting is enabled.  This returns the number of objects that
+    /// leaked.
+    static long FinishEvent(int run, int event);
+
+    /// Print the memory summary for the job.
+    static void Print(std::ostream& out);
+
+private:
+    /// Set when the heap and resident memory are recorded.
+    static bool fEnabled;
+};
+#endif
+
+// Local Variables:
+// mode:c++
+// c-basic-offset:4
+// compile-command:"$(git rev-parse --show-toplevel)/build/cube-build.sh force"
+// End:
@@ -8,18 +8,21 @@
 
 #include "CubeReconCluster.hxx"
 #include "CubeReconNode.hxx"
+#include "CubeMemoryAccount.hxx"
 
 ClassImp(Cube::ReconCluster);
 
 Cube::ReconCluster::ReconCluster()
     : ReconObject("cluster","Reconstructed SFG Cluster"),
-      fMoments(3), fTemporariesInitialized(false) {
+      fMoments(3), fTemporariesInitialized(false), fSumsValid(false) {
     fState = new Cube::ClusterState;
     fNodes = new Cube::ReconNodeContainerImpl<Cube::ClusterState>;
+    Cube::MemoryAccount::Created(Cube::MemoryAccount::kReconCluster);
 }
 
 Cube::ReconCluster::ReconCluster(const Cube::ReconCluster& cluster)
-    : Cube::ReconObject(cluster), fMoments(3), fTemporariesInitialized(false) {
+    : Cube::ReconObject(cluster), fMoments(3), fTemporariesInitialized(false),
+      fSumsValid(false) {
     fNodes = new Cube::ReconNodeContainerImpl<Cube::ClusterState>;
 
     // Copy the nodes.  Create new nodes with Cube::ClusterState's
@@ -47,9 +50,12 @@ Cube::ReconCluster::ReconCluster(const Cube::ReconCluster& cluster)
     else {
         fState = new Cube::ClusterState;
     }
+    Cube::MemoryAccount::Created(Cube::MemoryAccount::kReconCluster);
 }
 
-Cube::ReconCluster::~ReconCluster() {}
+Cube::ReconCluster::~ReconCluster() {
+    Cube::MemoryAccount::Destroyed(Cube::MemoryAccount::kReconCluster);
+}
 
 double Cube::ReconCluster::GetEDeposit() const {
     // I'm being a bit pedantic and casting to the base mix-in class.  This
@@ -141,6 +147,15 @@ void Cube::ReconCluster::SetMoments(const TMatrixT<double>& moments) {
     }
 }
 
+const Cube::ClusterSums& Cube::ReconCluster::GetSums() const {
+    if (fSumsValid) return fSums;
+    fSums.Clear();
+    Cube::Handle<Cube::HitSelection> hits = GetHitSelection();
+    if (hits) fSums.AddHits(hits->begin(), hits->end());
+    fSumsValid = true;
+    return fSums;
+}
+
 void Cube::ReconCluster::UpdateFromHits() {
     fTemporariesInitialized = false;
     // Make sure there is a hit container.
@@ -148,234 +163,53 @@ void Cube::ReconCluster::UpdateFromHits() {
     if (!hits) return;
 
     // Make sure the hit container isn't empty.
-    Cube::HitSelection::const_iterator beg = hits->begin();
-    Cube::HitSelection::const_iterator end = hits->end();
-    if (end-beg < 1) return;
+    if (hits->empty()) return;
 
-    fStatus = Cube::ReconObject::kSuccess;
-    fQuality = 1.0;
-    fNDOF = std::max(1,int(end-beg-1));
-    Cube::Handle<Cube::ClusterState> state = GetState();
-
-    int dim = state->GetDimensions();
-    TVectorT<double> vals(dim);
-    TVectorT<double> sigs(dim);
-    TVectorT<double> rms(dim);
-
-    // Save the index into the state for each of the values.
-    int eDep = state->GetEDepositIndex();
-    int posX = state->GetXIndex();
-    int posY = state->GetYIndex();
-    int posZ = state->GetZIndex();
-    int posT = state->GetTIndex();
-
-    // Find the energy deposit and the average position.  The position
-    // averages are energy deposition weighted.
-    TVectorT<double> stateValues(dim);
-    TVectorT<double> stateNorms(dim);
-    for (Cube::HitSelection::const_iterator h = beg;
-         h != end;
-         ++h) {
-        vals(eDep) = (*h)->GetCharge();
-        sigs(eDep) = 1.0;
-
-        vals(posX) = (*h)->GetPosition().X();
-        sigs(posX) = (*h)->GetUncertainty().X();
-
-        vals(posY) = (*h)->GetPosition().Y();
-        sigs(posY) = (*h)->GetUncertainty().Y();
-
-        vals(posZ) = (*h)->GetPosition().Z();
-        sigs(posZ) = (*h)->GetUncertainty().Z();
-
-        vals(posT) = (*h)->GetTime();
-        sigs(posT) = (*h)->GetTimeUncertainty();
-
-        // Form the sums needed to find averages.  Note that the energy
-        // deposit is not averaged,  It's taken out of the sum.
-        stateValues(eDep) += vals(eDep);
-        stateNorms(eDep) = 1.0;
-        for (int i=0; i<dim; ++i) {
-            if (i == eDep) continue;
-#define ENERGY_WEIGHTED
-#ifdef ENERGY_WEIGHTED
-            stateValues(i) += vals(eDep)*vals(i)/(sigs(i)*sigs(i));
-            stateNorms(i) += vals(eDep)*1.0/(sigs(i)*sigs(i));
-#else
-            stateValues(i) += vals(i)/(sigs(i)*sigs(i));
-            stateNorms(i) += 1.0/(sigs(i)*sigs(i));
-#endif
-        }
-    }
-
-    // Reset the edep norm so it is handled with everything else, then form
-    // the averages.
-    stateNorms(eDep) = 1.0;
-    for (int i=0; i<dim; ++i) {
-        if (stateNorms(i) > 0) stateValues(i) /= stateNorms(i);
-    }
-
-    // Estimate the covariance of cluster state values.
-    TMatrixTSym<double> stateCov(dim);
-    // This counts the weight for each bin of the covariance.
-    TMatrixTSym<double> weights(dim);
-    TMatrixTSym<double> weights2(dim);
-    // This counts the number of degrees of freedom contributing to each bin.
-    TMatrixTSym<double> dof(dim);
-    for (Cube::HitSelection::const_iterator h = beg;
-         h != end;
-         ++h) {
-        vals(eDep) = (*h)->GetCharge() - stateValues(eDep);
-        sigs(eDep) = std::sqrt((*h)->GetCharge());
-        rms(eDep) = 0.0;
-
-        vals(posX) = (*h)->GetPosition().X() - stateValues(posX);
-        sigs(posX) = (*h)->GetUncertainty().X();
-        rms(posX) = (*h)->GetSize().X();
-
-        vals(posY) = (*h)->GetPosition().Y() - stateValues(posY);
-        sigs(posY) = (*h)->GetUncertainty().Y();
-        rms(posY) = (*h)->GetSize().Y();
-
-        vals(posZ) = (*h)->GetPosition().Z() - stateValues(posZ);
-        sigs(posZ) = (*h)->GetUncertainty().Z();
-        rms(posZ) = (*h)->GetSize().Z();
-
-        vals(posT) = (*h)->GetTime() - stateValues(posT);
-        sigs(posT) = (*h)->GetTimeUncertainty();
-        rms(posT) = (*h)->GetTimeUncertainty();
-
-        for (int row = 0; row<dim; ++row) {
-            for (int col = row; col<dim; ++col) {
-                double weight = 1.0/(sigs(row)*sigs(col));
-                stateCov(row,col) += weight*vals(row)*vals(col);
-                weights(row,col) += weight;
-                weights2(row,col) += weight*weight;
-                double degrees
-                    = 4*rms(row)*rms(col)/(12*sigs(row)*sigs(col));
-                if (row == posT && col == posT) degrees = 1.0;
-                dof(row,col) += degrees;
-            }
-        }
-    }
-
-    // Turn the "stateCov" variable into the RMS.
-    for (int row = 0; row<dim; ++row) {
-        for (int col = row; col<dim; ++col) {
-            if (weights(row,col)>0) {
-                stateCov(row,col) /= weights(row,col);
-            }
-            else stateCov(row,col) = 0.0;
-            stateCov(col,row) = stateCov(row,col);
-        }
-    }
+    // Collect the sums over the hits in one pass.
+    fSums.Clear();
+    fSums.AddHits(hits->begin(), hits->end());
+    fSumsValid = true;
 
-    // Turn the RMS into a covariance of the mean (This is almost a repeat of
-    // turning the value into an RMS.
-    for (int row = 0; row<dim; ++row) {
-        for (int col = row; col<dim; ++col) {
-            if (dof(row,col)>0.9) {
-#ifdef NEW_IMPLEMENTATION
-                double w = weights(row,col);
-                stateCov(row,col) *= w*w / (w*w - weights2(row,col));
-#else
-                stateCov(row,col) /= std::sqrt(dof(row,col));
-#endif
-            }
-            else if (row==col) stateCov(row,col) = Cube::CorrValues::kFreeValue;
-            else stateCov(row,col) = 0.0;
-            stateCov(col,row) = stateCov(row,col);
-        }
-    }
+    UpdateFromSums();
+}
 
-#ifndef NO_FINITE_SIZE_CORRECTION
-    // Add the correction for finite size of the hits.
-    TVectorT<double> hitWeights(dim);
-    for (Cube::HitSelection::const_iterator h = beg;
-         h != end;
-         ++h) {
-        sigs(eDep) = std::sqrt((*h)->GetCharge());
-        sigs(posX) = (*h)->GetUncertainty().X();
-        sigs(posY) = (*h)->GetUncertainty().Y();
-        sigs(posZ) = (*h)->GetUncertainty().Z();
-        sigs(posT) = (*h)->GetTimeUncertainty();
-
-        for (int idx = 0; idx<dim; ++idx) {
-            double weight = 1.0/(sigs(idx)*sigs(idx));
-            hitWeights(idx) += weight;
-        }
-    }
+void Cube::ReconCluster::UpdateFromSums() {
+    fTemporariesInitialized = false;
+    if (fSums.GetHitCount() < 1) return;
 
-    for (int idx = 0; idx<dim; ++idx) {
-        if (hitWeights(idx)<1E-8) continue;
-        stateCov(idx,idx) += 1.0/hitWeights(idx);
-    }
-#endif
+    fStatus = Cube::ReconObject::kSuccess;
+    fQuality = 1.0;
+    fNDOF = std::max(1,fSums.GetHitCount()-1);
+    Cube::Handle<Cube::ClusterState> state = GetState();
 
-    // Fix the variance of the deposited energy.  This assumes it's Poisson
-    // distributed.
-    stateCov(eDep,eDep) = stateValues(eDep);
+    // Save the index into the state for each of the values in the sums.
+    int index[Cube::ClusterSums::kValues];
+    index[Cube::ClusterSums::kEDeposit] = state->GetEDepositIndex();
+    index[Cube::ClusterSums::kX] = state->GetXIndex();
+    index[Cube::ClusterSums::kY] = state->GetYIndex();
+    index[Cube::ClusterSums::kZ] = state->GetZIndex();
+    index[Cube::ClusterSums::kT] = state->GetTIndex();
+
+    // Find the energy deposit, the energy deposition weighted average
+    // position, and the covariance.
+    double values[Cube::ClusterSums::kValues];
+    double cov[Cube::ClusterSums::kValues][Cube::ClusterSums::kValues];
+    fSums.GetValues(values);
+    fSums.GetCovariance(cov);
 
     // Set the state value and covariance.
-    for (int row=0; row<dim; ++row) {
-        state->SetValue(row,stateValues(row));
-        for (int col=0; col<dim; ++col) {
-            state->SetCovarianceValue(row,col,stateCov(row,col));
-            state->SetCovarianceValue(col,row,stateCov(row,col));
-        }
-    }
-
-    // Find the moments of the cluster.  This could be done as part of the
-    // covariance calculation, but is seperated so it's easier to see what is
-    // going on.
-    TMatrixTSym<double> moments(3);
-    TMatrixTSym<double> chargeSum(3);
-    TVector3 center(state->GetValue(posX),
-                    state->GetValue(posY),
-                    state->GetValue(posZ));
-
-    // Calculate the charge weighted "sum of squared differences".
-    for (Cube::HitSelection::const_iterator h = beg;
-         h != end;
-         ++h) {
-        TVector3 diff = (*h)->GetPosition() - center;
-        for (int row = 0; row<3; ++row) {
-            for (int col = row; col<3; ++col) {
-                moments(row,col) += diff(row)*diff(col)*(*h)->GetCharge();
-                // Correct for the finite size of the hit.
-                if (row==col) {
-                    double r = (*h)->GetSize()[row];
-                    moments(row,col) += r*r*(*h)->GetCharge();
-                }
-                chargeSum(row,col) += (*h)->GetCharge();
-            }
-        }
-    }
-
-    // Turn this into the average square difference (i.e. the moments)
-    for (int row = 0; row<3; ++row) {
-        for (int col = row; col<3; ++col) {
-            // No divide by zero please!
-            if (chargeSum(row,col) > 1E-6) {
-                moments(row,col) = moments(row,col)/chargeSum(row,col);
-            }
-            else if (row == col) {
-                // There were no measurements on this axis so spread the
-                // charge over the entire range of the detector
-                // (i.e. +-"10 m + epsilon")
-                moments(row,col) = 1E+9;
-            }
-            else {
-                // There were no measurements so the aren't any off-axis
-                // correlations.
-                moments(row,col) = 0;
-            }
-            // Keep it symmetric.
-            moments(col,row) = moments(row,col);
+    for (int row=0; row<Cube::ClusterSums::kValues; ++row) {
+        state->SetValue(index[row],values[row]);
+        for (int col=0; col<Cube::ClusterSums::kValues; ++col) {
+            state->SetCovarianceValue(index[row],index[col],cov[row][col]);
         }
     }
 
-    SetMoments(moments);
+    // Find the moments of the cluster.
+    double moments[3][3];
+    fSums.GetMoments(moments);
+    SetMoments(moments[0][0], moments[1][1], moments[2][2],
+               moments[0][1], moments[0][2], moments[1][2]);
 }
 
 void Cube::ReconCluster::ls(Option_t *opt) const {
@@ -7,6 +7,7 @@
 #include "CubeHandle.hxx"
 #include "CubeReconObject.hxx"
 #include "CubeClusterState.hxx"
+#include "CubeClusterSums.hxx"
 
 namespace Cube {
     class ReconCluster;
@@ -105,6 +106,31 @@ public:
         UpdateFromHits();
     }
 
+    /// Fill the Cube::ReconCluster and Cube::ClusterState objects from hits
+    /// between the begin and end iterators when the sums for the hits are
+    /// already known.  This is the same as FillFromHits without the sums,
+    /// but the hits don't need to be looked at again.  It's used when a
+    /// cluster is made by combining other clusters (the sums of the
+    /// clusters can be added).  The sums must be for the same hits.
+    template <typename T>
+    void FillFromHits(const char* name, T begin, T end,
+                      const Cube::ClusterSums& sums) {
+        // Set the algorithm name.
+        fAlgorithm = std::string(name);
+
+        // Add a copy of the hits to the cluster.
+        if (end == begin) return;
+        Cube::Handle<Cube::HitSelection> hits(
+            new Cube::HitSelection("clusterHits"));
+        std::copy(begin, end, std::back_inserter(*hits));
+        SetHitSelection(hits);
+
+        // Update the cluster fields based on the sums.
+        fSums = sums;
+        fSumsValid = true;
+        UpdateFromSums();
+    }
+
 
     /// A convenience method to fill the cluster from a Cube::HitSelection.
     /// The hits are copied into the the cluster, so this does not take owner
@@ -113,6 +139,12 @@ public:
         FillFromHits(name, hits.begin(), hits.end());
     }
 
+    /// Get the running sums over the hits in the cluster.  The sums are set
+    /// by FillFromHits, and are found from the hit selection the first time
+    /// they are needed for a cluster that was copied or read from a file.
+    /// The sums are not updated if the hit selection is changed directly.
+    const Cube::ClusterSums& GetSums() const;
+
     /// List the results of in the cluster.
     virtual void ls(Option_t* opt = "") const;
 
@@ -148,6 +180,15 @@ private:
     /// Fill all of the fields of the cluster based on the hits.
     void UpdateFromHits();
 
+    /// Fill all of the fields of the cluster based on the sums.
+    void UpdateFromSums();
+
+    /// The running sums over the hits.
+    mutable Cube::ClusterSums fSums; //! Don't Save
+
+    /// A flag that the sums match the hits.
+    mutable bool fSumsValid; //! Don't Save
+
     /// The moments for this cluster.
     MomentMatrix fMoments;
 
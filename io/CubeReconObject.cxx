@@ -6,14 +6,10 @@
 #include "CubeReconObject.hxx"
 #include "CubeReconNode.hxx"
 #include "CubeReconState.hxx"
+#include "CubeEvent.hxx"
 
 ClassImp(Cube::ReconObject);
 
-namespace {
-    // This keeps track of the previous ReconObject unique identifier.
-    static UInt_t gReconObjectId = 0;
-}
-
 Cube::ReconObject::ReconObject()
     : TNamed("unnamed","Reconstruction Object"),
       fQuality(0), fState(NULL), fNodes(NULL), fStatus(0), fNDOF(0) {
@@ -22,12 +18,12 @@ Cube::ReconObject::ReconObject()
 Cube::ReconObject::ReconObject(const char* name, const char* title)
     : TNamed(name,title),
       fQuality(0), fState(NULL), fNodes(NULL), fStatus(0), fNDOF(0) {
-    SetUniqueID(++gReconObjectId);
+    SetUniqueID(Cube::Event::NewObjectId());
 }
 
 Cube::ReconObject::ReconObject(const Cube::ReconObject& object)
     : TNamed(object), fState(NULL), fNodes(NULL) {
-    SetUniqueID(++gReconObjectId);
+    SetUniqueID(Cube::Event::NewObjectId());
 
     fQuality = object.GetQuality();
     fStatus = object.GetStatus();
@@ -18,7 +18,9 @@ namespace Cube {
 /// the shared methods required to implement the basic reconstruction object
 /// functionality.  Each ReconObject object has it's TObject::fUniqueID value
 /// set.  These values can be used to associate global reconstruction objects
-/// to sub-detector reconstruction objects.
+/// to sub-detector reconstruction objects.  The value is a stable identifier
+/// assigned in the order the objects are made in the event (see
+/// Cube::Event::NewObjectId()), so it can be used to order objects.
 class Cube::ReconObject : public TNamed {
 public:
     /// The bits defining the state of the reconstruction that created this
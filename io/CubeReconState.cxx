@@ -1,8 +1,11 @@
 #include <iostream>
 #include <iomanip>
 #include <cmath>
+#include <algorithm>
+#include <stdexcept>
 
 #include <TROOT.h>
+#include <TBuffer.h>
 
 #include "CubeLog.hxx"
 #include "CubeReconState.hxx"
@@ -11,85 +14,198 @@
 
 ClassImp(Cube::ReconState);
 
-Cube::ReconState::ReconState() { }
+Cube::ReconState::ReconState() : fDimensions(0), fFields(NULL) {
+    for (int i = 0; i < kMaxDimensions; ++i) fValue[i] = 0.0;
+    for (int i = 0; i < kCovarianceSize; ++i) fCovariance[i] = 0.0;
+}
 
 Cube::ReconState::ReconState(const ReconState& state)
-    : TObject(state), fValues(state.fValues),
-      fFieldNames(state.fFieldNames) { }
+    : TObject(state), fDimensions(state.fDimensions),
+      fFields(state.fFields) {
+    CopyValues(state);
+}
 
 Cube::ReconState::~ReconState() { }
 
 std::string Cube::ReconState::GetStateFields(void) const {
-    // Construct a type name out of the field names.  This in turn is used by
-    // the CorrValues class to construct a type hash which is used to make
-    // sure that operations are done on compatible CorrValues objects.
+    // Construct a type name out of the field names.
     std::string typeName;
-    for (std::vector<std::string>::const_iterator n = fFieldNames.begin();
-         n != fFieldNames.end();
-         ++n) {
-        typeName += *n;
+    if (!fFields) return typeName;
+    for (int i = 0; i < fDimensions; ++i) {
+        typeName += fFields[i];
         typeName += " ";
     };
     return typeName;
 }
 
+int Cube::ReconState::AddFields(int size) {
+    int index = fDimensions;
+    fDimensions += size;
+    if (kMaxDimensions < fDimensions) {
+        CUBE_ERROR << "Too many state fields: " << fDimensions
+                   << " (max is " << kMaxDimensions << ")" << std::endl;
+        throw std::runtime_error("ReconState Range Error");
+    }
+    return index;
+}
+
 // Build the internal state vector.
-void Cube::ReconState::Init() {
-    fValues.ResizeTo(fFieldNames.size());
-    fValues.SetType(GetStateFields().c_str());
+void Cube::ReconState::Init(const char* const* names, int size) {
+    if (size != fDimensions) {
+        CUBE_ERROR << "Field names don't match the state: " << size
+                   << " names for " << fDimensions << " fields"
+                   << std::endl;
+        throw std::runtime_error("ReconState Range Error");
+    }
+    fFields = names;
+    for (int i = 0; i < fDimensions; ++i) {
+        fValue[i] = 0.0;
+        for (int j = 0; j <= i; ++j) fCovariance[CovarianceIndex(i,j)] = 0.0;
+        fCovariance[CovarianceIndex(i,i)] = Cube::CorrValues::kFreeValue;
+    }
+}
+
+void Cube::ReconState::CopyValues(const Cube::ReconState& state) {
+    if (state.fDimensions != fDimensions) {
+        CUBE_ERROR << "Dimensions mismatch: "
+                   << fDimensions << " != " << state.fDimensions
+                   << std::endl;
+        throw std::runtime_error("ReconState Range Error");
+    }
+    std::copy(state.fValue, state.fValue + fDimensions, fValue);
+    int size = CovarianceIndex(fDimensions,0);
+    std::copy(state.fCovariance, state.fCovariance + size, fCovariance);
 }
 
-int Cube::ReconState::GetDimensions() const {
-    return fValues.GetDimensions();
+void Cube::ReconState::Streamer(TBuffer& b) {
+    if (b.IsReading()) {
+        UInt_t start;
+        UInt_t count;
+        Version_t version = b.ReadVersion(&start, &count);
+        if (version < 3) {
+            // Older versions are read using the streamer info for the
+            // version (and the read rule for version 1).
+            b.ReadClassBuffer(Cube::ReconState::Class(), this,
+                              version, start, count);
+            return;
+        }
+        TObject::Streamer(b);
+        UChar_t dimensions;
+        b >> dimensions;
+        if (dimensions != fDimensions) {
+            CUBE_ERROR << "Dimensions mismatch: "
+                       << fDimensions << " != " << (int) dimensions
+                       << std::endl;
+            throw std::runtime_error("ReconState Range Error");
+        }
+        b.ReadFastArray(fValue, fDimensions);
+        b.ReadFastArray(fCovariance, CovarianceIndex(fDimensions,0));
+        b.CheckByteCount(start, count, Cube::ReconState::Class());
+        return;
+    }
+    UInt_t count = b.WriteVersion(Cube::ReconState::Class(), kTRUE);
+    TObject::Streamer(b);
+    UChar_t dimensions = fDimensions;
+    b << dimensions;
+    b.WriteFastArray(fValue, fDimensions);
+    b.WriteFastArray(fCovariance, CovarianceIndex(fDimensions,0));
+    b.SetByteCount(count, kTRUE);
+}
+
+void Cube::ReconState::CheckIndex(int i) const {
+    if (i<0) {
+        CUBE_ERROR << "Negative element index: " << i << std::endl;
+        throw std::runtime_error("ReconState Range Error");
+    }
+    if (fDimensions<=i) {
+        CUBE_ERROR << "Out of bounds element index: " << i
+                   << " (dim is " << fDimensions << ")" << std::endl;
+        throw std::runtime_error("ReconState Range Error");
+    }
 }
 
 double Cube::ReconState::GetValue(int i) const {
-    return fValues.GetValue(i);
+    CheckIndex(i);
+    return fValue[i];
 }
 
 void Cube::ReconState::SetValue(int i, double val) {
-    return fValues.SetValue(i, val);
+    CheckIndex(i);
+    fValue[i] = val;
 }
 
 double Cube::ReconState::GetCovarianceValue(int i, int j) const {
-    return fValues.GetCovarianceValue(i,j);
+    CheckIndex(i);
+    CheckIndex(j);
+    return fCovariance[CovarianceIndex(i,j)];
 }
 
 void Cube::ReconState::SetCovarianceValue(int i, int j, double val) {
-    fValues.SetCovarianceValue(i,j,val);
+    CheckIndex(i);
+    CheckIndex(j);
+    fCovariance[CovarianceIndex(i,j)] = val;
 }
 
 void Cube::ReconState::SetFree(int i) {
-    fValues.SetFree(i);
+    CheckIndex(i);
+    for (int j=0; j<fDimensions; ++j) {
+        fCovariance[CovarianceIndex(i,j)] = 0.0;
+    }
+    fCovariance[CovarianceIndex(i,i)] = Cube::CorrValues::kFreeValue;
 }
 
 bool Cube::ReconState::IsFree(int i) const {
-    return fValues.IsFree(i);
-}
-
-bool Cube::ReconState::IsFree(double v) const {
-    return fValues.IsFree(v);
+    return IsFree(GetCovarianceValue(i,i));
 }
 
 void Cube::ReconState::SetFixed(int i) {
-    fValues.SetFixed(i);
+    CheckIndex(i);
+    for (int j=0; j<fDimensions; ++j) {
+        fCovariance[CovarianceIndex(i,j)] = 0.0;
+    }
+    fCovariance[CovarianceIndex(i,i)] = Cube::CorrValues::kFixedValue;
 }
 
 bool Cube::ReconState::IsFixed(int i) const {
-    return fValues.IsFixed(i);
-}
-
-bool Cube::ReconState::IsFixed(double v) const {
-    return fValues.IsFixed(v);
+    return IsFixed(GetCovarianceValue(i,i));
 }
 
 void Cube::ReconState::Validate() {
-    fValues.Validate(true);
+    // The covariance is kept as a triangle, so it is always symmetric.  Make
+    // sure the free and fixed parameters are not correlated.
+    for (int i=0; i < fDimensions; ++i) {
+        if (IsFixed(i)) SetFixed(i);
+        if (IsFree(i)) SetFree(i);
+    }
 }
 
 Cube::CorrValues Cube::ReconState::ProjectState(
     const Cube::Handle<Cube::ReconState>& state) {
-    return state->fValues;
+    Cube::CorrValues values(state->GetDimensions());
+    values.SetType(state->GetStateFields().c_str());
+    for (int i = 0; i < state->GetDimensions(); ++i) {
+        values.SetValue(i,state->GetValue(i));
+        for (int j = 0; j <= i; ++j) {
+            values.SetCovarianceValue(i,j,state->GetCovarianceValue(i,j));
+        }
+    }
+    return values;
+}
+
+void Cube::ReconState::SetCorrValues(const Cube::CorrValues& values) {
+    if (values.GetDimensions() != fDimensions) {
+        CUBE_ERROR << "Dimensions mismatch: "
+                   << fDimensions << " != " << values.GetDimensions()
+                   << std::endl;
+        throw std::runtime_error("ReconState Range Error");
+    }
+    for (int i = 0; i < fDimensions; ++i) {
+        fValue[i] = values.GetValue(i);
+        for (int j = 0; j <= i; ++j) {
+            fCovariance[CovarianceIndex(i,j)]
+                = values.GetCovarianceValue(i,j);
+        }
+    }
 }
 
 /// Print the object information.
@@ -116,7 +232,7 @@ void Cube::ReconState::ls(Option_t* opt) const {
     for (int i = 0; i<GetDimensions(); ++i) {
         if (IsFree(i)) continue;
         TROOT::IndentLevel();
-        std::cout << "  " << std::setw(6) << fFieldNames[i];
+        std::cout << "  " << std::setw(6) << fFields[i];
         std::cout << ":: "
                   << unit::AsString(GetValue(i), GetCovarianceValue(i,i));
         for (int j=0 ; j<i; ++j) {
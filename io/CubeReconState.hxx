@@ -33,8 +33,26 @@ namespace Cube {
 /// derived from, and it provides minimal operations.  The main purpose of
 /// this class is to allow polymorphic vectors of states.  However, it
 /// provides some minimal access to the contained data.
+///
+/// The values and the covariance are kept in fixed size arrays inside the
+/// state (the covariance is symmetric, so only the lower triangle is kept),
+/// and the field names are in a static table that is shared by every state
+/// of the same class.  This means that making or copying a state doesn't
+/// allocate any memory.  The state has a custom streamer that only writes
+/// the values and covariance that are used by the state, so a small state
+/// doesn't write the unused part of the arrays.  Files written before
+/// version 2 kept the values in a Cube::CorrValues object, and are read
+/// using a schema evolution rule (see cuberecon_io_LinkDef.h).  Version 2
+/// files wrote the full arrays.
 class Cube::ReconState: public TObject {
 public:
+    /// The maximum number of values in a state.  This must be at least as
+    /// large as the largest state (Cube::TrackState).
+    enum {kMaxDimensions = 12};
+
+    /// The number of elements in the lower triangle of the covariance.
+    enum {kCovarianceSize = kMaxDimensions*(kMaxDimensions+1)/2};
+
     ReconState();
     ReconState(const Cube::ReconState& state);
     virtual ~ReconState();
@@ -44,7 +62,7 @@ public:
     std::string GetStateFields() const;
 
     /// Return the number of dimensions in the state (the size of the state).
-    int GetDimensions() const;
+    int GetDimensions() const {return fDimensions;}
 
     /// Not the preferred interface, but get the value by index.  The best way
     /// to get a value is through the Get method (e.g. GetEDeposit());
@@ -65,6 +83,11 @@ public:
     static Cube::CorrValues ProjectState(
         const Cube::Handle<ReconState>& state);
 
+    /// Set the values and covariance from a Cube::CorrValues object with the
+    /// same dimensions as the state.  This is used to read files written
+    /// before the values were kept in the state.
+    void SetCorrValues(const Cube::CorrValues& values);
+
     /// Set a parameter to be free (unconstrained).
     void SetFree(int i);
 
@@ -72,7 +95,7 @@ public:
     bool IsFree(int i) const;
 
     /// Check if a variance corresponds to a free parameter.
-    bool IsFree(double v) const;
+    bool IsFree(double v) const {return Cube::CorrValues::IsFree(v);}
 
     /// Set a parameter to be fixed.
     void SetFixed(int i);
@@ -81,7 +104,7 @@ public:
     bool IsFixed(int i) const;
 
     /// Check if a variance corresponds to a fixed parameter.
-    bool IsFixed(double v) const;
+    bool IsFixed(double v) const {return Cube::CorrValues::IsFixed(v);}
 
     /// Validate the covariance.
     void Validate();
@@ -97,18 +120,43 @@ protected:
     friend class PIDState;
     friend class VertexState;
 
+    /// Add fields to the state and return the index of the first one.  This
+    /// is used by the STATE_DEFINITION macros.
+    int AddFields(int size);
+
     /// A final initialization routine that is called in the constructor of
-    /// the instantiated class.  This builds the actual state vector.
-    void Init();
+    /// the instantiated class.  This checks the number of fields against the
+    /// shared table of field names for the class, and clears the state
+    /// vector.
+    void Init(const char* const* names, int size);
+
+    /// Copy the values and covariance from a state of the same class.
+    void CopyValues(const Cube::ReconState& state);
+
+    /// Check that an index is inside the state.
+    void CheckIndex(int i) const;
+
+    /// The index of an element in the lower triangle of the covariance.
+    static int CovarianceIndex(int i, int j) {
+        if (i < j) return j*(j+1)/2 + i;
+        return i*(i+1)/2 + j;
+    }
+
+    /// The number of values in the state.  This is set by the constructor.
+    int fDimensions; //! Don't Save
 
-    /// The vector of correlated values (a vector and a covariance) that holds
-    /// the state information.
-    Cube::CorrValues fValues;
+    /// The state values.  Only the first fDimensions values are saved.
+    float fValue[kMaxDimensions];
 
-    /// A vector of parameter names.  This identifies the fields in the state.
-    std::vector<std::string> fFieldNames;
+    /// The lower triangle of the state covariance.  Only the triangle for
+    /// the first fDimensions values is saved.
+    float fCovariance[kCovarianceSize];
 
-    ClassDef(ReconState,1);
+    /// The table of parameter names shared by all of the states of one
+    /// class.  This identifies the fields in the state.
+    const char* const* fFields; //! Don't Save
+
+    ClassDef(ReconState,3);
 };
 
 /// A macro that adds the energy deposit property to a state.
@@ -140,8 +188,12 @@ protected:
 
 /// This should be included in the class constructor.
 #define ENERGY_DEPOSIT_STATE_DEFINITION                                 \
-    fEDepositIndex=fFieldNames.size();                                  \
-    fFieldNames.push_back("EDeposit")
+    fEDepositIndex=AddFields(1)
+
+/// The names of the fields.  These are listed in the table of field names
+/// for the class.
+#define ENERGY_DEPOSIT_STATE_FIELDS                                     \
+    "EDeposit"
 
 /// A macro that adds the position property to a state.  The position state is
 /// defined as a four vector (X,Y,Z,T) and the associated uncertainties.
@@ -205,11 +257,12 @@ protected:
 
 /// This should be included in the class constructor.
 #define POSITION_STATE_DEFINITION                                       \
-    fPositionIndex=fFieldNames.size();                                  \
-    fFieldNames.push_back("X");                                         \
-    fFieldNames.push_back("Y");                                         \
-    fFieldNames.push_back("Z");                                         \
-    fFieldNames.push_back("T")
+    fPositionIndex=AddFields(4)
+
+/// The names of the fields.  These are listed in the table of field names
+/// for the class.
+#define POSITION_STATE_FIELDS                                           \
+    "X", "Y", "Z", "T"
 
 /// A macro that adds the direction property to a state.  The direction state
 /// is defined as a three vector (dX,dY,dZ) and the associated uncertainties.
@@ -266,10 +319,12 @@ protected:
 
 /// This should be included in the class constructor.
 #define DIRECTION_STATE_DEFINITION                                      \
-    fDirectionIndex=fFieldNames.size();                                 \
-    fFieldNames.push_back("dX");                                        \
-    fFieldNames.push_back("dY");                                        \
-    fFieldNames.push_back("dZ")
+    fDirectionIndex=AddFields(3)
+
+/// The names of the fields.  These are listed in the table of field names
+/// for the class.
+#define DIRECTION_STATE_FIELDS                                          \
+    "dX", "dY", "dZ"
 
 /// A macro that adds the width of a TReconShower object.  The cone value
 /// depends on the type of the shower fit.  For a EM fit, the cone value will
@@ -295,9 +350,13 @@ protected:
     private: unsigned char fConeIndex
 
 /// This should be included in the class constructor.
-#define CONE_STATE_DEFINITION                                       \
-    fConeIndex=fFieldNames.size();                                  \
-    fFieldNames.push_back("Cone")
+#define CONE_STATE_DEFINITION                                           \
+    fConeIndex=AddFields(1)
+
+/// The names of the fields.  These are listed in the table of field names
+/// for the class.
+#define CONE_STATE_FIELDS                                               \
+    "Cone"
 
 /// A macro that adds the mass to a state.  The mass state also holds the
 /// associated uncertainties.
@@ -322,9 +381,13 @@ protected:
     private: unsigned char fMassIndex
 
 /// This should be included in the class constructor.
-#define MASS_STATE_DEFINITION                                       \
-    fMassIndex=fFieldNames.size();                                  \
-    fFieldNames.push_back("Mass")
+#define MASS_STATE_DEFINITION                                           \
+    fMassIndex=AddFields(1)
+
+/// The names of the fields.  These are listed in the table of field names
+/// for the class.
+#define MASS_STATE_FIELDS                                               \
+    "Mass"
 
 /// A macro that adds the curvature property to a state.  The curvature state
 /// is defined as a three vector (cX,cY,cZ) and the associated uncertainties.
@@ -381,10 +444,12 @@ protected:
 
 /// This should be included in the class constructor.
 #define CURVATURE_STATE_DEFINITION                                      \
-    fCurvatureIndex=fFieldNames.size();                                 \
-    fFieldNames.push_back("curvX");                                     \
-    fFieldNames.push_back("curvY");                                     \
-    fFieldNames.push_back("curvZ")
+    fCurvatureIndex=AddFields(3)
+
+/// The names of the fields.  These are listed in the table of field names
+/// for the class.
+#define CURVATURE_STATE_FIELDS                                          \
+    "curvX", "curvY", "curvZ"
 
 /// A macro that adds the width of a curvilinear energy deposit property to a
 /// state.  The width is the extent of an energy deposition perpendicular to
@@ -410,9 +475,13 @@ protected:
     private: unsigned char fWidthIndex
 
 /// This should be included in the class constructor.
-#define WIDTH_STATE_DEFINITION                                       \
-    fWidthIndex=fFieldNames.size();                                  \
-    fFieldNames.push_back("Width")
+#define WIDTH_STATE_DEFINITION                                          \
+    fWidthIndex=AddFields(1)
+
+/// The names of the fields.  These are listed in the table of field names
+/// for the class.
+#define WIDTH_STATE_FIELDS                                              \
+    "Width"
 
 /// A macro that adds a property for the magnitude of the momentum to a state.
 #define MOMENTUM_STATE_DECLARATION                                      \
@@ -437,8 +506,12 @@ protected:
 
 /// This should be included in the class constructor.
 #define MOMENTUM_STATE_DEFINITION                                       \
-    fMomentumIndex=fFieldNames.size();                                  \
-    fFieldNames.push_back("Momentum")
+    fMomentumIndex=AddFields(1)
+
+/// The names of the fields.  These are listed in the table of field names
+/// for the class.
+#define MOMENTUM_STATE_FIELDS                                           \
+    "Momentum"
 
 /// A macro that adds a property for the magnitude of the particle charge to a
 /// state.
@@ -463,9 +536,13 @@ protected:
     private: unsigned char fChargeIndex
 
 /// This should be included in the class constructor.
-#define CHARGE_STATE_DEFINITION                                       \
-    fChargeIndex=fFieldNames.size();                                  \
-    fFieldNames.push_back("Charge")
+#define CHARGE_STATE_DEFINITION                                         \
+    fChargeIndex=AddFields(1)
+
+/// The names of the fields.  These are listed in the table of field names
+/// for the class.
+#define CHARGE_STATE_FIELDS                                             \
+    "Charge"
 
 #endif
 
@@ -1,6 +1,7 @@
 #include "CubeReconTrack.hxx"
 #include "CubeCorrValues.hxx"
 #include "CubeReconNode.hxx"
+#include "CubeMemoryAccount.hxx"
 
 #include <TROOT.h>
 
@@ -11,6 +12,7 @@ Cube::ReconTrack::ReconTrack()
     fState = new Cube::TrackState;
     fBackState = new Cube::TrackState;
     fNodes = new Cube::ReconNodeContainerImpl<Cube::TrackState>;
+    Cube::MemoryAccount::Created(Cube::MemoryAccount::kReconTrack);
 }
 
 Cube::ReconTrack::ReconTrack(const Cube::ReconTrack& track)
@@ -51,9 +53,12 @@ Cube::ReconTrack::ReconTrack(const Cube::ReconTrack& track)
         fBackState = new Cube::TrackState;
     }
 
+    Cube::MemoryAccount::Created(Cube::MemoryAccount::kReconTrack);
 }
 
-Cube::ReconTrack::~ReconTrack() {}
+Cube::ReconTrack::~ReconTrack() {
+    Cube::MemoryAccount::Destroyed(Cube::MemoryAccount::kReconTrack);
+}
 
 double Cube::ReconTrack::GetEDeposit() const {
     Cube::Handle<Cube::TrackState> state = GetState();
@@ -2,12 +2,23 @@
 
 ClassImp(Cube::ShowerState);
 
+namespace {
+    /// The field names shared by every shower state.  These must be in the
+    /// same order as the STATE_DEFINITION macros in the constructor.
+    const char* const gFieldNames[] = {
+        ENERGY_DEPOSIT_STATE_FIELDS,
+        POSITION_STATE_FIELDS,
+        DIRECTION_STATE_FIELDS,
+        CONE_STATE_FIELDS
+    };
+}
+
 Cube::ShowerState::ShowerState() {
     ENERGY_DEPOSIT_STATE_DEFINITION;
     POSITION_STATE_DEFINITION;
     DIRECTION_STATE_DEFINITION;
     CONE_STATE_DEFINITION;
-    Init();
+    Init(gFieldNames, sizeof(gFieldNames)/sizeof(gFieldNames[0]));
 }
 
 Cube::ShowerState::~ShowerState() {}
@@ -19,17 +30,9 @@ Cube::ShowerState::ShowerState(const Cube::ShowerState& init) {
     DIRECTION_STATE_DEFINITION;
     CONE_STATE_DEFINITION;
 
-    Init();
+    Init(gFieldNames, sizeof(gFieldNames)/sizeof(gFieldNames[0]));
 
-    for (int i=0; i<GetDimensions(); ++i) {
-        SetValue(i,init.GetValue(i));
-    }
-
-    for (int i=0; i<GetDimensions(); ++i) {
-        for (int j=0; j<GetDimensions(); ++j) {
-            SetCovarianceValue(i,j,init.GetCovarianceValue(i,j));
-        }
-    }
+    CopyValues(init);
 
 }
 
@@ -37,15 +40,7 @@ Cube::ShowerState&
 Cube::ShowerState::operator=(const Cube::ShowerState& rhs) {
     if (this == &rhs) return *this;
 
-    for (int i=0; i<GetDimensions(); ++i) {
-        SetValue(i,rhs.GetValue(i));
-    }
-
-    for (int i=0; i<GetDimensions(); ++i) {
-        for (int j=0; j<GetDimensions(); ++j) {
-            SetCovarianceValue(i,j,rhs.GetCovarianceValue(i,j));
-        }
-    }
+    CopyValues(rhs);
 
     return *this;
 }
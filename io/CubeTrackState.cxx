@@ -3,7 +3,19 @@
 ///////////////////////////////////////////////////////
 ClassImp(Cube::TrackState);
 
-Cube::TrackState::TrackState() {
+namespace {
+    /// The field names shared by every track state.  These must be in the
+    /// same order as the STATE_DEFINITION macros in the constructor.
+    const char* const gFieldNames[] = {
+        ENERGY_DEPOSIT_STATE_FIELDS,
+        POSITION_STATE_FIELDS,
+        DIRECTION_STATE_FIELDS,
+        CURVATURE_STATE_FIELDS,
+        WIDTH_STATE_FIELDS
+    };
+}
+
+Cube::TrackState::TrackState() : fSampleCount(0) {
 
     ENERGY_DEPOSIT_STATE_DEFINITION;
     POSITION_STATE_DEFINITION;
@@ -11,12 +23,13 @@ Cube::TrackState::TrackState() {
     CURVATURE_STATE_DEFINITION;
     WIDTH_STATE_DEFINITION;
 
-    Init();
+    Init(gFieldNames, sizeof(gFieldNames)/sizeof(gFieldNames[0]));
 }
 
 Cube::TrackState::~TrackState() {}
 
-Cube::TrackState::TrackState(const Cube::TrackState& init) {
+Cube::TrackState::TrackState(const Cube::TrackState& init)
+    : fSampleCount(init.fSampleCount) {
 
     ENERGY_DEPOSIT_STATE_DEFINITION;
     POSITION_STATE_DEFINITION;
@@ -24,31 +37,17 @@ Cube::TrackState::TrackState(const Cube::TrackState& init) {
     CURVATURE_STATE_DEFINITION;
     WIDTH_STATE_DEFINITION;
 
-    Init();
-
-    for (int i=0; i<GetDimensions(); ++i) {
-        SetValue(i,init.GetValue(i));
-    }
+    Init(gFieldNames, sizeof(gFieldNames)/sizeof(gFieldNames[0]));
 
-    for (int i=0; i<GetDimensions(); ++i) {
-        for (int j=0; j<GetDimensions(); ++j) {
-            SetCovarianceValue(i,j,init.GetCovarianceValue(i,j));
-        }
-    }
+    CopyValues(init);
 }
 
 Cube::TrackState& Cube::TrackState::operator=(const Cube::TrackState& rhs) {
     if (this == &rhs) return *this;
 
-    for (int i=0; i<GetDimensions(); ++i) {
-        SetValue(i,rhs.GetValue(i));
-    }
+    CopyValues(rhs);
 
-    for (int i=0; i<GetDimensions(); ++i) {
-        for (int j=0; j<GetDimensions(); ++j) {
-            SetCovarianceValue(i,j,rhs.GetCovarianceValue(i,j));
-        }
-    }
+    fSampleCount = rhs.fSampleCount;
 
     return *this;
 }
@@ -24,13 +24,25 @@ public:
     CURVATURE_STATE_DECLARATION;
     WIDTH_STATE_DECLARATION;
 
+    /// Set the number of samples that were used to estimate the state.  This
+    /// is only filled by fitters that approximate the state PDF using
+    /// samples (e.g. Cube::StochTrackFit), and is zero otherwise.
+    void SetSampleCount(int n) {fSampleCount = n;}
+
+    /// Get the number of samples that were used to estimate the state.
+    int GetSampleCount() const {return fSampleCount;}
+
     ENERGY_DEPOSIT_STATE_PRIVATE;
     POSITION_STATE_PRIVATE;
     DIRECTION_STATE_PRIVATE;
     CURVATURE_STATE_PRIVATE;
     WIDTH_STATE_PRIVATE;
 
-    ClassDef(TrackState,1);
+private:
+    /// The number of samples used to estimate the state.
+    int fSampleCount;
+
+    ClassDef(TrackState,2);
 };
 #endif
 
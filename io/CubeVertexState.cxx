@@ -3,11 +3,19 @@
 ///////////////////////////////////////////////////////
 ClassImp(Cube::VertexState);
 
+namespace {
+    /// The field names shared by every vertex state.  These must be in the
+    /// same order as the STATE_DEFINITION macros in the constructor.
+    const char* const gFieldNames[] = {
+        POSITION_STATE_FIELDS
+    };
+}
+
 Cube::VertexState::VertexState() {
 
     POSITION_STATE_DEFINITION;
 
-    Init();
+    Init(gFieldNames, sizeof(gFieldNames)/sizeof(gFieldNames[0]));
 }
 
 Cube::VertexState::~VertexState() {}
@@ -16,17 +24,9 @@ Cube::VertexState::VertexState(const Cube::VertexState& init) {
 
     POSITION_STATE_DEFINITION;
 
-    Init();
+    Init(gFieldNames, sizeof(gFieldNames)/sizeof(gFieldNames[0]));
 
-    for (int i=0; i<GetDimensions(); ++i) {
-        SetValue(i,init.GetValue(i));
-    }
-
-    for (int i=0; i<GetDimensions(); ++i) {
-        for (int j=0; j<GetDimensions(); ++j) {
-            SetCovarianceValue(i,j,init.GetCovarianceValue(i,j));
-        }
-    }
+    CopyValues(init);
 
 }
 
@@ -34,15 +34,7 @@ Cube::VertexState&
 Cube::VertexState::operator=(const Cube::VertexState& rhs) {
     if (this == &rhs) return *this;
 
-    for (int i=0; i<GetDimensions(); ++i) {
-        SetValue(i,rhs.GetValue(i));
-    }
-
-    for (int i=0; i<GetDimensions(); ++i) {
-        for (int j=0; j<GetDimensions(); ++j) {
-            SetCovarianceValue(i,j,rhs.GetCovarianceValue(i,j));
-        }
-    }
+    CopyValues(rhs);
 
     return *this;
 }
@@ -45,7 +45,17 @@
 
 #pragma link C++ class Cube::CorrValues+;
 
-#pragma link C++ class Cube::ReconState+;
+// The state has a custom streamer so that only the used part of the value
+// and covariance arrays is saved.  Versions before 3 are read using the
+// streamer info.  Before version 2, the state values were saved in a
+// CorrValues object.  The field names were also saved, but are now shared
+// by the class.
+#pragma link C++ class Cube::ReconState-;
+#pragma read sourceClass="Cube::ReconState" version="[1]"       \
+    targetClass="Cube::ReconState"                               \
+    source="Cube::CorrValues fValues"                            \
+    target="fValue,fCovariance"                                  \
+    code="{newObj->SetCorrValues(onfile.fValues);}"
 #pragma link C++ class Cube::Handle<Cube::ReconState>+;
 
 #pragma link C++ class Cube::VertexState+;
@@ -1,5 +1,7 @@
 #include "CubeBuildPairwiseVertices.hxx"
 #include "CubeCompareReconObjects.hxx"
+#include "CubeSortByKey.hxx"
+#include "CubeCompareStableIds.hxx"
 
 #include <CubeHandle.hxx>
 #include <CubeReconTrack.hxx>
@@ -8,12 +10,31 @@
 #include <CubeMakeUsed.hxx>
 #include <CubeUnits.hxx>
 #include <CubeVertexFit.hxx>
+#include <CubeTrackEndIndex.hxx>
 
 #include <TVector3.h>
 #include <TMath.h>
 
-#include <list>
 #include <set>
+#include <vector>
+#include <queue>
+
+void Cube::BuildPairwiseVertices::AddMerge(
+    MergeQueue& merges, const std::vector<VertexSlot>& vertices,
+    std::size_t slot1, std::size_t slot2) {
+    if (!vertices[slot1].fVertex || !vertices[slot2].fVertex) return;
+    Cube::Handle<Cube::ReconVertex> checkVertex
+        = CombineVertices(vertices[slot1].fVertex, vertices[slot2].fVertex);
+    if (!checkVertex) return;
+    MergeCandidate merge;
+    merge.fProbability = TMath::Prob(checkVertex->GetQuality(),
+                                     checkVertex->GetNDOF());
+    merge.fSlot1 = slot1;
+    merge.fSlot2 = slot2;
+    merge.fGeneration1 = vertices[slot1].fGeneration;
+    merge.fGeneration2 = vertices[slot2].fGeneration;
+    merges.push(merge);
+}
 
 Cube::BuildPairwiseVertices::BuildPairwiseVertices(const char* name)
     : Cube::Algorithm(name,"Build vertices for tracks that connect") {
@@ -23,6 +44,9 @@ Cube::BuildPairwiseVertices::BuildPairwiseVertices(const char* name)
     fActualMaxDistance = fMaxDistance;
     fMaxApproach = 40.0*unit::mm;
     fMinTrackLength = 5.0*unit::cm;
+    fVertexFitCount = 0;
+    fPairCandidateCount = 0;
+    fUseEndpointIndex = true;
 }
 
 Cube::BuildPairwiseVertices::~BuildPairwiseVertices() {}
@@ -90,61 +114,88 @@ Cube::BuildPairwiseVertices::Process(const Cube::AlgorithmResult& input,
         fActualMaxDistance = std::max(5*unit::cm,fActualMaxDistance);
     }
 
-    // Build all of the plausible vertices.
-    std::list<Cube::Handle<Cube::ReconVertex>> allVertices;
-    for (Cube::ReconObjectContainer::iterator t1 = allTracks.begin();
-         t1 != allTracks.end(); ++t1) {
-        if (TrackLength(*t1) < fMinTrackLength) continue;
-        for (Cube::ReconObjectContainer::iterator t2 = t1 + 1;
-             t2 != allTracks.end(); ++t2) {
-            if (TrackLength(*t2) < fMinTrackLength) continue;
-            Cube::Handle<Cube::ReconVertex> vtx = MakePairVertex((*t1),(*t2));
+    fVertexFitCount = 0;
+    fPairCandidateCount = 0;
+
+    // A pair vertex is within fActualMaxDistance of an end of both tracks,
+    // and the tracks pass within fMaxApproach of each other, so the ends
+    // used for the vertex can't be further apart than the search radius.
+    // The extra cube covers rounding.
+    double searchRadius = 2.0*fActualMaxDistance + fMaxApproach
+        + 10.0*unit::mm;
+    Cube::TrackEndIndex endIndex(searchRadius);
+    if (fUseEndpointIndex) {
+        for (std::size_t i = 0; i < allTracks.size(); ++i) {
+            Cube::Handle<Cube::ReconTrack> track = allTracks[i];
+            endIndex.Insert(i, track->GetFront()->GetPosition().Vect(),
+                            track->GetBack()->GetPosition().Vect());
+        }
+    }
+
+    // Build all of the plausible vertices.  Each vertex has a slot, and the
+    // slot generation is incremented every time the vertex in the slot
+    // changes.  The pairs are checked in the same order with or without the
+    // index, so the vertices are the same.
+    std::vector<VertexSlot> allVertices;
+    std::vector<int> partners;
+    for (std::size_t i = 0; i < allTracks.size(); ++i) {
+        Cube::Handle<Cube::ReconTrack> track1 = allTracks[i];
+        if (TrackLength(track1) < fMinTrackLength) continue;
+        partners.clear();
+        if (fUseEndpointIndex) {
+            endIndex.Query(track1->GetFront()->GetPosition().Vect(),
+                           track1->GetBack()->GetPosition().Vect(),
+                           searchRadius, partners);
+        }
+        else {
+            for (std::size_t j = 0; j < allTracks.size(); ++j) {
+                partners.push_back(j);
+            }
+        }
+        for (std::vector<int>::iterator p = partners.begin();
+             p != partners.end(); ++p) {
+            if (*p <= (int) i) continue;
+            Cube::Handle<Cube::ReconTrack> track2 = allTracks[*p];
+            if (TrackLength(track2) < fMinTrackLength) continue;
+            ++fPairCandidateCount;
+            Cube::Handle<Cube::ReconVertex> vtx
+                = MakePairVertex(track1,track2);
             if (!vtx) continue;
-            allVertices.push_back(vtx);
+            allVertices.push_back(VertexSlot(vtx));
         }
     }
 
     CUBE_LOG(2) << "BuildPairwiseVertices:: Have raw vertices "
                 << allVertices.size() << std::endl;
 
-    // Combine the vertices
-    while (!allVertices.empty()) {
-        // Find the best pair;
-        std::list<Cube::Handle<Cube::ReconVertex>>::iterator vtx1
-            = allVertices.end();
-        std::list<Cube::Handle<Cube::ReconVertex>>::iterator vtx2 = vtx1;
-
-        Cube::Handle<Cube::ReconVertex> bestVertex;
-        double bestProb = 0.0;
-        for (std::list<Cube::Handle<Cube::ReconVertex>>::iterator v1
-                 = allVertices.begin();
-             v1 != allVertices.end(); ++v1) {
-            for (std::list<Cube::Handle<Cube::ReconVertex>>::iterator v2
-                     = std::next(v1);
-                 v2 != allVertices.end(); ++v2) {
-                double d = ((*v1)->GetPosition().Vect()
-                            - (*v2)->GetPosition().Vect()).Mag();
-                Cube::Handle<Cube::ReconVertex> checkVertex
-                    = CombineVertices(*v1,*v2);
-                if (!checkVertex) continue;
-                double prob = TMath::Prob(checkVertex->GetQuality(),
-                                          checkVertex->GetNDOF());
-                if (bestProb > prob) continue;
-                vtx1 = v1;
-                vtx2 = v2;
-                bestVertex = checkVertex;
-                bestProb = prob;
-            }
-        }
-        // Nothing was found (belt and suspenders)
-        if (vtx1 == vtx2) break;
-        if (vtx1 == allVertices.end()) break;
-        if (vtx2 == allVertices.end()) break;
-        if (!bestVertex) break;
-        if (bestProb < fLikelihoodCut) {
-            break;
+    // Find all of the possible merges.  The queue is ordered by the
+    // probability of the merged vertex.
+    MergeQueue merges;
+    for (std::size_t v1 = 0; v1 < allVertices.size(); ++v1) {
+        for (std::size_t v2 = v1 + 1; v2 < allVertices.size(); ++v2) {
+            AddMerge(merges, allVertices, v1, v2);
         }
+    }
 
+    // Combine the vertices.  When two vertices are combined, the merged
+    // vertex replaces the first vertex (with a new generation), the second
+    // vertex is removed, and only the merges with the new vertex are fit.
+    // Merges that refer to an old generation are skipped when they reach
+    // the top of the queue.
+    while (!merges.empty()) {
+        MergeCandidate best = merges.top();
+        merges.pop();
+        VertexSlot& slot1 = allVertices[best.fSlot1];
+        VertexSlot& slot2 = allVertices[best.fSlot2];
+        if (!slot1.fVertex || slot1.fGeneration != best.fGeneration1) continue;
+        if (!slot2.fVertex || slot2.fGeneration != best.fGeneration2) continue;
+        if (best.fProbability < fLikelihoodCut) break;
+
+        // Refit the merge.  The fit is deterministic, so this is the same
+        // vertex that was fit when the merge was queued.
+        Cube::Handle<Cube::ReconVertex> bestVertex
+            = CombineVertices(slot1.fVertex, slot2.fVertex);
+        if (!bestVertex) continue;
         double variance = bestVertex->GetPositionVariance().X();
         variance = std::max(bestVertex->GetPositionVariance().Y(),variance);
         variance = std::max(bestVertex->GetPositionVariance().Z(),variance);
@@ -152,24 +203,35 @@ Cube::BuildPairwiseVertices::Process(const Cube::AlgorithmResult& input,
                     << " T: " << bestVertex->GetConstituents()->size()
                     << " C: " << bestVertex->GetQuality()
                     << "/" << bestVertex->GetNDOF()
-                    << " P: " << bestProb
+                    << " P: " << best.fProbability
                     << " S: " << std::sqrt(variance)
                     << std::endl;
 
-        // Combine them and put it back onto the list.
-        allVertices.erase(vtx1);
-        allVertices.erase(vtx2);
-        allVertices.push_front(bestVertex);
+        // Combine them and put the merged vertex into the first slot.
+        slot1.fVertex = bestVertex;
+        ++slot1.fGeneration;
+        slot2.fVertex = Cube::Handle<Cube::ReconVertex>();
+        ++slot2.fGeneration;
+        for (std::size_t v = 0; v < allVertices.size(); ++v) {
+            if (v == best.fSlot1) continue;
+            AddMerge(merges, allVertices, best.fSlot1, v);
+        }
+    }
+
+    for (std::vector<VertexSlot>::iterator v = allVertices.begin();
+         v != allVertices.end(); ++v) {
+        if (!v->fVertex) continue;
+        finalObjects->push_back(v->fVertex);
     }
 
-    std::copy(allVertices.begin(), allVertices.end(),
-              std::back_inserter(*finalObjects));
+    CUBE_LOG(2) << "BuildPairwiseVertices:: Vertex fits "
+                << fVertexFitCount << std::endl;
 
     CUBE_LOG(1) << "BuildPairwiseVertices:: Total vertices saved "
                 << finalObjects->size() << std::endl;
 
-    std::sort(finalObjects->begin(), finalObjects->end(),
-              Cube::CompareReconObjects());
+    Cube::SortByKey(finalObjects->begin(), finalObjects->end(),
+                    Cube::ReconObjectSortKey());
 
     result->AddObjectContainer(finalObjects);
 
@@ -270,7 +332,11 @@ Cube::BuildPairwiseVertices::CombineVertices(
     vtx->GetState()->SetPosition(pos.X(),pos.Y(),pos.Z(),t);
 
     Cube::Handle<Cube::ReconObjectContainer> constituents;
-    std::set<Cube::Handle<Cube::ReconTrack>> tracks;
+    // The tracks are ordered by the stable object identifier so the order
+    // of the vertex constituents doesn't depend on where they are in memory.
+    typedef std::set<Cube::Handle<Cube::ReconTrack>,
+                     Cube::CompareStableIds> TrackSet;
+    TrackSet tracks;
 
     constituents = vertex1->GetConstituents();
     if (constituents) {
@@ -290,10 +356,9 @@ Cube::BuildPairwiseVertices::CombineVertices(
 
     // Check that all the track pairs stay within the maximum allowed
     // approach.
-    for (std::set<Cube::Handle<Cube::ReconTrack>>::iterator t1 = tracks.begin();
+    for (TrackSet::iterator t1 = tracks.begin();
          t1 != tracks.end(); ++t1) {
-        for (std::set<Cube::Handle<Cube::ReconTrack>>::iterator t2
-                 = std::next(t1);
+        for (TrackSet::iterator t2 = std::next(t1);
              t2 != tracks.end(); ++t2) {
             if (*t1 == *t2) continue;
             double b = ClosestApproach(*t1,*t2);
@@ -309,7 +374,7 @@ Cube::BuildPairwiseVertices::CombineVertices(
     vertexHits->erase(h,vertexHits->end());
     vtx->SetHitSelection(vertexHits);
     double dof = 0;
-    for (std::set<Cube::Handle<Cube::ReconTrack>>::iterator t = tracks.begin();
+    for (TrackSet::iterator t = tracks.begin();
          t != tracks.end(); ++t) {
         if (!(*t)) {
             CUBE_ERROR << "Illegal object in vertex:: Must be a track"
@@ -333,6 +398,7 @@ Cube::BuildPairwiseVertices::CombineVertices(
     if (dof < 1) return Cube::Handle<Cube::ReconVertex>();
 
     Cube::VertexFit vtxFit;
+    ++fVertexFitCount;
     vtx = vtxFit(vtx);
 
     if (!vtx) return Cube::Handle<Cube::ReconVertex>();
@@ -524,6 +590,7 @@ Cube::BuildPairwiseVertices::MakePairVertex(
     vtx->SetHitSelection(vertexHits);
 
     Cube::VertexFit vtxFit;
+    ++fVertexFitCount;
     vtx = vtxFit(vtx);
 
     if (!vtx) return Cube::Handle<Cube::ReconVertex>();
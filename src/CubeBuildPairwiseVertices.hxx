@@ -9,6 +9,9 @@
 
 #include <TVector3.h>
 
+#include <vector>
+#include <queue>
+
 namespace Cube {
     class BuildPairwiseVertices;
 };
@@ -64,8 +67,68 @@ public:
     /// one track in the vertex must be longer than this.
     void SetRequiredTrackLength(double v) {fRequiredTrackLength = v;}
 
+    /// Get the number of vertex fits done by the last call to Process.
+    /// This is mostly for benchmarking.
+    int GetVertexFitCount() const {return fVertexFitCount;}
+
+    /// Set if the track pairs should be found using a spatial index of the
+    /// track ends (the default is true).  When this is false, every pair of
+    /// tracks is considered.  The vertices are the same either way.
+    void SetUseEndpointIndex(bool v) {fUseEndpointIndex = v;}
+
+    /// Get the number of track pairs that were checked for a vertex by the
+    /// last call to Process.  This is mostly for benchmarking.
+    int GetPairCandidateCount() const {return fPairCandidateCount;}
+
 private:
 
+    // A vertex being built.  The generation is incremented each time the
+    // vertex changes (or is removed) so that old merge candidates can be
+    // recognized.
+    struct VertexSlot {
+        explicit VertexSlot(Cube::Handle<Cube::ReconVertex> v)
+            : fVertex(v), fGeneration(0) {}
+        Cube::Handle<Cube::ReconVertex> fVertex;
+        int fGeneration;
+    };
+
+    // A possible merge of the vertices in two slots.  The merge is only
+    // valid while both slots have the same generation as when the merge was
+    // fit.  The merged vertex isn't kept (there can be a candidate for every
+    // pair of vertices), so the best merge is refit when it's used.
+    struct MergeCandidate {
+        double fProbability;
+        std::size_t fSlot1;
+        std::size_t fSlot2;
+        int fGeneration1;
+        int fGeneration2;
+
+        // Order by probability (the queue top is the most probable).  Ties
+        // are broken by the slots so the order is reproducible.
+        bool operator < (const MergeCandidate& rhs) const {
+            if (fProbability != rhs.fProbability) {
+                return fProbability < rhs.fProbability;
+            }
+            if (fSlot1 != rhs.fSlot1) return fSlot1 > rhs.fSlot1;
+            return fSlot2 > rhs.fSlot2;
+        }
+    };
+    typedef std::priority_queue<MergeCandidate> MergeQueue;
+
+    // Fit the merge of the vertices in two slots, and add it to the queue
+    // if the merge is allowed.
+    void AddMerge(MergeQueue& merges, const std::vector<VertexSlot>& vertices,
+                  std::size_t slot1, std::size_t slot2);
+
+    // The number of vertex fits done by the last call to Process.
+    int fVertexFitCount;
+
+    // The number of track pairs checked by the last call to Process.
+    int fPairCandidateCount;
+
+    // A flag that the track pairs should be found with a Cube::TrackEndIndex.
+    bool fUseEndpointIndex;
+
     // Stop combining vertices when the likelihood goes below this.  This is a
     // number between 0.0 and 1.0.  The likelihood is calculated with
     // TMath::Prob.
@@ -1,5 +1,7 @@
 #include "CubeClusterManagement.hxx"
 
+#include <cmath>
+
 /// Check if two clusters meet the SFG definition of neighbors.
 bool Cube::AreNeighbors(const Cube::ReconCluster& A,
                         const Cube::ReconCluster& B) {
@@ -17,3 +19,25 @@ bool Cube::AreNeighbors(const Cube::ReconCluster& A,
     if ((*(e1-1)) == (*(e2-1))) return true;
     return false;
 }
+
+/// Fix the position variance of a new cluster.
+void Cube::SetClusterVariance(Cube::ReconCluster& cluster) {
+    const Cube::ClusterSums& sums = cluster.GetSums();
+    if (sums.GetHitCount() < 1) return;
+    // Make an estimate of the effective number of hits in the cluster.
+    // Large charge hits count more than small charge hits.  The average of
+    // the fourth power of the charge gives an approximation of the relative
+    // variance on the moments for each hit.  The effective number of hits in
+    // the moment is calculated using this.
+    double avg = sums.GetChargeFourthSum()/sums.GetHitCount();
+    avg = std::pow(avg,1.0/4.0);
+    double hits = sums.GetCharge()/avg;
+    // Fix the uncertainty of the cluster so that it's right for a single hit,
+    // and reasonable for clusters including crosstalk.
+    double xx = cluster.GetMoments()(0,0)/hits;
+    double yy = cluster.GetMoments()(1,1)/hits;
+    double zz = cluster.GetMoments()(2,2)/hits;
+    double tt = cluster.GetPositionVariance().T();
+    Cube::Handle<Cube::ClusterState> state = cluster.GetState();
+    state->SetPositionVariance(xx,yy,zz,tt);
+}
@@ -56,6 +56,20 @@ namespace Cube {
     template<typename iterator>
     Cube::Handle<Cube::ReconCluster>
     CreateCluster(const char* name, iterator begin, iterator end);
+
+    /// Create a cluster from a set of hits when the sums over the hits are
+    /// already known (see Cube::ReconCluster::GetSums).  This is used when
+    /// clusters are combined since the sums for the new cluster can be found
+    /// from the sums for the old clusters without looking at the hits.
+    template<typename iterator>
+    Cube::Handle<Cube::ReconCluster>
+    CreateCluster(const char* name, iterator begin, iterator end,
+                  const Cube::ClusterSums& sums);
+
+    /// Fix the position variance of a cluster that was filled from hits so
+    /// that it's right for a single hit, and reasonable for clusters
+    /// including crosstalk.  This is used by CreateCluster.
+    void SetClusterVariance(Cube::ReconCluster& cluster);
 }
 
 template<typename iterator, typename container>
@@ -130,30 +144,20 @@ Cube::CreateCluster(const char* name, iterator begin, iterator end) {
     if (begin == end) return Cube::Handle<Cube::ReconCluster> ();
     Cube::Handle<Cube::ReconCluster> cluster(new Cube::ReconCluster);
     cluster->FillFromHits(name,begin,end);
-    // Make an estimate of the effective number of hits in the cluster.
-    // Large charge hits count more than small charge hits.
-    double hits = 0.0;
-    double avg = 0.0;
-    // The scale, with a value of 4, gives an approximation of the relative
-    // variance on the moments for each hit.  The effective number of hits in
-    // the moment is calculated using this.
-    double scale = 4.0;
-    for (Cube::HitSelection::iterator h = cluster->GetHitSelection()->begin();
-         h != cluster->GetHitSelection()->end(); ++h) {
-        hits += (*h)->GetCharge();
-        avg += std::pow((*h)->GetCharge(),scale);
-    }
-    avg /= cluster->GetHitSelection()->size();
-    avg = std::pow(avg,1.0/scale);
-    hits /= avg;
-    // Fix the uncertainty of the cluster so that it's right for a single hit,
-    // and reasonable for clusters including crosstalk.
-    double xx = cluster->GetMoments()(0,0)/hits;
-    double yy = cluster->GetMoments()(1,1)/hits;
-    double zz = cluster->GetMoments()(2,2)/hits;
-    double tt = cluster->GetPositionVariance().T();
-    Cube::Handle<Cube::ClusterState> state = cluster->GetState();
-    state->SetPositionVariance(xx,yy,zz,tt);
+    Cube::SetClusterVariance(*cluster);
+    return cluster;
+}
+
+/// Take some hits and the sums over the hits, and create a cluster.  This is
+/// the same as CreateCluster without the sums.
+template<typename iterator>
+Cube::Handle<Cube::ReconCluster>
+Cube::CreateCluster(const char* name, iterator begin, iterator end,
+                    const Cube::ClusterSums& sums) {
+    if (begin == end) return Cube::Handle<Cube::ReconCluster> ();
+    Cube::Handle<Cube::ReconCluster> cluster(new Cube::ReconCluster);
+    cluster->FillFromHits(name,begin,end,sums);
+    Cube::SetClusterVariance(*cluster);
     return cluster;
 }
 #endif
@@ -9,51 +9,108 @@
 
 namespace Cube {
 
-    /// This is a predicate to order recon objects.  This puts the vertices,
+    /// The sort key for a recon object (see ReconObjectSortKey).  The keys
+    /// are compared in the order of the fields, and smaller keys come first.
+    struct ReconObjectKey {
+        /// The object type: 0 for vertices, 1 for tracks, 2 for clusters,
+        /// and 3 for anything else.
+        int fType;
+
+        /// Zero if a vertex has constituents, otherwise one.
+        int fEmpty;
+
+        /// The negative of the size (constituents for vertices, nodes for
+        /// tracks, and hits for clusters) so larger objects come first.
+        int fSize;
+
+        /// The negative of the number of vertex hits.
+        int fHits;
+
+        /// The stable object identifier to order objects that are
+        /// otherwise equal.
+        UInt_t fId;
+
+        /// The object pointer to order objects with the same identifier
+        /// (e.g. objects read from old files).
+        const Cube::ReconObject* fPointer;
+
+        bool operator < (const ReconObjectKey& rhs) const {
+            if (fType != rhs.fType) return fType < rhs.fType;
+            if (fEmpty != rhs.fEmpty) return fEmpty < rhs.fEmpty;
+            if (fSize != rhs.fSize) return fSize < rhs.fSize;
+            if (fHits != rhs.fHits) return fHits < rhs.fHits;
+            if (fId != rhs.fId) return fId < rhs.fId;
+            return fPointer < rhs.fPointer;
+        }
+    };
+
+    /// Extract the sort key for a recon object.  This puts the vertices,
     /// followed by tracks and clusters.  Within any type the objects are
     /// ordered by decreasing size (i.e. largest first).  If everything about
-    /// two objects is equal, they are ordered by the value of the pointers.
-    struct CompareReconObjects {
-        bool operator () (Cube::Handle<Cube::ReconObject> lhs,
-                          Cube::Handle<Cube::ReconObject> rhs) {
-            Cube::Handle<Cube::ReconVertex> lv = lhs;
-            Cube::Handle<Cube::ReconVertex> rv = rhs;
-            Cube::Handle<Cube::ReconTrack> lt = lhs;
-            Cube::Handle<Cube::ReconTrack> rt = rhs;
-            Cube::Handle<Cube::ReconCluster> lc = lhs;
-            Cube::Handle<Cube::ReconCluster> rc = rhs;
-
-            if (lv && rv) {
-                if (lv->GetConstituents()&&!rv->GetConstituents()) return true;
-                if (!lv->GetConstituents()&&rv->GetConstituents()) return false;
-                if (lv->GetConstituents() && rv->GetConstituents()) {
-                    if (lv->GetConstituents()->size()
-                        != rv->GetConstituents()->size()) {
-                        return (lv->GetConstituents()->size()
-                                > rv->GetConstituents()->size());
-                    }
-                    int s1 = -1;
-                    if (lv->GetHitSelection()) s1=lv->GetHitSelection()->size();
-                    int s2 = -1;
-                    if (rv->GetHitSelection()) s2=rv->GetHitSelection()->size();
-                    return (s1 > s2);
+    /// two objects is equal, they are ordered by the stable identifier (see
+    /// Cube::Event::NewObjectId()), so the order doesn't depend on where the
+    /// objects are in memory.
+    /// The key is meant to be used with Cube::SortByKey so the handles are
+    /// only cast once for each object.
+    ///
+    /// \code
+    /// Cube::SortByKey(objects->begin(), objects->end(),
+    ///                 Cube::ReconObjectSortKey());
+    /// \endcode
+    struct ReconObjectSortKey {
+        ReconObjectKey operator () (
+            const Cube::Handle<Cube::ReconObject>& object) const {
+            ReconObjectKey key;
+            key.fType = 3;
+            key.fEmpty = 0;
+            key.fSize = 0;
+            key.fHits = 0;
+            key.fPointer = Cube::GetPointer(object);
+            key.fId = key.fPointer ? key.fPointer->GetUniqueID() : 0;
+
+            Cube::Handle<Cube::ReconVertex> v = object;
+            if (v) {
+                key.fType = 0;
+                if (!v->GetConstituents()) {
+                    key.fEmpty = 1;
+                    return key;
+                }
+                key.fSize = - (int) v->GetConstituents()->size();
+                key.fHits = 1;
+                if (v->GetHitSelection()) {
+                    key.fHits = - (int) v->GetHitSelection()->size();
                 }
+                return key;
             }
-            if (lv && !rv) return true;
-            if (!lv && rv) return false;
 
-            if (lt && rt) return lt->GetNodes().size() > rt->GetNodes().size();
-            if (lt && !rt) return true;
-            if (!lt && rt) return false;
+            Cube::Handle<Cube::ReconTrack> t = object;
+            if (t) {
+                key.fType = 1;
+                key.fSize = - (int) t->GetNodes().size();
+                return key;
+            }
 
-            if (lc && rc) {
-                return (lc->GetHitSelection()->size()
-                        > rc->GetHitSelection()->size());
+            Cube::Handle<Cube::ReconCluster> c = object;
+            if (c) {
+                key.fType = 2;
+                if (c->GetHitSelection()) {
+                    key.fSize = - (int) c->GetHitSelection()->size();
+                }
+                return key;
             }
-            if (lc && !rc) return true;
-            if (!lc && rc) return false;
 
-            return Cube::GetPointer(lhs) < Cube::GetPointer(rhs);
+            return key;
+        }
+    };
+
+    /// This is a predicate to order recon objects using ReconObjectSortKey.
+    /// When sorting a whole container, prefer Cube::SortByKey with a
+    /// ReconObjectSortKey since this finds both keys for every comparison.
+    struct CompareReconObjects {
+        bool operator () (Cube::Handle<Cube::ReconObject> lhs,
+                          Cube::Handle<Cube::ReconObject> rhs) {
+            ReconObjectSortKey key;
+            return key(lhs) < key(rhs);
         }
     };
 };
@@ -0,0 +1,59 @@
+#ifndef CubeCompareStableIds_hxx_seen
+#define CubeCompareStableIds_hxx_seen
+
+#include <CubeHandle.hxx>
+
+namespace Cube {
+
+    /// Get the stable identifier of the object referenced by a handle.  The
+    /// identifier is saved in TObject::fUniqueID, and is assigned in the
+    /// order that hits and reconstruction objects are made in an event (see
+    /// Cube::Event::NewHitId() and Cube::Event::NewObjectId()).  An empty
+    /// handle has an identifier of zero.
+    template <typename T>
+    UInt_t GetStableId(const Cube::Handle<T>& handle) {
+        const T* object = Cube::GetPointer(handle);
+        if (!object) return 0;
+        return object->GetUniqueID();
+    }
+
+    /// This is a predicate to order handles by the stable identifier of the
+    /// object, so that sets and maps of handles have the same order every
+    /// time an event is processed.  Ordering by the handle (i.e. the
+    /// pointer) depends on where the objects are allocated.  Objects with
+    /// the same identifier (e.g. hits read from a file written before the
+    /// hits had identifiers) are ordered by the pointer.
+    ///
+    /// \code
+    /// std::set<Cube::Handle<Cube::Hit>, Cube::CompareStableIds> hits;
+    /// \endcode
+    struct CompareStableIds {
+        template <typename T>
+        bool operator () (const Cube::Handle<T>& lhs,
+                          const Cube::Handle<T>& rhs) const {
+            UInt_t l = GetStableId(lhs);
+            UInt_t r = GetStableId(rhs);
+            if (l != r) return l < r;
+            return lhs < rhs;
+        }
+    };
+
+    /// Extract the stable identifier as a key for Cube::SortByKey.
+    ///
+    /// \code
+    /// Cube::SortByKey(hits->begin(), hits->end(), Cube::StableIdKey());
+    /// \endcode
+    struct StableIdKey {
+        template <typename T>
+        UInt_t operator () (const Cube::Handle<T>& handle) const {
+            return GetStableId(handle);
+        }
+    };
+};
+#endif
+
+// Local Variables:
+// mode:c++
+// c-basic-offset:4
+// compile-command:"$(git rev-parse --show-toplevel)/build/cube-build.sh force"
+// End:
@@ -8,17 +8,37 @@
 #include <CubeHandle.hxx>
 #include <CubeUnits.hxx>
 
+#include <TLorentzVector.h>
+#include <TVector3.h>
+
+#include <vector>
+#include <unordered_set>
+#include <cmath>
+
 namespace Cube {
     /// Take iterators from a container holding TReconCluster objects in
     /// the right order for the track nodes, and construct a track.  The
     /// first argument becomes the name of the algorithm that created the
     /// track.  The track will be "fitted" by interpolating along the
     /// clusters.  The resulting track should be refit.
+    ///
+    /// The node states are local averages over the nearby clusters, and the
+    /// weights fall off with distance.  The average for a node starts at the
+    /// node and works outward along the track in both directions, and stops
+    /// at the first cluster that is further along the track than the window
+    /// (the clusters next to the node are always used).  The window is
+    /// applied to the path length along the clusters, not the distance
+    /// between the clusters, so the clusters on a track that curls back
+    /// toward the node are used until the path is longer than the window.
+    /// The default window is ten times the direction averaging scale, which
+    /// covers all but a few 1E-4 of the direction weight.  A very large
+    /// window uses every cluster.
     template<typename clusterIterator>
     Cube::Handle<Cube::ReconTrack>
     CreateTrackFromClusters(const char* name,
                             clusterIterator begin, clusterIterator end,
-                            bool verify=true);
+                            bool verify=true,
+                            double window=600.0*unit::mm);
 
     /// Take iterators from a container holding THandle<THit> objects, and
     /// create a track.  The hits must be in the order that they should
@@ -54,15 +74,13 @@ template<typename clusterIterator>
 Cube::Handle<Cube::ReconTrack>
 Cube::CreateTrackFromClusters(const char* name,
                                  clusterIterator begin, clusterIterator end,
-                                 bool verify) {
+                                 bool verify, double window) {
     if (verify) {
+        std::unordered_set<const void*> seen;
         for (clusterIterator i = begin; i!=end; ++i) {
-            clusterIterator j = i;
-            while ((++j) != end) {
-                if (Cube::GetPointer(*i) != Cube::GetPointer(*j)) continue;
-                CUBE_ERROR << "Invalid track: multiple copies of object"
-                           << std::endl;
-            }
+            if (seen.insert(Cube::GetPointer(*i)).second) continue;
+            CUBE_ERROR << "Invalid track: multiple copies of object"
+                       << std::endl;
         }
     }
 
@@ -86,6 +104,10 @@ Cube::CreateTrackFromClusters(const char* name,
 
     Cube::ReconNodeContainer& nodes = track->GetNodes();
     double totalCharge = 0.0;
+    // Copy the cluster positions and deposits so the averages don't need to
+    // go through the handles.
+    std::vector<TLorentzVector> positions;
+    std::vector<double> deposits;
     while (begin != end) {
         Cube::Handle<Cube::ReconCluster> cluster = *begin;
         if (!cluster) {
@@ -98,6 +120,8 @@ Cube::CreateTrackFromClusters(const char* name,
         node->SetState(state);
         node->SetObject(object);
         nodes.push_back(node);
+        positions.push_back(cluster->GetPosition());
+        deposits.push_back(cluster->GetEDeposit());
         totalCharge += cluster->GetEDeposit();
         ++begin;
     }
@@ -108,48 +132,52 @@ Cube::CreateTrackFromClusters(const char* name,
         return Cube::Handle<Cube::ReconTrack>();
     }
 
+    // The path length along the track to each cluster.  This is used to
+    // limit the averages since, unlike the distance between clusters, it
+    // can only increase along the track.
+    std::vector<double> travel(positions.size());
+    travel[0] = 0.0;
+    for (std::size_t i = 1; i < positions.size(); ++i) {
+        travel[i] = travel[i-1]
+            + (positions[i].Vect() - positions[i-1].Vect()).Mag();
+    }
+
     const double dirScale = 60.0*unit::mm;
     const double posScale = 30.0*unit::mm;
     const double chargeScale = 15.0*unit::mm;
 
     // Average the positions and directions along the track.
-    for (Cube::ReconNodeContainer::iterator node = nodes.begin();
-         node != nodes.end(); ++node) {
-        Cube::Handle<Cube::TrackState> state = (*node)->GetState();
-        Cube::Handle<Cube::ReconCluster> nodeObject = (*node)->GetObject();
+    const int nodeCount = nodes.size();
+    for (int node = 0; node < nodeCount; ++node) {
+        Cube::Handle<Cube::TrackState> state = nodes[node]->GetState();
+        const TVector3 nodePos = positions[node].Vect();
         TVector3 dir(0,0,0);
         TVector3 curve(0,0,0);
         /////////////////////////////////////////////////
         // Find the local average direction and curvature
         /////////////////////////////////////////////////
         double weight = 0.0;
-        Cube::ReconNodeContainer::iterator other = nodes.begin();
-        while (other != node) {
+        for (int other = node-1; other >= 0; --other) {
             // Nodes before the current node.
-            Cube::Handle<Cube::ReconCluster> otherObject
-                = (*other)->GetObject();
-            TVector3 diff = nodeObject->GetPosition().Vect()
-                - otherObject->GetPosition().Vect();
+            TVector3 diff = nodePos - positions[other].Vect();
             double dist = diff.Mag();
+            if (travel[node]-travel[other] > window
+                && other < node-1) break;
             double w = dist/dirScale; w = w*std::exp(-w);
             dir += w*diff.Unit();
             curve += (w/dist)*diff.Unit();
             weight += w;
-            ++other;
         }
-        other = node+1;
-        while (other != nodes.end()) {
+        for (int other = node+1; other < nodeCount; ++other) {
             // Nodes after the current node.
-            Cube::Handle<Cube::ReconCluster> otherObject
-                = (*other)->GetObject();
-            TVector3 diff = otherObject->GetPosition().Vect()
-                - nodeObject->GetPosition().Vect();
+            TVector3 diff = positions[other].Vect() - nodePos;
             double dist = diff.Mag();
+            if (travel[other]-travel[node] > window
+                && other > node+1) break;
             double w = dist/dirScale; w = w*std::exp(-w);
             dir += w*diff.Unit();
             curve -= (w/dist)*diff.Unit();
             weight += w;
-            ++other;
         }
         dir = dir.Unit();
         curve = (1.0/weight)*curve;
@@ -159,55 +187,49 @@ Cube::CreateTrackFromClusters(const char* name,
         // curvature.
         /////////////////////////////////////////////////////////////////
         const double objWeight = 0.1;
-        TVector3 pos = nodeObject->GetPosition().Vect();
+        TVector3 pos = nodePos;
         TVector3 posVar(objWeight*pos.X()*pos.X(),
                         objWeight*pos.Y()*pos.Y(),
                         objWeight*pos.Z()*pos.Z());
         pos = objWeight*pos;
-        double timeState = objWeight*nodeObject->GetPosition().T();
+        double timeState = objWeight*positions[node].T();
         double timeVar = 0.0;
         weight = objWeight;
-        other = nodes.begin();
-        while (other != node) {
+        for (int other = node-1; other >= 0; --other) {
             // Nodes before the current node.
-            Cube::Handle<Cube::ReconCluster> otherObject
-                = (*other)->GetObject();
-            TVector3 diff = otherObject->GetPosition().Vect()
-                - nodeObject->GetPosition().Vect();
+            TVector3 diff = positions[other].Vect() - nodePos;
             double dist = diff.Mag();
+            if (travel[node]-travel[other] > window
+                && other < node-1) break;
             double w = dist/posScale; w = w*std::exp(-w*w);
-            TVector3 temp = otherObject->GetPosition().Vect();
+            TVector3 temp = positions[other].Vect();
             temp += dist*dir;
             pos += w*temp;
             posVar.SetX(w*temp.X()*temp.X() + posVar.X());
             posVar.SetY(w*temp.Y()*temp.Y() + posVar.Y());
             posVar.SetZ(w*temp.X()*temp.Z() + posVar.Z());
-            double t = (otherObject->GetPosition().T());
+            double t = positions[other].T();
             timeState += w*t;
             timeVar += w*t*t;
             weight += w;
-            ++other;
         }
-        other = node+1;
-        while (other != nodes.end()) {
+        for (int other = node+1; other < nodeCount; ++other) {
             // Nodes after the current node.
-            Cube::Handle<Cube::ReconCluster> otherObject
-                = (*other)->GetObject();
-            TVector3 diff = otherObject->GetPosition().Vect()
-                - nodeObject->GetPosition().Vect();
+            TVector3 diff = positions[other].Vect() - nodePos;
             double dist = diff.Mag();
+            if (travel[other]-travel[node] > window
+                && other > node+1) break;
             double w = dist/posScale; w = w*std::exp(-w*w);
-            TVector3 temp = otherObject->GetPosition().Vect();
+            TVector3 temp = positions[other].Vect();
             temp -= dist*dir;
             pos += w*temp;
             posVar.SetX(w*temp.X()*temp.X() + posVar.X());
             posVar.SetY(w*temp.Y()*temp.Y() + posVar.Y());
             posVar.SetZ(w*temp.X()*temp.Z() + posVar.Z());
-            double t = (otherObject->GetPosition().T());
+            double t = positions[other].T();
             timeState += w*t;
             timeVar += w*t*t;
             weight += w;
-            ++other;
         }
         pos = (1.0/weight)*pos;
         posVar = (1.0/weight)*posVar;
@@ -220,20 +242,25 @@ Cube::CreateTrackFromClusters(const char* name,
         /////////////////////////////////////////////////////
         // Smooth the charge for this node.
         /////////////////////////////////////////////////////
-        other = nodes.begin();
-        weight = 0.0;
-        double charge = 0.0;
-        while (other != nodes.end()) {
-            Cube::Handle<Cube::ReconCluster> otherObject
-                = (*other)->GetObject();
-            TVector3 diff = otherObject->GetPosition().Vect()
-                - nodeObject->GetPosition().Vect();
+        weight = 1.0;
+        double charge = deposits[node];
+        for (int other = node-1; other >= 0; --other) {
+            TVector3 diff = positions[other].Vect() - nodePos;
+            double dist = diff.Mag();
+            if (travel[node]-travel[other] > window
+                && other < node-1) break;
+            double w = dist/chargeScale; w = std::exp(-0.5*w*w);
+            charge += w*deposits[other];
+            weight += w;
+        }
+        for (int other = node+1; other < nodeCount; ++other) {
+            TVector3 diff = positions[other].Vect() - nodePos;
             double dist = diff.Mag();
-            // if (diff*dir < 0.0) dist = -dist;  // in case look at slope.
+            if (travel[other]-travel[node] > window
+                && other > node+1) break;
             double w = dist/chargeScale; w = std::exp(-0.5*w*w);
-            charge += w*otherObject->GetEDeposit();
+            charge += w*deposits[other];
             weight += w;
-            ++other;
         }
         charge /= weight;
 
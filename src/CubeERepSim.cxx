@@ -217,6 +217,8 @@ void Cube::ConvertERepSim(Cube::Event& event) {
     event.Initialize(ERepSim::Input::Get().RunId,
                      ERepSim::Input::Get().EventId,
                      NULL);
+    // The hits get their identifiers from the current event.
+    event.MakeCurrentEvent();
 
     double extraFiberLength
         = (*ERepSim::Input::Get().Property)["3DST.Response.Atten.SensorDist"]
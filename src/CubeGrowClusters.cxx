@@ -1,7 +1,7 @@
 #include "CubeGrowClusters.hxx"
 #include "CubeMakeUsed.hxx"
 #include "CubeClusterManagement.hxx"
-#include "CubeTrackFit.hxx"
+#include "CubeTrackFitBatch.hxx"
 #include "CubeCreateTrack.hxx"
 #include "CubeSafeLine.hxx"
 
@@ -243,11 +243,16 @@ Cube::GrowClusters::Process(const Cube::AlgorithmResult& input,
         // a track.  (This prevents crossing tracks).
         interiorHits.insert(*sharedHit);
 
-        // Make the new cluster
+        // Make the new cluster.  The sums for the new cluster are the sums
+        // for the two clusters, without counting the shared hit twice.
+        Cube::ClusterSums newClusterSums = (*bestPair.first)->GetSums();
+        newClusterSums += (*bestPair.second)->GetSums();
+        newClusterSums.RemoveHit(*(*sharedHit));
         Cube::Handle<Cube::ReconCluster> newCluster
             = Cube::CreateCluster("clusterGrow",
-                                     newClusterHits.begin(),
-                                     newClusterHits.end());
+                                  newClusterHits.begin(),
+                                  newClusterHits.end(),
+                                  newClusterSums);
 
         // Remove the two clusters being combined from the list (after
         // combining them so the iterators are valid for that step).
@@ -262,7 +267,10 @@ Cube::GrowClusters::Process(const Cube::AlgorithmResult& input,
     // Copy the remaining clusters into the finalObjects.  Everything in the
     // clusterList has already been combined as much as possible, and is a
     // candidate "track".
-    Cube::TrackFit fitter;
+    // The tracks are fit as a batch after the loop, and then the fitted
+    // tracks replace the unfitted tracks in finalObjects.
+    Cube::TrackFitBatch::TrackVector newTracks;
+    std::vector<std::size_t> newTrackIndex;
     for (ClusterList::iterator c1 = clusterList.begin();
          c1 != clusterList.end(); ++c1) {
         if ((*c1)->GetHitSelection()->size() < 4) {
@@ -287,10 +295,18 @@ Cube::GrowClusters::Process(const Cube::AlgorithmResult& input,
             = Cube::CreateTrackFromHits("growClusters",
                                         (*c1)->GetHitSelection()->begin(),
                                         (*c1)->GetHitSelection()->end());
-        track = fitter(track);
+        newTracks.push_back(track);
+        newTrackIndex.push_back(finalObjects->size());
         finalObjects->push_back(track);
     }
 
+    // Fit the new tracks as a batch.
+    Cube::TrackFitBatch fitBatch;
+    Cube::TrackFitBatch::TrackVector fitted = fitBatch(newTracks);
+    for (std::size_t i = 0; i < fitted.size(); ++i) {
+        (*finalObjects)[newTrackIndex[i]] = fitted[i];
+    }
+
     // Build the hit selections.
     Cube::MakeUsed makeUsed(*inputHits);
     result = makeUsed(result);
@@ -1,8 +1,10 @@
 #include "CubeGrowTracks.hxx"
-#include "CubeTrackFit.hxx"
+#include "CubeTrackFitBatch.hxx"
 #include "CubeCreateTrack.hxx"
 #include "CubeCompareReconObjects.hxx"
+#include "CubeSortByKey.hxx"
 #include "CubeMakeUsed.hxx"
+#include "CubeTrackEndIndex.hxx"
 
 #include <CubeHandle.hxx>
 #include <CubeReconTrack.hxx>
@@ -15,8 +17,31 @@
 
 #include <memory>
 #include <list>
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <iterator>
 #include <cmath>
 
+namespace {
+    // A track waiting to be merged.  The keys increase from the front to the
+    // back of the list, and the key is used for the track in the end index.
+    struct TrackEntry {
+        TrackEntry(int k, Cube::Handle<Cube::ReconTrack> t)
+            : fKey(k), fTrack(t) {}
+        int fKey;
+        Cube::Handle<Cube::ReconTrack> fTrack;
+    };
+
+    TVector3 NodeFront(Cube::Handle<Cube::ReconTrack> track) {
+        return track->GetNodes().front()->GetState()->GetPosition().Vect();
+    }
+
+    TVector3 NodeBack(Cube::Handle<Cube::ReconTrack> track) {
+        return track->GetNodes().back()->GetState()->GetPosition().Vect();
+    }
+}
+
 Cube::GrowTracks::GrowTracks()
     : Cube::Algorithm("GrowTracks",
                  "Merge tracks that are end-to-end") {
@@ -45,6 +70,9 @@ Cube::GrowTracks::GrowTracks()
     fMatchedPositionCut = 15.0*unit::mm;
     // = Cube::TOARuntimeParams::Get().GetParameterD(
     //     "sfgRecon.GrowTracks.MatchedPositionCut");
+
+    fUseEndpointIndex = true;
+    fMatchCandidateCount = 0;
 }
 
 Cube::GrowTracks::~GrowTracks() { }
@@ -258,11 +286,12 @@ Cube::GrowTracks::Process(const Cube::AlgorithmResult& input,
 
     // Create a stack to keep tracks in.  When the stack is empty, all the
     // tracks that need to be merge have been merge.
-    typedef std::list< Cube::Handle<Cube::ReconTrack> > TrackList;
+    typedef std::list<TrackEntry> TrackList;
     TrackList trackList;
 
     // Make a copy of all of the tracks in the input objects, and save the
     // non-tracks to the output.
+    std::vector< Cube::Handle<Cube::ReconTrack> > inputTracks;
     for (Cube::ReconObjectContainer::iterator t = inputObjects->begin();
          t != inputObjects->end(); ++t) {
         Cube::Handle<Cube::ReconTrack> track = *t;
@@ -270,17 +299,41 @@ Cube::GrowTracks::Process(const Cube::AlgorithmResult& input,
             finalObjects->push_back(*t);
             continue;
         }
-        trackList.push_back(track);
+        inputTracks.push_back(track);
     }
 
     // Sort the tracks so that the longest ones are first.
-    trackList.sort(Cube::CompareReconObjects());
+    std::stable_sort(inputTracks.begin(), inputTracks.end(),
+                     Cube::CompareReconObjects());
+
+    // Only tracks with an end within the merge distance of an end of the
+    // base track can be merged, so the tracks to check are found with an
+    // index of the track ends.  The extra millimeter covers rounding.  The
+    // map finds the list entry for a key.
+    double searchRadius = fMergeDistanceCut + 1.0*unit::mm;
+    Cube::TrackEndIndex endIndex(searchRadius);
+    std::map<int, TrackList::iterator> listEntries;
+    for (std::size_t i = 0; i < inputTracks.size(); ++i) {
+        trackList.push_back(TrackEntry(i,inputTracks[i]));
+        listEntries[i] = std::prev(trackList.end());
+        if (fUseEndpointIndex) {
+            endIndex.Insert(i, NodeFront(inputTracks[i]),
+                            NodeBack(inputTracks[i]));
+        }
+    }
+    int frontKey = -1;
+
+    fMatchCandidateCount = 0;
 
     // Pop a track off the stack and see if it should be merged.  If the track
     // is merged, the result is pushed back on the stack.  If it doesn't get
     // merge, the track get's pushed into the final object container.
+    std::vector<int> keys;
+    std::vector<TrackList::iterator> candidates;
     while (!trackList.empty()) {
-        Cube::Handle<Cube::ReconTrack> track1 = trackList.front();
+        Cube::Handle<Cube::ReconTrack> track1 = trackList.front().fTrack;
+        listEntries.erase(trackList.front().fKey);
+        endIndex.Remove(trackList.front().fKey);
         trackList.pop_front();  // This removes the track from the list!
 
         // Don't use a very short track as a base for merging.  The tracks
@@ -291,11 +344,31 @@ Cube::GrowTracks::Process(const Cube::AlgorithmResult& input,
             continue;
         }
 
-        int index = 0;
-        for (TrackList::iterator t = trackList.begin();
-             t!=trackList.end(); ++t) {
-            ++index;
-            Cube::Handle<Cube::ReconTrack> track2 = *t;
+        // Find the tracks to check in list order.  The keys from the index
+        // are sorted, and the keys are in the same order as the list.
+        candidates.clear();
+        if (fUseEndpointIndex) {
+            keys.clear();
+            endIndex.Query(NodeFront(track1), NodeBack(track1),
+                           searchRadius, keys);
+            for (std::vector<int>::iterator k = keys.begin();
+                 k != keys.end(); ++k) {
+                candidates.push_back(listEntries[*k]);
+            }
+        }
+        else {
+            for (TrackList::iterator t = trackList.begin();
+                 t!=trackList.end(); ++t) {
+                candidates.push_back(t);
+            }
+        }
+
+        for (std::vector<TrackList::iterator>::iterator c
+                 = candidates.begin();
+             c != candidates.end(); ++c) {
+            TrackList::iterator t = *c;
+            Cube::Handle<Cube::ReconTrack> track2 = t->fTrack;
+            ++fMatchCandidateCount;
 
             bool goodMatch = false;
             do {
@@ -372,6 +445,8 @@ Cube::GrowTracks::Process(const Cube::AlgorithmResult& input,
             ///////////////////////////////////////////////////////
 
             // Remove the track iterator (the track is held in track2).
+            listEntries.erase(t->fKey);
+            endIndex.Remove(t->fKey);
             trackList.erase(t);
 
             // Merge the tracks.  This preserves the direction of track1.  The
@@ -387,7 +462,12 @@ Cube::GrowTracks::Process(const Cube::AlgorithmResult& input,
 
             // Put the new track back into the front of the list (track1 was
             // the longest, so the merged track should also be the longest.
-            trackList.push_front(merged);
+            trackList.push_front(TrackEntry(frontKey,merged));
+            listEntries[frontKey] = trackList.begin();
+            if (fUseEndpointIndex) {
+                endIndex.Insert(frontKey, NodeFront(merged), NodeBack(merged));
+            }
+            --frontKey;
 
             // Clear out the track variable.  This releases the handle.
             track1 = Cube::Handle<Cube::ReconTrack>();
@@ -404,10 +484,13 @@ Cube::GrowTracks::Process(const Cube::AlgorithmResult& input,
 
     }
 
-    std::sort(finalObjects->begin(), finalObjects->end(),
-              Cube::CompareReconObjects());
+    Cube::SortByKey(finalObjects->begin(), finalObjects->end(),
+                    Cube::ReconObjectSortKey());
 
-    Cube::TrackFit fitter;
+    // Refit the tracks that were changed as a batch, and then put the
+    // results back in place.
+    Cube::TrackFitBatch::TrackVector refitTracks;
+    std::vector<Cube::ReconObjectContainer::iterator> refitObjects;
     for (Cube::ReconObjectContainer::iterator o = finalObjects->begin();
          o != finalObjects->end(); ++o) {
         Cube::Handle<Cube::ReconTrack> track = *o;
@@ -415,7 +498,13 @@ Cube::GrowTracks::Process(const Cube::AlgorithmResult& input,
         if (track->CheckStatus(Cube::ReconObject::kSuccess)) {
             continue;
         }
-        *o = fitter(track);
+        refitTracks.push_back(track);
+        refitObjects.push_back(o);
+    }
+    Cube::TrackFitBatch fitBatch;
+    Cube::TrackFitBatch::TrackVector fitted = fitBatch(refitTracks);
+    for (std::size_t i = 0; i < fitted.size(); ++i) {
+        *refitObjects[i] = fitted[i];
     }
 
     result->AddObjectContainer(finalObjects);
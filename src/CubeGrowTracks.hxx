@@ -32,6 +32,16 @@ public:
     typedef enum {kFrontFront, kFrontBack, kBackFront, kBackBack, kNotClose}
         Orientation;
 
+    /// Set if the tracks to check for a merge should be found using a
+    /// spatial index of the track ends (the default is true).  When this is
+    /// false, every remaining track is checked.  The merged tracks are the
+    /// same either way.
+    void SetUseEndpointIndex(bool v) {fUseEndpointIndex = v;}
+
+    /// Get the number of track pairs that were checked for a merge by the
+    /// last call to Process.  This is mostly for benchmarking.
+    int GetMatchCandidateCount() const {return fMatchCandidateCount;}
+
 private:
     /// Return how the tracks are oriented relative to each other.
     Orientation TrackOrientation(Cube::Handle<Cube::ReconTrack> t1,
@@ -101,6 +111,13 @@ private:
     /// Tracks that have a closets approach of less than this are not
     /// rejected.  They will also need to have matched directions.
     double fMatchedPositionCut;
+
+    /// A flag that the tracks to check should be found with a
+    /// Cube::TrackEndIndex.
+    bool fUseEndpointIndex;
+
+    /// The number of track pairs checked by the last call to Process.
+    int fMatchCandidateCount;
 };
 #endif
 
@@ -5,208 +5,165 @@
 #include <CubeHandle.hxx>
 #include <CubeHit.hxx>
 
-#include <set>
-
-/// WARNING: There is a lot of duplicated code here, and it could probably be
-/// implemented with some clever templating.  BUT, it's not worth changing
-/// since it works.  HOWEVER, if a bug is found, you need to apply the fix to
-/// each of the specialized routines.
+#include <unordered_set>
+
+namespace {
+    /// Collect hits into an output selection keeping the first copy of each
+    /// hit.  The hits already in the output are counted as seen, so the
+    /// output can be built up over several calls.  The same collector is
+    /// used for all of the hit selection functions, and the mode picks
+    /// which hits are kept.
+    class HitCollector {
+    public:
+        enum Mode {kAll, kComposite, kSimple};
+
+        HitCollector(Cube::HitSelection& output, Mode mode)
+            : fOutput(output), fMode(mode) {
+            fSeen.reserve(2*fOutput.size()+64);
+            for (Cube::HitSelection::iterator hit = fOutput.begin();
+                 hit != fOutput.end(); ++hit) {
+                fSeen.insert(Cube::GetPointer(*hit));
+            }
+        }
 
-Cube::Handle<Cube::HitSelection>
-Cube::AllHitSelection(Cube::ReconObjectContainer& input) {
+        /// Add a hit.  Simple hits are only added in the kAll and kSimple
+        /// modes, and composite hits are unpacked in the kSimple mode.
+        void AddHit(const Cube::Handle<Cube::Hit>& hit) {
+            if (fMode == kAll) {
+                Insert(hit);
+                return;
+            }
+            if (hit->GetConstituentCount() < 1) {
+                if (fMode == kSimple) Insert(hit);
+                return;
+            }
+            if (fMode == kComposite) {
+                Insert(hit);
+                return;
+            }
+            // The hit is composite, so split it up.  A composite hit only
+            // needs to be unpacked once.
+            if (!fUnpacked.insert(Cube::GetPointer(hit)).second) return;
+            for (int i=0; i < hit->GetConstituentCount(); ++i) {
+                AddHit(hit->GetConstituent(i));
+            }
+        }
 
-    // Collect every hit found into a set.
-    std::set<Cube::Handle<Cube::Hit>> hitSet;
-    for (Cube::ReconObjectContainer::iterator o = input.begin();
-         o != input.end();
-         ++o) {
-        // Add the hits for the object.
-        Cube::Handle<Cube::HitSelection> objHits = (*o)->GetHitSelection();
-        if (objHits) {
-            for (Cube::HitSelection::iterator hit = objHits->begin();
-                 hit != objHits->end();
-                 ++hit) {
-                hitSet.insert(*hit);
+        /// Add the hits in a hit selection.
+        void AddHits(Cube::HitSelection& input) {
+            for (Cube::HitSelection::iterator hit = input.begin();
+                 hit != input.end(); ++hit) {
+                AddHit(*hit);
             }
         }
 
-        // Add hits for the constituents.
-        Cube::Handle<Cube::ReconObjectContainer> parts
-            = (*o)->GetConstituents();
-        if (parts) {
-            objHits = Cube::AllHitSelection(*parts);
-            if (objHits) {
-                for (Cube::HitSelection::iterator hit = objHits->begin();
-                     hit != objHits->end();
-                     ++hit) {
-                    hitSet.insert(*hit);
-                }
+        /// Add the hits for the objects, and the hits for the constituents
+        /// of the objects.
+        void AddObjects(Cube::ReconObjectContainer& input) {
+            for (Cube::ReconObjectContainer::iterator o = input.begin();
+                 o != input.end(); ++o) {
+                Cube::Handle<Cube::HitSelection> objHits
+                    = (*o)->GetHitSelection();
+                if (objHits) AddHits(*objHits);
+                Cube::Handle<Cube::ReconObjectContainer> parts
+                    = (*o)->GetConstituents();
+                if (parts) AddObjects(*parts);
             }
         }
-    }
 
-    // Copy the set of hits into a hit selection
-    Cube::Handle<Cube::HitSelection> hits(new Cube::HitSelection("all"));
-    for (std::set<Cube::Handle<Cube::Hit>>::iterator h = hitSet.begin();
-         h != hitSet.end(); ++h) {
-        hits->push_back(*h);
-    }
+    private:
+        /// Add a hit to the output if it hasn't been seen.
+        void Insert(const Cube::Handle<Cube::Hit>& hit) {
+            if (!fSeen.insert(Cube::GetPointer(hit)).second) return;
+            fOutput.push_back(hit);
+        }
+
+        Cube::HitSelection& fOutput;
+        Mode fMode;
+
+        /// The hits that are in the output.
+        std::unordered_set<const Cube::Hit*> fSeen;
 
+        /// The composite hits that have been unpacked (kSimple mode).
+        std::unordered_set<const Cube::Hit*> fUnpacked;
+    };
+}
+
+void Cube::AllHitSelection(Cube::ReconObjectContainer& input,
+                           Cube::HitSelection& output) {
+    HitCollector collector(output, HitCollector::kAll);
+    collector.AddObjects(input);
+}
+
+Cube::Handle<Cube::HitSelection>
+Cube::AllHitSelection(Cube::ReconObjectContainer& input) {
+    Cube::Handle<Cube::HitSelection> hits(new Cube::HitSelection("all"));
+    Cube::AllHitSelection(input, *hits);
     return hits;
 }
 
+void Cube::AllHitSelection(Cube::HitSelection& input,
+                           Cube::HitSelection& output) {
+    HitCollector collector(output, HitCollector::kAll);
+    collector.AddHits(input);
+}
+
 Cube::Handle<Cube::HitSelection>
 Cube::AllHitSelection(Cube::HitSelection& input) {
-    std::set<Cube::Handle<Cube::Hit>> hitSet;
-    for (Cube::HitSelection::iterator hit = input.begin();
-         hit != input.end();
-         ++hit) {
-        hitSet.insert(*hit);
-    }
-
     Cube::Handle<Cube::HitSelection> hits(new Cube::HitSelection("all"));
-    for (std::set<Cube::Handle<Cube::Hit>>::iterator h = hitSet.begin();
-         h != hitSet.end(); ++h) {
-        hits->push_back(*h);
-    }
-
+    Cube::AllHitSelection(input, *hits);
     return hits;
 }
 
+void Cube::CompositeHitSelection(Cube::ReconObjectContainer& input,
+                                 Cube::HitSelection& output) {
+    HitCollector collector(output, HitCollector::kComposite);
+    collector.AddObjects(input);
+}
+
 Cube::Handle<Cube::HitSelection>
 Cube::CompositeHitSelection(Cube::ReconObjectContainer& input) {
-
-    std::set<Cube::Handle<Cube::Hit>> hitSet;
-    for (Cube::ReconObjectContainer::iterator o = input.begin();
-         o != input.end();
-         ++o) {
-        // Add the hits for the object.
-        Cube::Handle<Cube::HitSelection> objHits = (*o)->GetHitSelection();
-        if (objHits) {
-            for (Cube::HitSelection::iterator hit = objHits->begin();
-                 hit != objHits->end();
-                 ++hit) {
-                if ((*hit)->GetConstituentCount() < 1) continue;
-                hitSet.insert(*hit);
-            }
-        }
-
-        // Add hits for the constituents.
-        Cube::Handle<Cube::ReconObjectContainer> parts
-            = (*o)->GetConstituents();
-        if (parts) {
-            objHits = Cube::AllHitSelection(*parts);
-            if (objHits) {
-                for (Cube::HitSelection::iterator hit = objHits->begin();
-                     hit != objHits->end();
-                     ++hit) {
-                    if ((*hit)->GetConstituentCount() < 1) continue;
-                    hitSet.insert(*hit);
-                }
-            }
-        }
-    }
-
     Cube::Handle<Cube::HitSelection> hits(new Cube::HitSelection("composite"));
-    for (std::set<Cube::Handle<Cube::Hit>>::iterator h = hitSet.begin();
-         h != hitSet.end(); ++h) {
-        hits->push_back(*h);
-    }
-
+    Cube::CompositeHitSelection(input, *hits);
     return hits;
 }
 
+void Cube::CompositeHitSelection(Cube::HitSelection& input,
+                                 Cube::HitSelection& output) {
+    HitCollector collector(output, HitCollector::kComposite);
+    collector.AddHits(input);
+}
+
 Cube::Handle<Cube::HitSelection>
 Cube::CompositeHitSelection(Cube::HitSelection& input) {
-    std::set<Cube::Handle<Cube::Hit>> hitSet;
-    for (Cube::HitSelection::iterator hit = input.begin();
-         hit != input.end();
-         ++hit) {
-        if ((*hit)->GetConstituentCount() < 1) continue;
-        hitSet.insert(*hit);
-    }
-
     Cube::Handle<Cube::HitSelection> hits(new Cube::HitSelection("composite"));
-    for (std::set<Cube::Handle<Cube::Hit>>::iterator h = hitSet.begin();
-         h != hitSet.end(); ++h) {
-        hits->push_back(*h);
-    }
-
+    Cube::CompositeHitSelection(input, *hits);
     return hits;
 }
 
+void Cube::SimpleHitSelection(Cube::ReconObjectContainer& input,
+                              Cube::HitSelection& output) {
+    HitCollector collector(output, HitCollector::kSimple);
+    collector.AddObjects(input);
+}
+
 Cube::Handle<Cube::HitSelection>
 Cube::SimpleHitSelection(Cube::ReconObjectContainer& input) {
-    std::set<Cube::Handle<Cube::Hit>> hitSet;
-    for (Cube::ReconObjectContainer::iterator o = input.begin();
-         o != input.end();
-         ++o) {
-        // Add the hits for the object.
-        Cube::Handle<Cube::HitSelection> objHits = (*o)->GetHitSelection();
-        if (objHits) {
-            Cube::Handle<Cube::HitSelection> simpleHits =
-                Cube::SimpleHitSelection(*(*o)->GetHitSelection());
-            for (Cube::HitSelection::iterator hit = simpleHits->begin();
-                 hit != simpleHits->end();
-                 ++hit) {
-                hitSet.insert(*hit);
-            }
-        }
-
-        // Add hits for the constituents.
-        Cube::Handle<Cube::ReconObjectContainer> parts
-            = (*o)->GetConstituents();
-        if (parts) {
-            objHits = Cube::SimpleHitSelection(*parts);
-            if (objHits) {
-                for (Cube::HitSelection::iterator hit = objHits->begin();
-                     hit != objHits->end();
-                     ++hit) {
-                    hitSet.insert(*hit);
-                }
-            }
-        }
-    }
-
     Cube::Handle<Cube::HitSelection> hits(new Cube::HitSelection("simple"));
-    for (std::set<Cube::Handle<Cube::Hit>>::iterator h = hitSet.begin();
-         h != hitSet.end(); ++h) {
-        hits->push_back(*h);
-    }
-
+    Cube::SimpleHitSelection(input, *hits);
     return hits;
 }
 
+void Cube::SimpleHitSelection(Cube::HitSelection& input,
+                              Cube::HitSelection& output) {
+    HitCollector collector(output, HitCollector::kSimple);
+    collector.AddHits(input);
+}
+
 Cube::Handle<Cube::HitSelection>
 Cube::SimpleHitSelection(Cube::HitSelection& input) {
-    std::set<Cube::Handle<Cube::Hit>> hitSet;
-    for (Cube::HitSelection::iterator hit = input.begin();
-         hit != input.end();
-         ++hit) {
-        if ((*hit)->GetConstituentCount() < 1) {
-            hitSet.insert(*hit);
-            continue;
-        }
-        // The hit is composite, so split it up.
-        Cube::HitSelection compositeHits;
-        for (int i=0; i < (*hit)->GetConstituentCount(); ++i) {
-            compositeHits.push_back((*hit)->GetConstituent(i));
-        }
-        Cube::Handle<Cube::HitSelection> newHits =
-            SimpleHitSelection(compositeHits);
-        for (Cube::HitSelection::iterator simple = newHits->begin();
-             simple != newHits->end();
-             ++simple) {
-            hitSet.insert(*simple);
-        }
-    }
-
     Cube::Handle<Cube::HitSelection> hits(new Cube::HitSelection("simple"));
-    for (std::set<Cube::Handle<Cube::Hit>>::iterator h = hitSet.begin();
-         h != hitSet.end(); ++h) {
-        hits->push_back(*h);
-    }
-
+    Cube::SimpleHitSelection(input, *hits);
     return hits;
 }
 
@@ -4,12 +4,21 @@
 #include <CubeReconObject.hxx>
 #include <CubeHandle.hxx>
 
+/// The hit selection functions return each hit once, in the order that the
+/// hits are first found.  The versions that take an output selection append
+/// to it (so a selection can be reused between calls), and a hit that is
+/// already in the output selection isn't added again.
 namespace Cube {
     /// Collect all of the hits used by ReconObject objects in a
     /// reconstruction object container into a single hit selection.
     Cube::Handle<Cube::HitSelection>
     AllHitSelection(Cube::ReconObjectContainer& input);
 
+    /// Add all of the hits used by ReconObject objects in a reconstruction
+    /// object container to the output hit selection.
+    void AllHitSelection(Cube::ReconObjectContainer& input,
+                         Cube::HitSelection& output);
+
     /// Copy all of the hits used by in a hitselection to a new hit selection.
     /// This is mostly for symmetry with the composite and simple hit
     /// selection functions.  This does make sure all of the hits in the
@@ -17,16 +26,30 @@ namespace Cube {
     Cube::Handle<Cube::HitSelection>
     AllHitSelection(Cube::HitSelection& input);
 
+    /// Add all of the hits in a hit selection to the output hit selection.
+    void AllHitSelection(Cube::HitSelection& input,
+                         Cube::HitSelection& output);
+
     /// Collect all of the composite hits used by ReconObject objects in a
     /// reconstruction object container into one hit selection.
     Cube::Handle<Cube::HitSelection>
     CompositeHitSelection(Cube::ReconObjectContainer& input);
 
+    /// Add all of the composite hits used by ReconObject objects in a
+    /// reconstruction object container to the output hit selection.
+    void CompositeHitSelection(Cube::ReconObjectContainer& input,
+                               Cube::HitSelection& output);
+
     /// Collect all of the composite hits in a HitSelection into a new
     /// HitSelection.
     Cube::Handle<Cube::HitSelection>
     CompositeHitSelection(Cube::HitSelection& input);
 
+    /// Add all of the composite hits in a HitSelection to the output hit
+    /// selection.
+    void CompositeHitSelection(Cube::HitSelection& input,
+                               Cube::HitSelection& output);
+
     /// Collect all of the simple (also called fiber) hits used by
     /// ReconObject objects in a reconstruction object container into
     /// one hit selection.  This will unpack any composite hits to get
@@ -34,11 +57,22 @@ namespace Cube {
     Cube::Handle<Cube::HitSelection>
     SimpleHitSelection(Cube::ReconObjectContainer& input);
 
+    /// Add all of the simple hits used by ReconObject objects in a
+    /// reconstruction object container to the output hit selection.  The
+    /// composite hits are unpacked directly into the output.
+    void SimpleHitSelection(Cube::ReconObjectContainer& input,
+                            Cube::HitSelection& output);
+
     /// Collect all of the simple (also called fiber) hits in a
     /// HitSelection into a new THitSelection.  This will unpack any
     /// composite hits to get the simple hits used to construct the
     /// composite hit.
     Cube::Handle<Cube::HitSelection>
     SimpleHitSelection(Cube::HitSelection& input);
+
+    /// Add all of the simple hits in a HitSelection to the output hit
+    /// selection.  The composite hits are unpacked directly into the output.
+    void SimpleHitSelection(Cube::HitSelection& input,
+                            Cube::HitSelection& output);
 }
 #endif
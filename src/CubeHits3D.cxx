@@ -4,6 +4,8 @@
 #include "CubeUnits.hxx"
 #include "CubeInfo.hxx"
 #include "CubeShareCharge.hxx"
+#include "CubeSortByKey.hxx"
+#include "CubeCompareStableIds.hxx"
 
 #include <CubeLog.hxx>
 #include <CubeHandle.hxx>
@@ -16,10 +18,20 @@
 #include <cmath>
 
 namespace {
-    struct hitCompareHitZ {
-        bool operator () (const Cube::Handle<Cube::Hit>& lhs,
-                          const Cube::Handle<Cube::Hit>& rhs) {
-            return lhs->GetPosition().Z() < rhs->GetPosition().Z();
+    struct hitKeyZ {
+        double operator () (const Cube::Handle<Cube::Hit>& hit) const {
+            return hit->GetPosition().Z();
+        }
+    };
+
+    // Order the fibers by time, and then by the hit identifier so that the
+    // order doesn't depend on where the hits are in memory.
+    struct compareFiberTQ {
+        bool operator () (
+            const std::pair<double, Cube::Handle<Cube::Hit>>& lhs,
+            const std::pair<double, Cube::Handle<Cube::Hit>>& rhs) const {
+            if (lhs.first != rhs.first) return lhs.first < rhs.first;
+            return Cube::CompareStableIds()(lhs.second, rhs.second);
         }
     };
 
@@ -93,7 +105,7 @@ std::pair<double,double> Cube::Hits3D::HitTime(FiberTQ& fiberTQ) const {
     const double hitRes = 0.7*unit::ns;
 
     // Order the fiber times.  The times are transit time corrected.
-    std::sort(fiberTQ.begin(),fiberTQ.end());
+    std::sort(fiberTQ.begin(),fiberTQ.end(),compareFiberTQ());
 
     // Now take the charge weighted average and RMS of the late hits.  The
     // average is also calculated for all hits to help calculate the
@@ -356,8 +368,8 @@ Cube::Hits3D::Process(const Cube::AlgorithmResult& fibers,
         }
     }
 
-    std::sort(xzHits.begin(), xzHits.end(), hitCompareHitZ());
-    std::sort(yzHits.begin(), yzHits.end(), hitCompareHitZ());
+    Cube::SortByKey(xzHits.begin(), xzHits.end(), hitKeyZ());
+    Cube::SortByKey(yzHits.begin(), yzHits.end(), hitKeyZ());
 
     CUBE_LOG(0) << "XZ Hits: " << xzHits.size()
                 << " YZ Hits: " << yzHits.size()
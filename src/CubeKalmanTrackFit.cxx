@@ -0,0 +1,291 @@
+#include "CubeKalmanTrackFit.hxx"
+#include "CubeTrackMeasurements.hxx"
+#include "CubeNodeTimeFit.hxx"
+
+#include <CubeReconNode.hxx>
+#include <CubeReconCluster.hxx>
+#include <CubeLog.hxx>
+#include <CubeUnits.hxx>
+
+#include <Math/SMatrix.h>
+#include <Math/SVector.h>
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // The filter state is (X, Y, Z, DX, DY, DZ).  The direction isn't
+    // constrained by the update, so it's renormalized after each node is
+    // added, and again when the node states are filled.
+    enum {kX = 0, kDX = 3, kStateSize = 6, kMeasSize = 3};
+
+    typedef ROOT::Math::SVector<double,kStateSize> KalmanVector;
+    typedef ROOT::Math::SMatrix<double,kStateSize,kStateSize> KalmanMatrix;
+    typedef ROOT::Math::SVector<double,kMeasSize> MeasVector;
+    typedef ROOT::Math::SMatrix<double,kMeasSize,kMeasSize> MeasMatrix;
+    typedef ROOT::Math::SMatrix<double,kMeasSize,kStateSize> GainMatrix;
+    typedef ROOT::Math::SMatrix<double,kStateSize,kMeasSize> GainTMatrix;
+
+    // The filter quantities that are saved at each node so that the
+    // smoother can be applied.
+    struct KalmanStep {
+        KalmanVector fPredicted;    // The state predicted at the node.
+        KalmanMatrix fPredictedCov; // The predicted covariance.
+        KalmanVector fFiltered;     // The state after the node is added.
+        KalmanMatrix fFilteredCov;  // The covariance after the node.
+        KalmanMatrix fTransport;    // The transport from the last node.
+        double fChi2;               // The filter residual chi-squared.
+    };
+}
+
+Cube::KalmanTrackFit::KalmanTrackFit()
+    : fMaximumChi2PerDOF(4.0), fMaximumNodeChi2(25.0) {
+    // Use the same noise as the stochastic fitter so that the fits can be
+    // compared.  This uses the radiation length for plastic.
+    fScatteringSigma
+        = Cube::MultipleScatteringAngle(105*unit::MeV, 500*unit::MeV,
+                                        41.31*unit::cm, 1*unit::cm);
+}
+Cube::KalmanTrackFit::~KalmanTrackFit() {}
+
+Cube::Handle<Cube::ReconTrack>
+Cube::KalmanTrackFit::Apply(Cube::Handle<Cube::ReconTrack>& input) {
+
+    Cube::ReconNodeContainer& nodes = input->GetNodes();
+    if (nodes.size() < 3) {
+        CUBE_LOG(2) << "Kalman::" << "Not enough nodes to fit." << std::endl;
+        return Cube::Handle<Cube::ReconTrack>();
+    }
+
+    CUBE_LOG(2) << "Kalman::" << "Fit with " << nodes.size()
+                << " nodes" << std::endl;
+
+    // Collect the measurements.
+    Cube::TrackMeasurements measurements;
+    if (!measurements.Fill(nodes)) return Cube::Handle<Cube::ReconTrack>();
+    std::vector<MeasVector> meas(nodes.size());
+    std::vector<MeasMatrix> measCov(nodes.size());
+    for (std::size_t i = 0; i < nodes.size(); ++i) {
+        for (int j = 0; j < kMeasSize; ++j) {
+            meas[i](j) = measurements[i].GetPosition(j);
+            measCov[i](j,j) = measurements[i].GetVariance(j);
+        }
+    }
+
+    // Make the prior from the first node, and the direction toward a node a
+    // few steps along the track (the same nodes used by the stochastic fit
+    // prior).
+    std::size_t priorNode = std::min((std::size_t) 4, nodes.size()-1);
+    MeasVector priorDir = meas[priorNode] - meas[0];
+    double priorLength = std::sqrt(ROOT::Math::Dot(priorDir,priorDir));
+    if (priorLength < 0.1*unit::mm) {
+        CUBE_LOG(2) << "Kalman::" << "Measurements at same location"
+                    << std::endl;
+        return Cube::Handle<Cube::ReconTrack>();
+    }
+    priorDir /= priorLength;
+    KalmanVector state;
+    KalmanMatrix stateCov;
+    for (int i = 0; i < kMeasSize; ++i) {
+        state(kX+i) = meas[0](i);
+        state(kDX+i) = priorDir(i);
+        stateCov(kX+i,kX+i) = measCov[0](i,i);
+        stateCov(kDX+i,kDX+i) = 0.25;
+    }
+
+    // The measurement is the position part of the state.
+    GainMatrix measure;
+    for (int i = 0; i < kMeasSize; ++i) measure(i,kX+i) = 1.0;
+
+    // Forward filter.
+    const double scatter = fScatteringSigma*fScatteringSigma;
+    std::vector<KalmanStep> steps(nodes.size());
+    double chiSquared = 0.0;
+    for (std::size_t n = 0; n < nodes.size(); ++n) {
+        KalmanStep& step = steps[n];
+        // Transport the state to the point of closest approach to the
+        // measurement in a straight line.
+        double dist = 0.0;
+        for (int i = 0; i < kMeasSize; ++i) {
+            dist += state(kDX+i)*(meas[n](i) - state(kX+i));
+        }
+        double absDist = std::abs(dist);
+        step.fTransport = ROOT::Math::SMatrixIdentity();
+        for (int i = 0; i < kMeasSize; ++i) step.fTransport(kX+i,kDX+i) = dist;
+        step.fPredicted = step.fTransport*state;
+        step.fPredictedCov = step.fTransport*stateCov
+            *ROOT::Math::Transpose(step.fTransport);
+        // Add the multiple scattering as a random walk of the direction.
+        double dirVar = scatter*absDist;
+        for (int i = 0; i < kMeasSize; ++i) {
+            step.fPredictedCov(kX+i,kX+i) += dirVar*dist*dist/3.0;
+            step.fPredictedCov(kX+i,kDX+i) += dirVar*dist/2.0;
+            step.fPredictedCov(kDX+i,kX+i) += dirVar*dist/2.0;
+            step.fPredictedCov(kDX+i,kDX+i) += dirVar;
+        }
+
+        // Add the measurement.
+        MeasVector residual = meas[n] - measure*step.fPredicted;
+        MeasMatrix residualCov = measure*step.fPredictedCov
+            *ROOT::Math::Transpose(measure) + measCov[n];
+        if (!residualCov.Invert()) {
+            CUBE_LOG(2) << "Kalman::" << "Singular residual covariance"
+                        << std::endl;
+            return Cube::Handle<Cube::ReconTrack>();
+        }
+        GainTMatrix gain = step.fPredictedCov
+            *ROOT::Math::Transpose(measure)*residualCov;
+        step.fFiltered = step.fPredicted + gain*residual;
+        KalmanMatrix update = ROOT::Math::SMatrixIdentity();
+        update -= gain*measure;
+        step.fFilteredCov = update*step.fPredictedCov;
+        step.fChi2 = ROOT::Math::Dot(residual,residualCov*residual);
+        chiSquared += step.fChi2;
+
+        // Check for a kink.  The first node defines the prior so it can't be
+        // inconsistent.
+        if (n > 0 && step.fChi2 > fMaximumNodeChi2) {
+            CUBE_LOG(2) << "Kalman::" << "Kink at node " << n
+                        << " with chi2 " << step.fChi2 << std::endl;
+            return Cube::Handle<Cube::ReconTrack>();
+        }
+
+        // Keep the direction normalized so that the next transport
+        // distance is a length.  The normalized state is saved in the step
+        // (with the direction rows and columns of the covariance scaled to
+        // match) so that the smoother combines it with a prediction that
+        // was transported from the same state.
+        double norm = std::sqrt(step.fFiltered(kDX)*step.fFiltered(kDX)
+                                + step.fFiltered(kDX+1)*step.fFiltered(kDX+1)
+                                + step.fFiltered(kDX+2)*step.fFiltered(kDX+2));
+        if (norm > 0.0) {
+            for (int i = 0; i < kMeasSize; ++i) {
+                step.fFiltered(kDX+i) /= norm;
+                for (int j = 0; j < kStateSize; ++j) {
+                    step.fFilteredCov(kDX+i,j) /= norm;
+                    step.fFilteredCov(j,kDX+i) /= norm;
+                }
+            }
+        }
+        state = step.fFiltered;
+        stateCov = step.fFilteredCov;
+    }
+
+    int trackDOF = 3*nodes.size() - 6;
+    if (chiSquared > fMaximumChi2PerDOF*trackDOF) {
+        CUBE_LOG(2) << "Kalman::" << "Bad fit with chi2 " << chiSquared
+                    << "/" << trackDOF << std::endl;
+        return Cube::Handle<Cube::ReconTrack>();
+    }
+
+    // Backward smoother (Rauch-Tung-Striebel).  This overwrites the filtered
+    // state at each node with the smoothed state.
+    for (int n = (int) nodes.size() - 2; n >= 0; --n) {
+        KalmanStep& step = steps[n];
+        const KalmanStep& next = steps[n+1];
+        KalmanMatrix predictedErr = next.fPredictedCov;
+        if (!predictedErr.Invert()) {
+            CUBE_LOG(2) << "Kalman::" << "Singular predicted covariance"
+                        << std::endl;
+            return Cube::Handle<Cube::ReconTrack>();
+        }
+        KalmanMatrix smoother = step.fFilteredCov
+            *ROOT::Math::Transpose(next.fTransport)*predictedErr;
+        step.fFiltered += smoother*(next.fFiltered - next.fPredicted);
+        step.fFilteredCov += smoother*(next.fFilteredCov - next.fPredictedCov)
+            *ROOT::Math::Transpose(smoother);
+    }
+
+    // Fill the node states.
+    double energyDeposit = 0.0;
+    double energyVariance = 0.0;
+    for (std::size_t n = 0; n < nodes.size(); ++n) {
+        const KalmanVector& v = steps[n].fFiltered;
+        const KalmanMatrix& c = steps[n].fFilteredCov;
+        Cube::Handle<Cube::TrackState> trackState = nodes[n]->GetState();
+        const Cube::TrackMeasurement& measure = measurements[n];
+
+        energyDeposit += measure.GetEDeposit();
+        energyVariance += measure.GetEDepositVariance();
+
+        double norm = std::sqrt(v(kDX)*v(kDX) + v(kDX+1)*v(kDX+1)
+                                + v(kDX+2)*v(kDX+2));
+        trackState->SetEDeposit(measure.GetEDeposit());
+        trackState->SetEDepositVariance(measure.GetEDepositVariance());
+        trackState->SetPosition(v(kX), v(kX+1), v(kX+2),
+                                measure.GetPosition(3));
+        trackState->SetDirection(v(kDX)/norm, v(kDX+1)/norm, v(kDX+2)/norm);
+        for (int i = 0; i < kMeasSize; ++i) {
+            for (int j = 0; j < kMeasSize; ++j) {
+                trackState->SetPositionCovariance(i,j,c(kX+i,kX+j));
+                trackState->SetDirectionCovariance(
+                    i,j,c(kDX+i,kDX+j)/norm/norm);
+                trackState->SetCovarianceValue(
+                    trackState->GetXIndex()+i,
+                    trackState->GetDirectionIndex()+j,
+                    c(kX+i,kDX+j)/norm);
+                trackState->SetCovarianceValue(
+                    trackState->GetDirectionIndex()+j,
+                    trackState->GetXIndex()+i,
+                    c(kX+i,kDX+j)/norm);
+            }
+            trackState->SetPositionCovariance(3,i,0.0);
+            trackState->SetPositionCovariance(i,3,0.0);
+        }
+        trackState->SetCurvature(0.0,0.0,0.0);
+        trackState->SetCurvatureVariance(0.005,0.005,0.005);
+        trackState->SetSampleCount(0);
+    }
+
+    // Fit the node times to a line as a function of the distance traveled
+    // along the track (the same fit as the stochastic fitter).  This needs
+    // the node positions and directions.  The returned uncertainty is for
+    // the fitted time offset, and is used for all of the nodes.
+    double tUnc = Cube::FitNodeTimes(nodes,measurements);
+    for (std::size_t n = 0; n < nodes.size(); ++n) {
+        Cube::Handle<Cube::TrackState> trackState = nodes[n]->GetState();
+        trackState->SetPositionCovariance(3,3,tUnc);
+    }
+
+    // Fill the overall track state at the front.
+    Cube::Handle<Cube::TrackState> trackState = input->GetFront();
+    Cube::Handle<Cube::TrackState> nodeState = nodes.front()->GetState();
+    *trackState = *nodeState;
+    trackState->SetEDeposit(energyDeposit);
+    trackState->SetEDepositVariance(energyVariance);
+
+    // Fill the overall track state at the back.
+    trackState = input->GetBack();
+    nodeState = nodes.back()->GetState();
+    *trackState = *nodeState;
+    trackState->SetEDeposit(energyDeposit);
+    trackState->SetEDepositVariance(energyVariance);
+
+    // Setup the track information and status fields.
+    input->SetStatus(Cube::ReconObject::kSuccess);
+    input->SetStatus(Cube::ReconObject::kRan);
+    input->SetStatus(Cube::ReconObject::kKalmanFit);
+    input->SetAlgorithmName("KalmanTrackFit");
+    input->SetQuality(chiSquared);
+    input->SetNDOF(trackDOF);
+
+    // Check the track direction based on timing and reverse if necessary.
+    // This is the same as the stochastic fit.
+    double dt = input->GetBack()->GetPosition().T()
+        - input->GetFront()->GetPosition().T();
+    if (dt < 0.0) input->ReverseTrack();
+
+    CUBE_LOG(1) << "Kalman::"
+                << " " << nodes.size() << " nodes"
+                << ", Chi-Squared: "  << chiSquared
+                << "/" << trackDOF << " d.o.f." << std::endl;
+
+    return input;
+}
+
+// Local Variables:
+// mode:c++
+// c-basic-offset:4
+// compile-command:"$(git rev-parse --show-toplevel)/build/cube-build.sh force"
+// End:
@@ -0,0 +1,76 @@
+#ifndef CubeKalmanTrackFit_hxx_seen
+#define CubeKalmanTrackFit_hxx_seen
+
+#include "CubeTrackFitBase.hxx"
+
+#include <CubeReconTrack.hxx>
+#include <CubeHandle.hxx>
+
+namespace Cube {
+    class KalmanTrackFit;
+};
+
+/// A deterministic track fit done with a Kalman filter and a
+/// Rauch-Tung-Striebel smoother.  The track is described by a position and a
+/// direction that is propagated in a straight line between the nodes, and
+/// multiple scattering is included as a random walk of the direction.  The
+/// node objects are used as position measurements.  This takes an input
+/// track where all of the nodes are filled with objects, and the nodes are in
+/// the correct order.  See the Cube::TrackFitBase class for more detailed API
+/// documentation.
+///
+/// This is much faster than the Cube::StochTrackFit, and gives the same
+/// result for tracks that are well described by Gaussian uncertainties.  The
+/// fit fails (returns an empty handle, and leaves the track unchanged) when
+/// the chi-squared per degree of freedom is too large, or when a single node
+/// is inconsistent with the track (usually a kink, or a hard scatter), so
+/// that Cube::TrackFit can escalate to the stochastic fitter.
+class Cube::KalmanTrackFit : public Cube::TrackFitBase {
+public:
+    KalmanTrackFit();
+    virtual ~KalmanTrackFit();
+
+    /// Fit the skeleton of a track.
+    virtual Cube::Handle<Cube::ReconTrack>
+    Apply(Cube::Handle<Cube::ReconTrack>& input);
+
+    /// Set the direction change due to multiple scattering (in radians) per
+    /// square root of length.  This has the same meaning as the direction
+    /// sigma used by the Cube::StochTrackFit.
+    void SetScatteringSigma(double v) {fScatteringSigma = v;}
+
+    /// Get the direction change per square root of length.
+    double GetScatteringSigma() const {return fScatteringSigma;}
+
+    /// Set the maximum chi-squared per degree of freedom for an acceptable
+    /// fit.
+    void SetMaximumChi2PerDOF(double v) {fMaximumChi2PerDOF = v;}
+
+    /// Get the maximum chi-squared per degree of freedom.
+    double GetMaximumChi2PerDOF() const {return fMaximumChi2PerDOF;}
+
+    /// Set the maximum chi-squared contribution for a single node (the
+    /// filter residual at the node).  A node above this is treated as a kink
+    /// and the fit fails.
+    void SetMaximumNodeChi2(double v) {fMaximumNodeChi2 = v;}
+
+    /// Get the maximum chi-squared contribution for a single node.
+    double GetMaximumNodeChi2() const {return fMaximumNodeChi2;}
+
+private:
+    // The direction change per square root of length.
+    double fScatteringSigma;
+
+    // The maximum chi-squared per degree of freedom for an acceptable fit.
+    double fMaximumChi2PerDOF;
+
+    // The maximum filter residual chi-squared for one node.
+    double fMaximumNodeChi2;
+};
+#endif
+
+// Local Variables:
+// mode:c++
+// c-basic-offset:4
+// compile-command:"$(git rev-parse --show-toplevel)/build/cube-build.sh force"
+// End:
@@ -2,16 +2,19 @@
 #include "CubeTimeSlice.hxx"
 #include "CubeHits3D.hxx"
 #include "CubeMakeUsed.hxx"
+#include "CubeCompareStableIds.hxx"
 
 #include <CubeLog.hxx>
 #include <CubeHandle.hxx>
 #include <CubeAlgorithmResult.hxx>
+#include <CubeAlgorithmTrace.hxx>
 #include <CubeUnits.hxx>
 
 #include <CubeInfo.hxx>
 
 #include <sstream>
 #include <iomanip>
+#include <iterator>
 #include <memory>
 
 Cube::MakeHits3D::MakeHits3D()
@@ -205,6 +208,8 @@ Cube::MakeHits3D::Process(const Cube::AlgorithmResult& input,
             // Cube::AlgorithmResult.
             Cube::HitSelection local("fibers");
             std::copy(hits->begin(), hits->end(), std::back_inserter(local));
+            Cube::AlgorithmTrace::SliceScope sliceTrace(
+                std::distance(slices->begin(),obj));
             Cube::Handle<Cube::AlgorithmResult> hits3D
                 = Run<Cube::Hits3D>(local);
             if (!hits3D) continue;
@@ -240,13 +245,16 @@ Cube::MakeHits3D::Process(const Cube::AlgorithmResult& input,
         }
     }
 
-    // Make sure the hit selections don't have duplicates
-    std::sort(unusedHits->begin(), unusedHits->end());
+    // Make sure the hit selections don't have duplicates.  The hits are
+    // sorted by the stable identifier so the saved order doesn't depend on
+    // where the hits are in memory.
+    std::sort(unusedHits->begin(), unusedHits->end(),
+              Cube::CompareStableIds());
     Cube::HitSelection::iterator end
         = std::unique(unusedHits->begin(), unusedHits->end());
     unusedHits->erase(end, unusedHits->end());
 
-    std::sort(usedHits->begin(), usedHits->end());
+    std::sort(usedHits->begin(), usedHits->end(), Cube::CompareStableIds());
     end = std::unique(usedHits->begin(), usedHits->end());
     usedHits->erase(end, usedHits->end());
 
@@ -1,5 +1,4 @@
 #include "CubeMakeUsed.hxx"
-#include "CubeHitUtilities.hxx"
 
 #include <CubeAlgorithmResult.hxx>
 #include <CubeInfo.hxx>
@@ -7,15 +6,81 @@
 
 #include <algorithm>
 #include <vector>
-#include <set>
+#include <unordered_map>
 
 Cube::MakeUsed::MakeUsed(const Cube::HitSelection& allHits)
-    : fAllHits(allHits) { }
+    : fAllHits(allHits), fGeneration(0) {
+    // A hit that is in allHits more than once shares the stamp of the
+    // first copy.
+    fIndex.reserve(fAllHits.size());
+    fFirst.resize(fAllHits.size());
+    for (std::size_t i = 0; i < fAllHits.size(); ++i) {
+        fFirst[i] = fIndex.insert(
+            std::make_pair(Cube::GetPointer(fAllHits[i]), i)).first->second;
+    }
+    fStamp.resize(fAllHits.size(), fGeneration);
+}
 
 Cube::MakeUsed::~MakeUsed() {}
 
+void Cube::MakeUsed::Stamp(const Cube::Handle<Cube::Hit>& hit) {
+    std::unordered_map<const Cube::Hit*, std::size_t>::iterator index
+        = fIndex.find(Cube::GetPointer(hit));
+    if (index == fIndex.end()) return;
+    fStamp[index->second] = fGeneration;
+}
+
+void Cube::MakeUsed::MarkUsed(const Cube::Handle<Cube::Hit>& hit) {
+    Stamp(hit);
+    MarkSimple(hit);
+}
+
+void Cube::MakeUsed::MarkSimple(const Cube::Handle<Cube::Hit>& hit) {
+    for (int i=0; i < hit->GetConstituentCount(); ++i) {
+        Cube::Handle<Cube::Hit> constituent = hit->GetConstituent(i);
+        if (constituent->GetConstituentCount() < 1) Stamp(constituent);
+        else MarkSimple(constituent);
+    }
+}
+
+void Cube::MakeUsed::AddUsed(const Cube::Handle<Cube::Hit>& hit,
+                             Cube::HitSelection& usedHits) {
+    unsigned int& seen = fSeen[Cube::GetPointer(hit)];
+    if (seen == fGeneration) return;
+    seen = fGeneration;
+    usedHits.push_back(hit);
+    MarkUsed(hit);
+}
+
+void Cube::MakeUsed::AddUsed(const Cube::ReconObjectContainer& objects,
+                             Cube::HitSelection& usedHits) {
+    for (Cube::ReconObjectContainer::const_iterator o = objects.begin();
+         o != objects.end(); ++o) {
+        Cube::Handle<Cube::HitSelection> objHits = (*o)->GetHitSelection();
+        if (objHits) {
+            for (Cube::HitSelection::iterator h = objHits->begin();
+                 h != objHits->end(); ++h) {
+                AddUsed(*h,usedHits);
+            }
+        }
+        Cube::Handle<Cube::ReconObjectContainer> parts
+            = (*o)->GetConstituents();
+        if (parts) AddUsed(*parts,usedHits);
+    }
+}
+
 Cube::Handle<Cube::AlgorithmResult>
 Cube::MakeUsed::operator () (Cube::Handle<Cube::AlgorithmResult> input) {
+    // Start a new generation.  Every stamp from an earlier call is now out
+    // of date, so the used flags don't need to be cleared.  The stamps start
+    // at zero, so generation zero is never used.
+    ++fGeneration;
+    if (fGeneration == 0) {
+        std::fill(fStamp.begin(), fStamp.end(), 0);
+        fSeen.clear();
+        ++fGeneration;
+    }
+
     // Check for the existing unused hits.  Create the container if they don't
     // exist.
     Cube::Handle<Cube::HitSelection> unusedHits
@@ -37,58 +102,30 @@ Cube::MakeUsed::operator () (Cube::Handle<Cube::AlgorithmResult> input) {
         usedHits = input->GetHitSelection("used");
     }
 
-    // Get final objects from the algorithm result and add the hits to the
-    // used selection.
+    // Mark any hits that are already in the used selection, and then add the
+    // hits from the final objects.  Each hit is added once, and the hits
+    // used to build composite hits are marked as used too.
+    Cube::HitSelection existingHits;
+    existingHits.swap(*usedHits);
+    for (Cube::HitSelection::iterator h = existingHits.begin();
+         h != existingHits.end(); ++h) {
+        AddUsed(*h,*usedHits);
+    }
     Cube::Handle<Cube::ReconObjectContainer> finalObjects
         = input->GetObjectContainer("final");
-    if (finalObjects) {
-        Cube::Handle<Cube::HitSelection> hits
-            = Cube::AllHitSelection(*finalObjects);
-        // The hits exist, so copy them into the usedHits.
-        if (hits) {
-            std::copy(hits->begin(), hits->end(),
-                      std::back_inserter(*usedHits));
-        }
-    }
+    if (finalObjects) AddUsed(*finalObjects,*usedHits);
 
-    // Make sure the used hits are unique.
-    Cube::HitSelection::iterator end
-        = std::unique(usedHits->begin(), usedHits->end());
-    usedHits->erase(end, usedHits->end());
-
-    // Build a selection that has all of the composite hits, as well as any
-    // simple hits that were used to build the composites, plus an simple hits
-    // that are directly in the used hits.
-    Cube::HitSelection everyLastHit;
-    std::copy(usedHits->begin(), usedHits->end(),
-              std::back_inserter(everyLastHit));
-
-    Cube::Handle<Cube::HitSelection> allTheSimpleHits
-        = Cube::SimpleHitSelection(everyLastHit);
-    std::copy(allTheSimpleHits->begin(), allTheSimpleHits->end(),
-              std::back_inserter(everyLastHit));
-
-    // Make sure the used hits are unique and sorted.
-    end = std::unique(everyLastHit.begin(), everyLastHit.end());
-    everyLastHit.erase(end, everyLastHit.end());
-    std::sort(everyLastHit.begin(),everyLastHit.end());
-
-    // Figure out which inputs hits are not used.
-    if (!fAllHits.empty()) {
-        // The input hits possibly a include mix of simple and composite hits.
-        for (Cube::HitSelection::iterator hit = fAllHits.begin();
-             hit != fAllHits.end(); ++hit) {
-            if (std::binary_search(
-                    everyLastHit.begin(),everyLastHit.end(),*hit)) {
-                continue;
-            }
-            unusedHits->push_back(*hit);
-        }
+    // Figure out which inputs hits are not used.  The input hits possibly
+    // include a mix of simple and composite hits.
+    for (std::size_t i = 0; i < fAllHits.size(); ++i) {
+        if (fStamp[fFirst[i]] == fGeneration) continue;
+        unusedHits->push_back(fAllHits[i]);
     }
 
     // Make sure the unused hits are unique.  They should be, but check
     // anyway.
-    end = std::unique(unusedHits->begin(), unusedHits->end());
+    Cube::HitSelection::iterator end
+        = std::unique(unusedHits->begin(), unusedHits->end());
     unusedHits->erase(end, unusedHits->end());
 
     Cube::HitSelection usedECal;
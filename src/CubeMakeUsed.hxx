@@ -7,6 +7,9 @@
 #include <CubeAlgorithm.hxx>
 #include <CubeHandle.hxx>
 
+#include <vector>
+#include <unordered_map>
+
 namespace Cube {
     class MakeUsed;
 }
@@ -31,13 +34,52 @@ public:
     /// Take the input AlgorithmResult, and build a "used" and "unused" hit
     /// selection out of the hits in "allHits".  The new hit selections are
     /// then added to the algorithm result and returned.  The input algorithm
-    /// is modified (and returned).
+    /// is modified (and returned).  The used hits are in the order they are
+    /// found in the final objects, and the unused hits are in the same
+    /// order as "allHits".
     Cube::Handle<Cube::AlgorithmResult>
     operator ()(Cube::Handle<Cube::AlgorithmResult> input);
 
 private:
+    /// Mark a hit in fAllHits as used in the current generation.  Hits that
+    /// aren't in fAllHits are ignored.
+    void Stamp(const Cube::Handle<Cube::Hit>& hit);
+
+    /// Mark a hit (and the simple hits used to build it) as used.
+    void MarkUsed(const Cube::Handle<Cube::Hit>& hit);
+
+    /// Mark the simple hits used to build a composite hit as used.
+    void MarkSimple(const Cube::Handle<Cube::Hit>& hit);
+
+    /// Add the hits for the objects (and their constituents) to the used
+    /// hits, and mark them.
+    void AddUsed(const Cube::ReconObjectContainer& objects,
+                 Cube::HitSelection& usedHits);
+
+    /// Add a hit to the used hits if it isn't already there, and mark it.
+    void AddUsed(const Cube::Handle<Cube::Hit>& hit,
+                 Cube::HitSelection& usedHits);
+
     /// All of the hits that might appear in the input algorithm.
     Cube::HitSelection fAllHits;
+
+    /// The position of each hit in fAllHits (the first copy).
+    std::unordered_map<const Cube::Hit*, std::size_t> fIndex;
+
+    /// The position of the first copy of each hit in fAllHits.
+    std::vector<std::size_t> fFirst;
+
+    /// The generation when each hit in fAllHits was last marked as used.  A
+    /// hit is used if the stamp matches the current generation, so nothing
+    /// needs to be cleared between calls.
+    std::vector<unsigned int> fStamp;
+
+    /// The generation for the current call.
+    unsigned int fGeneration;
+
+    /// The generation when a hit was added to the used selection.  This
+    /// covers every hit seen, including hits that aren't in fAllHits.
+    std::unordered_map<const Cube::Hit*, unsigned int> fSeen;
 };
 
 #endif
@@ -1,5 +1,5 @@
 #include "CubeMergeXTalk.hxx"
-#include "CubeTrackFit.hxx"
+#include "CubeTrackFitBatch.hxx"
 #include "CubeCreateTrack.hxx"
 #include "CubeMakeUsed.hxx"
 #include "CubeInfo.hxx"
@@ -16,11 +16,14 @@
 #include <vector>
 #include <map>
 #include <set>
+#include <unordered_map>
+#include <algorithm>
 #include <cmath>
 
 Cube::MergeXTalk::MergeXTalk()
     : Cube::Algorithm("MergeXTalk",
-                      "Merge candidate crosstalk with the tracks") {}
+                      "Merge candidate crosstalk with the tracks"),
+      fUseNeighborIndex(true) {}
 
 Cube::MergeXTalk::~MergeXTalk() {}
 
@@ -54,6 +57,96 @@ namespace {
     };
 }
 
+// A map from the integer cube coordinates (number, bar, and plane decoded
+// from the hit identifier) to the track hits in that cube.  Neighboring
+// cubes differ by at most one in each coordinate, so the possible
+// neighbors of a hit are in the 27 cubes around it.  Hits that aren't in a
+// 3DST cube are kept in a list that is always checked, and a hit that isn't
+// in a cube is checked against every track hit.  The candidates are
+// returned in the same order as allHits so that choices between equally
+// good neighbors don't change.
+class Cube::MergeXTalk::NeighborIndex {
+public:
+    typedef std::vector<AllHits::iterator> Candidates;
+
+    NeighborIndex(AllHits& allHits, bool useCubes)
+        : fAllHits(allHits), fUseCubes(useCubes) {
+        if (!fUseCubes) return;
+        for (AllHits::iterator h = fAllHits.begin();
+             h != fAllHits.end(); ++h) {
+            int n, b, p;
+            if (CubeCoordinates(h->first,n,b,p)) {
+                fCubes[CubeKey(n,b,p)].push_back(h);
+            }
+            else {
+                fOthers.push_back(h);
+            }
+        }
+    }
+
+    // Fill the track hits that might neighbor the hit.
+    void Find(Cube::Handle<Cube::Hit> hit, Candidates& candidates) const {
+        candidates.clear();
+        int n, b, p;
+        if (!fUseCubes || !CubeCoordinates(hit,n,b,p)) {
+            for (AllHits::iterator h = fAllHits.begin();
+                 h != fAllHits.end(); ++h) {
+                candidates.push_back(h);
+            }
+            return;
+        }
+        for (int i = n-1; i <= n+1; ++i) {
+            for (int j = b-1; j <= b+1; ++j) {
+                for (int k = p-1; k <= p+1; ++k) {
+                    if (i < 0 || j < 0 || k < 0) continue;
+                    std::unordered_map<int,Candidates>::const_iterator c
+                        = fCubes.find(CubeKey(i,j,k));
+                    if (c == fCubes.end()) continue;
+                    candidates.insert(candidates.end(),
+                                      c->second.begin(), c->second.end());
+                }
+            }
+        }
+        candidates.insert(candidates.end(), fOthers.begin(), fOthers.end());
+        std::sort(candidates.begin(), candidates.end(),
+                  AllHitsOrder(fAllHits));
+    }
+
+    AllHits::iterator End() const {return fAllHits.end();}
+
+private:
+    // Order iterators into allHits by the allHits key.
+    struct AllHitsOrder {
+        explicit AllHitsOrder(const AllHits& a) : fCompare(a.key_comp()) {}
+        bool operator ()(AllHits::iterator lhs, AllHits::iterator rhs) const {
+            return fCompare(lhs->first, rhs->first);
+        }
+        AllHits::key_compare fCompare;
+    };
+
+    // Get the cube coordinates for a hit.  This returns false if the hit
+    // isn't in a 3DST cube.
+    static bool CubeCoordinates(Cube::Handle<Cube::Hit> hit,
+                                int& n, int& b, int& p) {
+        int id = hit->GetIdentifier();
+        if (!Cube::Info::Is3DST(id)) return false;
+        n = Cube::Info::CubeNumber(id);
+        b = Cube::Info::CubeBar(id);
+        p = Cube::Info::CubePlane(id);
+        return (n >= 0 && b >= 0 && p >= 0);
+    }
+
+    // Each coordinate fits in 9 bits.
+    static int CubeKey(int n, int b, int p) {
+        return (n << 18) | (b << 9) | p;
+    }
+
+    AllHits& fAllHits;
+    bool fUseCubes;
+    std::unordered_map<int, Candidates> fCubes;
+    Candidates fOthers;
+};
+
 
 Cube::Handle<Cube::AlgorithmResult>
 Cube::MergeXTalk::Process(const Cube::AlgorithmResult& input,
@@ -115,12 +208,16 @@ Cube::MergeXTalk::Process(const Cube::AlgorithmResult& input,
         finalObjects->push_back(*t);
     }
 
+    // The track hits don't change while the clusters are merged (hits are
+    // only added to the node sets), so the neighbor index is built once.
+    NeighborIndex neighborIndex(allHits, fUseNeighborIndex);
+
     CUBE_LOG(3) << "xtalk :: Merge the clusters" << std::endl;
     // Check each cluster to see if it is consistent with a cluster made of
     // cross talk hits.
     for (ClusterList::iterator c = clusterList.begin();
          c != clusterList.end(); ++c) {
-        int neighbors = CountClusterNeighbors(allHits, *c);
+        int neighbors = CountClusterNeighbors(neighborIndex, *c);
         int nHits = (*c)->GetHitSelection()->size();
         // If a cluster has hits that are not neighboring a track, then assume
         // it is not made up of cross talk.  Notice that a cluster with cross
@@ -136,8 +233,9 @@ Cube::MergeXTalk::Process(const Cube::AlgorithmResult& input,
         Cube::Handle<Cube::HitSelection> hits = (*c)->GetHitSelection();
         for (Cube::HitSelection::iterator h = hits->begin();
              h != hits->end(); ++h) {
-            Cube::Handle<Cube::Hit> bestNeighbor = FindBestNeighbor(allHits,*h);
-            if (!bestNeighbor) {
+            AllHits::iterator bestNeighbor
+                = FindBestNeighbor(neighborIndex,*h);
+            if (bestNeighbor == allHits.end()) {
                 CUBE_ERROR << "No neighbor, but there should be one."
                            << std::endl;
                 continue;
@@ -145,8 +243,8 @@ Cube::MergeXTalk::Process(const Cube::AlgorithmResult& input,
             // Add the current hit to all of the tracks that include
             // the bestNeighbor.
             for (std::set<NodeHits>::iterator s
-                     = allHits[bestNeighbor].begin();
-                 s != allHits[bestNeighbor].end(); ++s) {
+                     = bestNeighbor->second.begin();
+                 s != bestNeighbor->second.end(); ++s) {
                 (*s)->insert(*h);
             }
         }
@@ -158,7 +256,7 @@ Cube::MergeXTalk::Process(const Cube::AlgorithmResult& input,
     // Build the new tracks from the allTracks vector and add them to
     // finalObjects.  Keep track of all of the hits in the tracks.
     HitSet trackHits;
-    Cube::TrackFit fitter;
+    Cube::TrackFitBatch::TrackVector newTracks;
     for (AllTracks::iterator t = allTracks.begin();
          t != allTracks.end(); ++t) {
         // Build the clusters for the nodes.
@@ -175,10 +273,14 @@ Cube::MergeXTalk::Process(const Cube::AlgorithmResult& input,
         Cube::Handle<Cube::ReconTrack> track
             = Cube::CreateTrackFromClusters(
                 "xtalk",clusters.begin(), clusters.end());
-        // Fit the track
-        track = fitter(track);
-        // Add to finalObjects
-        finalObjects->push_back(track);
+        newTracks.push_back(track);
+    }
+
+    // Fit the new tracks as a batch, and add them to finalObjects.
+    Cube::TrackFitBatch fitBatch;
+    Cube::TrackFitBatch::TrackVector fitted = fitBatch(newTracks);
+    for (std::size_t i = 0; i < fitted.size(); ++i) {
+        finalObjects->push_back(fitted[i]);
     }
 
 
@@ -221,12 +323,15 @@ Cube::MergeXTalk::Process(const Cube::AlgorithmResult& input,
 }
 
 // Count the number of cubes in allHits that are neighboring to hit.
-int Cube::MergeXTalk::CountHitNeighbors(AllHits& allHits,
+int Cube::MergeXTalk::CountHitNeighbors(const NeighborIndex& neighbors,
                                         Cube::Handle<Cube::Hit>& hit) {
     CubeProximity proximity;
     int neighborHits = 0;
-    for (AllHits::iterator h = allHits.begin(); h != allHits.end(); ++h) {
-        Cube::Handle<Cube::Hit> trackHit = h->first;
+    NeighborIndex::Candidates candidates;
+    neighbors.Find(hit,candidates);
+    for (NeighborIndex::Candidates::iterator h = candidates.begin();
+         h != candidates.end(); ++h) {
+        Cube::Handle<Cube::Hit> trackHit = (*h)->first;
         double diff = proximity(trackHit,hit);
         // Only hits that are direct neighbors are considered.  This assumes
         // that the hit sizes are all larger than one mm.
@@ -237,32 +342,37 @@ int Cube::MergeXTalk::CountHitNeighbors(AllHits& allHits,
 
 // Count the number of cubes in a cluster that have a neighbor.
 int Cube::MergeXTalk::CountClusterNeighbors(
-    AllHits& allHits,
+    const NeighborIndex& neighbors,
     Cube::Handle<Cube::ReconCluster>& cluster) {
     Cube::Handle<Cube::HitSelection> hits = cluster->GetHitSelection();
     int clusterNeighbors = 0;
     for (Cube::HitSelection::iterator h = hits->begin();
          h != hits->end(); ++h) {
-        int hitNeighbors = CountHitNeighbors(allHits,*h);
+        int hitNeighbors = CountHitNeighbors(neighbors,*h);
         if (hitNeighbors>0) ++clusterNeighbors;
     }
     return clusterNeighbors;
 }
 
-Cube::Handle<Cube::Hit> Cube::MergeXTalk::FindBestNeighbor(
-    AllHits& allHits, Cube::Handle<Cube::Hit>& hit) {
+Cube::MergeXTalk::AllHits::iterator Cube::MergeXTalk::FindBestNeighbor(
+    const NeighborIndex& neighbors, Cube::Handle<Cube::Hit>& hit) {
     CubeProximity proximity;
+    AllHits::iterator bestEntry = neighbors.End();
     Cube::Handle<Cube::Hit> bestHit;
-    for (AllHits::iterator h = allHits.begin(); h != allHits.end(); ++h) {
-        Cube::Handle<Cube::Hit> trackHit = h->first;
+    NeighborIndex::Candidates candidates;
+    neighbors.Find(hit,candidates);
+    for (NeighborIndex::Candidates::iterator h = candidates.begin();
+         h != candidates.end(); ++h) {
+        Cube::Handle<Cube::Hit> trackHit = (*h)->first;
         // If hit and trackHit are the same, it's the best hit.
-        if (trackHit == hit) return trackHit;
+        if (trackHit == hit) return *h;
         double dist = proximity(trackHit,hit);
         if (dist > 1.0) continue;
         // The hits are neighbors, and haven't found another neighbor yet, so
         // tkat this one.
         if (!bestHit) {
             bestHit = trackHit;
+            bestEntry = *h;
             continue;
         }
         // Accept the closest neighbor first.  This favors hits in the same
@@ -271,16 +381,18 @@ Cube::Handle<Cube::Hit> Cube::MergeXTalk::FindBestNeighbor(
         TVector3 bestDist = hit->GetPosition() - bestHit->GetPosition();
         if (trackDist.Mag() < bestDist.Mag()) {
             bestHit = trackHit;
+            bestEntry = *h;
             continue;
         }
         // The two candidate neighbors are at the same distance, so take the
         // one with the biggest charge.
         if (bestHit->GetCharge() < trackHit->GetCharge()) {
             bestHit = trackHit;
+            bestEntry = *h;
             continue;
         }
     }
-    return bestHit;
+    return bestEntry;
 }
 
 // Local Variables:
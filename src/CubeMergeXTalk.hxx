@@ -7,6 +7,8 @@
 #include <CubeHit.hxx>
 #include <CubeReconCluster.hxx>
 
+#include "CubeCompareStableIds.hxx"
+
 #include <memory>
 #include <vector>
 #include <map>
@@ -25,8 +27,10 @@ class Cube::MergeXTalk
     : public Cube::Algorithm {
 public:
 
-    // A vector of sets of hits associated with each node of a track.
-    typedef std::set<Cube::Handle<Cube::Hit>> HitSet;
+    // A vector of sets of hits associated with each node of a track.  The
+    // hits are ordered by the stable hit identifier so the order doesn't
+    // depend on where the hits are in memory.
+    typedef std::set<Cube::Handle<Cube::Hit>,Cube::CompareStableIds> HitSet;
     // A shared pointer for the set of hits in a node.
     typedef std::shared_ptr<HitSet> NodeHits;
     // All the nodes for one track.
@@ -35,7 +39,8 @@ public:
     typedef std::vector< TrackNodeHits > AllTracks;
     // A map from a hit to all of the Nodes that contain the hit.  A hit can
     // be in two or more nodes when tracks overlap (e.g. at a vertex).
-    typedef std::map<Cube::Handle<Cube::Hit>, std::set<NodeHits> > AllHits;
+    typedef std::map<Cube::Handle<Cube::Hit>, std::set<NodeHits>,
+                     Cube::CompareStableIds> AllHits;
 
     MergeXTalk();
     virtual ~MergeXTalk();
@@ -46,20 +51,33 @@ public:
             const Cube::AlgorithmResult& in1 = Cube::AlgorithmResult::Empty,
             const Cube::AlgorithmResult& in2 = Cube::AlgorithmResult::Empty);
 
+    /// Set if the neighboring hits should be found using a map of the cube
+    /// coordinates (the default is true).  When this is false, every track
+    /// hit is checked.  The result is the same either way.
+    void SetUseNeighborIndex(bool v) {fUseNeighborIndex = v;}
+
 private:
 
+    // Find the track hits that might neighbor a hit.  This is defined in
+    // the implementation file.
+    class NeighborIndex;
+
     // Count the number of cubes in allHits that are neighboring to hit.
-    int CountHitNeighbors(AllHits& allHits, Cube::Handle<Cube::Hit>& hit);
+    int CountHitNeighbors(const NeighborIndex& neighbors,
+                          Cube::Handle<Cube::Hit>& hit);
 
     // Count the number of cubes in a cluster that have a neighbor.
-    int CountClusterNeighbors(AllHits& allHits,
+    int CountClusterNeighbors(const NeighborIndex& neighbors,
                               Cube::Handle<Cube::ReconCluster>& cluster);
 
-    // Find the best neighboring hit to be cross talk.
-    Cube::Handle<Cube::Hit> FindBestNeighbor(AllHits& allHits,
-                                             Cube::Handle<Cube::Hit>& hit);
-
+    // Find the best neighboring hit to be cross talk.  This returns the
+    // entry in allHits for the neighbor (so the nodes containing the
+    // neighbor are available), or allHits.end() if there isn't a neighbor.
+    AllHits::iterator FindBestNeighbor(const NeighborIndex& neighbors,
+                                       Cube::Handle<Cube::Hit>& hit);
 
+    // A flag that the neighbor index should use the cube coordinates.
+    bool fUseNeighborIndex;
 };
 #endif
 
@@ -0,0 +1,115 @@
+#include "CubeNodeTimeFit.hxx"
+
+#include <CubeTrackState.hxx>
+#include <CubeUnits.hxx>
+
+#include <TLorentzVector.h>
+#include <TVector3.h>
+
+#include <cmath>
+
+Cube::NodeTimeFit::NodeTimeFit()
+    : fPenalty(4.0), fInvBeta(0.0), fT0(0.0), fT0Var(0.0) {
+    Clear();
+}
+
+bool Cube::NodeTimeFit::Solve() {
+    if (!(fS > 0.0)) return false;
+    double xx = fXX;
+    double det = fS*xx - fX*fX;
+    double invBeta = (det > 0.0) ? (fS*fXY - fX*fY)/det : 0.0;
+    if (invBeta > 0.0) {
+        xx += fPenalty;
+        det = fS*xx - fX*fX;
+    }
+    if (!(det > 0.0)) {
+        // All of the nodes are at the same distance.
+        fInvBeta = 0.0;
+        fT0 = fY/fS;
+        fT0Var = 1.0/fS;
+        return true;
+    }
+    fInvBeta = (fS*fXY - fX*fY)/det;
+    fT0 = (xx*fY - fX*fXY)/det;
+    fT0Var = xx/det;
+    return true;
+}
+
+void Cube::NodeTravel(const Cube::ReconNodeContainer& nodes,
+                      std::vector<double>& travel) {
+    // The speed of light.
+    const double ccc = (30.0*unit::cm)/(1.0*unit::ns);
+    travel.resize(nodes.size());
+    if (travel.empty()) return;
+    double totalDist = 0.0;
+    for (int i = 0; i < (int) nodes.size(); ++i) {
+        if (i > 0) {
+            Cube::Handle<Cube::TrackState> state1 = nodes[i]->GetState();
+            Cube::Handle<Cube::TrackState> state0 = nodes[i-1]->GetState();
+            TVector3 diff
+                = state1->GetPosition().Vect()-state0->GetPosition().Vect();
+            TVector3 dir = state1->GetDirection() + state0->GetDirection();
+            totalDist += diff*dir.Unit();
+        }
+        travel[i] = totalDist;
+    }
+    double offsetDist = travel[travel.size()/2];
+    for (int i = 0; i < (int) travel.size(); ++i) {
+        travel[i] = (travel[i] - offsetDist)/ccc;
+    }
+}
+
+double Cube::FitNodeTimes(Cube::ReconNodeContainer& nodes,
+                          const Cube::TrackMeasurements& measurements,
+                          double huberCut) {
+    std::vector<double> travel;
+    NodeTravel(nodes,travel);
+    std::vector<double> times(nodes.size());
+    std::vector<double> weights(nodes.size());
+    for (int i = 0; i < (int) nodes.size(); ++i) {
+        times[i] = measurements[i].GetPosition(3);
+        weights[i] = 1.0/measurements[i].GetVariance(3);
+    }
+
+    Cube::NodeTimeFit timeFit;
+    for (int i = 0; i < (int) nodes.size(); ++i) {
+        timeFit.Add(travel[i],times[i],weights[i]);
+    }
+    if (!timeFit.Solve()) return 0.0;
+
+    // Reweight the nodes until the fit stops changing.  This is only done
+    // when the robust fit is requested.
+    const int maxIterations = 20;
+    for (int iter = 0; huberCut > 0.0 && iter < maxIterations; ++iter) {
+        double lastInvBeta = timeFit.GetInvBeta();
+        double lastT0 = timeFit.GetT0();
+        timeFit.Clear();
+        for (int i = 0; i < (int) nodes.size(); ++i) {
+            double pull = (times[i] - timeFit.Time(travel[i]))
+                *std::sqrt(weights[i]);
+            double w = weights[i];
+            if (std::abs(pull) > huberCut) w *= huberCut/std::abs(pull);
+            timeFit.Add(travel[i],times[i],w);
+        }
+        if (!timeFit.Solve()) return 0.0;
+        if (std::abs(timeFit.GetT0() - lastT0) < 1E-6*unit::ns
+            && std::abs(timeFit.GetInvBeta() - lastInvBeta) < 1E-6) break;
+    }
+
+    // Set the node times.  Done this way because the position is returned
+    // by value (intentionally).
+    for (int i = 0; i < (int) nodes.size(); ++i) {
+        Cube::Handle<Cube::TrackState> state = nodes[i]->GetState();
+        TLorentzVector pos = state->GetPosition();
+        pos.SetT(timeFit.Time(travel[i]));
+        state->SetPosition(pos);
+    }
+
+    return std::sqrt(timeFit.GetT0Variance());
+}
+
+// Local Variables:
+// mode:c++
+// c-basic-offset:4
+// compile-command:"$(git rev-parse --show-toplevel)/build/cube-build.sh force"
+// End:
@@ -0,0 +1,99 @@
+#ifndef CubeNodeTimeFit_hxx_seen
+#define CubeNodeTimeFit_hxx_seen
+
+#include <CubeReconNode.hxx>
+#include <CubeTrackMeasurements.hxx>
+
+#include <vector>
+
+namespace Cube {
+    class NodeTimeFit;
+
+    /// Find the distance traveled along the track to each node (divided by
+    /// the speed of light so it has units of time).  The zero is put at the
+    /// middle node to reduce the correlation between the slope and offset.
+    void NodeTravel(const Cube::ReconNodeContainer& nodes,
+                    std::vector<double>& travel);
+
+    /// Fit the node times to a line as a function of the distance traveled
+    /// along the track, and fill the node state times with the result.  By
+    /// default this is the plain weighted least squares fit.  If huberCut is
+    /// positive, the nodes with residuals larger than huberCut standard
+    /// deviations are iteratively deweighted (a Huber loss).  This returns
+    /// the uncertainty on the time offset.
+    double FitNodeTimes(Cube::ReconNodeContainer& nodes,
+                        const Cube::TrackMeasurements& measurements,
+                        double huberCut = 0.0);
+};
+
+/// Fit times to the line "t = invBeta*x + t0" where x is the distance
+/// traveled along the track divided by the speed of light.  Superluminal
+/// velocities are allowed so that the timing resolution can be handled, but
+/// positive inverse velocities get a quadratic penalty (the same penalty
+/// that was used in the Minuit fit this replaces).  This is a linear least
+/// squares problem with an exact solution, so the weighted sums are
+/// accumulated one measurement at a time with Add(), and then Solve() finds
+/// the parameters (and the T0 uncertainty) from the sums.
+class Cube::NodeTimeFit {
+public:
+    NodeTimeFit();
+
+    /// Remove all of the measurements.
+    void Clear() {fS = fX = fY = fXX = fXY = 0.0;}
+
+    /// Add a measurement with an expected time of "invBeta*x + t0".  The
+    /// weight is usually one over the time variance.
+    void Add(double x, double t, double w) {
+        fS += w;
+        fX += w*x;
+        fY += w*t;
+        fXX += w*x*x;
+        fXY += w*x*t;
+    }
+
+    /// Solve for the best fit parameters.  This returns false if there
+    /// isn't a solution.
+    bool Solve();
+
+    /// The expected time at a distance.
+    double Time(double x) const {return fInvBeta*x + fT0;}
+
+    /// Set the penalty for positive inverse velocities.  The penalty added
+    /// to the chi-squared is "penalty*invBeta^2".
+    void SetPenalty(double p) {fPenalty = p;}
+
+    /// Get the penalty for positive inverse velocities.
+    double GetPenalty() const {return fPenalty;}
+
+    /// Get the fitted inverse velocity.
+    double GetInvBeta() const {return fInvBeta;}
+
+    /// Get the fitted time offset.
+    double GetT0() const {return fT0;}
+
+    /// Get the variance of the fitted time offset.
+    double GetT0Variance() const {return fT0Var;}
+
+private:
+    // The weighted sums.
+    double fS;
+    double fX;
+    double fY;
+    double fXX;
+    double fXY;
+
+    // The penalty for positive values of the inverse velocity.
+    double fPenalty;
+
+    // The fit results.
+    double fInvBeta;
+    double fT0;
+    double fT0Var;
+};
+#endif
+
+// Local Variables:
+// mode:c++
+// c-basic-offset:4
+// compile-command:"$(git rev-parse --show-toplevel)/build/cube-build.sh force"
+// End:
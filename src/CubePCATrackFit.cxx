@@ -1,4 +1,5 @@
 #include "CubePCATrackFit.hxx"
+#include "CubeTrackMeasurements.hxx"
 
 #include <CubeReconNode.hxx>
 #include <CubeReconCluster.hxx>
@@ -48,24 +49,26 @@ Cube::PCATrackFit::Apply(Cube::Handle<Cube::ReconTrack>& input) {
     /// Fill the PCA using the node object positions.  This also makes a very
     /// crude estimate of the position covariance.
     /////////////////////////////////////////////////////////////////////
+    // Get the measurements from the node objects.  They had better be
+    // clusters.
+    Cube::TrackMeasurements measurements;
+    if (!measurements.Fill(nodes)) return Cube::Handle<Cube::ReconTrack>();
+
     std::unique_ptr<TPrincipal> pca(new TPrincipal(3,""));
     TMatrixD posCov(3,3);
-    for (Cube::ReconNodeContainer::iterator n = nodes.begin();
-         n != nodes.end(); ++n) {
-        // Get the object from the node.  It had better be a cluster.
-        Cube::Handle<Cube::ReconCluster> cluster = (*n)->GetObject();
-        if (!cluster) {
-            CUBE_ERROR << "Missing cluster in track" << std::endl;
-            return Cube::Handle<Cube::ReconTrack>();
-        }
-        double row1[3] = {cluster->GetPosition().X(),
-                          cluster->GetPosition().Y(),
-                          cluster->GetPosition().Z()};
-        for (double q = cluster->GetEDeposit(); q > 0; q -= 1) {
+    for (Cube::TrackMeasurements::const_iterator m = measurements.begin();
+         m != measurements.end(); ++m) {
+        double row1[3] = {m->GetPosition(0),
+                          m->GetPosition(1),
+                          m->GetPosition(2)};
+        for (double q = m->GetEDeposit(); q > 0; q -= 1) {
             pca->AddRow(row1);
         }
 
-        Cube::ReconCluster::MomentMatrix moments = cluster->GetMoments();
+        Cube::ReconCluster::MomentMatrix moments(3);
+        for (int i=0; i<3; ++i) {
+            for (int j=0; j<3; ++j) moments(i,j) = m->GetMoment(i,j);
+        }
         moments.InvertFast();
         posCov += moments;
     }
@@ -79,14 +82,15 @@ Cube::PCATrackFit::Apply(Cube::Handle<Cube::ReconTrack>& input) {
 
     /// Find the front and last positions of the track by projecting using the
     /// PCA.
-    Cube::Handle<Cube::ReconCluster> frontCluster = nodes.front()->GetObject();
+    const Cube::TrackMeasurement& frontMeas = measurements[0];
     double frontPrincipal
-        = FindPrincipal(*pca, frontCluster->GetPosition().Vect());
+        = FindPrincipal(*pca, frontMeas.GetSpatialPosition());
     TVector3 frontPosition = FindPosition(*pca,frontPrincipal);
 
-    Cube::Handle<Cube::ReconCluster> backCluster = nodes.back()->GetObject();
+    const Cube::TrackMeasurement& backMeas
+        = measurements[measurements.size()-1];
     double backPrincipal
-        = FindPrincipal(*pca, backCluster->GetPosition().Vect());
+        = FindPrincipal(*pca, backMeas.GetSpatialPosition());
     TVector3 backPosition = FindPosition(*pca,backPrincipal);
 
     // The track direction is just the direction between the front and back
@@ -94,12 +98,9 @@ Cube::PCATrackFit::Apply(Cube::Handle<Cube::ReconTrack>& input) {
     TVector3 dir = (backPosition-frontPosition).Unit();
     TMatrixD dirCov(3,3);
     double length2 = (backPosition-frontPosition).Mag2();
-    Cube::Handle<Cube::ClusterState> frontState = frontCluster->GetState();
-    Cube::Handle<Cube::ClusterState> backState = backCluster->GetState();
     for (int i=0; i<3; ++i) {
         for (int j=0; j<3; ++j) {
-            double v = frontCluster->GetMoments()(i,j)
-                + backCluster->GetMoments()(i,j);
+            double v = frontMeas.GetMoment(i,j) + backMeas.GetMoment(i,j);
             v = v/length2;
             dirCov(i,j) = v;
         }
@@ -111,36 +112,34 @@ Cube::PCATrackFit::Apply(Cube::Handle<Cube::ReconTrack>& input) {
     double logLikelihood = 0.0;
     double energyDeposit = 0.0;
     double energyVariance = 0.0;
-    for (Cube::ReconNodeContainer::iterator n = nodes.begin();
-         n != nodes.end(); ++n) {
+    for (std::size_t n = 0; n < nodes.size(); ++n) {
         // Get the state to be filled from the node.  It had better be a
         // trackState!.
-        Cube::Handle<Cube::TrackState> trackState = (*n)->GetState();
+        Cube::Handle<Cube::TrackState> trackState = nodes[n]->GetState();
 
-        // Get the object from the node.  It had better be a cluster.
-        Cube::Handle<Cube::ReconCluster> cluster = (*n)->GetObject();
-        Cube::Handle<Cube::ClusterState> clusterState = cluster->GetState();
+        // Get the measurement from the node object.
+        const Cube::TrackMeasurement& meas = measurements[n];
 
         // Find the position for this node.
         double nodePrincipal
-            = FindPrincipal(*pca, clusterState->GetPosition().Vect());
+            = FindPrincipal(*pca, meas.GetSpatialPosition());
         TVector3 nodePosition = FindPosition(*pca,nodePrincipal);
 
         // Sum the track energy deposit and variance so that we can fill the
         // track state later.
-        energyDeposit += clusterState->GetEDeposit();
-        energyVariance += clusterState->GetEDepositVariance();
+        energyDeposit += meas.GetEDeposit();
+        energyVariance += meas.GetEDepositVariance();
 
         // Set the track state using the estimated node position and direction
-        trackState->SetEDeposit(clusterState->GetEDeposit());
+        trackState->SetEDeposit(meas.GetEDeposit());
         trackState->SetPosition(nodePosition.X(),
                                 nodePosition.Y(),
                                 nodePosition.Z(),
-                                clusterState->GetPosition().T());
+                                meas.GetPosition(3));
         trackState->SetDirection(dir.X(),dir.Y(),dir.Z());
 
         // Set the track state covariances.
-        trackState->SetEDepositVariance(clusterState->GetEDepositVariance());
+        trackState->SetEDepositVariance(meas.GetEDepositVariance());
         for (int i=0; i<3; ++i) {
             for (int j=0; j<3; ++j) {
                 double v = posCov(i,j);
@@ -152,10 +151,9 @@ Cube::PCATrackFit::Apply(Cube::Handle<Cube::ReconTrack>& input) {
 
         // Calculate the goodness.  This depends on the idea that the cluster
         // covariance is always diagonal.
-        TVector3 nodeDiff = nodePosition - cluster->GetPosition().Vect();
+        TVector3 nodeDiff = nodePosition - meas.GetSpatialPosition();
         for (int i=0; i<3; ++i) {
-            logLikelihood +=
-                nodeDiff[i]*nodeDiff[i]/cluster->GetPositionVariance()[i];
+            logLikelihood += nodeDiff[i]*nodeDiff[i]/meas.GetVariance(i);
         }
     }
 
@@ -5,15 +5,19 @@
 #include "CubeMakeUsed.hxx"
 #include "CubeClusterManagement.hxx"
 #include "CubeCompareReconObjects.hxx"
+#include "CubeSortByKey.hxx"
 
 #include <CubeLog.hxx>
 #include <CubeInfo.hxx>
 #include <CubeHandle.hxx>
 #include <CubeReconCluster.hxx>
 #include <CubeAlgorithmResult.hxx>
+#include <CubeAlgorithmTrace.hxx>
+#include <CubeAlgorithmSummary.hxx>
 
 #include <sstream>
 #include <iomanip>
+#include <iterator>
 
 Cube::Recon::Recon(): Cube::Algorithm("CubeRecon") {
     fOversizeCut = 20000;
@@ -70,6 +74,7 @@ Cube::Recon::Process(const Cube::AlgorithmResult& input,
             CUBE_ERROR << "Skip oversize slice with "
                        << hits->size() << " hits"
                        << std::endl;
+            Cube::AlgorithmSummary::AddOversizeSlice(hits->size());
             Cube::Handle<Cube::ReconCluster> cluster
                 = Cube::CreateCluster("cubeReconLarge",
                                       hits->begin(), hits->end());
@@ -81,6 +86,8 @@ Cube::Recon::Process(const Cube::AlgorithmResult& input,
         // translated into a AlgorithmResult.
         Cube::HitSelection local("cubes");
         std::copy(hits->begin(), hits->end(), std::back_inserter(local));
+        Cube::AlgorithmTrace::SliceScope sliceTrace(
+            std::distance(slices->begin(),object));
         Cube::Handle<Cube::AlgorithmResult>
             treeRecon = Run<Cube::TreeRecon>(local);
         if (!treeRecon) {
@@ -102,8 +109,8 @@ Cube::Recon::Process(const Cube::AlgorithmResult& input,
         }
     }
 
-    std::sort(finalObjects->begin(), finalObjects->end(),
-              Cube::CompareReconObjects());
+    Cube::SortByKey(finalObjects->begin(), finalObjects->end(),
+                    Cube::ReconObjectSortKey());
 
     // Save the final objects last.
     result->AddObjectContainer(finalObjects);
@@ -162,7 +162,7 @@ void Cube::ShareCharge::FillAugmented(const Cube::HitSelection& hits3D) {
     fAugmentedDeposits.clear();
 
     // Extract the simple hits from all of the input composite Hits.
-    std::set<Cube::Handle<Cube::Hit>> fiberHits;
+    std::set<Cube::Handle<Cube::Hit>,Cube::CompareStableIds> fiberHits;
     for (Cube::HitSelection::const_iterator hit = hits3D.begin();
          hit != hits3D.end(); ++hit) {
         if ((*hit)->GetConstituentCount() < 3) {
@@ -181,10 +181,10 @@ void Cube::ShareCharge::FillAugmented(const Cube::HitSelection& hits3D) {
     }
 
     // Create the augmented fibers.
-    for (std::set<Cube::Handle<Cube::Hit>>::iterator fiber = fiberHits.begin();
+    for (std::set<Cube::Handle<Cube::Hit>,
+             Cube::CompareStableIds>::iterator fiber = fiberHits.begin();
          fiber != fiberHits.end(); ++fiber) {
-        std::map<Cube::Handle<Cube::Hit>,
-                 std::shared_ptr<AugmentedFiber>>::iterator
+        AugmentedFiberMap::iterator
             fiberCheck = fAugmentedFibers.find((*fiber));
         if (fiberCheck != fAugmentedFibers.end()) {
             CUBE_ERROR << "Fiber already added to augmented fibers"
@@ -216,8 +216,7 @@ void Cube::ShareCharge::FillAugmented(const Cube::HitSelection& hits3D) {
             newDeposit->Cube = newCube;
             newDeposit->Cube.lock()->Deposits.push_back(newDeposit);
             newDeposit->Attenuation = Attenuation(fiber,dist);
-            std::map<Cube::Handle<Cube::Hit>,
-                     std::shared_ptr<AugmentedFiber>>::iterator
+            AugmentedFiberMap::iterator
                 fiberCheck = fAugmentedFibers.find(fiber);
             if (fiberCheck == fAugmentedFibers.end()) throw;
             newDeposit->Fiber = fiberCheck->second;
@@ -239,8 +238,7 @@ void Cube::ShareCharge::FillAugmented(const Cube::HitSelection& hits3D) {
 
     // Check the number of fibers with overlaps.
     int overlaps = 0;
-    for (std::map<Cube::Handle<Cube::Hit>,
-             std::shared_ptr<AugmentedFiber>>::iterator f
+    for (AugmentedFiberMap::iterator f
              = fAugmentedFibers.begin();
          f !=  fAugmentedFibers.end(); ++f) {
         if (f->second->IsSharedFiber()) ++overlaps;
@@ -267,8 +265,7 @@ double Cube::ShareCharge::GetTotalDeposit() {
 
 double Cube::ShareCharge::GetTotalCharge() {
     double totalCharge = 0.0;
-    for (std::map<Cube::Handle<Cube::Hit>,
-             std::shared_ptr<AugmentedFiber>>::iterator f
+    for (AugmentedFiberMap::iterator f
              = fAugmentedFibers.begin();
          f != fAugmentedFibers.end(); ++f) {
         totalCharge += f->second->GetMeasurement();
@@ -278,8 +275,7 @@ double Cube::ShareCharge::GetTotalCharge() {
 
 double Cube::ShareCharge::GetExpectedTotalCharge() {
     double totalCharge = 0.0;
-    for (std::map<Cube::Handle<Cube::Hit>,
-             std::shared_ptr<AugmentedFiber>>::iterator f
+    for (AugmentedFiberMap::iterator f
              = fAugmentedFibers.begin();
          f != fAugmentedFibers.end(); ++f) {
         totalCharge += f->second->GetExpectedMeasurement();
@@ -345,8 +341,7 @@ double Cube::ShareCharge::GetFastEntropyDerivative(double d,
 
 double Cube::ShareCharge::GetFiberChi2() {
     double chi2 = 0.0;
-    for (std::map<Cube::Handle<Cube::Hit>,
-             std::shared_ptr<AugmentedFiber>>::iterator f
+    for (AugmentedFiberMap::iterator f
              = fAugmentedFibers.begin();
          f != fAugmentedFibers.end(); ++f) {
         double m = f->second->GetMeasurement();
@@ -22,6 +22,7 @@
 /////////////////////////////////////////////////////////////////////
 #include <CubeHitSelection.hxx>
 #include <CubeHit.hxx>
+#include <CubeCompareStableIds.hxx>
 
 #include <memory>
 #include <vector>
@@ -41,8 +42,12 @@ private:
     // won't work!
     std::vector<std::shared_ptr<AugmentedCube>> fAugmentedCubes;
     std::vector<std::shared_ptr<AugmentedDeposit>> fAugmentedDeposits;
-    std::map<Cube::Handle<Cube::Hit>,
-             std::shared_ptr<AugmentedFiber>> fAugmentedFibers;
+    // The fibers are ordered by the stable hit identifier, so the order
+    // doesn't depend on where the hits are in memory.
+    typedef std::map<Cube::Handle<Cube::Hit>,
+                     std::shared_ptr<AugmentedFiber>,
+                     Cube::CompareStableIds> AugmentedFiberMap;
+    AugmentedFiberMap fAugmentedFibers;
 
     // An object to keep track of the energy deposited in each cube.  The
     // deposited energy is then split equally between the fibers that are
@@ -0,0 +1,177 @@
+#ifndef CubeSortByKey_hxx_seen
+#define CubeSortByKey_hxx_seen
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <iterator>
+#include <type_traits>
+#include <cstring>
+#include <cstddef>
+#include <stdint.h>
+
+namespace Cube {
+    /// Sort a range by a key that is extracted from each element.  The key
+    /// is found once for each element (instead of twice for each
+    /// comparison), and the (key, index) pairs are sorted in a contiguous
+    /// array.  The elements are then put into the sorted order with one copy
+    /// of each element.  The key function is a functor taking an element and
+    /// returning a key that can be compared with operator<.
+    ///
+    /// \code
+    /// struct HitTime {
+    ///     double operator () (const Cube::Handle<Cube::Hit>& hit) const {
+    ///         return hit->GetTime();
+    ///     }
+    /// };
+    /// Cube::SortByKey(hits.begin(), hits.end(), HitTime());
+    /// \endcode
+    ///
+    /// The sort is stable, so elements with equal keys stay in the input
+    /// order.  Arithmetic keys (int, double, ...) are sorted with a radix
+    /// sort, and other keys are sorted with std::sort.
+    template <typename RandomIt, typename KeyFunction>
+    void SortByKey(RandomIt begin, RandomIt end, KeyFunction key);
+
+    namespace SortByKeyDetail {
+        /// Turn an arithmetic key into an unsigned integer with the same
+        /// order.
+        template <typename Key>
+        uint64_t RadixKey(Key key, std::true_type /* is_floating_point */) {
+            double value = key;
+            // Make negative zero the same as zero.
+            value += 0.0;
+            uint64_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            if (bits & 0x8000000000000000ULL) return ~bits;
+            return bits | 0x8000000000000000ULL;
+        }
+
+        template <typename Key>
+        uint64_t RadixKey(Key key, std::false_type /* is_floating_point */) {
+            if (std::is_signed<Key>::value) {
+                return static_cast<uint64_t>(static_cast<int64_t>(key))
+                    ^ 0x8000000000000000ULL;
+            }
+            return static_cast<uint64_t>(key);
+        }
+
+        /// Sort (key, index) pairs with a least significant digit radix
+        /// sort.  Bytes that are the same for every key are skipped, so keys
+        /// that only span a narrow range only take a few passes.
+        inline void RadixSort(
+            std::vector< std::pair<uint64_t,std::size_t> >& keys) {
+            std::vector< std::pair<uint64_t,std::size_t> > buffer(keys.size());
+            std::size_t counts[8][256];
+            std::memset(counts, 0, sizeof(counts));
+            for (std::size_t i = 0; i < keys.size(); ++i) {
+                uint64_t k = keys[i].first;
+                for (int b = 0; b < 8; ++b) {
+                    ++counts[b][(k >> (8*b)) & 0xFF];
+                }
+            }
+            for (int b = 0; b < 8; ++b) {
+                // Skip a byte that is the same for every key.
+                std::size_t digit = (keys[0].first >> (8*b)) & 0xFF;
+                if (counts[b][digit] == keys.size()) continue;
+                std::size_t offset = 0;
+                for (int d = 0; d < 256; ++d) {
+                    std::size_t c = counts[b][d];
+                    counts[b][d] = offset;
+                    offset += c;
+                }
+                for (std::size_t i = 0; i < keys.size(); ++i) {
+                    std::size_t d = (keys[i].first >> (8*b)) & 0xFF;
+                    buffer[counts[b][d]++] = keys[i];
+                }
+                keys.swap(buffer);
+            }
+        }
+
+        /// Below this size std::sort is faster than the radix sort.
+        const std::size_t kRadixMinimum = 256;
+
+        /// Find the sorted order for an arithmetic key.
+        template <typename RandomIt, typename KeyFunction>
+        void SortedOrder(RandomIt begin, RandomIt end, KeyFunction& key,
+                         std::vector<std::size_t>& order,
+                         std::true_type /* is_arithmetic */) {
+            typedef typename std::decay<decltype(key(*begin))>::type Key;
+            std::vector< std::pair<uint64_t,std::size_t> > keys;
+            keys.reserve(end - begin);
+            for (RandomIt i = begin; i != end; ++i) {
+                keys.push_back(
+                    std::make_pair(
+                        RadixKey<Key>(key(*i),
+                                      std::is_floating_point<Key>()),
+                        keys.size()));
+            }
+            if (keys.size() < kRadixMinimum) {
+                std::sort(keys.begin(), keys.end());
+            }
+            else {
+                RadixSort(keys);
+            }
+            order.resize(keys.size());
+            for (std::size_t i = 0; i < keys.size(); ++i) {
+                order[i] = keys[i].second;
+            }
+        }
+
+        /// Order (key, index) pairs by the key, and then the index.
+        template <typename Key>
+        struct CompareKeys {
+            bool operator () (const std::pair<Key,std::size_t>& lhs,
+                              const std::pair<Key,std::size_t>& rhs) const {
+                if (lhs.first < rhs.first) return true;
+                if (rhs.first < lhs.first) return false;
+                return lhs.second < rhs.second;
+            }
+        };
+
+        /// Find the sorted order for any other key.
+        template <typename RandomIt, typename KeyFunction>
+        void SortedOrder(RandomIt begin, RandomIt end, KeyFunction& key,
+                         std::vector<std::size_t>& order,
+                         std::false_type /* is_arithmetic */) {
+            typedef typename std::decay<decltype(key(*begin))>::type Key;
+            std::vector< std::pair<Key,std::size_t> > keys;
+            keys.reserve(end - begin);
+            for (RandomIt i = begin; i != end; ++i) {
+                keys.push_back(std::make_pair(key(*i), keys.size()));
+            }
+            std::sort(keys.begin(), keys.end(), CompareKeys<Key>());
+            order.resize(keys.size());
+            for (std::size_t i = 0; i < keys.size(); ++i) {
+                order[i] = keys[i].second;
+            }
+        }
+    }
+}
+
+template <typename RandomIt, typename KeyFunction>
+void Cube::SortByKey(RandomIt begin, RandomIt end, KeyFunction key) {
+    typedef typename std::decay<decltype(key(*begin))>::type Key;
+    typedef typename std::iterator_traits<RandomIt>::value_type Value;
+    if (end - begin < 2) return;
+
+    std::vector<std::size_t> order;
+    Cube::SortByKeyDetail::SortedOrder(begin, end, key, order,
+                                       std::is_arithmetic<Key>());
+
+    // Copy the elements out in the sorted order, and then copy them back.
+    std::vector<Value> sorted;
+    sorted.reserve(order.size());
+    for (std::size_t i = 0; i < order.size(); ++i) {
+        sorted.push_back(*(begin + order[i]));
+    }
+    std::copy(sorted.begin(), sorted.end(), begin);
+}
+
+#endif
+
+// Local Variables:
+// mode:c++
+// c-basic-offset:4
+// compile-command:"$(git rev-parse --show-toplevel)/build/cube-build.sh force"
+// End:
@@ -1,6 +1,7 @@
 #include "CubeSpanningTree.hxx"
 #include "CubeMakeUsed.hxx"
 #include "CubeClusterManagement.hxx"
+#include "CubeCompareStableIds.hxx"
 
 #include <CubeInfo.hxx>
 #include <CubeLog.hxx>
@@ -112,7 +113,11 @@ Cube::SpanningTree::Process(const Cube::AlgorithmResult& input,
         }
 
         // Make a set of hits to be completely sure there are no duplicates.
-        std::set<Cube::Handle<Cube::Hit>> hitSet;
+        // The set is ordered by the stable hit identifier so the tree (and
+        // the clusters) don't depend on where the hits are in memory.
+        typedef std::set<Cube::Handle<Cube::Hit>,
+                         Cube::CompareStableIds> HitSet;
+        HitSet hitSet;
         for (Cube::HitSelection::iterator h = objectHits->begin();
              h != objectHits->end(); ++h) {
             hitSet.insert((*h));
@@ -122,7 +127,7 @@ Cube::SpanningTree::Process(const Cube::AlgorithmResult& input,
 
         // Only make tracks in the tracking detectors.
         std::size_t notTrackingHits = 0;
-        for (std::set<Cube::Handle<Cube::Hit>>::iterator h = hitSet.begin();
+        for (HitSet::iterator h = hitSet.begin();
              h != hitSet.end(); ++h) {
             if (Cube::Info::IsECal((*h)->GetIdentifier())) {
                 ++notTrackingHits;
@@ -1,26 +1,39 @@
 #include "CubeStochTrackFit.hxx"
+#include "CubePhiloxRandom.hxx"
+#include "CubeTrackMeasurements.hxx"
+#include "CubeNodeTimeFit.hxx"
+#include "CubeThreadSafety.hxx"
 #include "SimpleSIR.hh"
 
 #include <CubeReconNode.hxx>
 #include <CubeReconCluster.hxx>
 #include <CubeLog.hxx>
 #include <CubeUnits.hxx>
+#include <CubeEvent.hxx>
 #include <TUnitsTable.hxx>
 
 #include <TMatrixD.h>
 #include <TPrincipal.h>
-#include <TRandom.h>
 #include <TDecompChol.h>
 
-#include <Math/Minimizer.h>
-#include <Math/Factory.h>
-#include <Math/Functor.h>
-
 #include <vector>
+#include <algorithm>
 #include <cmath>
+#include <future>
+#include <functional>
+#include <sstream>
+#include <iomanip>
 
 #define DEBUG_NUMERIC_PROBLEMS
 
+// The filter passes can run on a second thread, so they don't write to
+// std::cout.  The messages are written to the log for the pass (with the
+// same format as CUBE_LOG and CUBE_ERROR), and the calling thread writes the
+// log when the pass is finished.
+#define PASS_LOG(log,level) if ((level) <= (CUBE_LOG_LEVEL)) (log) \
+    << std::setfill('%') << std::setw(level+2) << " " << std::setfill(' ')
+#define PASS_ERROR(log) ((log) <<__FILE__<<":: " << __LINE__ << ": " )
+
 ////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////
@@ -33,7 +46,9 @@
 // namespace.
 namespace {
     typedef std::vector<float> FilterState;
-    typedef Cube::Handle<Cube::ReconCluster> FilterMeasure;
+    // The measurements are read from a Cube::TrackMeasurements block that is
+    // filled once per fit.
+    typedef const Cube::TrackMeasurement* FilterMeasure;
 
     // Copied from the TCorrValue index definitions for Cube::TrackState.
     // These definitions *MUST* *MATCH* the indices in Cube::TrackState.
@@ -53,36 +68,58 @@ namespace {
         kSampleSize = 12,
     };
 
+    // The samples are stored as a structure of arrays so that each step of
+    // the filter is a set of loops over contiguous float arrays.
+    typedef SimpleSIRSamples<kSampleSize> FilterSamples;
+
     /// A user likelihood for the SimpleSIR template.
     ///
     /// Implement a (mostly) Gaussian likelihood for the cluster position.
-    /// This plays games to have more tail.
+    /// This plays games to have more tail.  The measurement is unpacked once,
+    /// and then the likelihood is calculated for all of the samples.
     struct FilterLikelihood {
-        double operator () (const FilterState& state,
-                            const FilterMeasure& meas) {
-            double rr = 0.0;
-            for (int i=0; i<3; ++i) {
-                double r1 = meas->GetPosition()[i] - state[kX+i];
-                rr += r1*r1/meas->GetPositionVariance()[i];
+        void operator () (const FilterSamples& samples,
+                          const FilterMeasure& meas,
+                          double* likelihood) {
+            const float mx = meas->GetPosition(0);
+            const float my = meas->GetPosition(1);
+            const float mz = meas->GetPosition(2);
+            const float wx = 1.0/meas->GetVariance(0);
+            const float wy = 1.0/meas->GetVariance(1);
+            const float wz = 1.0/meas->GetVariance(2);
+            const float* x = samples[kX];
+            const float* y = samples[kY];
+            const float* z = samples[kZ];
+            const std::size_t n = samples.size();
+            for (std::size_t s = 0; s < n; ++s) {
+                float rx = mx - x[s];
+                float ry = my - y[s];
+                float rz = mz - z[s];
+                float rr = rx*rx*wx + ry*ry*wy + rz*rz*wz;
+                // Add more tail!
+                rr = (rr > 1.0f) ? std::sqrt(rr) : rr;
+                likelihood[s] = std::exp(-0.5f*rr);
             }
-            // Add more tail!
-            if (rr > 1.0) rr = sqrt(rr);
-            return std::exp(-rr/2.0);
         }
     };
 
     /// A user state propagator for the SimpleSIR template.
     ///
-    /// Propagate the state to a measurement.  It takes a state and a
-    /// measurement, and propagates the state to the point of closest approach
-    /// to the measurement.  There are a handful of "input" fields that can be
-    /// used to control the scattering as the state is propagated.
+    /// Propagate the state to a measurement.  It takes the samples and a
+    /// measurement, and propagates each sample to the point of closest
+    /// approach to the measurement.  There are a handful of "input" fields
+    /// that can be used to control the scattering as the state is
+    /// propagated.
     struct FilterPropagate {
         // These need to be set before and between calls to UpdateState.
-        FilterPropagate():  fEDepSigma(0),
+        FilterPropagate():  fRandom(NULL), fEDepSigma(0),
                             fPosSigma(0), fTimeSigma(0), fVelocity(1.0),
                             fDirSigma(0), fCurvSigma(0) {}
 
+        // The random number stream for the fit.  This must be set before
+        // the propagator is used.
+        Cube::PhiloxRandom* fRandom;
+
         // The last position.  This is updated for each step and is used in
         // case the measurement is being completely missed (this happens when
         // there is a hard scatter).
@@ -116,196 +153,278 @@ namespace {
         // fitting.
         double fCurvSigma;
 
-        // A method that is used to propagate the state to the point of
+        // The random numbers used for one propagation.  This is a work area
+        // that is kept so it isn't reallocated for every measurement.
+        std::vector<float> fNoise;
+
+        // Indices of the random number blocks in fNoise.  Each block holds
+        // one value per sample.
+        enum {
+            kNoiseDX = 0, kNoiseDY, kNoiseDZ, kNoiseNorm, kNoiseT,
+            kNoiseX, kNoiseY, kNoiseZ, kNoiseEDep,
+            kNoiseCurvX, kNoiseCurvY, kNoiseCurvZ, kNoiseWidth,
+            kNoiseGaussian, // The number of Gaussian blocks.
+            kNoiseKink = kNoiseGaussian, // A block of uniform values.
+            kNoiseBlocks,
+        };
+
+        // A method that is used to propagate the samples to the point of
         // closest approach to the measurement.  The update can work in either
         // the forward or backward direction.
-        double operator () (FilterState& state,
-                            const FilterMeasure& meas) {
-            // Make an initial estimate of the distance to closest approach.
-            double dist = 0.0;
-            for (int i=0; i<3; ++i) {
-                dist += state[kDX+i]*(meas->GetPosition()[i]-state[kX+i]);
-            }
-            // This is the changing part of the multiple scattering.  The
-            // multiplicative constant needs to be set as part of fDirSigma,
-            // and fPosSigma.  The std::abs() is so that the backward
-            // filtering works OK.
-            double multipleScatter = std::sqrt(std::abs(dist));
-            // Add scattering to the direction and find the normalize.
-            double norm = 0.0;
-            for (int i=0; i<3; ++i) {
-                if (fDirSigma > 0) {
-                    double s = multipleScatter*fDirSigma;
-                    state[kDX+i] += gRandom->Gaus(0.0,s);
-                }
-                norm += state[kDX+i]*state[kDX+i];
-            }
-            norm = std::sqrt(norm);
-            // Update the distance to closest approach.
-            dist = 0.0;
-            for (int i=0; i<3; ++i) {
-                dist += state[kDX+i]*(meas->GetPosition()[i]-state[kX+i])/norm;
-            }
-            // Update the direction normalization.  The direction is slightly
-            // denormalized to prevent the variance from getting to small and
-            // the correlations from getting to large.
-            norm *= gRandom->Gaus(1.0,0.001);
-            for (int i=0; i<3; ++i) {
-                state[kDX+i] /= norm;
-            }
-            // Recalculate the multipleScatter (because, why not).
-            multipleScatter = std::abs(dist);
-            multipleScatter *= std::sqrt(multipleScatter);
-            // Update the time
-            state[kT] += dist/(30.0*fVelocity*unit::cm/unit::ns);
-            if (fTimeSigma > 0) {
-                state[kT] += gRandom->Gaus(0.0,fTimeSigma);
-            }
-            // Update the position.
-            for (int i=0; i<3; ++i) {
-                state[kX+i] += dist*state[kDX+i];
-                if (fPosSigma > 0) {
-                    double s = multipleScatter*fPosSigma;
-                    state[kX+i] += gRandom->Gaus(0.0,s);
-                }
-            }
-            // Update the energy deposit.
-            if (fEDepSigma > 0) {
-                state[kEDep] += gRandom->Gaus(0.0,fEDepSigma);
-            }
-            // Apply curvature
-            if (fCurvSigma > 0) {
-                state[kCurvX] += gRandom->Gaus(0.0,fCurvSigma);
-                state[kCurvY] += gRandom->Gaus(0.0,fCurvSigma);
-                state[kCurvZ] += gRandom->Gaus(0.0,fCurvSigma);
-            }
+        void operator () (FilterSamples& samples,
+                          const FilterMeasure& meas) {
+            const std::size_t n = samples.size();
+            if (n < 1) return;
+
+            // Unpack the measurement once.
+            const float mx = meas->GetPosition(0);
+            const float my = meas->GetPosition(1);
+            const float mz = meas->GetPosition(2);
+
+            // Draw all of the random numbers for this step in one batch.
+            fNoise.resize(kNoiseBlocks*n);
+            fRandom->FillGaus(fNoise.data(), kNoiseGaussian*n);
+            fRandom->FillUniform(fNoise.data()+kNoiseKink*n, n);
+            const float* gDX = fNoise.data() + kNoiseDX*n;
+            const float* gDY = fNoise.data() + kNoiseDY*n;
+            const float* gDZ = fNoise.data() + kNoiseDZ*n;
+            const float* gNorm = fNoise.data() + kNoiseNorm*n;
+            const float* gT = fNoise.data() + kNoiseT*n;
+            const float* gX = fNoise.data() + kNoiseX*n;
+            const float* gY = fNoise.data() + kNoiseY*n;
+            const float* gZ = fNoise.data() + kNoiseZ*n;
+            const float* gEDep = fNoise.data() + kNoiseEDep*n;
+            const float* gCurvX = fNoise.data() + kNoiseCurvX*n;
+            const float* gCurvY = fNoise.data() + kNoiseCurvY*n;
+            const float* gCurvZ = fNoise.data() + kNoiseCurvZ*n;
+            const float* gWidth = fNoise.data() + kNoiseWidth*n;
+
+            // A zero sigma turns off the variation.
+            const float dirSigma = std::max(fDirSigma,0.0);
+            const float posSigma = std::max(fPosSigma,0.0);
+            const float timeSigma = std::max(fTimeSigma,0.0);
+            const float eDepSigma = std::max(fEDepSigma,0.0);
+            const float curvSigma = std::max(fCurvSigma,0.0);
+            const float invSpeed
+                = 1.0/(30.0*fVelocity*unit::cm/unit::ns);
+
+            float* x = samples[kX];
+            float* y = samples[kY];
+            float* z = samples[kZ];
+            float* t = samples[kT];
+            float* dx = samples[kDX];
+            float* dy = samples[kDY];
+            float* dz = samples[kDZ];
+            float* eDep = samples[kEDep];
+            float* curvX = samples[kCurvX];
+            float* curvY = samples[kCurvY];
+            float* curvZ = samples[kCurvZ];
+            float* width = samples[kWidth];
+
+            for (std::size_t s = 0; s < n; ++s) {
+                float px = mx - x[s];
+                float py = my - y[s];
+                float pz = mz - z[s];
+                // Make an initial estimate of the distance to closest
+                // approach.
+                float dist = dx[s]*px + dy[s]*py + dz[s]*pz;
+                // This is the changing part of the multiple scattering.  The
+                // multiplicative constant needs to be set as part of
+                // fDirSigma, and fPosSigma.  The std::abs() is so that the
+                // backward filtering works OK.
+                float multipleScatter = std::sqrt(std::abs(dist));
+                // Add scattering to the direction and find the normalize.
+                float dirScatter = multipleScatter*dirSigma;
+                dx[s] += dirScatter*gDX[s];
+                dy[s] += dirScatter*gDY[s];
+                dz[s] += dirScatter*gDZ[s];
+                float norm = std::sqrt(dx[s]*dx[s] + dy[s]*dy[s]
+                                       + dz[s]*dz[s]);
+                // Update the distance to closest approach.
+                dist = (dx[s]*px + dy[s]*py + dz[s]*pz)/norm;
+                // Update the direction normalization.  The direction is
+                // slightly denormalized to prevent the variance from getting
+                // to small and the correlations from getting to large.
+                norm *= 1.0f + 0.001f*gNorm[s];
+                dx[s] /= norm;
+                dy[s] /= norm;
+                dz[s] /= norm;
+                // Recalculate the multipleScatter (because, why not).
+                float absDist = std::abs(dist);
+                multipleScatter = absDist*std::sqrt(absDist);
+                // Update the time
+                t[s] += dist*invSpeed + timeSigma*gT[s];
+                // Update the position.
+                float posScatter = multipleScatter*posSigma;
+                x[s] += dist*dx[s] + posScatter*gX[s];
+                y[s] += dist*dy[s] + posScatter*gY[s];
+                z[s] += dist*dz[s] + posScatter*gZ[s];
+                // Update the energy deposit.
+                eDep[s] += eDepSigma*gEDep[s];
+                // Apply curvature
+                curvX[s] += curvSigma*gCurvX[s];
+                curvY[s] += curvSigma*gCurvY[s];
+                curvZ[s] += curvSigma*gCurvZ[s];
 #ifdef APPLY_CURVATURE
-            // This update needs to be triple checked to make sure I did the
-            // algebra properly...  Because of the multiple scattering,
-            // I'm guessing that we aren't sensitive to the curvature in the
-            // first place.
-            TVector3 tempCurv(state[kCurvX],state[kCurvY],state[kCurvZ]);
-            TVector3 tempDir(state[kDX],state[kDY],state[kDZ]);
-            TVector3 tempCurv = tempCurv.Cross(tempDir);
-            for (int i=0; i<3; ++i) {
-                state[kX+i] += dist*dist*tempCurv(i);
-                state[kDX+i] += dist*tempCurv(i);
-            }
+                // This update needs to be triple checked to make sure I did
+                // the algebra properly...  Because of the multiple
+                // scattering, I'm guessing that we aren't sensitive to the
+                // curvature in the first place.
+                TVector3 tempCurv(curvX[s],curvY[s],curvZ[s]);
+                TVector3 tempDir(dx[s],dy[s],dz[s]);
+                tempCurv = tempCurv.Cross(tempDir);
+                x[s] += dist*dist*tempCurv.X();
+                y[s] += dist*dist*tempCurv.Y();
+                z[s] += dist*dist*tempCurv.Z();
+                dx[s] += dist*tempCurv.X();
+                dy[s] += dist*tempCurv.Y();
+                dz[s] += dist*tempCurv.Z();
 #endif
-            // Fill the track width. These are not used.
-            state[kWidth] = gRandom->Gaus();
+                // Fill the track width. These are not used.
+                width[s] = gWidth[s];
+            }
 
 #define ALLOW_HARD_SCATTERING
 #ifdef ALLOW_HARD_SCATTERING
-            // Use a "do" loop so it's easy to "break" out if needed.
-            do {
-                // Finally, check if there might be a hard scatter.  This
-                // means that the state completely misses the measurement.
-                // The new state is updated to be close to the measurement.
-                TVector3 miss = meas->GetPosition().Vect()
-                    - TVector3(state[kX], state[kY], state[kZ]);
-                double missDist = miss.Mag();
-                /// This next line isn't quite right... but not quite wrong.
-                double missSigma = std::sqrt(meas->GetPositionVariance().X());
-                /// Measurements that are more than this many standard
-                /// deviations away from the state are considered to have been
-                /// missed.
-                double allowedMiss = 5.0;
-                // Base the chance of treating this as a kink on the missed
-                // distance.
-                double kinkChance = 0.1; // sets the max probability.
-                double sharpness = 6.0; // sets the transition speed.
-                double totalMiss = missDist/missSigma - allowedMiss;
-                kinkChance = kinkChance/(sharpness*std::exp(-totalMiss) + 1.0);
-                if (kinkChance < gRandom->Uniform()) break;
+            // Finally, check if there might be a hard scatter.  This means
+            // that the state completely misses the measurement.  The new
+            // state is updated to be close to the measurement.
+            //
+            /// This next line isn't quite right... but not quite wrong.
+            const float missSigma
+                = std::sqrt(meas->GetVariance(0));
+            /// Measurements that are more than this many standard
+            /// deviations away from the state are considered to have been
+            /// missed.
+            const float allowedMiss = 5.0;
+            // Base the chance of treating this as a kink on the missed
+            // distance.
+            const float maxKinkChance = 0.1; // sets the max probability.
+            const float sharpness = 6.0; // sets the transition speed.
+            // A crude estimate of the local direction.
+            TVector3 progress = meas->GetSpatialPosition() - fLastPosition;
+            progress = progress.Unit();
+            // Find the kinked samples.  The chance is calculated for all of
+            // the samples, and the (rare) kinked samples are fixed after.
+            // The uniform random numbers are replaced by the chance minus the
+            // random value, so a positive value means the sample is kinked.
+            float* kink = fNoise.data() + kNoiseKink*n;
+            for (std::size_t s = 0; s < n; ++s) {
+                float px = mx - x[s];
+                float py = my - y[s];
+                float pz = mz - z[s];
+                float missDist = std::sqrt(px*px + py*py + pz*pz);
+                float totalMiss = missDist/missSigma - allowedMiss;
+                float chance
+                    = maxKinkChance/(sharpness*std::exp(-totalMiss) + 1.0f);
+                kink[s] = chance - kink[s];
+            }
+            for (std::size_t s = 0; s < n; ++s) {
+                if (kink[s] <= 0.0f) continue;
                 // Update the position to be near the measurement.
+                TVector3 miss(mx - x[s], my - y[s], mz - z[s]);
+                double missDist = miss.Mag();
                 miss = miss.Unit();
-                double posCorr = gRandom->Gaus(missDist,missSigma);
-                // Update the direction to be along a crude estimate of the
-                // local direction, and make sure we don't reverse it.
-                TVector3 progress = meas->GetPosition().Vect() - fLastPosition;
-                progress = progress.Unit();
-                double dirCorr = 0.0;
-                for (int i=0; i<3; ++i) dirCorr += progress[i] * state[kDX+i];
-                if (dirCorr < 0.0) progress = - progress;
+                double posCorr = fRandom->Gaus(missDist,missSigma);
+                // Update the direction to be along the local direction, and
+                // make sure we don't reverse it.
+                double dirCorr = progress.X()*dx[s]
+                    + progress.Y()*dy[s] + progress.Z()*dz[s];
+                TVector3 localDir = progress;
+                if (dirCorr < 0.0) localDir = - localDir;
                 // Update the position, and direction.
-                double norm = 0.0;
-                for (int i=0; i<3; ++i) {
-                    state[kX+i] += miss[i]*posCorr;
-                    state[kDX + i] = gRandom->Gaus(progress[i],0.2);
-                    norm += state[kDX+i]*state[kDX+i];
-                }
+                x[s] += miss.X()*posCorr;
+                y[s] += miss.Y()*posCorr;
+                z[s] += miss.Z()*posCorr;
+                dx[s] = fRandom->Gaus(localDir.X(),0.2);
+                dy[s] = fRandom->Gaus(localDir.Y(),0.2);
+                dz[s] = fRandom->Gaus(localDir.Z(),0.2);
                 // Tweak the direction normalization to break the
                 // correlations.
-                norm = std::sqrt(norm)*gRandom->Gaus(1.0,0.001);
-                for (int i=0; i<3; ++i) {
-                    state[kDX+i] /= norm;
-                }
-            } while (false); // Never continue.
+                double norm = std::sqrt(dx[s]*dx[s] + dy[s]*dy[s]
+                                        + dz[s]*dz[s]);
+                norm *= fRandom->Gaus(1.0,0.001);
+                dx[s] /= norm;
+                dy[s] /= norm;
+                dz[s] /= norm;
+            }
 #endif
-            return 1.0;
         }
     };
 
-    // Declare the filter.
-    typedef SimpleSIR<FilterState, FilterPropagate,
-                          FilterMeasure, FilterLikelihood> FilterSIR;
+    /// A user random number generator for the SimpleSIR template.  This
+    /// draws from the same stream as the propagator.
+    struct FilterRandom {
+        FilterRandom(): fRandom(NULL) {}
+        Cube::PhiloxRandom* fRandom;
+        double operator () () {return fRandom->Uniform();}
+    };
 
-    // Calculate the average and covariance for the current state vector.
-    void MakeAverage(const FilterSIR::SampleVector& samples,
-                           FilterState& stateAvg, TMatrixD& stateCov) {
-        std::size_t dim = samples[0].second.size();
+    // Declare the filter.
+    typedef SimpleSIR<kSampleSize, FilterPropagate,
+                      FilterMeasure, FilterLikelihood,
+                      FilterRandom> FilterSIR;
+
+    // Calculate the average and covariance for the current samples.  The
+    // sums are done one state element (or pair of elements) at a time so
+    // that the loops run over contiguous arrays.
+    void MakeAverage(const FilterSamples& samples,
+                     FilterState& stateAvg, TMatrixD& stateCov,
+                     std::ostream& log) {
+        const std::size_t dim = kSampleSize;
+        const std::size_t n = samples.size();
         if (stateAvg.size() != dim) {
             stateAvg.resize(dim);
             stateCov.ResizeTo(dim,dim);
         }
-        for (std::size_t i=0; i<dim; ++i) {
-            stateAvg[i] = 0.0;
-            for (std::size_t j=0; j<dim; ++j) {
-                stateCov(i,j) = 0.0;
-            }
-        }
+        const double* w = samples.Weight.data();
         // Find the averages.
         double weight = 0.0;
-        for (FilterSIR::SampleVector::const_iterator s = samples.begin();
-             s != samples.end(); ++s) {
-            weight += s->first;
+        for (std::size_t s = 0; s < n; ++s) weight += w[s];
 #ifdef DEBUG_NUMERIC_PROBLEMS
-            if (!std::isfinite(s->first)) {
-                CUBE_ERROR << "Invalid sample weight " << s->first
-                           << std::endl;
+        for (std::size_t s = 0; s < n; ++s) {
+            if (!std::isfinite(w[s])) {
+                PASS_ERROR(log) << "Invalid sample weight " << w[s]
+                                << std::endl;
                 throw std::runtime_error("Numeric problem");
             }
-#endif
             for (std::size_t i=0; i<dim; ++i) {
-#ifdef DEBUG_NUMERIC_PROBLEMS
-                if (!std::isfinite(s->second[i])) {
-                    CUBE_ERROR << "Invalid sample" << std::endl;
+                if (!std::isfinite(samples[i][s])) {
+                    PASS_ERROR(log) << "Invalid sample" << std::endl;
                     for (std::size_t j = 0; j<dim; ++j) {
-                        CUBE_LOG(0) << "S[" << j << "] = " << s->second[j]
-                                    << std::endl;
+                        PASS_LOG(log,0) << "S[" << j << "] = "
+                                        << samples[j][s] << std::endl;
                     }
                     throw std::runtime_error("Numeric problem");
                 }
-#endif
-                stateAvg[i] += s->first*s->second[i];
             }
         }
+#endif
+        for (std::size_t i=0; i<dim; ++i) {
+            const float* v = samples[i];
+            double avg = 0.0;
+            for (std::size_t s = 0; s < n; ++s) avg += w[s]*v[s];
+            stateAvg[i] = avg;
+        }
 #ifdef DEBUG_NUMERIC_PROBLEMS
         if (weight < 0.099 || 1.001 < weight || !std::isfinite(weight)) {
-            CUBE_ERROR << "Invalid weight " << weight << std::endl;
+            PASS_ERROR(log) << "Invalid weight " << weight << std::endl;
             throw std::runtime_error("Weight must be 1.0");
         }
 #endif
-        // Find the covariance (brute force!)
-        for (FilterSIR::SampleVector::const_iterator s = samples.begin();
-             s != samples.end(); ++s) {
-            for (std::size_t i=0; i<dim; ++i) {
-                double a = s->second[i]-stateAvg[i];
-                for (std::size_t j=0; j<dim; ++j) {
-                    double b = s->second[j]-stateAvg[j];
-                    stateCov(i,j) += s->first*a*b;
+        // Find the covariance (brute force, but only the upper triangle).
+        for (std::size_t i=0; i<dim; ++i) {
+            const float* a = samples[i];
+            const double aAvg = stateAvg[i];
+            for (std::size_t j=i; j<dim; ++j) {
+                const float* b = samples[j];
+                const double bAvg = stateAvg[j];
+                double cov = 0.0;
+                for (std::size_t s = 0; s < n; ++s) {
+                    cov += w[s]*(a[s]-aAvg)*(b[s]-bAvg);
                 }
+                stateCov(i,j) = cov;
+                stateCov(j,i) = cov;
             }
         }
         // Check that the variances aren't getting very small.  This uses the
@@ -315,13 +434,15 @@ namespace {
         for (std::size_t i=0; i<dim; ++i) {
 #ifdef DEBUG_NUMERIC_PROBLEMS
             if (!std::isfinite(stateAvg[i])) {
-                CUBE_ERROR << "Invalid average state " << i << std::endl;
+                PASS_ERROR(log) << "Invalid average state " << i
+                                << std::endl;
                 throw std::runtime_error("Numeric problem");
             }
 #endif
 #ifdef DEBUG_NUMERIC_PROBLEMS
             if (!std::isfinite(stateCov(i,i))) {
-                CUBE_ERROR << "Invalid average variance " << i << std::endl;
+                PASS_ERROR(log) << "Invalid average variance " << i
+                                << std::endl;
                 throw std::runtime_error("Numeric problem");
             }
 #endif
@@ -337,7 +458,8 @@ namespace {
                 if (i == j) continue;
 #ifdef DEBUG_NUMERIC_PROBLEMS
                 if (!std::isfinite(stateCov(i,j))) {
-                    CUBE_ERROR << "Invalid average covariance " << i << " " << j << std::endl;
+                    PASS_ERROR(log) << "Invalid average covariance "
+                                    << i << " " << j << std::endl;
                     throw std::runtime_error("Numeric problem");
                 }
 #endif
@@ -565,7 +687,8 @@ namespace {
     // Take all of the nodes and make a guess at the curvature by
     // statistically sampling triplets of nodes.
     void MakeCurvature(const Cube::ReconNodeContainer& nodes,
-                       double& curvature, double& curvatureSigma) {
+                       double& curvature, double& curvatureSigma,
+                       Cube::PhiloxRandom& random) {
         curvature = 0.0;
         curvatureSigma = 0.0;
         // For a short track, just return a zero curvature and a large
@@ -579,8 +702,8 @@ namespace {
         int maxTrial = 100.0;
         int trials = 0.0;
         for (int trial = 0; trial < maxTrial; ++trial) {
-            int offset = (int) gRandom->Uniform(minOffset,maxOffset);
-            int first = (int) gRandom->Uniform(0.0,nodes.size()-2*offset);
+            int offset = (int) random.Uniform(minOffset,maxOffset);
+            int first = (int) random.Uniform(0.0,nodes.size()-2*offset);
             Cube::ReconNodeContainer::const_iterator begin
                 = nodes.begin()+first;
             Cube::ReconNodeContainer::const_iterator middle = begin + offset;
@@ -637,15 +760,16 @@ namespace {
     // resized before this is called.  There need to be at least two
     // measurements (usually, the first few measurements should be used).  The
     // directions go from the first measurement toward the last measurement.
-    void MakePrior(FilterSIR::SampleVector& samples,
+    void MakePrior(FilterSamples& samples,
                    std::vector<FilterMeasure> meas,
-                   double curv, double curvSigma) {
-        CUBE_LOG(2) <<"Stochastic::" <<
-                       "Initial curvature " << curv << "+/-" << curvSigma
-                    << std::endl;
+                   double curv, double curvSigma,
+                   Cube::PhiloxRandom& random, std::ostream& log) {
+        PASS_LOG(log,2) <<"Stochastic::" <<
+                          "Initial curvature " << curv << "+/-" << curvSigma
+                        << std::endl;
         double mSize = meas.size();
         if (mSize < 2) {
-            CUBE_ERROR << "Not enough measurements" << std::endl;
+            PASS_ERROR(log) << "Not enough measurements" << std::endl;
         }
         // Estimate energy deposition
         double avgEDep = 0.0;
@@ -653,71 +777,57 @@ namespace {
             avgEDep += meas[i]->GetEDeposit();
         }
         double length =
-            (meas.front()->GetPosition().Vect()
-             - meas.back()->GetPosition().Vect()).Mag();
+            (meas.front()->GetSpatialPosition()
+             - meas.back()->GetSpatialPosition()).Mag();
         if (length<0.1) {
-            CUBE_ERROR << "Measurements at same location" << std::endl;
+            PASS_ERROR(log) << "Measurements at same location" << std::endl;
             for (int i = 0; i<meas.size(); ++i) {
-                CUBE_LOG(0) << i
-                            << " " << meas[i]->GetEDeposit()
-                            << " " <<  meas[i]->GetPosition().X()
-                            << " " <<  meas[i]->GetPosition().Y()
-                            << " " <<  meas[i]->GetPosition().Z()
-                            << " " <<  meas[i]->GetPosition().T()
-                            << std::endl;
-                for (auto hit : *meas[i]->GetHitSelection()) {
-                    CUBE_LOG(0) << "   " << hit->GetIdentifier()
-                               << " " << hit->GetCharge()
-                               << " " << hit->GetPosition().X()
-                               << " " << hit->GetPosition().Y()
-                               << " " << hit->GetPosition().Z()
-                               << " " << hit->GetTime()
-                               << std::endl;
-                }
+                PASS_LOG(log,0) << i
+                                << " " << meas[i]->GetEDeposit()
+                                << " " <<  meas[i]->GetPosition(0)
+                                << " " <<  meas[i]->GetPosition(1)
+                                << " " <<  meas[i]->GetPosition(2)
+                                << " " <<  meas[i]->GetPosition(3)
+                                << " " <<  meas[i]->GetHitCount() << " hits"
+                                << std::endl;
             }
         }
         avgEDep /= length;
-        for (FilterSIR::SampleVector::iterator s = samples.begin();
-             s != samples.end(); ++s) {
-            s->first = 1.0/samples.size();
-            if (s->second.size() != kSampleSize) {
-                CUBE_ERROR << "Sample size is wrong.  Problem someplace"
-                           << " " << s->second.size()
-                           << " vs " << kSampleSize << std::endl;
-                throw std::runtime_error("Bad sample size");
-            }
-            int m1 = (int) gRandom->Uniform(0.0, mSize);
+        const std::size_t n = samples.size();
+        for (std::size_t s = 0; s < n; ++s) {
+            samples.Weight[s] = 1.0/n;
+            int m1 = (int) random.Uniform(0.0, mSize);
             int m2 = m1;
-            while (m1 == m2) m2 = (int) gRandom->Uniform(0.0, mSize);
+            while (m1 == m2) m2 = (int) random.Uniform(0.0, mSize);
             // Fill the position.  Assume a 1cm cube size.
             for (int i=0; i<3; ++i) {
-                s->second[kX+i] = meas[m1]->GetPosition()[i]
-                    + gRandom->Uniform(-5.0*unit::mm,5.0*unit::mm);
+                samples[kX+i][s] = meas[m1]->GetPosition(i)
+                    + random.Uniform(-5.0*unit::mm,5.0*unit::mm);
             }
-            s->second[kT] = gRandom->Gaus(meas[m1]->GetPosition().T(),
-                                          meas[m1]->GetPositionVariance().T());
+            samples[kT][s] = random.Gaus(meas[m1]->GetPosition(3),
+                                         meas[m1]->GetVariance(3));
             // Fill the direction.  It will be normalized when propagated.
             double dirSign = 1.0;
             if (m2 < m1) dirSign = -1.0;
             for (int i=0; i<3; ++i) {
-                s->second[kDX+i] = meas[m2]->GetPosition()[i]
-                    + gRandom->Uniform(-5.0*unit::mm,5.0*unit::mm)
-                    - s->second[kX+i];
-                s->second[kDX+i] *= dirSign;
+                samples[kDX+i][s] = meas[m2]->GetPosition(i)
+                    + random.Uniform(-5.0*unit::mm,5.0*unit::mm)
+                    - samples[kX+i][s];
+                samples[kDX+i][s] *= dirSign;
             }
             // Fill the energy deposition and curvature.
-            s->second[kEDep] =  gRandom->Gaus(avgEDep,std::sqrt(avgEDep));
-            s->second[kCurvX] =  curv;
-            s->second[kCurvY] =  curv;
-            s->second[kCurvZ] =  curv;
+            samples[kEDep][s] =  random.Gaus(avgEDep,std::sqrt(avgEDep));
+            samples[kCurvX][s] =  curv;
+            samples[kCurvY][s] =  curv;
+            samples[kCurvZ][s] =  curv;
             if (curvSigma > 0.0) {
-                s->second[kCurvX] += gRandom->Gaus(0.0,curvSigma);
-                s->second[kCurvY] += gRandom->Gaus(0.0,curvSigma);
-                s->second[kCurvZ] += gRandom->Gaus(0.0,curvSigma);
+                samples[kCurvX][s] += random.Gaus(0.0,curvSigma);
+                samples[kCurvY][s] += random.Gaus(0.0,curvSigma);
+                samples[kCurvZ][s] += random.Gaus(0.0,curvSigma);
             }
             // Fill the widths (not used).  Fill with gaus to prevent a
             // singular matrix.
-            s->second[kWidth] = gRandom->Gaus();
+            samples[kWidth][s] = random.Gaus();
         }
     }
 
@@ -782,9 +892,11 @@ namespace {
     // distribution described by the stateAvg and stateCov.  This is used to
     // make sure that the resampling doesn't collapse all of the states into a
     // single point (a typical failing of a SIR filter).
-    void GaussianResample(FilterSIR::SampleVector& samples,
+    void GaussianResample(FilterSamples& samples,
                           const FilterState& stateAvg,
-                          const TMatrixD& stateCov) {
+                          const TMatrixD& stateCov,
+                          Cube::PhiloxRandom& random,
+                          std::ostream& log) {
 
         TMatrixD newCov(stateCov);
         TMatrixD decomposition(stateAvg.size(),stateAvg.size());
@@ -799,7 +911,7 @@ namespace {
                 break;
             }
 
-            CUBE_LOG(0) << "Bad decomposition" << std::endl;
+            PASS_LOG(log,0) << "Bad decomposition" << std::endl;
             // The Cholesky decomposition has failed.  That usually means that
             // the current estimate of the covariance has a one or more pairs
             // of variables that are too correlated, or that the variance of
@@ -832,123 +944,228 @@ namespace {
             maxCorrelation *= 0.9;
         }
 
+        // Draw all of the normal deviates needed for the resampling in one
+        // batch.  The deviates for state element "i" are in a contiguous
+        // block of samples.size() values.
+        const std::size_t dim = stateAvg.size();
+        const std::size_t n = samples.size();
+        std::vector<float> deviates(n*dim);
+        random.FillGaus(deviates.data(), deviates.size());
+
+        // Set all the samples to have a uniform weight (normalized to 1).
+        for (std::size_t s = 0; s < n; ++s) samples.Weight[s] = 1.0/n;
+
         // Update the samples using the Cholesky decomposition of the
         // covariance.  This makes sure that we don't have any duplicated
-        // samples.
-        for (FilterSIR::SampleVector::iterator s = samples.begin();
-             s != samples.end(); ++s) {
-            // Set all the samples to have a uniform weight (normalized to 1).
-            s->first = 1.0/samples.size();
-            // Set the average value for the state;
-            for (std::size_t i = 0; i < stateAvg.size(); ++i) {
-                s->second[i] = stateAvg[i];
-            }
-            // Add a fluctuation around the average using the Cholesky
-            // decomposition.
-            for (std::size_t i = 0; i < stateAvg.size(); ++i) {
-                double r = gRandom->Gaus(0.0,1.0);
-                for (std::size_t j = 0; j < stateAvg.size(); ++j) {
-                    s->second[j] += r*decomposition(i,j);
-                }
+        // samples.  Each state element is filled with the average value, and
+        // then the fluctuations are added one deviate block at a time.
+        for (std::size_t j = 0; j < dim; ++j) {
+            float* v = samples[j];
+            const float avg = stateAvg[j];
+            for (std::size_t s = 0; s < n; ++s) v[s] = avg;
+            for (std::size_t i = 0; i <= j; ++i) {
+                const float u = decomposition(i,j);
+                const float* r = deviates.data() + i*n;
+                for (std::size_t s = 0; s < n; ++s) v[s] += r[s]*u;
             }
         }
     }
 
-    // Find the multiple scattering constants for a particular mass and
-    // momentum.  The mass, momentum and length are HEP units.
-    double MultipleScatteringAngle(double mass, double mom,
-                                   double radLen, double dist) {
-        if (mass < 1.0*unit::MeV) {
-            // Electrons don't multiple scatter, so return a big value to take
-            // into account how "flexible" the track is.
-            return 0.10;
+    // Check the effective sample size after a measurement, and resample if
+    // the samples have degenerated.  When the minimum and maximum sample
+    // counts are different, this also picks the number of samples for the
+    // next step: the count is doubled when the effective sample size has
+    // collapsed (the measurement was poorly covered by the samples), and
+    // halved when almost all samples are still effective (the PDF is being
+    // over sampled).  Since the samples are redrawn from the average and
+    // covariance, changing the count is done as part of the resampling.
+    // This returns the number of samples after the check.
+    int CheckSamples(FilterSIR& filter, FilterSamples& samples,
+                     FilterState& stateAvg, TMatrixD& stateCov,
+                     Cube::PhiloxRandom& random,
+                     int minimumCount, int maximumCount,
+                     std::ostream& log) {
+        const double growFraction = 0.1;
+        const double resampleFraction = 0.5;
+        const double shrinkFraction = 0.9;
+        int count = samples.size();
+        double eff = filter.GetEffectiveSamples(samples);
+        int newCount = count;
+        if (eff < growFraction*count) {
+            newCount = std::min(2*count, maximumCount);
+        }
+        else if (eff > shrinkFraction*count) {
+            newCount = std::max(count/2, minimumCount);
         }
-        double enr = std::sqrt(mass*mass + mom*mom);
-        double beta = std::sqrt(1.0-mass*mass/enr/enr);
-        // double sqrtRadLen = std::sqrt(41.31 * unit::cm);
-        double sqrtRadLen = std::sqrt(radLen);
-        double logCorr = 1.0 - 0.038*std::log(dist/sqrtRadLen/sqrtRadLen);
-        return (13.6*unit::MeV*logCorr)/(beta*mom*sqrtRadLen);
+        newCount = std::max(newCount, minimumCount);
+        newCount = std::min(newCount, maximumCount);
+        if (newCount == count && eff >= resampleFraction*count) {
+            return count;
+        }
+        samples.resize(newCount);
+        GaussianResample(samples,stateAvg,stateCov,random,log);
+        MakeAverage(samples,stateAvg,stateCov,log);
+        return newCount;
     }
 
-    // This must be destroyed before the event is freed.
-    struct NodeTimeFit : public ROOT::Math::IMultiGenFunction {
-        typedef std::vector<
-            std::pair<double,Cube::Handle<Cube::ReconNode>>> TravelVector;
-        TravelVector fTravel;
-
-        explicit NodeTimeFit(Cube::ReconNodeContainer& nodes) {
-            fTravel.clear();
-            double totalDist = 0.0;
-            for (int i = 0; i < (int) nodes.size(); ++i) {
-                Cube::Handle<Cube::ReconCluster> object = nodes[i]->GetObject();
-                if (i < 1) {
-                    fTravel.push_back(std::make_pair(totalDist,nodes[i]));
-                    continue;
-                }
-                Cube::Handle<Cube::TrackState> state1 = nodes[i]->GetState();
-                Cube::Handle<Cube::TrackState> state0 = nodes[i-1]->GetState();
-                TVector3 diff
-                    = state1->GetPosition().Vect()-state0->GetPosition().Vect();
-                TVector3 dir = state1->GetDirection() + state0->GetDirection();
-                totalDist += diff*dir.Unit();
-                fTravel.push_back(std::make_pair(totalDist,nodes[i]));
-            }
-            // Correct so that the zero distance is close to the center of the
-            // track.
-            int iOffset = fTravel.size()/2;
-            double offsetDist = fTravel[iOffset].first;
-            for (int i = 0; i < (int) nodes.size(); ++i) {
-                fTravel[i].first = fTravel[i].first - offsetDist;
+    // Build the key for the random number stream used to fit a track.  The
+    // key combines the user seed, the run and event numbers, and the hits on
+    // the track nodes (which identify the time slice and the track), so the
+    // same track always gets the same stream no matter when, or on which
+    // thread, it's fit.
+    uint64_t TrackSeed(const Cube::ReconNodeContainer& nodes, uint64_t seed) {
+        uint64_t key = seed;
+        Cube::Event* event = Cube::Event::CurrentEvent();
+        if (event) {
+            key = Cube::PhiloxRandom::Hash(key, event->GetRunId());
+            key = Cube::PhiloxRandom::Hash(key, event->GetEventId());
+        }
+        for (Cube::ReconNodeContainer::const_iterator n = nodes.begin();
+             n != nodes.end(); ++n) {
+            Cube::Handle<Cube::ReconObject> object = (*n)->GetObject();
+            if (!object) continue;
+            Cube::Handle<Cube::HitSelection> hits = object->GetHitSelection();
+            if (!hits) continue;
+            for (Cube::HitSelection::const_iterator h = hits->begin();
+                 h != hits->end(); ++h) {
+                key = Cube::PhiloxRandom::Hash(key, (*h)->GetIdentifier());
+                key = Cube::PhiloxRandom::Hash(
+                    key, std::llround((*h)->GetTime()/unit::picosecond));
             }
         }
+        return key;
+    }
+
+    // The per-node result of one filter pass (in node order).  A pass only
+    // writes into this buffer (and never touches the nodes, or std::cout)
+    // so that the forward and backward passes can be run at the same time.
+    struct FilterPassResult {
+        FilterPassResult(): fTotalSamples(0.0) {}
+        std::vector<FilterState> fAverage;
+        std::vector<TMatrixD> fCovariance;
+        std::vector<int> fSampleCount;
+        // The total number of samples propagated for all of the nodes.
+        double fTotalSamples;
+        // The messages from the pass (see PASS_LOG).
+        std::ostringstream fLog;
+    };
+
+    // Write the messages from a filter pass.  This must be called on the
+    // thread running the fit after the pass is finished.
+    void WritePassLog(FilterPassResult& result) {
+        std::string text = result.fLog.str();
+        if (!text.empty()) std::cout << text << std::flush;
+        result.fLog.str("");
+    }
+
+    // Run one filter pass over the measurements.  The forward pass runs from
+    // the front to the back of the track, and the backward pass runs from
+    // the back to the front.  Each pass uses a separate random number stream
+    // derived from the track seed so the result is the same no matter which
+    // thread runs the pass, or if the passes are run concurrently.
+    void RunFilterPass(const Cube::TrackMeasurements& measurements,
+                       bool backward, uint64_t trackSeed,
+                       int minimumCount, int maximumCount, int initialCount,
+                       FilterPassResult& result) {
+        const int nMeas = measurements.size();
+        result.fAverage.resize(nMeas);
+        result.fCovariance.resize(nMeas);
+        result.fSampleCount.resize(nMeas);
+        result.fTotalSamples = 0.0;
+
+        // Create the random number stream for this pass.
+        Cube::PhiloxRandom random(trackSeed, (backward ? 1 : 0));
+
+        // Create the filter
+        FilterSIR filter;
+        filter.SetResampleFraction(0.0);
+        filter.Propagator.fRandom = &random;
+        filter.Random.fRandom = &random;
+
+        // Estimate the curvature
+        double priorCurvature = 0.0;
+        double priorCurvatureSigma = 1.0/(20.0*unit::cm);
+        PASS_LOG(result.fLog,2) << "Stochastic::"
+                                << "Estimated curvature prior: "
+                                << priorCurvature
+                                << " +/- " << priorCurvatureSigma
+                                << std::endl;
+
+        // Make a prior near the starting end of the track.  The prior
+        // measurements are always in node order.
+        std::vector<FilterMeasure> priorMeasurements(std::min(nMeas,5));
+        int priorOffset = 0;
+        if (backward) priorOffset = nMeas - priorMeasurements.size();
+        for (int i=0; i<priorMeasurements.size(); ++i) {
+            priorMeasurements[i] = &measurements[i+priorOffset];
+        }
+        FilterSamples samples(initialCount);
+        MakePrior(samples,priorMeasurements,priorCurvature,
+                  priorCurvatureSigma,random,result.fLog);
+        if (!backward) filter.Propagator(samples,priorMeasurements[0]);
+        else {
+            filter.Propagator.fLastPosition
+                = measurements[nMeas-1].GetSpatialPosition();
+        }
+
+        // Set the noise terms (this should be done for each step when real
+        // multiple scattering is considered).  The constant values work well
+        // enough for a simple fitter.  This uses the radiation length for
+        // plastic.
+        filter.Propagator.fDirSigma
+            = Cube::MultipleScatteringAngle(105*unit::MeV, 500*unit::MeV,
+                                      41.31*unit::cm, 1*unit::cm);
+        filter.Propagator.fPosSigma = filter.Propagator.fDirSigma/sqrt(3.0);
+        filter.Propagator.fCurvSigma = 0.0001;
+        filter.Propagator.fEDepSigma = 0.01;
+        filter.Propagator.fTimeSigma = 0.01;
+        filter.Propagator.fVelocity = 1.0;
+
+        PASS_LOG(result.fLog,2) << "Stochastic::"
+                                << "Direction sigma per sqrt(mm): "
+                                << filter.Propagator.fDirSigma << std::endl;
+
+        FilterState stateAvg;
+        TMatrixD stateCov;
+        for (int step = 0; step < nMeas; ++step) {
+            int i = step;
+            if (backward) i = nMeas - step - 1;
+            filter.UpdateSamples(samples,&measurements[i]);
+
+            MakeAverage(samples,stateAvg,stateCov,result.fLog);
+
+            // Check if we need to resample.
+            result.fTotalSamples += samples.size();
+            int count = CheckSamples(filter,samples,stateAvg,stateCov,random,
+                                     minimumCount,maximumCount,result.fLog);
+            filter.Propagator.fLastPosition.SetXYZ(
+                stateAvg[kX],stateAvg[kY],stateAvg[kZ]);
 
-        virtual ~NodeTimeFit() {fTravel.clear();}
-
-        IBaseFunctionMultiDimTempl* Clone() const {return NULL;}
-
-        unsigned int NDim() const {return 2;}
-
-        double DoEval(const double* par) const {
-            double invBeta = par[0];
-            double t0 = par[1];
-            // Cut off the superluminal penalty (velocities more that
-            // C are OK).
-            double timeGoodness = std::abs(invBeta) - 1.0;
-            timeGoodness = std::max(0.0,invBeta);
-            // Apply a baseline penalty for velocities less than the speed of
-            // light.
-            timeGoodness = 4.0*timeGoodness*timeGoodness;
-            for (int i=0; i<fTravel.size(); ++i) {
-                Cube::Handle<Cube::ReconCluster> cluster
-                    = fTravel[i].second->GetObject();
-                // The speed of light.
-                const double ccc = (30.0*unit::cm)/(1.0*unit::ns);
-                // Expected, measured and the variance.
-                double tExp = invBeta*fTravel[i].first/ccc + t0;
-                double tMea = cluster->GetPosition().T();
-                double tVar = cluster->GetPositionVariance().T();
-                // The timeGoodness for this measurement.  Truncated to reject
-                // outliers.
-                double cc = (tExp-tMea);
-                cc = cc*cc/tVar;
-                const double chi2Epsilon = 1E-6; // Divide by zero is bad...
-                const double chi2Cut = 9.0;
-                const double chi2Offset = 1.0/chi2Epsilon + 1.0/chi2Cut;
-                cc = 1.0/(cc + chi2Epsilon) + 1.0/chi2Cut;
-                cc = 1.0/cc - 1.0/chi2Offset;
-                timeGoodness += cc;
-                // Set the time.  Done this way because the position is
-                // returned by value (intentionally).
-                Cube::Handle<Cube::TrackState> state
-                    = fTravel[i].second->GetState();
-                TLorentzVector pos = state->GetPosition();
-                pos.SetT(tExp);
-                state->SetPosition(pos);
+#ifdef DEBUG_NUMERIC_PROBLEMS
+            for (int j=0; j<stateAvg.size(); ++j) {
+                if (!std::isfinite(stateAvg[j])) {
+                    PASS_ERROR(result.fLog) << "Invalid filter average value"
+                                            << std::endl;
+                    throw std::runtime_error("Numeric problem");
+                }
+                for (int k=0; k<stateAvg.size(); ++k) {
+                    if (std::isfinite(stateCov(j,k))) continue;
+                    PASS_ERROR(result.fLog)
+                        << "Invalid filter covariance value"
+                        << " (" << j << "," << k << ") " << stateCov(j,k)
+                        << std::endl;
+                    throw std::runtime_error("Numeric problem");
+                }
             }
-            return timeGoodness;
+#endif
+
+            // Save the state for this node.
+            result.fAverage[i] = stateAvg;
+            result.fCovariance[i].ResizeTo(stateCov);
+            result.fCovariance[i] = stateCov;
+            result.fSampleCount[i] = count;
         }
-    };
+    }
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -958,7 +1175,9 @@ namespace {
 //////////////////////////////////////////////////////////////////////
 
 Cube::StochTrackFit::StochTrackFit(int nSamples)
-    : fSampleCount(nSamples) {}
+    : fSampleCount(nSamples), fAdaptiveSampling(false),
+      fMinimumSampleCount(100), fMaximumSampleCount(4000),
+      fTimeHuberCut(0.0), fSeed(0), fConcurrentPasses(false) {}
 Cube::StochTrackFit::~StochTrackFit() {}
 
 //////////////////////////////////////////////////////////////////////
@@ -984,167 +1203,128 @@ Cube::StochTrackFit::Apply(Cube::Handle<Cube::ReconTrack>& input) {
 
     int dim = nodes.front()->GetState()->GetDimensions();
     if (kSampleSize != dim) {
-        std::runtime_error("Stochastic fitter state definitions are wrong");
+        throw std::runtime_error(
+            "Stochastic fitter state definitions are wrong");
     }
 
-    // Define the samples that will describe the state PDF.
-    FilterSIR::SampleVector samples(fSampleCount);
-    for (FilterSIR::SampleVector::iterator s = samples.begin();
-         s != samples.end(); ++s) {
-        s->first = 1.0/dim;
-        s->second.resize(dim);
+    // Copy the node measurements out of the clusters once.  The filter reads
+    // the measurements many times per node.
+    Cube::TrackMeasurements measurements;
+    if (!measurements.Fill(nodes)) {
+        return Cube::Handle<Cube::ReconTrack>();
     }
 
-    CUBE_LOG(2) <<"Stochastic::" <<"Start a stochastic fit with "
-              << nodes.size() << " nodes "
-              << " sampled with " << fSampleCount << " samples" << std::endl;
-
-    // Make some variables for calculating the averages and covariance from
-    // the samples.
-    FilterState stateAvg;
-    TMatrixD stateCov;
-
-    // Create the filter
-    FilterSIR filter;
-    filter.SetResampleFraction(0.0);
-
-    // Estimate the curvature
-    double priorCurvature = 0.0;
-    double priorCurvatureSigma = 1.0/(20.0*unit::cm);
-    // MakeCurvature(nodes,priorCurvature,priorCurvatureSigma);
-    CUBE_LOG(2) << "Stochastic::" << "Estimated curvature prior: "
-                << priorCurvature
-                << " +/- " << priorCurvatureSigma << std::endl;
-    // Make a prior near the front of the track.
-    std::vector<FilterMeasure> priorMeasurements;
-    if (nodes.size() > 5) priorMeasurements.resize(5);
-    else priorMeasurements.resize(nodes.size());
-    for (int i=0; i<priorMeasurements.size(); ++i) {
-        priorMeasurements[i] = nodes[i]->GetObject();
-    }
-    MakePrior(samples,priorMeasurements,priorCurvature,priorCurvatureSigma);
-    for (FilterSIR::SampleVector::iterator s = samples.begin();
-         s != samples.end(); ++s) {
-        filter.Propagator(s->second,priorMeasurements[0]);
+    // Find the range for the number of samples.  When the sampling isn't
+    // adaptive, the range only contains the requested sample count.
+    int minimumCount = fSampleCount;
+    int maximumCount = fSampleCount;
+    if (fAdaptiveSampling) {
+        minimumCount = std::max(2,fMinimumSampleCount);
+        maximumCount = std::max(minimumCount,fMaximumSampleCount);
     }
-#ifdef DEBUG_PRIOR
-    MakeAverage(samples,stateAvg,stateCov);
-    for (int i=0; i<stateAvg.size(); ++i) {
-        nodes.front()->GetState()->SetValue(i,stateAvg[i]);
-        for (int j=0; j < stateAvg.size(); ++j) {
-            nodes.front()->GetState()->SetCovarianceValue(i,j,stateCov(i,j));
-        }
-    }
-    DebugState("Prior", nodes.front()->GetState());
-#endif
+    int initialCount = std::max(minimumCount,
+                                std::min(fSampleCount,maximumCount));
 
-    // Set the noise terms (this should be done for each step when real
-    // multiple scattering is considered).  The constant values work well
-    // enough for a simple fitter.  This uses the radiation length for
-    // plastic.
-    filter.Propagator.fDirSigma
-        = MultipleScatteringAngle(105*unit::MeV, 500*unit::MeV,
-                                  41.31*unit::cm, 1*unit::cm);
-    filter.Propagator.fPosSigma = filter.Propagator.fDirSigma/sqrt(3.0);
-    filter.Propagator.fCurvSigma = 0.0001;
-    filter.Propagator.fEDepSigma = 0.01;
-    filter.Propagator.fTimeSigma = 0.01;
-    filter.Propagator.fVelocity = 1.0;
-
-    CUBE_LOG(2) << "Stochastic::" << "Direction sigma per sqrt(mm): "
-                   << filter.Propagator.fDirSigma << std::endl;
-
-    // Forward filter from the front to the back of the track.  This sets the
-    // forward estimate of the states.
-    for (Cube::ReconNodeContainer::iterator n = nodes.begin();
-         n != nodes.end(); ++n) {
-        filter.UpdateSamples(samples,(*n)->GetObject());
-
-        MakeAverage(samples,stateAvg,stateCov);
-
-        // Check if we need to resample.
-        double eff = filter.GetEffectiveSamples(samples.begin(), samples.end());
-        if (eff < 0.5*samples.size()) {
-            GaussianResample(samples,stateAvg,stateCov);
-            MakeAverage(samples,stateAvg,stateCov);
-        }
-        filter.Propagator.fLastPosition.SetXYZ(
-            stateAvg[kX],stateAvg[kY],stateAvg[kZ]);
-
-        // Save the forward going state.
-        for (int i=0; i<stateAvg.size(); ++i) {
-#ifdef DEBUG_NUMERIC_PROBLEMS
-            if (!std::isfinite(stateAvg[i])) {
-                CUBE_ERROR << "Invalid forward going average value"
-                           << std::endl;
-                throw std::runtime_error("Numeric problem");
+    CUBE_LOG(2) <<"Stochastic::" <<"Start a stochastic fit with "
+              << nodes.size() << " nodes "
+              << " sampled with " << initialCount << " samples" << std::endl;
+
+    // Run the forward filter (front to back) and the backward filter (back
+    // to front) over the nodes.  The passes are independent until they are
+    // combined, so each has its own random number stream and sample buffers,
+    // and the backward pass is run on a second thread while the forward pass
+    // runs here.  The result doesn't depend on whether the passes are
+    // concurrent.
+    uint64_t trackSeed = TrackSeed(nodes,fSeed);
+    FilterPassResult forward;
+    FilterPassResult backward;
+    try {
+        if (fConcurrentPasses) {
+            Cube::EnableThreadSafety();
+            std::future<void> backwardPass
+                = std::async(std::launch::async, RunFilterPass,
+                             std::cref(measurements), true, trackSeed,
+                             minimumCount, maximumCount, initialCount,
+                             std::ref(backward));
+            // The backward pass must finish (and the exceptions must be
+            // caught) before the buffers go out of scope.
+            try {
+                RunFilterPass(measurements, false, trackSeed,
+                              minimumCount, maximumCount, initialCount,
+                              forward);
             }
-#endif
-            (*n)->GetState()->SetValue(i,stateAvg[i]);
-            for (int j=0; j < stateAvg.size(); ++j) {
-#ifdef DEBUG_NUMERIC_PROBLEMS
-                if (!std::isfinite(stateCov(i,j))) {
-                    stateCov.Print();
-                    CUBE_ERROR << "Invalid forward going covariance value"
-                               << std::endl;
-                    throw std::runtime_error("Numeric problem");
-                }
-#endif
-                (*n)->GetState()->SetCovarianceValue(i,j,stateCov(i,j));
+            catch (...) {
+                backwardPass.wait();
+                throw;
             }
+            backwardPass.get();
+        }
+        else {
+            RunFilterPass(measurements, false, trackSeed,
+                          minimumCount, maximumCount, initialCount, forward);
+            RunFilterPass(measurements, true, trackSeed,
+                          minimumCount, maximumCount, initialCount, backward);
         }
     }
-
-    // Make a prior near the back of the track.
-    for (int i = 0 ; i<priorMeasurements.size(); ++i) {
-        priorMeasurements[i]
-            = nodes[i+nodes.size()-priorMeasurements.size()]->GetObject();
+    catch (...) {
+        WritePassLog(forward);
+        WritePassLog(backward);
+        throw;
+    }
+    WritePassLog(forward);
+    WritePassLog(backward);
+
+    // The total number of samples propagated for all nodes in both passes.
+    double totalSamples = forward.fTotalSamples + backward.fTotalSamples;
+
+    // Save the forward going states.
+    for (std::size_t i = 0; i < nodes.size(); ++i) {
+        Cube::Handle<Cube::TrackState> forwardState = nodes[i]->GetState();
+        const FilterState& stateAvg = forward.fAverage[i];
+        const TMatrixD& stateCov = forward.fCovariance[i];
+        forwardState->SetSampleCount(forward.fSampleCount[i]);
+        for (int j=0; j<stateAvg.size(); ++j) {
+            forwardState->SetValue(j,stateAvg[j]);
+            for (int k=0; k < stateAvg.size(); ++k) {
+                forwardState->SetCovarianceValue(j,k,stateCov(j,k));
+            }
+        }
     }
-    MakePrior(samples,priorMeasurements,priorCurvature,priorCurvatureSigma);
 
     double energyDeposit = 0.0;
     double energyVariance = 0.0;
     double chiSquared = 0.0;
 
-    // Backward filter from the back to the front of the track.  This then
-    // applies forward-backward smoothing.
+    // Apply forward-backward smoothing, working from the back to the front
+    // of the track so that the counts of measurements contributing to the
+    // forward and backward states are the same as the backward pass.
     int forwardMeas = nodes.size();
     int backwardMeas = 0;
-    for (Cube::ReconNodeContainer::reverse_iterator n = nodes.rbegin();
-         n != nodes.rend(); ++n) {
-        filter.UpdateSamples(samples,(*n)->GetObject());
+    for (int i = (int) nodes.size()-1; i >= 0; --i) {
+        const Cube::TrackMeasurement& measure = measurements[i];
 
-        MakeAverage(samples,stateAvg,stateCov);
-
-        // Check if we need to resample.
-        double eff = filter.GetEffectiveSamples(samples.begin(), samples.end());
-        if (eff < 0.5*samples.size()) {
-            GaussianResample(samples,stateAvg,stateCov);
-            MakeAverage(samples,stateAvg,stateCov);
-        }
-        filter.Propagator.fLastPosition.SetXYZ(
-            stateAvg[kX],stateAvg[kY],stateAvg[kZ]);
-
-        // Combine states also updates the current state.  This is also
-        // updating the number of measurements contributing to the forward and
-        // backward states.
-        ForwardBackwardSmoothing((*n)->GetState(),forwardMeas--,
-                                 stateAvg,stateCov,++backwardMeas);
+        // Combine states also updates the current state.
+        ForwardBackwardSmoothing(nodes[i]->GetState(),forwardMeas--,
+                                 backward.fAverage[i],
+                                 backward.fCovariance[i],
+                                 ++backwardMeas);
 
         // Sum up the total track energy.
-        Cube::Handle<Cube::ReconCluster> cluster = (*n)->GetObject();
-        Cube::Handle<Cube::ClusterState> clusterState = cluster->GetState();
-        energyDeposit += clusterState->GetEDeposit();
-        energyVariance += clusterState->GetEDepositVariance();
+        energyDeposit += measure.GetEDeposit();
+        energyVariance += measure.GetEDepositVariance();
 
         // Calculate the goodness.  This depends on the idea that the cluster
         // covariance is always diagonal.
-        Cube::Handle<Cube::TrackState> trackState = (*n)->GetState();
+        Cube::Handle<Cube::TrackState> trackState = nodes[i]->GetState();
+
+        // The node state is described by the larger of the forward and
+        // backward sample counts.
+        trackState->SetSampleCount(
+            std::max(forward.fSampleCount[i],backward.fSampleCount[i]));
         TVector3 nodeDiff = trackState->GetPosition().Vect()
-            - clusterState->GetPosition().Vect();
-        for (int i=0; i<3; ++i) {
-            chiSquared +=
-                nodeDiff[i]*nodeDiff[i]/cluster->GetPositionVariance()[i];
+            - measure.GetSpatialPosition();
+        for (int j=0; j<3; ++j) {
+            chiSquared += nodeDiff[j]*nodeDiff[j]/measure.GetVariance(j);
         }
     }
 
@@ -1160,15 +1340,13 @@ Cube::StochTrackFit::Apply(Cube::Handle<Cube::ReconTrack>& input) {
             int k = i + j;
             if (k < 1) continue;
             if (nodes.size() <= k + 1) continue;
-            Cube::Handle<Cube::ReconCluster> object = nodes[k]->GetObject();
             double r = std::exp(-0.5*j*j/fWidth);
-            eDep += r*object->GetEDeposit();
+            eDep += r*measurements[k].GetEDeposit();
             eWght += r;
         }
         Cube::Handle<Cube::TrackState> state = nodes[i]->GetState();
-        Cube::Handle<Cube::ReconCluster> object = nodes[i]->GetObject();
         if (eWght < 0.01) {
-            state->SetEDeposit(object->GetEDeposit());
+            state->SetEDeposit(measurements[i].GetEDeposit());
             continue;
         }
         eDep /= eWght;
@@ -1183,35 +1361,12 @@ Cube::StochTrackFit::Apply(Cube::Handle<Cube::ReconTrack>& input) {
 
 #ifndef SIMPLE_TIME_LINE_FIT
     {
-        // Fit an inverse velocity (ns/mm) to the track.  The range of the
-        // inverse velocity is limited so there is a minimum track velocity.
-        // Superluminal velocities are allowed so that timing resolution can
-        // be handled.
-        std::unique_ptr<ROOT::Math::Minimizer>
-            minimizer(ROOT::Math::Factory::CreateMinimizer("Minuit", "Migrad"));
-        if (!minimizer) {
-            CUBE_ERROR << "Minimizer not created" << std::endl;
-            throw std::runtime_error("Unable to create vertex fit minimizer");
-        }
-
-        NodeTimeFit timeGoodness(nodes);
-        minimizer->SetFunction(timeGoodness);
-        minimizer->SetVariable(0,"invBeta",0.0,1.0);
-        minimizer->SetVariable(1,"T0",input->GetMedian().T(),1.0);
-        minimizer->SetPrintLevel(0);
-
-        minimizer->Minimize();
-        // Make sure the nodes are filled at the best fit position.  They are
-        // filled in DoEval.
-        double bestTimeGoodness = timeGoodness.DoEval(minimizer->X());
-
-        // Since the NodeTimeFit is setup as a robust estimator (not an actual
-        // chi2), the estimated uncertainties are not very appropriate.  The
-        // slope uncertainty is particularly poorly estimated since the slope
-        // has an extra non-linear penalty term.  Based on a quick look, the
-        // return Error on the fitted time offset seems to be a reasonable
-        // uncertainty estimate, even if it isn't formally correct.
-        double tUnc = minimizer->Errors()[1];
+        // Fit an inverse velocity to the track.  Superluminal velocities are
+        // allowed so that timing resolution can be handled.  The returned
+        // uncertainty is for the fitted time offset, and is used for all of
+        // the nodes.
+        double tUnc
+            = Cube::FitNodeTimes(nodes,measurements,fTimeHuberCut);
         for (int i = 0; i < (int) nodes.size(); ++i) {
             Cube::Handle<Cube::TrackState> state = nodes[i]->GetState();
             // Eliminate all time correlations.
@@ -1231,15 +1386,14 @@ Cube::StochTrackFit::Apply(Cube::Handle<Cube::ReconTrack>& input) {
         double y = 0.0;
         double s = 0.0;
         for (int i = 0; i < (int) nodes.size(); ++i) {
-            Cube::Handle<Cube::ReconCluster> object = nodes[i]->GetObject();
             // Never let the variance become less than this minimum.  It
             // should be a parameter.
-            double v = std::max(object->GetPositionVariance().T(),
+            double v = std::max(measurements[i].GetVariance(3),
                                 0.7*unit::ns);
             xx += i*i/v;
             x += i/v;
-            xy += i*object->GetPosition().T()/v;
-            y += object->GetPosition().T()/v;
+            xy += i*measurements[i].GetPosition(3)/v;
+            y += measurements[i].GetPosition(3)/v;
             s += 1.0/v;
         }
         double d = x*x - s*xx;
@@ -1253,10 +1407,9 @@ Cube::StochTrackFit::Apply(Cube::Handle<Cube::ReconTrack>& input) {
             if (!std::isfinite(t)) throw std::runtime_error("Bug in time");
 #endif
             Cube::Handle<Cube::TrackState> state = nodes[i]->GetState();
-            Cube::Handle<Cube::ReconCluster> object = nodes[i]->GetObject();
             TLorentzVector pos = state->GetPosition(); // Not by reference!!
             pos.SetT(t);
-            double dt = object->GetPosition().T() - t;
+            double dt = measurements[i].GetPosition(3) - t;
             double tt = dt*dt;
             tUnc += tt*tt;
             state->SetPosition(pos);
@@ -1293,12 +1446,17 @@ Cube::StochTrackFit::Apply(Cube::Handle<Cube::ReconTrack>& input) {
         state->SetCurvatureVariance(0.005,0.005,0.005);
     }
 
+    // The average number of samples used per node (and per pass).  This is
+    // saved in the overall track states.
+    int averageSamples = (int) (totalSamples/(2.0*nodes.size()) + 0.5);
+
     // Fill the overall track state at the front.
     Cube::Handle<Cube::TrackState> trackState = input->GetFront();
     Cube::Handle<Cube::TrackState> nodeState = nodes.front()->GetState();
     *trackState = *nodeState;
     trackState->SetEDeposit(energyDeposit);
     trackState->SetEDepositVariance(energyVariance);
+    trackState->SetSampleCount(averageSamples);
 
     // Fill the overall track state at the back.
     trackState = input->GetBack();
@@ -1306,6 +1464,7 @@ Cube::StochTrackFit::Apply(Cube::Handle<Cube::ReconTrack>& input) {
     *trackState = *nodeState;
     trackState->SetEDeposit(energyDeposit);
     trackState->SetEDepositVariance(energyVariance);
+    trackState->SetSampleCount(averageSamples);
 
     DebugState("Track",input->GetFront());
     DebugState("Back",input->GetBack());
@@ -1328,7 +1487,7 @@ Cube::StochTrackFit::Apply(Cube::Handle<Cube::ReconTrack>& input) {
 
     CUBE_LOG(1) << "Stochastic::"
                 << " " << nodes.size() << " nodes"
-                << " with " << fSampleCount << " samples"
+                << " with " << averageSamples << " samples per node"
                 << ", Chi-Squared: "  << chiSquared
                 << "/" << trackDOF << " d.o.f." << std::endl;
 
@@ -6,6 +6,8 @@
 #include <CubeReconTrack.hxx>
 #include <CubeHandle.hxx>
 
+#include <cstdint>
+
 namespace Cube {
     class StochTrackFit;
 };
@@ -39,19 +41,90 @@ public:
     /// Get the number of samples that will be used in the next call to Apply.
     int GetSampleCount() const {return fSampleCount;}
 
+    /// Let the number of samples change along the track.  When this is true,
+    /// the fit starts with GetSampleCount() samples (clamped to the limits),
+    /// and then the sample count is increased when the effective sample size
+    /// collapses, and decreased when the samples are much more than is
+    /// needed to describe the PDF.  The number of samples used for each node
+    /// is saved in the node state (see Cube::TrackState::GetSampleCount()).
+    void SetAdaptiveSampling(bool v) {fAdaptiveSampling = v;}
+
+    /// Check if the number of samples can change along the track.
+    bool GetAdaptiveSampling() const {return fAdaptiveSampling;}
+
+    /// Set the limits on the number of samples when adaptive sampling is
+    /// used.
+    void SetSampleCountLimits(int minimum, int maximum) {
+        fMinimumSampleCount = minimum;
+        fMaximumSampleCount = maximum;
+    }
+
+    /// Get the minimum number of samples used by adaptive sampling.
+    int GetMinimumSampleCount() const {return fMinimumSampleCount;}
+
+    /// Get the maximum number of samples used by adaptive sampling.
+    int GetMaximumSampleCount() const {return fMaximumSampleCount;}
+
     /// Set the size of the energy deposition calculation region.
     void SetDepositionWindow(double v) {fWidth = v;}
 
+    /// Set the cut (in standard deviations) used by the robust (Huber) fit
+    /// of the node times.  Nodes with a larger time residual (e.g. from late
+    /// light) are deweighted.  The default is zero, which gives the plain
+    /// least squares fit (see Cube::FitNodeTimes()).
+    void SetTimeHuberCut(double v) {fTimeHuberCut = v;}
+
+    /// Get the cut used by the robust fit of the node times.
+    double GetTimeHuberCut() const {return fTimeHuberCut;}
+
+    /// Set the seed for the random number streams.  Each track is fit with
+    /// its own stream that is keyed by this seed, the run and event numbers,
+    /// and the hits on the track, so the fit is reproducible and doesn't
+    /// depend on the order (or thread) that tracks are fit in.
+    void SetSeed(uint64_t s) {fSeed = s;}
+
+    /// Get the seed for the random number streams.
+    uint64_t GetSeed() const {return fSeed;}
+
+    /// Run the forward and backward filter passes at the same time (the
+    /// backward pass is run on a second thread).  Each pass has its own
+    /// random number stream, so the fit result is the same either way.  The
+    /// default is false since a thread is started for every fit, so this
+    /// should only be turned on when there are spare cores.  The passes
+    /// don't write to std::cout; the messages are saved and written after
+    /// both passes are finished.
+    void SetConcurrentPasses(bool v) {fConcurrentPasses = v;}
+
+    /// Check if the forward and backward passes are run at the same time.
+    bool GetConcurrentPasses() const {return fConcurrentPasses;}
+
 private:
     // The number of samples in the sample vector that is used to describe the
     // PDF.
     int fSampleCount;
 
+    // A flag that the number of samples may change along the track.
+    bool fAdaptiveSampling;
+
+    // The limits on the number of samples for adaptive sampling.
+    int fMinimumSampleCount;
+    int fMaximumSampleCount;
+
     // The define the region over which the energy deposition is calculated.
     // This can be thought of as the Gaussian window that the deposition is
     // averaged over.  The units are implementation specific (currently
     // indexed by node).
     double fWidth;
+
+    // The Huber cut (in standard deviations) for the node time fit.
+    double fTimeHuberCut;
+
+    // The user seed that is combined with the event and track identity to
+    // key the random number stream for each fit.
+    uint64_t fSeed;
+
+    // A flag that the forward and backward passes are run concurrently.
+    bool fConcurrentPasses;
 };
 #endif
 
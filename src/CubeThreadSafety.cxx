@@ -0,0 +1,20 @@
+#include "CubeThreadSafety.hxx"
+
+#include <TROOT.h>
+
+#include <mutex>
+
+namespace {
+    // The flag that ROOT has been told about the threads.
+    std::once_flag gEnableThreadSafety;
+}
+
+void Cube::EnableThreadSafety() {
+    std::call_once(gEnableThreadSafety, ROOT::EnableThreadSafety);
+}
+
+// Local Variables:
+// mode:c++
+// c-basic-offset:4
+// compile-command:"$(git rev-parse --show-toplevel)/build/cube-build.sh force"
+// End:
@@ -0,0 +1,17 @@
+#ifndef CubeThreadSafety_hxx_seen
+#define CubeThreadSafety_hxx_seen
+
+namespace Cube {
+    /// Tell ROOT that it's going to be used by several threads.  This must
+    /// be called before the first extra thread is started, and is only done
+    /// once (later calls do nothing).  It should only be called when a
+    /// thread is actually going to be started since it makes ROOT slower.
+    void EnableThreadSafety();
+};
+#endif
+
+// Local Variables:
+// mode:c++
+// c-basic-offset:4
+// compile-command:"$(git rev-parse --show-toplevel)/build/cube-build.sh force"
+// End:
@@ -1,5 +1,6 @@
 #include "CubeTimeSlice.hxx"
 #include "CubeClusterManagement.hxx"
+#include "CubeSortByKey.hxx"
 
 #include "CubeUnits.hxx"
 
@@ -10,10 +11,9 @@
 #include <algorithm>
 
 namespace {
-    struct timeSort {
-        bool operator() (const Cube::Handle<Cube::Hit>& lhs,
-                         const Cube::Handle<Cube::Hit>& rhs) {
-            return lhs->GetTime() < rhs->GetTime();
+    struct timeKey {
+        double operator() (const Cube::Handle<Cube::Hit>& hit) const {
+            return hit->GetTime();
         }
     };
 };
@@ -50,7 +50,7 @@ Cube::TimeSlice::Process(const Cube::AlgorithmResult& in,
 
     // Copy all of the input hits to the output
     std::copy(hits->begin(), hits->end(), std::back_inserter(*usedHits));
-    std::sort(usedHits->begin(), usedHits->end(), timeSort());
+    Cube::SortByKey(usedHits->begin(), usedHits->end(), timeKey());
 
     // Check for any gaps in the hits and build into separate clusters.
     Cube::HitSelection::iterator first = usedHits->begin();
@@ -0,0 +1,102 @@
+#include "CubeTrackEndIndex.hxx"
+
+#include <CubeLog.hxx>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+Cube::TrackEndIndex::TrackEndIndex(double cellSize)
+    : fCellSize(cellSize) {
+    if (!(fCellSize > 0.0)) {
+        CUBE_ERROR << "Invalid cell size " << cellSize << std::endl;
+        throw std::runtime_error("Invalid track end index cell size");
+    }
+}
+
+Cube::TrackEndIndex::~TrackEndIndex() {}
+
+Cube::TrackEndIndex::CellKey
+Cube::TrackEndIndex::FindCell(const TVector3& position) const {
+    return CellKey((int) std::floor(position.X()/fCellSize),
+                   (int) std::floor(position.Y()/fCellSize),
+                   (int) std::floor(position.Z()/fCellSize));
+}
+
+void Cube::TrackEndIndex::AddEnd(int key, const TVector3& position) {
+    fCells[FindCell(position)].push_back(Entry(key,position));
+}
+
+void Cube::TrackEndIndex::RemoveEnd(int key, const TVector3& position) {
+    std::map<CellKey, Cell>::iterator c = fCells.find(FindCell(position));
+    if (c == fCells.end()) return;
+    Cell& cell = c->second;
+    for (Cell::iterator e = cell.begin(); e != cell.end(); ++e) {
+        if (e->fKey != key) continue;
+        cell.erase(e);
+        break;
+    }
+    if (cell.empty()) fCells.erase(c);
+}
+
+void Cube::TrackEndIndex::Insert(int key,
+                                 const TVector3& front,
+                                 const TVector3& back) {
+    Remove(key);
+    fEnds[key] = std::make_pair(front,back);
+    AddEnd(key,front);
+    AddEnd(key,back);
+}
+
+void Cube::TrackEndIndex::Remove(int key) {
+    std::map<int, std::pair<TVector3,TVector3> >::iterator ends
+        = fEnds.find(key);
+    if (ends == fEnds.end()) return;
+    RemoveEnd(key,ends->second.first);
+    RemoveEnd(key,ends->second.second);
+    fEnds.erase(ends);
+}
+
+void Cube::TrackEndIndex::Collect(const TVector3& position, double radius,
+                                  std::vector<int>& keys) const {
+    if (fCells.empty()) return;
+    TVector3 corner(radius,radius,radius);
+    CellKey low = FindCell(position - corner);
+    CellKey high = FindCell(position + corner);
+    double radius2 = radius*radius;
+    for (int i = std::get<0>(low); i <= std::get<0>(high); ++i) {
+        for (int j = std::get<1>(low); j <= std::get<1>(high); ++j) {
+            for (int k = std::get<2>(low); k <= std::get<2>(high); ++k) {
+                std::map<CellKey, Cell>::const_iterator c
+                    = fCells.find(CellKey(i,j,k));
+                if (c == fCells.end()) continue;
+                for (Cell::const_iterator e = c->second.begin();
+                     e != c->second.end(); ++e) {
+                    if ((e->fPosition - position).Mag2() > radius2) continue;
+                    keys.push_back(e->fKey);
+                }
+            }
+        }
+    }
+}
+
+void Cube::TrackEndIndex::Query(const TVector3& position, double radius,
+                                std::vector<int>& keys) const {
+    Collect(position,radius,keys);
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+}
+
+void Cube::TrackEndIndex::Query(const TVector3& front, const TVector3& back,
+                                double radius, std::vector<int>& keys) const {
+    Collect(front,radius,keys);
+    Collect(back,radius,keys);
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+}
+
+// Local Variables:
+// mode:c++
+// c-basic-offset:4
+// compile-command:"$(git rev-parse --show-toplevel)/build/cube-build.sh force"
+// End:
@@ -0,0 +1,102 @@
+#ifndef CubeTrackEndIndex_hxx_seen
+#define CubeTrackEndIndex_hxx_seen
+
+#include <TVector3.h>
+
+#include <vector>
+#include <map>
+#include <tuple>
+
+namespace Cube {
+    class TrackEndIndex;
+};
+
+/// A spatial index of the end points of the tracks in a time slice.  Each
+/// track is added with an integer key (usually the position of the track in
+/// a container) and the positions of the two track ends.  The ends are kept
+/// on a uniform grid, so finding the tracks with an end near a position only
+/// looks at the grid cells that overlap the search radius.  This is used to
+/// avoid looking at every pair of tracks when only tracks with nearby ends
+/// can be matched.
+///
+/// \code
+/// Cube::TrackEndIndex index(10*unit::cm);
+/// for (int i = 0; i < tracks.size(); ++i) {
+///     index.Insert(i, tracks[i]->GetFront()->GetPosition().Vect(),
+///                  tracks[i]->GetBack()->GetPosition().Vect());
+/// }
+/// std::vector<int> near;
+/// index.Query(position, 5*unit::cm, near);
+/// \endcode
+class Cube::TrackEndIndex {
+public:
+    /// Construct the index.  The cell size should be about the same as the
+    /// typical search radius.
+    explicit TrackEndIndex(double cellSize);
+    virtual ~TrackEndIndex();
+
+    /// Add the ends of a track to the index.  If the key is already in the
+    /// index, the old ends are replaced.
+    void Insert(int key, const TVector3& front, const TVector3& back);
+
+    /// Remove a track from the index.  Nothing happens if the key isn't in
+    /// the index.
+    void Remove(int key);
+
+    /// Fill the keys for tracks that have an end within the radius of the
+    /// position.  The keys are appended to the output which is then sorted
+    /// with duplicates removed.  A track will appear once even if both ends
+    /// are near the position.
+    void Query(const TVector3& position, double radius,
+               std::vector<int>& keys) const;
+
+    /// Fill the keys for tracks that have an end within the radius of either
+    /// the front or back position.  See Query.
+    void Query(const TVector3& front, const TVector3& back, double radius,
+               std::vector<int>& keys) const;
+
+    /// Get the number of tracks in the index.
+    std::size_t size() const {return fEnds.size();}
+
+    /// Remove all of the tracks.
+    void clear() {fCells.clear(); fEnds.clear();}
+
+private:
+
+    typedef std::tuple<int,int,int> CellKey;
+
+    struct Entry {
+        Entry(int k, const TVector3& p) : fKey(k), fPosition(p) {}
+        int fKey;
+        TVector3 fPosition;
+    };
+
+    typedef std::vector<Entry> Cell;
+
+    /// Find the cell containing a position.
+    CellKey FindCell(const TVector3& position) const;
+
+    /// Add or remove one end of a track.
+    void AddEnd(int key, const TVector3& position);
+    void RemoveEnd(int key, const TVector3& position);
+
+    /// Add the keys for ends near a position without sorting.
+    void Collect(const TVector3& position, double radius,
+                 std::vector<int>& keys) const;
+
+    /// The size of a grid cell.
+    double fCellSize;
+
+    /// The occupied grid cells.
+    std::map<CellKey, Cell> fCells;
+
+    /// The front and back positions for each key.
+    std::map<int, std::pair<TVector3,TVector3> > fEnds;
+};
+#endif
+
+// Local Variables:
+// mode:c++
+// c-basic-offset:4
+// compile-command:"$(git rev-parse --show-toplevel)/build/cube-build.sh force"
+// End:
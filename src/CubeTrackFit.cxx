@@ -1,27 +1,404 @@
 #include "CubeTrackFit.hxx"
 #include "CubePCATrackFit.hxx"
 #include "CubeStochTrackFit.hxx"
+#include "CubeKalmanTrackFit.hxx"
+#include "CubePhiloxRandom.hxx"
+
+#include <CubeReconNode.hxx>
+#include <CubeEvent.hxx>
+#include <CubeLog.hxx>
+#include <CubeUnits.hxx>
+
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cmath>
+#include <mutex>
+#include <memory>
+
+namespace {
+    // A saved fit.  The states are saved in the order of the fitted track,
+    // and fReversed is true if the fitter reversed the node order.  The
+    // node object identifiers are saved in the order of the input track so
+    // that a cached fit is only used for the same nodes.
+    struct CachedFit {
+        bool fSuccess;
+        bool fReversed;
+        std::vector<UInt_t> fNodeIds;
+        std::vector<Cube::TrackState> fNodeStates;
+        Cube::TrackState fFront;
+        Cube::TrackState fBack;
+        Cube::ReconObject::Status fStatus;
+        double fQuality;
+        double fNDOF;
+        std::string fAlgorithm;
+        double fFitTime;
+    };
+
+    // The cache of fits for the current event.
+    typedef std::map<uint64_t, CachedFit> FitCache;
+    FitCache gFitCache;
+
+    // The event that the cache was filled for.
+    Cube::Event* gFitCacheEvent = NULL;
+    int gFitCacheRun = -1;
+    int gFitCacheEventId = -1;
+
+    // The cache statistics.
+    int gFitCacheHits = 0;
+    int gFitCacheMisses = 0;
+    int gFitCacheMismatches = 0;
+    double gFitCacheTimeSaved = 0.0;
+
+    // Protect the cache (and the statistics) when tracks are fit on several
+    // threads (see Cube::TrackFitBatch).  The lock isn't held while a track
+    // is being fit.
+    std::mutex gFitCacheMutex;
+
+    // Mix a double into a hash using the bit pattern.
+    uint64_t HashDouble(uint64_t key, double value) {
+        uint64_t bits = 0;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return Cube::PhiloxRandom::Hash(key, bits);
+    }
+
+    // Build the key for a track from the hits in each node (in order).
+    uint64_t TrackKey(const Cube::ReconTrack& track, uint64_t key) {
+        const Cube::ReconNodeContainer& nodes = track.GetNodes();
+        key = Cube::PhiloxRandom::Hash(key, nodes.size());
+        for (Cube::ReconNodeContainer::const_iterator n = nodes.begin();
+             n != nodes.end(); ++n) {
+            Cube::Handle<Cube::ReconObject> object = (*n)->GetObject();
+            if (!object) continue;
+            Cube::Handle<Cube::HitSelection> hits = object->GetHitSelection();
+            if (!hits) continue;
+            key = Cube::PhiloxRandom::Hash(key, hits->size());
+            for (Cube::HitSelection::const_iterator h = hits->begin();
+                 h != hits->end(); ++h) {
+                key = Cube::PhiloxRandom::Hash(key, (*h)->GetIdentifier());
+                key = HashDouble(key, (*h)->GetTime());
+                key = HashDouble(key, (*h)->GetCharge());
+            }
+        }
+        return key;
+    }
+
+    // Get the identifiers of the node objects (in order).
+    void NodeIds(const Cube::ReconTrack& track, std::vector<UInt_t>& ids) {
+        const Cube::ReconNodeContainer& nodes = track.GetNodes();
+        ids.clear();
+        for (Cube::ReconNodeContainer::const_iterator n = nodes.begin();
+             n != nodes.end(); ++n) {
+            Cube::Handle<Cube::ReconObject> object = (*n)->GetObject();
+            ids.push_back(object ? object->GetUniqueID() : 0);
+        }
+    }
+
+    // Check if two states are exactly the same.
+    bool SameState(const Cube::TrackState& a, const Cube::TrackState& b) {
+        if (a.GetDimensions() != b.GetDimensions()) return false;
+        for (int i=0; i<a.GetDimensions(); ++i) {
+            if (a.GetValue(i) != b.GetValue(i)) return false;
+            for (int j=0; j<a.GetDimensions(); ++j) {
+                if (a.GetCovarianceValue(i,j)
+                    != b.GetCovarianceValue(i,j)) return false;
+            }
+        }
+        return true;
+    }
+
+    // Save a fit result.  The input is the node object at the front of the
+    // track before the fit so that a reversal can be found, and the node
+    // object identifiers before the fit.
+    void SaveFit(CachedFit& saved,
+                 Cube::Handle<Cube::ReconTrack> result,
+                 Cube::Handle<Cube::ReconObject> front,
+                 const std::vector<UInt_t>& nodeIds) {
+        saved.fSuccess = false;
+        saved.fReversed = false;
+        saved.fNodeIds = nodeIds;
+        if (!result) return;
+        saved.fSuccess = true;
+        Cube::ReconNodeContainer& nodes = result->GetNodes();
+        saved.fReversed = (nodes.size() > 1
+                           && !(nodes.front()->GetObject() == front));
+        saved.fNodeStates.clear();
+        for (Cube::ReconNodeContainer::iterator n = nodes.begin();
+             n != nodes.end(); ++n) {
+            Cube::Handle<Cube::TrackState> state = (*n)->GetState();
+            saved.fNodeStates.push_back(*state);
+        }
+        saved.fFront = *result->GetFront();
+        saved.fBack = *result->GetBack();
+        saved.fStatus = result->GetStatus();
+        saved.fQuality = result->GetQuality();
+        saved.fNDOF = result->GetNDOF();
+        saved.fAlgorithm = result->GetAlgorithmName();
+    }
+
+    // Fill a track from a saved fit.  The track must have the same nodes as
+    // the one that was saved (see SameNodes()).
+    Cube::Handle<Cube::ReconTrack>
+    RestoreFit(const CachedFit& saved, Cube::Handle<Cube::ReconTrack> input) {
+        if (!saved.fSuccess) return Cube::Handle<Cube::ReconTrack>();
+        Cube::ReconNodeContainer& nodes = input->GetNodes();
+        if (saved.fReversed) std::reverse(nodes.begin(), nodes.end());
+        for (std::size_t i = 0; i < nodes.size(); ++i) {
+            Cube::Handle<Cube::TrackState> state = nodes[i]->GetState();
+            *state = saved.fNodeStates[i];
+        }
+        *input->GetFront() = saved.fFront;
+        *input->GetBack() = saved.fBack;
+        input->ClearStatus(input->GetStatus());
+        input->SetStatus(saved.fStatus);
+        input->SetQuality(saved.fQuality);
+        input->SetNDOF(saved.fNDOF);
+        input->SetAlgorithmName(saved.fAlgorithm.c_str());
+        return input;
+    }
+
+    // Check that a saved fit is for the same node objects (in the same
+    // order) as the input track.  This protects against a key collision, and
+    // against a track with the same hits in different node objects.
+    bool SameNodes(const CachedFit& saved,
+                   const std::vector<UInt_t>& nodeIds) {
+        if (saved.fNodeIds != nodeIds) return false;
+        if (!saved.fSuccess) return true;
+        return saved.fNodeStates.size() == nodeIds.size();
+    }
+
+    // Empty the cache and reset the statistics.  The cache must be locked.
+    void ClearFitCache() {
+        gFitCache.clear();
+        gFitCacheEvent = NULL;
+        gFitCacheHits = 0;
+        gFitCacheMisses = 0;
+        gFitCacheMismatches = 0;
+        gFitCacheTimeSaved = 0.0;
+    }
+
+    // Make sure the cache belongs to the current event.  This returns false
+    // if there isn't a current event (so the cache can't be used).  The
+    // cache must be locked.
+    bool CheckCacheEvent() {
+        Cube::Event* event = Cube::Event::CurrentEvent();
+        if (!event) return false;
+        if (event == gFitCacheEvent
+            && event->GetRunId() == gFitCacheRun
+            && event->GetEventId() == gFitCacheEventId) return true;
+        if (gFitCacheHits > 0 || gFitCacheMisses > 0) {
+            CUBE_LOG(1) << "TrackFit cache: " << gFitCacheHits << " hits"
+                        << ", " << gFitCacheMisses << " misses"
+                        << ", " << gFitCacheTimeSaved << " s saved"
+                        << std::endl;
+        }
+        ClearFitCache();
+        gFitCacheEvent = event;
+        gFitCacheRun = event->GetRunId();
+        gFitCacheEventId = event->GetEventId();
+        return true;
+    }
+}
 
 Cube::TrackFit::TrackFit()
-    : fStochastic(NULL), fPCA(NULL) {}
+    : fUseCache(true), fCheckCache(false),
+      fConfigurationChanged(true), fConfigurationKey(0),
+      fUseKalman(true), fConcurrentPasses(false),
+      fAdaptiveSampling(false),
+      fMinimumSampleCount(100), fMaximumSampleCount(4000),
+      fTimeHuberCut(0.0),
+      fKalman(NULL), fStochastic(NULL), fPCA(NULL) {}
 Cube::TrackFit::~TrackFit() {
+    if (fKalman) delete fKalman;
     if (fStochastic) delete fStochastic;
     if (fPCA) delete fPCA;
 }
 
+void Cube::TrackFit::SetConcurrentPasses(bool v) {
+    fConcurrentPasses = v;
+    if (fStochastic) fStochastic->SetConcurrentPasses(v);
+}
+
+void Cube::TrackFit::SetAdaptiveSampling(bool v) {
+    fAdaptiveSampling = v;
+    if (fStochastic) fStochastic->SetAdaptiveSampling(v);
+    fConfigurationChanged = true;
+}
+
+void Cube::TrackFit::SetSampleCountLimits(int minimum, int maximum) {
+    fMinimumSampleCount = minimum;
+    fMaximumSampleCount = maximum;
+    if (fStochastic) fStochastic->SetSampleCountLimits(minimum,maximum);
+    fConfigurationChanged = true;
+}
+
+void Cube::TrackFit::SetTimeHuberCut(double v) {
+    fTimeHuberCut = v;
+    if (fStochastic) fStochastic->SetTimeHuberCut(v);
+    fConfigurationChanged = true;
+}
+
+void Cube::TrackFit::ConfigureStochastic(
+    Cube::StochTrackFit& stochastic) const {
+    stochastic.SetConcurrentPasses(fConcurrentPasses);
+    stochastic.SetAdaptiveSampling(fAdaptiveSampling);
+    stochastic.SetSampleCountLimits(fMinimumSampleCount,fMaximumSampleCount);
+    stochastic.SetTimeHuberCut(fTimeHuberCut);
+}
+
+int Cube::TrackFit::GetCacheHits() {
+    std::lock_guard<std::mutex> lock(gFitCacheMutex);
+    return gFitCacheHits;
+}
+
+int Cube::TrackFit::GetCacheMisses() {
+    std::lock_guard<std::mutex> lock(gFitCacheMutex);
+    return gFitCacheMisses;
+}
+
+double Cube::TrackFit::GetCacheTimeSaved() {
+    std::lock_guard<std::mutex> lock(gFitCacheMutex);
+    return gFitCacheTimeSaved;
+}
+
+int Cube::TrackFit::GetCacheMismatches() {
+    std::lock_guard<std::mutex> lock(gFitCacheMutex);
+    return gFitCacheMismatches;
+}
+
+void Cube::TrackFit::ClearCache() {
+    std::lock_guard<std::mutex> lock(gFitCacheMutex);
+    ClearFitCache();
+}
+
+uint64_t Cube::TrackFit::ConfigurationKey() {
+    if (!fConfigurationChanged) return fConfigurationKey;
+    fConfigurationChanged = false;
+    uint64_t key = Cube::PhiloxRandom::Hash(0, fUseKalman);
+    // Use a default fitter to describe the configuration of a fitter that
+    // hasn't been created yet.
+    Cube::StochTrackFit defaultStochastic;
+    ConfigureStochastic(defaultStochastic);
+    const Cube::StochTrackFit* stochastic = fStochastic;
+    if (!stochastic) stochastic = &defaultStochastic;
+    key = Cube::PhiloxRandom::Hash(key, stochastic->GetSampleCount());
+    key = Cube::PhiloxRandom::Hash(key, stochastic->GetSeed());
+    key = Cube::PhiloxRandom::Hash(key, stochastic->GetAdaptiveSampling());
+    key = Cube::PhiloxRandom::Hash(key, stochastic->GetMinimumSampleCount());
+    key = Cube::PhiloxRandom::Hash(key, stochastic->GetMaximumSampleCount());
+    key = HashDouble(key, stochastic->GetTimeHuberCut());
+    if (fUseKalman) {
+        Cube::KalmanTrackFit defaultKalman;
+        const Cube::KalmanTrackFit* kalman = fKalman;
+        if (!kalman) kalman = &defaultKalman;
+        key = HashDouble(key, kalman->GetScatteringSigma());
+        key = HashDouble(key, kalman->GetMaximumChi2PerDOF());
+        key = HashDouble(key, kalman->GetMaximumNodeChi2());
+    }
+    fConfigurationKey = key;
+    return key;
+}
+
 Cube::Handle<Cube::ReconTrack>
 Cube::TrackFit::Apply(Cube::Handle<Cube::ReconTrack>& input) {
+    if (!fUseCache || !input) return FitTrack(input);
+
+    uint64_t key = TrackKey(*input, ConfigurationKey());
+    Cube::Handle<Cube::ReconObject> front;
+    if (!input->GetNodes().empty()) {
+        front = input->GetNodes().front()->GetObject();
+    }
+    std::vector<UInt_t> nodeIds;
+    NodeIds(*input, nodeIds);
+
+    std::unique_lock<std::mutex> lock(gFitCacheMutex);
+    if (!CheckCacheEvent()) {
+        lock.unlock();
+        return FitTrack(input);
+    }
+
+    FitCache::iterator found = gFitCache.find(key);
+    if (found != gFitCache.end() && SameNodes(found->second, nodeIds)) {
+        ++gFitCacheHits;
+        gFitCacheTimeSaved += found->second.fFitTime;
+        // Copy the saved fit so the lock can be released.
+        std::unique_ptr<CachedFit> cached(new CachedFit(found->second));
+        lock.unlock();
+        if (!fCheckCache) return RestoreFit(*cached, input);
+        // Check that the cached fit matches a new fit of the input track.
+        // The input is fit in place (a copy would need a new object
+        // identifier, and this can be run on the Cube::TrackFitBatch
+        // threads), so the new fit is returned.
+        CachedFit check;
+        Cube::Handle<Cube::ReconTrack> result = FitTrack(input);
+        SaveFit(check, result, front, nodeIds);
+        bool same = (check.fSuccess == cached->fSuccess);
+        if (same && check.fSuccess) {
+            same = (check.fReversed == cached->fReversed)
+                && (check.fQuality == cached->fQuality)
+                && (check.fNodeStates.size()
+                    == cached->fNodeStates.size())
+                && SameState(check.fFront, cached->fFront)
+                && SameState(check.fBack, cached->fBack);
+            for (std::size_t i = 0;
+                 same && i < check.fNodeStates.size(); ++i) {
+                same = SameState(check.fNodeStates[i],
+                                 cached->fNodeStates[i]);
+            }
+        }
+        if (!same) {
+            lock.lock();
+            ++gFitCacheMismatches;
+            lock.unlock();
+            CUBE_ERROR << "Cached track fit differs from a new fit"
+                       << std::endl;
+        }
+        return result;
+    }
+
+    ++gFitCacheMisses;
+    lock.unlock();
+    std::chrono::steady_clock::time_point start
+        = std::chrono::steady_clock::now();
+    Cube::Handle<Cube::ReconTrack> result = FitTrack(input);
+    std::chrono::steady_clock::time_point stop
+        = std::chrono::steady_clock::now();
+    CachedFit saved;
+    SaveFit(saved, result, front, nodeIds);
+    saved.fFitTime = std::chrono::duration<double>(stop-start).count();
+    lock.lock();
+    gFitCache[key] = saved;
+
+    return result;
+}
+
+Cube::Handle<Cube::ReconTrack>
+Cube::TrackFit::FitTrack(Cube::Handle<Cube::ReconTrack>& input) {
     Cube::Handle<Cube::ReconTrack> result;
 
+    // Try the Kalman filter.  It's fast, and fails when the track isn't
+    // well described by Gaussian scattering (a bad chi2, or a kink).
+    if (fUseKalman) {
+        if (!fKalman) {
+            fKalman = new Cube::KalmanTrackFit;
+        }
+
+        result = fKalman->Apply(input);
+
+        if (result) return result;
+    }
+
     // Try to apply the stochastic stocastic fitter.
     if (!fStochastic) {
         fStochastic = new Cube::StochTrackFit;
+        ConfigureStochastic(*fStochastic);
     }
 
     result = fStochastic->Apply(input);
 
-    // If theres a successful result, return it. (not very useful without
-    // multiple fitters!).
+    // If theres a successful result, return it.
     if (result) return result;
 
     // Try to apply the PCA fitter.  It should always work, but only fits a
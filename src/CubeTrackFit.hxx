@@ -6,10 +6,13 @@
 #include <CubeReconTrack.hxx>
 #include <CubeHandle.hxx>
 
+#include <cstdint>
+
 namespace Cube {
     class TrackFit;
     class PCATrackFit;
     class StochTrackFit;
+    class KalmanTrackFit;
 };
 
 /// A class to fit the skeleton of a track.  The track is expected to have
@@ -28,6 +31,21 @@ namespace Cube {
 /// fitting ReconTrack objects, not ReconPID objects.  ReconPID objects
 /// must be fit with a different class.
 ///
+/// The fitters are tried in order of cost.  The Cube::KalmanTrackFit is
+/// tried first, and is accepted unless the chi-squared is bad, or a node is
+/// inconsistent with the track (e.g. a kink).  The fit then escalates to the
+/// Cube::StochTrackFit, and finally to the Cube::PCATrackFit which should
+/// always work (but only fits a straight line).
+///
+/// The fit results are cached for the current event (see
+/// Cube::Event::CurrentEvent()).  The cache is keyed by the hits in each node
+/// (in order) and the fitter configuration, so a track that is rebuilt
+/// without changing its hits (e.g. by GrowTracks or MergeXTalk) gets the
+/// saved fit instead of being refit.  A saved fit is only used when the
+/// track has the same node objects (in the same order).  Since the fitters
+/// are deterministic for a fixed input, the cached result is identical to a
+/// new fit.
+///
 /// Most code should be using Cube::TrackFit which will choose the best fitter
 /// to use in each circumstance.  How to use these fitting classes:
 ///
@@ -71,10 +89,115 @@ public:
     Cube::PCATrackFit* GetPCA() {return fPCA;}
 
     // Return a pointer to the stochastic track fitter (it may be NULL).
-    Cube::StochTrackFit* GetStochastic() {return fStochastic;}
+    // The fitter configuration can be changed through the pointer, so the
+    // cache key is recalculated for the next fit.
+    Cube::StochTrackFit* GetStochastic() {
+        fConfigurationChanged = true;
+        return fStochastic;
+    }
+
+    // Return a pointer to the Kalman track fitter (it may be NULL).  The
+    // cache key is recalculated for the next fit.
+    Cube::KalmanTrackFit* GetKalman() {
+        fConfigurationChanged = true;
+        return fKalman;
+    }
+
+    /// Set if the Kalman filter should be tried before the stochastic
+    /// fitter (the default is true).
+    void SetUseKalman(bool v) {fUseKalman = v; fConfigurationChanged = true;}
+
+    /// Set if the stochastic fitter runs the forward and backward passes
+    /// at the same time (see Cube::StochTrackFit::SetConcurrentPasses).  The
+    /// default is false.  The result is the same either way.
+    void SetConcurrentPasses(bool v);
+
+    /// Set if the stochastic fitter can change the number of samples along
+    /// the track (see Cube::StochTrackFit::SetAdaptiveSampling).  The default
+    /// is false.
+    void SetAdaptiveSampling(bool v);
+
+    /// Set the limits on the number of samples used by the stochastic fitter
+    /// when the sampling is adaptive (see
+    /// Cube::StochTrackFit::SetSampleCountLimits).
+    void SetSampleCountLimits(int minimum, int maximum);
+
+    /// Set the cut (in standard deviations) used by the stochastic fitter
+    /// for the robust fit of the node times (see
+    /// Cube::StochTrackFit::SetTimeHuberCut).  The default is zero, which
+    /// gives the plain least squares fit.
+    void SetTimeHuberCut(double v);
+
+    /// Set if the per-event fit cache should be used (the default is true).
+    void SetUseCache(bool v) {fUseCache = v;}
+
+    /// Set if every cached fit should be checked against a new fit.  This
+    /// is slow, and is intended for validation.  A mismatch is reported as
+    /// an error.
+    void SetCheckCache(bool v) {fCheckCache = v;}
+
+    /// Get the number of fits that were found in the cache.
+    static int GetCacheHits();
+
+    /// Get the number of fits that were not found in the cache.
+    static int GetCacheMisses();
+
+    /// Get the fitting time (in seconds) that was saved by using the cache.
+    static double GetCacheTimeSaved();
+
+    /// Get the number of cached fits that were different from a new fit
+    /// (only filled when SetCheckCache(true)).
+    static int GetCacheMismatches();
+
+    /// Remove all of the fits from the cache.  This is done automatically
+    /// when the current event changes.
+    static void ClearCache();
 
 private:
 
+    /// Apply the fitters (without the cache).
+    Cube::Handle<Cube::ReconTrack>
+    FitTrack(Cube::Handle<Cube::ReconTrack>& input);
+
+    /// Get the key for the fitter configuration.  The key is only
+    /// recalculated after the configuration might have changed.
+    uint64_t ConfigurationKey();
+
+    /// Copy the stochastic fitter settings into a new stochastic fitter.
+    void ConfigureStochastic(Cube::StochTrackFit& stochastic) const;
+
+    /// A flag that the fit cache should be used.
+    bool fUseCache;
+
+    /// A flag that cached fits should be checked.
+    bool fCheckCache;
+
+    /// A flag that the configuration key needs to be recalculated.
+    bool fConfigurationChanged;
+
+    /// The key for the fitter configuration.
+    uint64_t fConfigurationKey;
+
+    /// A flag that the Kalman fitter should be tried first.
+    bool fUseKalman;
+
+    /// A flag that the stochastic fitter passes are run at the same time.
+    bool fConcurrentPasses;
+
+    /// A flag that the stochastic fitter uses adaptive sampling.
+    bool fAdaptiveSampling;
+
+    /// The limits on the number of samples for adaptive sampling.
+    int fMinimumSampleCount;
+    int fMaximumSampleCount;
+
+    /// The Huber cut for the stochastic fitter node time fit.
+    double fTimeHuberCut;
+
+    /// A pointer to the Kalman fitter.  This is only instantiated if the
+    /// fitter is used.
+    Cube::KalmanTrackFit* fKalman;
+
     /// A pointer to the stochastic stocastic fitter.  This is only
     /// instantiated if the fitter is used.
     Cube::StochTrackFit* fStochastic;
@@ -0,0 +1,197 @@
+#include "CubeTrackFitBatch.hxx"
+#include "CubeTrackFit.hxx"
+#include "CubeThreadSafety.hxx"
+
+#include <CubeReconNode.hxx>
+#include <CubeReconObject.hxx>
+#include <CubeLog.hxx>
+
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <exception>
+#include <algorithm>
+#include <sstream>
+#include <memory>
+#include <set>
+
+namespace {
+    // The number of threads to use when a count isn't provided.  The tracks
+    // are fit on the calling thread unless more threads are requested.
+    int gDefaultThreadCount = 1;
+
+    // Order the tracks so the longest are fit first.  The index is used to
+    // break ties so the schedule is reproducible.
+    struct LongestFirst {
+        explicit LongestFirst(const Cube::TrackFitBatch::TrackVector& t)
+            : fTracks(t) {}
+        bool operator () (int a, int b) const {
+            int aSize = fTracks[a] ? fTracks[a]->GetNodes().size() : 0;
+            int bSize = fTracks[b] ? fTracks[b]->GetNodes().size() : 0;
+            if (aSize != bSize) return aSize > bSize;
+            return a < b;
+        }
+        const Cube::TrackFitBatch::TrackVector& fTracks;
+    };
+
+    // Add a pointer to the set, and return true if it was already there.
+    bool AlreadySeen(std::set<const TObject*>& seen, const TObject* object) {
+        if (!object) return false;
+        return !seen.insert(object).second;
+    }
+
+    // Check if any node, node state, node object, or hit selection is used
+    // by more than one track.  The handles to these objects are copied while
+    // a track is fit, and the reference counts aren't thread safe.  The hits
+    // are only read through the hit selections (the hit handles aren't
+    // copied), so the tracks can share hits.
+    bool SharedHandles(const Cube::TrackFitBatch::TrackVector& tracks) {
+        std::set<const TObject*> seen;
+        for (Cube::TrackFitBatch::TrackVector::const_iterator t
+                 = tracks.begin();
+             t != tracks.end(); ++t) {
+            if (!*t) continue;
+            const Cube::ReconNodeContainer& nodes = (*t)->GetNodes();
+            for (Cube::ReconNodeContainer::const_iterator n = nodes.begin();
+                 n != nodes.end(); ++n) {
+                if (AlreadySeen(seen, Cube::GetPointer(*n))) return true;
+                Cube::Handle<Cube::ReconState> state = (*n)->GetState();
+                if (AlreadySeen(seen, Cube::GetPointer(state))) return true;
+                Cube::Handle<Cube::ReconObject> object = (*n)->GetObject();
+                if (!object) continue;
+                if (AlreadySeen(seen, Cube::GetPointer(object))) return true;
+                Cube::Handle<Cube::HitSelection> hits
+                    = object->GetHitSelection();
+                if (AlreadySeen(seen, Cube::GetPointer(hits))) return true;
+            }
+        }
+        return false;
+    }
+
+    // The work shared between the threads fitting a batch.  Each thread
+    // takes the next track from the schedule until the schedule is empty.
+    // Each thread writes a different element of the output, so the only
+    // shared state is the index of the next track.
+    struct BatchWork {
+        BatchWork(Cube::TrackFitBatch::TrackVector& input,
+                  Cube::TrackFitBatch::TrackVector& output,
+                  const std::vector<int>& schedule, bool useCache)
+            : fInput(input), fOutput(output), fSchedule(schedule),
+              fUseCache(useCache), fNext(0) {}
+
+        void operator () () {
+            // Each thread has its own fitter since the fitters keep state.
+            // The fitter runs the stochastic filter passes one after the
+            // other, so the only threads are the ones the batch starts.
+            Cube::TrackFit fitter;
+            fitter.SetUseCache(fUseCache);
+            fitter.SetConcurrentPasses(false);
+            try {
+                while (true) {
+                    std::size_t next = fNext++;
+                    if (next >= fSchedule.size()) break;
+                    int index = fSchedule[next];
+                    if (!fInput[index]) continue;
+                    fOutput[index] = fitter(fInput[index]);
+                }
+            }
+            catch (...) {
+                // Stop the other threads, and save the first exception so
+                // it can be rethrown on the calling thread.
+                fNext = fSchedule.size();
+                std::lock_guard<std::mutex> lock(fErrorMutex);
+                if (!fError) fError = std::current_exception();
+            }
+        }
+
+        // Run the work on a worker thread.  The log messages are written to
+        // a buffer since the calling thread is writing to std::cout.
+        void RunWorker(std::ostream* log) {
+            Cube::LogStreamPointer() = log;
+            (*this)();
+            Cube::LogStreamPointer() = NULL;
+        }
+
+        Cube::TrackFitBatch::TrackVector& fInput;
+        Cube::TrackFitBatch::TrackVector& fOutput;
+        const std::vector<int>& fSchedule;
+        bool fUseCache;
+        std::atomic<std::size_t> fNext;
+        std::mutex fErrorMutex;
+        std::exception_ptr fError;
+    };
+}
+
+Cube::TrackFitBatch::TrackFitBatch(int threads)
+    : fThreadCount(1), fUseCache(true) {
+    SetThreadCount(threads);
+}
+
+Cube::TrackFitBatch::~TrackFitBatch() {}
+
+void Cube::TrackFitBatch::SetDefaultThreadCount(int threads) {
+    if (threads < 1) threads = std::thread::hardware_concurrency();
+    gDefaultThreadCount = std::max(1,threads);
+}
+
+void Cube::TrackFitBatch::SetThreadCount(int threads) {
+    if (threads < 1) threads = gDefaultThreadCount;
+    fThreadCount = std::max(1,threads);
+}
+
+Cube::TrackFitBatch::TrackVector
+Cube::TrackFitBatch::Apply(Cube::TrackFitBatch::TrackVector& input) {
+    TrackVector output(input.size());
+
+    // Schedule the tracks longest first.
+    std::vector<int> schedule(input.size());
+    for (std::size_t i = 0; i < input.size(); ++i) schedule[i] = i;
+    std::sort(schedule.begin(), schedule.end(), LongestFirst(input));
+
+    int threads = std::min(fThreadCount, (int) input.size());
+    if (threads > 1 && SharedHandles(input)) {
+        CUBE_LOG(1) << "TrackFitBatch: Tracks share node objects."
+                    << " Fitting on one thread." << std::endl;
+        threads = 1;
+    }
+
+    BatchWork work(input, output, schedule, fUseCache);
+
+    CUBE_LOG(2) << "TrackFitBatch: Fit " << input.size() << " tracks"
+                << " with " << std::max(threads,1) << " threads"
+                << std::endl;
+
+    if (threads > 1) {
+        Cube::EnableThreadSafety();
+    }
+
+    // The calling thread does a share of the work.  The workers write their
+    // log messages into buffers that are written here after they finish.
+    std::vector<std::thread> workers;
+    std::vector< std::unique_ptr<std::ostringstream> > logs;
+    for (int i = 1; i < threads; ++i) {
+        logs.push_back(
+            std::unique_ptr<std::ostringstream>(new std::ostringstream));
+        workers.push_back(std::thread(&BatchWork::RunWorker,
+                                      &work, logs.back().get()));
+    }
+    work();
+    for (std::vector<std::thread>::iterator w = workers.begin();
+         w != workers.end(); ++w) {
+        w->join();
+    }
+    for (std::size_t i = 0; i < logs.size(); ++i) {
+        std::string text = logs[i]->str();
+        if (!text.empty()) Cube::LogStream() << text << std::flush;
+    }
+
+    if (work.fError) std::rethrow_exception(work.fError);
+
+    return output;
+}
+
+// Local Variables:
+// mode:c++
+// c-basic-offset:4
+// compile-command:"$(git rev-parse --show-toplevel)/build/cube-build.sh force"
+// End:
@@ -0,0 +1,84 @@
+#ifndef CubeTrackFitBatch_hxx_seen
+#define CubeTrackFitBatch_hxx_seen
+
+#include <CubeReconTrack.hxx>
+#include <CubeHandle.hxx>
+
+#include <vector>
+
+namespace Cube {
+    class TrackFitBatch;
+};
+
+/// Fit a batch of tracks (usually all of the tracks in a time slice) using
+/// several threads.  Each track is fit with Cube::TrackFit, and the result
+/// is the same as fitting the tracks one at a time.  The tracks are
+/// scheduled longest first (by number of nodes) so that a long track doesn't
+/// end up being fit alone at the end of the batch.  The fitted tracks are
+/// returned in the same order as the input, and a track that failed to fit
+/// gets an empty handle (the same as Cube::TrackFit).
+///
+/// \code
+/// Cube::TrackFitBatch fitBatch;
+/// Cube::TrackFitBatch::TrackVector fitted = fitBatch(tracks);
+/// \endcode
+///
+/// The batch is fit on the calling thread unless more threads are requested
+/// with SetThreadCount or SetDefaultThreadCount.  The reference counting in
+/// Cube::Handle isn't thread safe, so the tracks in a batch must not share
+/// nodes, node states, node objects, or hit selections (which is true for
+/// tracks made by the Cube::CreateTrack functions).  If two tracks in the
+/// batch share one of these, the batch is fit on the calling thread.  The
+/// fits only read the hits, so the tracks may share hits.  The log messages
+/// from the worker threads are saved, and written by the calling thread
+/// after the batch is finished.
+class Cube::TrackFitBatch {
+public:
+    typedef std::vector< Cube::Handle<Cube::ReconTrack> > TrackVector;
+
+    /// Construct the batch fitter.  The optional argument is the maximum
+    /// number of threads to use.  If it's zero (or less), the default
+    /// number of threads is used (see SetThreadCount).
+    explicit TrackFitBatch(int threads = 0);
+    virtual ~TrackFitBatch();
+
+    /// Fit all of the tracks in the input.  The output vector has one entry
+    /// for each input track (in the same order).
+    TrackVector Apply(TrackVector& input);
+
+    /// Fit all of the tracks in the input.  See Apply.
+    TrackVector operator ()(TrackVector& input) {return Apply(input);}
+
+    /// Set the maximum number of threads to use.  If the value is zero (or
+    /// less), this uses the default set with SetDefaultThreadCount (one
+    /// thread if there isn't a default).
+    void SetThreadCount(int threads);
+
+    /// Get the maximum number of threads that will be used.
+    int GetThreadCount() const {return fThreadCount;}
+
+    /// Set the number of threads used by a batch fitter that is constructed
+    /// without a thread count (e.g. inside of an algorithm).  The default
+    /// is one thread.  If the value is zero (or less), the number of
+    /// hardware threads is used.
+    static void SetDefaultThreadCount(int threads);
+
+    /// Set if the Cube::TrackFit cache should be used (the default is
+    /// true).  See Cube::TrackFit::SetUseCache.
+    void SetUseCache(bool v) {fUseCache = v;}
+
+private:
+
+    /// The maximum number of threads to use.
+    int fThreadCount;
+
+    /// A flag that the fit cache should be used.
+    bool fUseCache;
+};
+#endif
+
+// Local Variables:
+// mode:c++
+// c-basic-offset:4
+// compile-command:"$(git rev-parse --show-toplevel)/build/cube-build.sh force"
+// End:
@@ -0,0 +1,76 @@
+#include "CubeTrackMeasurements.hxx"
+
+#include <CubeLog.hxx>
+#include <CubeUnits.hxx>
+
+#include <stdexcept>
+#include <cmath>
+
+double Cube::MultipleScatteringAngle(double mass, double mom,
+                                     double radLen, double dist) {
+    if (mass < 1.0*unit::MeV) {
+        // Electrons don't multiple scatter, so return a big value to take
+        // into account how "flexible" the track is.
+        return 0.10;
+    }
+    double enr = std::sqrt(mass*mass + mom*mom);
+    double beta = std::sqrt(1.0-mass*mass/enr/enr);
+    double sqrtRadLen = std::sqrt(radLen);
+    double logCorr = 1.0 - 0.038*std::log(dist/sqrtRadLen/sqrtRadLen);
+    return (13.6*unit::MeV*logCorr)/(beta*mom*sqrtRadLen);
+}
+
+Cube::TrackMeasurement::TrackMeasurement()
+    : fEDeposit(0), fEDepositVariance(0), fHitCount(0) {
+    for (int i=0; i<4; ++i) {
+        fPosition[i] = 0.0;
+        fVariance[i] = 0.0;
+    }
+    for (int i=0; i<3; ++i) {
+        for (int j=0; j<3; ++j) fMoments[i][j] = 0.0;
+    }
+}
+
+Cube::TrackMeasurement::TrackMeasurement(const Cube::ReconCluster& cluster) {
+    // Get the state once, and copy the values out of it.
+    Cube::Handle<Cube::ClusterState> state = cluster.GetState();
+    if (!state) throw std::runtime_error("Cluster state missing");
+    TLorentzVector pos = state->GetPosition();
+    TLorentzVector var = state->GetPositionVariance();
+    for (int i=0; i<4; ++i) {
+        fPosition[i] = pos[i];
+        fVariance[i] = var[i];
+    }
+    fEDeposit = state->GetEDeposit();
+    fEDepositVariance = state->GetEDepositVariance();
+    const Cube::ReconCluster::MomentMatrix& moments = cluster.GetMoments();
+    for (int i=0; i<3; ++i) {
+        for (int j=0; j<3; ++j) fMoments[i][j] = moments(i,j);
+    }
+    fHitCount = 0;
+    if (cluster.GetHitSelection()) {
+        fHitCount = cluster.GetHitSelection()->size();
+    }
+}
+
+bool Cube::TrackMeasurements::Fill(const Cube::ReconNodeContainer& nodes) {
+    fMeasurements.clear();
+    fMeasurements.reserve(nodes.size());
+    for (Cube::ReconNodeContainer::const_iterator n = nodes.begin();
+         n != nodes.end(); ++n) {
+        Cube::Handle<Cube::ReconCluster> cluster = (*n)->GetObject();
+        if (!cluster) {
+            CUBE_ERROR << "Missing cluster in track" << std::endl;
+            fMeasurements.clear();
+            return false;
+        }
+        fMeasurements.push_back(Cube::TrackMeasurement(*cluster));
+    }
+    return true;
+}
+
+// Local Variables:
+// mode:c++
+// c-basic-offset:4
+// compile-command:"$(git rev-parse --show-toplevel)/build/cube-build.sh force"
+// End:
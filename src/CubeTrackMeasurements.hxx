@@ -0,0 +1,125 @@
+#ifndef CubeTrackMeasurements_hxx_seen
+#define CubeTrackMeasurements_hxx_seen
+
+#include <CubeReconNode.hxx>
+#include <CubeReconCluster.hxx>
+#include <CubeHandle.hxx>
+
+#include <TLorentzVector.h>
+#include <TVector3.h>
+
+#include <vector>
+
+namespace Cube {
+    class TrackMeasurement;
+    class TrackMeasurements;
+
+    /// Estimate the multiple scattering angle for a particle of the given
+    /// mass and momentum traveling the distance through a material with the
+    /// radiation length using the PDG (Highland) formula.  The mass,
+    /// momentum and lengths are HEP units.  This is shared by the track
+    /// fitters so that they use the same noise.
+    double MultipleScatteringAngle(double mass, double mom,
+                                   double radLen, double dist);
+};
+
+/// The values from a track node object (a Cube::ReconCluster) that are used
+/// by the track fitters.  This is a plain copy of the cluster position,
+/// uncertainty, energy deposit and moments, so that the fitters can read
+/// them without going through the handles (each handle dereference is a
+/// dynamic_cast, and the cluster accessors return the values by copy).
+class Cube::TrackMeasurement {
+public:
+    TrackMeasurement();
+
+    /// Copy the values from a cluster.
+    explicit TrackMeasurement(const Cube::ReconCluster& cluster);
+
+    /// Get the X, Y, Z, or T coordinate (index 0 to 3).
+    double GetPosition(int i) const {return fPosition[i];}
+
+    /// Get the X, Y, Z, or T variance (index 0 to 3).
+    double GetVariance(int i) const {return fVariance[i];}
+
+    /// Get the position as a four vector.
+    TLorentzVector GetFourPosition() const {
+        return TLorentzVector(fPosition[0],fPosition[1],
+                              fPosition[2],fPosition[3]);
+    }
+
+    /// Get the spatial position.
+    TVector3 GetSpatialPosition() const {
+        return TVector3(fPosition[0],fPosition[1],fPosition[2]);
+    }
+
+    /// Get the energy deposit.
+    double GetEDeposit() const {return fEDeposit;}
+
+    /// Get the energy deposit variance.
+    double GetEDepositVariance() const {return fEDepositVariance;}
+
+    /// Get the (i,j) moment of the charge distribution.
+    double GetMoment(int i, int j) const {return fMoments[i][j];}
+
+    /// Get the number of hits in the cluster.
+    int GetHitCount() const {return fHitCount;}
+
+private:
+    double fPosition[4];
+    double fVariance[4];
+    double fEDeposit;
+    double fEDepositVariance;
+    double fMoments[3][3];
+    int fHitCount;
+};
+
+/// A contiguous block of the measurements for every node in a track (in node
+/// order).  The block is filled once at the start of a fit, and then used by
+/// the fitter instead of the node objects.
+///
+/// \code
+/// Cube::TrackMeasurements meas(track->GetNodes());
+/// for (std::size_t i = 0; i < meas.size(); ++i) {
+///     double t = meas[i].GetPosition(3);
+/// }
+/// \endcode
+class Cube::TrackMeasurements {
+public:
+    typedef std::vector<Cube::TrackMeasurement>::const_iterator
+    const_iterator;
+
+    TrackMeasurements() {}
+
+    /// Fill the measurements from the node objects.
+    explicit TrackMeasurements(const Cube::ReconNodeContainer& nodes) {
+        Fill(nodes);
+    }
+
+    /// Fill the measurements from the node objects.  This returns false (and
+    /// leaves the measurements empty) if a node object isn't a cluster.
+    bool Fill(const Cube::ReconNodeContainer& nodes);
+
+    /// Get the number of measurements.
+    std::size_t size() const {return fMeasurements.size();}
+
+    /// Check if there are any measurements.
+    bool empty() const {return fMeasurements.empty();}
+
+    /// Get a measurement.
+    const Cube::TrackMeasurement& operator [] (std::size_t i) const {
+        return fMeasurements[i];
+    }
+
+    const_iterator begin() const {return fMeasurements.begin();}
+    const_iterator end() const {return fMeasurements.end();}
+
+private:
+    std::vector<Cube::TrackMeasurement> fMeasurements;
+};
+#endif
+
+// Local Variables:
+// mode:c++
+// c-basic-offset:4
+// compile-command:"$(git rev-parse --show-toplevel)/build/cube-build.sh force"
+// End:
@@ -15,12 +15,7 @@
 #include <CubeAlgorithmResult.hxx>
 
 #include <algorithm>
-
-#ifdef EXPLORE_RUN_TIME
-#include <time.h>
-#include <TH2F.h>
-TH2F* bogo_treeReconTime = NULL;
-#endif
+#include <unordered_set>
 
 Cube::TreeRecon::TreeRecon(): Cube::Algorithm("TreeRecon") { }
 
@@ -36,11 +31,6 @@ Cube::TreeRecon::Process(const Cube::AlgorithmResult& input,
     // cube hit.
     Cube::Handle<Cube::HitSelection> inputHits = input.GetHitSelection();
 
-#ifdef EXPLORE_RUN_TIME
-    double ticks;
-    ticks = clock();
-#endif
-
     // Create the result for this algorithm.
     Cube::Handle<Cube::AlgorithmResult> result = CreateResult();
 
@@ -165,24 +155,23 @@ Cube::TreeRecon::Process(const Cube::AlgorithmResult& input,
     do {
         // Take all of the hits in the final objects, subtract them from the
         // input hits, and then recluster the result.
-        Cube::Handle<Cube::HitSelection> finalHits
-            = Cube::AllHitSelection(*finalObjects);
-
-        // Make a local copy of the input hits so they can be sorted.
-        Cube::HitSelection allHits;
-        std::copy(inputHits->begin(), inputHits->end(),
-                  std::back_inserter(allHits));
-
-        // Sort the hits so set_difference can be used to remove hits that are
-        // in final.
-        std::sort(allHits.begin(), allHits.end());
-        std::sort(finalHits->begin(), finalHits->end());
+        Cube::HitSelection finalHits;
+        Cube::AllHitSelection(*finalObjects, finalHits);
+        std::unordered_set<const Cube::Hit*> usedHits;
+        usedHits.reserve(2*finalHits.size()+1);
+        for (Cube::HitSelection::iterator h = finalHits.begin();
+             h != finalHits.end(); ++h) {
+            usedHits.insert(Cube::GetPointer(*h));
+        }
 
-        // Take the set difference between all hits and the final hits.
+        // Keep the input hits that aren't in final.  The hits stay in the
+        // input order.
         Cube::HitSelection needsClustering;
-        std::set_difference(allHits.begin(),allHits.end(),
-                            finalHits->begin(),finalHits->end(),
-                            std::back_inserter(needsClustering));
+        for (Cube::HitSelection::iterator h = inputHits->begin();
+             h != inputHits->end(); ++h) {
+            if (usedHits.count(Cube::GetPointer(*h))) continue;
+            needsClustering.push_back(*h);
+        }
 
         ///////////////////////////////////////////////////////////////
         // Handle the left over hits.
@@ -216,28 +205,6 @@ Cube::TreeRecon::Process(const Cube::AlgorithmResult& input,
     Cube::MakeUsed makeUsed(*inputHits);
     result = makeUsed(result);
 
-#ifdef EXPLORE_RUN_TIME
-    double newTicks = clock();
-    newTicks -= ticks;
-    newTicks /= 1000000.0;
-    if (newTicks < 0) newTicks += 72.0*60.0;
-    std::cout << "**************** TICKS " << newTicks << std::endl;
-    if (!bogo_treeReconTime) {
-        std::cout << "MAKE HISTOGRAM BOGO_TREERECONTIME" << std::endl;
-        bogo_treeReconTime = new TH2F("treeReconTime", "Time vs Hits",
-                                      100, 0.0, std::log10(20000.0),
-                                      100, 0.0, std::log10(10000));
-    }
-    double hitCount = inputHits->size();
-    std::cout << hitCount << " " << newTicks << std::endl;
-    if (hitCount < 1) hitCount = 1;
-    if (newTicks < 1) newTicks = 1;
-    hitCount = std::log10(hitCount);
-    newTicks = std::log10(newTicks);
-    if (newTicks < 0.01) newTicks = 0.01;
-    bogo_treeReconTime->Fill(hitCount,newTicks);
-#endif
-
     return result;
 }
 
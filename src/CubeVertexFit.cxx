@@ -9,16 +9,54 @@
 #include <Math/Minimizer.h>
 #include <Math/Factory.h>
 #include <Math/Functor.h>
+#include <Math/SMatrix.h>
+#include <Math/SVector.h>
 
-Cube::VertexFit::VertexFit() {}
+#include <vector>
+#include <cmath>
+
+Cube::VertexFit::VertexFit()
+    : fUseMinuit(false), fMinuitFallbacks(0) {}
 Cube::VertexFit::~VertexFit() {}
 
 namespace {
+    typedef ROOT::Math::SMatrix<double,3,3,
+                                ROOT::Math::MatRepSym<double,3> > VertexMatrix;
+    typedef ROOT::Math::SVector<double,3> VertexVector;
+
+    // The values needed from one end of a track.  These are copied out of
+    // the track state once for each fit so the chi2 doesn't need to look at
+    // the state on every call.
+    struct TrackEnd {
+        TVector3 fPosition;
+        TVector3 fDirection;
+        // The average of the X, Y, and Z position variances.
+        double fPositionVariance;
+        // The sum of the X, Y, and Z direction variances.
+        double fDirectionVariance;
+    };
+
+    // The line parameters for a track.
+    struct TrackLine {
+        TrackEnd fFront;
+        TrackEnd fBack;
+        double fLength;
+    };
+
+    void FillTrackEnd(Cube::Handle<Cube::TrackState> state, TrackEnd& end) {
+        end.fPosition = state->GetPosition().Vect();
+        end.fDirection = state->GetDirection();
+        TLorentzVector posVar = state->GetPositionVariance();
+        end.fPositionVariance = (posVar.X() + posVar.Y() + posVar.Z())/3.0;
+        TVector3 dirVar = state->GetDirectionVariance();
+        end.fDirectionVariance = dirVar.X() + dirVar.Y() + dirVar.Z();
+    }
+
     class VertexChi2 : public ROOT::Math::IMultiGenFunction {
-        Cube::Handle<Cube::ReconObjectContainer> fTracks;
+        const std::vector<TrackLine>& fLines;
     public:
-        explicit VertexChi2(Cube::Handle<Cube::ReconObjectContainer> tracks)
-            : fTracks(tracks) { }
+        explicit VertexChi2(const std::vector<TrackLine>& lines)
+            : fLines(lines) { }
         ~VertexChi2() {}
         IBaseFunctionMultiDimTempl* Clone() const {return NULL;}
         unsigned int NDim() const {
@@ -53,11 +91,11 @@ namespace {
             return frDist*frDist*bkDist*bkDist;
         }
 
-        // This calculates a chi2 for the impact parameter for an end of the
-        // track.  The dist, impact, and state should be for the end being
+        // This calculates the variance of the impact parameter for an end of
+        // the track.  The dist and end should be for the end being
         // calculated.  The length is for the entire track.
-        double StateChi2(double dist, double impact, double length,
-                         Cube::Handle<Cube::TrackState> state) const {
+        double ImpactVariance(double dist, double length,
+                              const TrackEnd& end) const {
 
             double cubeSize = 10.0*unit::mm;
             double var = 0.0;
@@ -72,43 +110,41 @@ namespace {
             var += cubeSize/12.0;
 
             // Add in the variance for the position.
-            var += state->GetPositionVariance().X()/3.0;
-            var += state->GetPositionVariance().Y()/3.0;
-            var += state->GetPositionVariance().Z()/3.0;
+            var += end.fPositionVariance;
 
             // Add in the variance for the direction.
-            var += dist*dist*state->GetDirectionVariance().X();
-            var += dist*dist*state->GetDirectionVariance().Y();
-            var += dist*dist*state->GetDirectionVariance().Z();
+            var += dist*dist*end.fDirectionVariance;
 
-            return impact*impact/var;
+            return var;
+        }
+
+        // This calculates a chi2 for the impact parameter for an end of the
+        // track.  The dist, impact, and end should be for the end being
+        // calculated.  The length is for the entire track.
+        double StateChi2(double dist, double impact, double length,
+                         const TrackEnd& end) const {
+            return impact*impact/ImpactVariance(dist,length,end);
         }
 
         double DoEval(const double* par) const {
             TVector3 vtx(par[0],par[1],par[2]);
             double chi2 = 0.0;
-            for (Cube::ReconObjectContainer::iterator t = fTracks->begin();
-                 t != fTracks->end(); ++t) {
-                Cube::Handle<Cube::ReconTrack> track = (*t);
-
-                // Find the length of the track
-                double length =
-                    (track->GetFront()->GetPosition().Vect()
-                     - track->GetBack()->GetPosition().Vect()).Mag();
+            for (std::vector<TrackLine>::const_iterator l = fLines.begin();
+                 l != fLines.end(); ++l) {
+                const TrackEnd& front = l->fFront;
+                const TrackEnd& back = l->fBack;
 
                 // Parameters for the front of the track.  The front distance
                 // will be negative if the vertex is in the "right" place.
-                TVector3 frDiff = vtx-track->GetFront()->GetPosition().Vect();
-                double frDist = frDiff * track->GetFront()->GetDirection();
-                double frImpact =
-                    (frDiff - frDist*track->GetFront()->GetDirection()).Mag();
+                TVector3 frDiff = vtx - front.fPosition;
+                double frDist = frDiff * front.fDirection;
+                double frImpact = (frDiff - frDist*front.fDirection).Mag();
 
                 // Parameters for the back of the track.  The back distance
                 // will be positive if the vertex is in the right place.
-                TVector3 bkDiff = vtx-track->GetBack()->GetPosition().Vect();
-                double bkDist = bkDiff * track->GetBack()->GetDirection();
-                double bkImpact
-                    = (bkDiff - bkDist*track->GetBack()->GetDirection()).Mag();
+                TVector3 bkDiff = vtx - back.fPosition;
+                double bkDist = bkDiff * back.fDirection;
+                double bkImpact = (bkDiff - bkDist*back.fDirection).Mag();
 
                 // Limit the effect of the "other" end of the track.
                 double frStep = OtherChi2Step(bkDist);
@@ -116,14 +152,12 @@ namespace {
 
                 double frChi2 = 0.0;
                 if (frStep > 0.0) {
-                    frChi2 = StateChi2(frDist,frImpact,length,
-                                       track->GetFront());
+                    frChi2 = StateChi2(frDist,frImpact,l->fLength,front);
                 }
 
                 double bkChi2 = 0.0;
                 if (bkStep > 0.0) {
-                    bkChi2 = StateChi2(bkDist,bkImpact,length,
-                                       track->GetBack());
+                    bkChi2 = StateChi2(bkDist,bkImpact,l->fLength,back);
                 }
 
                 // Find the penalty for being in the middle of the track.
@@ -136,6 +170,188 @@ namespace {
             }
             return chi2;
         }
+
+        // Add the weighted projection for one end of a track to the normal
+        // equations.  The projection removes the component along the track
+        // direction, so the end only constrains the impact parameter.
+        void AddEnd(double weight, const TrackEnd& end,
+                    VertexMatrix& normal, VertexVector& rhs) const {
+            double dir[3] = {end.fDirection.X(),
+                             end.fDirection.Y(),
+                             end.fDirection.Z()};
+            double pos[3] = {end.fPosition.X(),
+                             end.fPosition.Y(),
+                             end.fPosition.Z()};
+            for (int i=0; i<3; ++i) {
+                for (int j=0; j<3; ++j) {
+                    double proj = - dir[i]*dir[j];
+                    if (i == j) proj += 1.0;
+                    // The normal matrix is symmetric, so (i,j) and (j,i)
+                    // are the same element.
+                    if (j <= i) normal(i,j) += weight*proj;
+                    rhs(i) += weight*proj*pos[j];
+                }
+            }
+        }
+
+        // Find the chi2 (DoEval) derivatives at a position by finite
+        // differences.  The value is the chi2 at the position, and delta is
+        // the finite difference step.  The gradient and the second
+        // derivative matrix are filled.
+        void Derivatives(const double* par, double value, double delta,
+                         VertexVector& grad, VertexMatrix& hess) const {
+            double plus[3];
+            double minus[3];
+            for (int i=0; i<3; ++i) {
+                double shifted[3] = {par[0], par[1], par[2]};
+                shifted[i] = par[i] + delta;
+                plus[i] = DoEval(shifted);
+                shifted[i] = par[i] - delta;
+                minus[i] = DoEval(shifted);
+                grad(i) = (plus[i] - minus[i])/(2.0*delta);
+                hess(i,i) = (plus[i] - 2.0*value + minus[i])/(delta*delta);
+            }
+            for (int i=0; i<3; ++i) {
+                for (int j=0; j<i; ++j) {
+                    double shifted[3] = {par[0], par[1], par[2]};
+                    double sum = 0.0;
+                    for (int si = -1; si <= 1; si += 2) {
+                        for (int sj = -1; sj <= 1; sj += 2) {
+                            shifted[i] = par[i] + si*delta;
+                            shifted[j] = par[j] + sj*delta;
+                            sum += si*sj*DoEval(shifted);
+                        }
+                    }
+                    hess(i,j) = sum/(4.0*delta*delta);
+                }
+            }
+        }
+
+        // Take Newton steps on the chi2 (DoEval) starting from the
+        // reweighting fixed point found by LinearFit.  The impact variance
+        // depends on the vertex position, so the fixed point of the
+        // reweighting isn't the minimum of the chi2, but it's close enough
+        // that a couple of Newton steps will reach the minimum.  A step is
+        // only taken if it lowers the chi2.  The covariance is twice the
+        // inverse of the second derivative matrix at the minimum, which is
+        // the covariance Minuit reports for a chi2.  This returns false if
+        // the second derivative matrix isn't positive definite.
+        bool NewtonPolish(double* par, VertexMatrix& cov) const {
+            const int maxIterations = 10;
+            const double tolerance = 0.001*unit::mm;
+            const double delta = 0.01*unit::mm;
+            double value = DoEval(par);
+            VertexVector grad;
+            VertexMatrix hess;
+            for (int iteration = 0; iteration < maxIterations; ++iteration) {
+                Derivatives(par, value, delta, grad, hess);
+                cov = hess;
+                if (!cov.InvertChol()) return false;
+                VertexVector step = cov*grad;
+                // Shorten the step until the chi2 doesn't increase.
+                double trial[3];
+                double trialValue = value;
+                bool improved = false;
+                for (int halving = 0; halving < 10; ++halving) {
+                    for (int i=0; i<3; ++i) trial[i] = par[i] - step(i);
+                    trialValue = DoEval(trial);
+                    if (trialValue <= value) {
+                        improved = true;
+                        break;
+                    }
+                    step *= 0.5;
+                }
+                if (!improved) break;
+                double length = std::sqrt(ROOT::Math::Dot(step,step));
+                for (int i=0; i<3; ++i) par[i] = trial[i];
+                value = trialValue;
+                if (length < tolerance) break;
+            }
+            Derivatives(par, value, delta, grad, hess);
+            cov = hess;
+            if (!cov.InvertChol()) return false;
+            cov *= 2.0;
+            return true;
+        }
+
+        // Find the vertex with a linear fit.  The impact parameter for each
+        // track end is linear in the vertex position, so for fixed weights
+        // (the step times the inverse variance) the minimum is the solution
+        // of a 3x3 set of normal equations.  The weights are recalculated at
+        // each new position until the position stops changing.  Since the
+        // weights depend on the position, this only finds a fixed point of
+        // the reweighting, so the result is polished with Newton steps on
+        // the full chi2 (see NewtonPolish) which also provides the
+        // covariance.  The middle of track penalty isn't included in the
+        // linear fit, so this fails when the penalty is not zero at the
+        // solution.  On success, the position and covariance are filled and
+        // this returns true.
+        bool LinearFit(double* par, VertexMatrix& cov) const {
+            const int maxIterations = 20;
+            const double tolerance = 0.001*unit::mm;
+            TVector3 vtx(par[0],par[1],par[2]);
+            bool converged = false;
+            for (int iteration = 0; iteration < maxIterations; ++iteration) {
+                VertexMatrix normal;
+                VertexVector rhs;
+                for (std::vector<TrackLine>::const_iterator l = fLines.begin();
+                     l != fLines.end(); ++l) {
+                    const TrackEnd& front = l->fFront;
+                    const TrackEnd& back = l->fBack;
+                    double frDist = (vtx - front.fPosition)*front.fDirection;
+                    double bkDist = (vtx - back.fPosition)*back.fDirection;
+                    double frStep = OtherChi2Step(bkDist);
+                    double bkStep = OtherChi2Step(-frDist);
+                    if (frStep > 0.0) {
+                        AddEnd(frStep/ImpactVariance(frDist,l->fLength,front),
+                               front, normal, rhs);
+                    }
+                    if (bkStep > 0.0) {
+                        AddEnd(bkStep/ImpactVariance(bkDist,l->fLength,back),
+                               back, normal, rhs);
+                    }
+                }
+                cov = normal;
+                if (!cov.InvertChol()) return false;
+                VertexVector next = cov*rhs;
+                TVector3 newVtx(next(0),next(1),next(2));
+                double step = (newVtx - vtx).Mag();
+                vtx = newVtx;
+                if (!std::isfinite(step)) return false;
+                if (step < tolerance) {
+                    converged = true;
+                    break;
+                }
+            }
+            if (!converged) return false;
+
+            double polished[3] = {vtx.X(), vtx.Y(), vtx.Z()};
+            if (!NewtonPolish(polished,cov)) return false;
+            vtx.SetXYZ(polished[0],polished[1],polished[2]);
+
+            // Check that the vertex isn't in the middle of a track.
+            for (std::vector<TrackLine>::const_iterator l = fLines.begin();
+                 l != fLines.end(); ++l) {
+                const TrackEnd& front = l->fFront;
+                const TrackEnd& back = l->fBack;
+                double frDist = (vtx - front.fPosition)*front.fDirection;
+                double bkDist = (vtx - back.fPosition)*back.fDirection;
+                if (MiddlePenalty(frDist,bkDist) > 0.0) return false;
+            }
+
+            // Check that the covariance is sensible.  Nearly parallel tracks
+            // leave a direction that is hardly constrained.
+            for (int i=0; i<3; ++i) {
+                if (!std::isfinite(cov(i,i))) return false;
+                if (cov(i,i) <= 0.0) return false;
+                if (cov(i,i) > 1000.0*unit::mm*1000.0*unit::mm) return false;
+            }
+
+            par[0] = vtx.X();
+            par[1] = vtx.Y();
+            par[2] = vtx.Z();
+            return true;
+        }
     };
 }
 
@@ -153,8 +369,9 @@ Cube::VertexFit::Apply(Cube::Handle<Cube::ReconVertex>& input) {
         return Cube::Handle<Cube::ReconVertex>();
     }
 
-    Cube::Handle<Cube::ReconObjectContainer>
-        tracks(new Cube::ReconObjectContainer("tracks"));
+    // Copy the line parameters out of the tracks once.
+    std::vector<TrackLine> lines;
+    lines.reserve(inputObjects->size());
 
     double time = 0.0;
     double timeWeight = 0.0;
@@ -163,18 +380,22 @@ Cube::VertexFit::Apply(Cube::Handle<Cube::ReconVertex>& input) {
          o != inputObjects->end(); ++o) {
         Cube::Handle<Cube::ReconTrack> track = *(o);
         if (!track) continue;
-        tracks->push_back(track);
+        TrackLine line;
+        FillTrackEnd(track->GetFront(),line.fFront);
+        FillTrackEnd(track->GetBack(),line.fBack);
+        line.fLength = (line.fFront.fPosition - line.fBack.fPosition).Mag();
+        lines.push_back(line);
         double t = track->GetPosition().T();
         double w = track->GetPositionVariance().T();
         timeWeight += w;
         time += w*t;
         time2 += w*t*t;
     }
-    if (tracks->empty()) {
+    if (lines.empty()) {
         CUBE_ERROR << "No tracks to fit." << std::endl;
         return Cube::Handle<Cube::ReconVertex>();
     }
-    if (tracks->size() < 2) {
+    if (lines.size() < 2) {
         CUBE_ERROR << "Need at least 2 tracks for fit." << std::endl;
         return Cube::Handle<Cube::ReconVertex>();
     }
@@ -182,20 +403,7 @@ Cube::VertexFit::Apply(Cube::Handle<Cube::ReconVertex>& input) {
     time = time/timeWeight;
     time2 = time2/timeWeight;
 
-    VertexChi2 chi2(tracks);
-
-    std::unique_ptr<ROOT::Math::Minimizer>
-        minimizer(ROOT::Math::Factory::CreateMinimizer("Minuit", "Migrad"));
-    if (!minimizer) {
-        CUBE_ERROR << "Minimizer not created" << std::endl;
-        throw std::runtime_error("Unable to create vertex fit minimizer");
-    }
-
-    minimizer->SetFunction(chi2);
-    minimizer->SetVariable(0,"X",input->GetPosition().X(),1.0);
-    minimizer->SetVariable(1,"Y",input->GetPosition().Y(),1.0);
-    minimizer->SetVariable(2,"Z",input->GetPosition().Z(),1.0);
-    minimizer->SetPrintLevel(0);
+    VertexChi2 chi2(lines);
 
     CUBE_LOG(3) << "Starting point is "
                 << " @ (" << input->GetPosition().X()
@@ -204,16 +412,53 @@ Cube::VertexFit::Apply(Cube::Handle<Cube::ReconVertex>& input) {
                 << ", " << input->GetPosition().T()
                 << ")" << std::endl;
 
-    minimizer->Minimize();
-    double minChi2 = chi2.DoEval(minimizer->X());
+    double vertex[3] = {input->GetPosition().X(),
+                        input->GetPosition().Y(),
+                        input->GetPosition().Z()};
+    VertexMatrix covariance;
+    bool fitted = false;
+    if (!fUseMinuit) {
+        fitted = chi2.LinearFit(vertex,covariance);
+        if (!fitted) {
+            CUBE_LOG(2) << "Linear vertex fit failed, use Minuit"
+                        << std::endl;
+            ++fMinuitFallbacks;
+        }
+    }
+
+    if (!fitted) {
+        std::unique_ptr<ROOT::Math::Minimizer>
+            minimizer(ROOT::Math::Factory::CreateMinimizer("Minuit",
+                                                           "Migrad"));
+        if (!minimizer) {
+            CUBE_ERROR << "Minimizer not created" << std::endl;
+            throw std::runtime_error("Unable to create vertex fit minimizer");
+        }
+
+        minimizer->SetFunction(chi2);
+        minimizer->SetVariable(0,"X",input->GetPosition().X(),1.0);
+        minimizer->SetVariable(1,"Y",input->GetPosition().Y(),1.0);
+        minimizer->SetVariable(2,"Z",input->GetPosition().Z(),1.0);
+        minimizer->SetPrintLevel(0);
+
+        minimizer->Minimize();
+        for (int i=0; i<3; ++i) {
+            vertex[i] = minimizer->X()[i];
+            for (int j=0; j<=i; ++j) {
+                covariance(i,j) = minimizer->CovMatrix(i,j);
+            }
+        }
+    }
+
+    double minChi2 = chi2.DoEval(vertex);
 
     Cube::Handle<Cube::VertexState> state = input->GetState();
     for (int i=0; i<3; ++i) {
-        state->SetValue(state->GetPositionIndex() + i, minimizer->X()[i]);
+        state->SetValue(state->GetPositionIndex() + i, vertex[i]);
         for (int j=0; j<3; ++j) {
             state->SetCovarianceValue(state->GetPositionIndex() + i,
                                       state->GetPositionIndex() + j,
-                                      minimizer->CovMatrix(i,j));
+                                      covariance(i,j));
 
         }
     }
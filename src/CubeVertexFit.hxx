@@ -33,6 +33,16 @@ namespace Cube {
 /// Cube::Handle<ReconVertex> fittedVertex = vertexFit->Apply(inputVertex);
 /// \endcode
 ///
+/// The vertex is first found by solving the normal equations for the track
+/// impact parameters, with the weights recalculated at each new position.
+/// The impact parameter variance depends on the position, so the result is
+/// then polished with Newton steps on the full chi2, and the covariance is
+/// found from the second derivatives of the chi2 at the minimum (the same
+/// way Minuit finds it).  If the linear fit fails (for instance, when the
+/// tracks are nearly parallel, or the best position is in the middle of a
+/// track), the vertex is found by minimizing the same chi2 with Minuit.  The
+/// two methods are compared by the testVertexFitters program.
+///
 /// \warning The input vertex is expected to be modified by the fitter so that
 /// the result handle will be equal to the input handle.  However, this is not
 /// guaranteed.  The resulting vertex may be a different object than the input
@@ -58,6 +68,24 @@ public:
     virtual Cube::Handle<Cube::ReconVertex>
     Apply(Cube::Handle<Cube::ReconVertex>& input);
 
+    /// Set if the vertex should always be found using Minuit instead of the
+    /// linear fit.  The default is false.
+    void SetUseMinuit(bool v) {fUseMinuit = v;}
+
+    /// Get if the vertex is always found using Minuit.
+    bool GetUseMinuit() const {return fUseMinuit;}
+
+    /// Get the number of times the linear fit failed and the vertex was
+    /// found with Minuit.
+    int GetMinuitFallbackCount() const {return fMinuitFallbacks;}
+
+private:
+
+    /// A flag that Minuit should always be used.
+    bool fUseMinuit;
+
+    /// The number of fits that fell back to Minuit.
+    int fMinuitFallbacks;
 };
 #endif
 
@@ -14,97 +14,145 @@
 namespace SIMPLE_SIR_NAMESPACE {
 #endif
 
+// The default UserRandom class.  This provides uniform random numbers between
+// 0.0 and 1.0 from gRandom.
+struct SimpleSIRDefaultRandom {
+    double operator () () {return gRandom->Uniform(0.0,1.0);}
+};
+
+// The samples for a SimpleSIR filter.
+template<int Dimension>
+class SimpleSIRSamples {
+public:
+    enum {kDimension = Dimension};
+
+    explicit SimpleSIRSamples(std::size_t n = 0) {resize(n);}
+
+    // The number of samples.
+    std::size_t size() const {return Weight.size();}
+
+    // Change the number of samples.  New samples are filled with zero.
+    void resize(std::size_t n) {
+        Weight.resize(n);
+        for (int i=0; i<Dimension; ++i) Value[i].resize(n);
+    }
+
+    // Exchange the samples with another set of samples without copying.
+    void swap(SimpleSIRSamples& other) {
+        Weight.swap(other.Weight);
+        for (int i=0; i<Dimension; ++i) Value[i].swap(other.Value[i]);
+    }
+
+    // Get the array of values for one element of the state.
+    float* operator [] (int i) {return Value[i].data();}
+    const float* operator [] (int i) const {return Value[i].data();}
+
+    // The weight for each sample.
+    std::vector<double> Weight;
+
+    // The values for each state element.  Value[i][s] is element "i" of
+    // sample "s".
+    std::vector<float> Value[Dimension];
+};
+
 /////////////////////////////////////////////////////////////////
 // A simple template implementation of a Sequential Importance Resampling
 // (SIR) Particle Filter.  I wrote this as an exercise to understand SIR
 // particle filters, but it turns out to be surprisingly useful.  The file is
-// almost entirely documentation since the actual template is only about 70
+// almost entirely documentation since the actual template is only about 100
 // lines of code.
 //
 // This defines a template which generates a class to apply a SIR particle
 // filter.  The template operates on a weighted point cloud that describes a
-// PDF.  The point cloud is defined as a vector of weight and state pairs (the
-// StatePair class).  The user must construct a point cloud describing the
-// prior information before the filter is applied.  Then the UpdateSamples()
-// method is called for each new measurement.  When UpdateSamples() returns,
-// the point cloud has been updated to reflect the new information.  See the
-// example below.  There is also a working example included as an "ifdef"
-// section of code at the end of this file.
+// PDF.  The state for each point is a fixed number of floats, and the point
+// cloud is stored as a "structure of arrays" (one array per state element,
+// and one array of weights) in a SimpleSIRSamples object.  That means there
+// isn't a heap allocation per sample, and the user provided propagator and
+// likelihood work on all of the samples at once using simple loops over
+// contiguous arrays that the compiler can vectorize.  The user must fill
+// the samples with the prior information before the filter is applied.
+// Then the UpdateSamples() method is called for each new measurement.  When
+// UpdateSamples() returns, the point cloud has been updated to reflect the
+// new information.  See the example below.  There is also a working example
+// included as an "ifdef" section of code at the end of this file.
 //
 // The template defines one important class method:
 //
-// SimpleSIR<>::UpdateSamples(SampleVector& samples, Measurement measurement)
+// SimpleSIR<>::UpdateSamples(Samples& samples, Measurement measurement)
 // -- Apply the effects of the measurement to the PDF described by samples.
-// The vector of samples is modified.
+// The samples are modified.
 //
-// The template defines classes that are useful for the user.
+// The template defines a class that is useful for the user.
 //
-// SimpleSir<>::SamplePair -- A std::pair<double,UserState> that holds the
-// weight (in first), and the user defined state in second.
+// SimpleSIR<>::Samples -- A SimpleSIRSamples<Dimension> that holds the point
+// cloud.  The element "i" of sample "s" is samples[i][s], and the weight is
+// samples.Weight[s].
 //
-// SimpleSir<>::SampleVector -- A std::vector<SamplePair> that holds the point
-// cloud.
+// The template takes four arguments, and an optional fifth.
 //
-// The template takes four arguments.
+// Dimension -- The number of floats in the state.
 //
-// UserState -- A class that describes the state.  The particle filter doesn't
-// try to access the internals of the state, so it can contain almost
-// anything.  However, it must be copyable since the filter will copy the
-// state by value.
-//
-// UserStatePropagator -- A class that implements ```double operator ()``` to
-// propagate the state value to the time step (usually determined by the next
-// measurement).  The return value should (almost) always be 1.0.  See below
-// for details on how it needs to be declared.
+// UserPropagator -- A class that implements ```void operator ()``` to
+// propagate all of the samples to the time step (usually determined by the
+// next measurement).  See below for details on how it needs to be declared.
 //
 // UserMeasurement -- A class that describes a measurement.  The particle
 // filter doesn't try to access the internals of the measurement, so it can
 // contain almost anything.  The template always uses the measurement as
 // "const UserMeasurement&"
 //
-// UserLikelihood -- A class that implements ``` double operator ()`` to
-// calculate the likelihood of a measurement given a state.  The return value
-// needs to be between 0.0 and 1.0.  See below for details on how it needs to
-// be declared.
+// UserLikelihood -- A class that implements ```void operator ()``` to
+// calculate the likelihood of a measurement for all of the samples.  See
+// below for details on how it needs to be declared.
+//
+// UserRandom -- (optional) A class that implements ```double operator ()```
+// to return a uniform random number between 0.0 and 1.0.  This is used to
+// choose samples during resampling.  The default uses gRandom, but a user
+// can provide their own generator so that a filter is reproducible, and can
+// be run on several threads.
 //
-// ## THE UserStatePropagator CLASS
+// ## THE UserPropagator CLASS
 //
-// This is provided by the user to update a particular state to the next step.
-// As far as the template is concerned, the class only needs to provide a
-// single method declared.
+// This is provided by the user to update all of the samples to the next
+// step.  As far as the template is concerned, the class only needs to
+// provide a single method declared.
 //
 // ```
-// class UserStatePropagator {
+// class UserPropagator {
 // public:
-//    double operator () (UserState& state,
-//                        const UserMeasurement& measurement);
+//    void operator () (SimpleSIRSamples<Dimension>& samples,
+//                      const UserMeasurement& measurement);
 // };
 // ```
 //
-// The return value is a weight adjustment that can be applied to the sample
-// weight.  The return value should almost always be 1.0.  It is there so that
-// the propagated state can have extra variance so that the propagated state
-// does not get stuck in a "low variance" situation.  If you find that it's a
-// problem, you probably should not use a particle filter (so always return
-// 1.0).
+// The propagator updates the values of every sample in place.  It replaces
+// the older per-sample propagator which returned a weight factor for each
+// state, so there is no longer a return value to adjust the weights.  The
+// propagator is handed the weights along with the values, and any change it
+// makes to samples.Weight is kept (the new weight is multiplied by the
+// likelihood, and then renormalized).  Normally the weights should be left
+// alone since adjusting them is a sign that a particle filter is the wrong
+// tool.
 //
 // See below for an example implementation.
 //
 // ## The UserLikelihood CLASS
 //
 // This is provided by the user to calculate the likelihood of a measurement
-// given a state.  As far as the template is concerned, the class only needs
-// to provide a single method
+// for every sample.  As far as the template is concerned, the class only
+// needs to provide a single method
 //
 // ```
 // class UserLikelihood {
 // public:
-//     double operator() (const UserState& state,
-//                        const UserMeasurement& measurement);
+//     void operator() (const SimpleSIRSamples<Dimension>& samples,
+//                      const UserMeasurement& measurement,
+//                      double* likelihood);
 // };
 // ```
 //
-// The return value needs to be between 0.0 and 1.0.
+// where likelihood has room for one value per sample.  Each value needs to
+// be between 0.0 and 1.0.
 //
 // ## EXAMPLE
 //
@@ -123,13 +171,11 @@ namespace SIMPLE_SIR_NAMESPACE {
 // };
 // ```
 //
-// The state is the current position at a particular time.
+// The state is the current position (element 0) at a particular time
+// (element 1).
 //
 // ```
-// struct MyState {
-//     float x;
-//     float t;
-// };
+// typedef SimpleSIRSamples<2> MySamples;
 // ```
 //
 // The measurement has a unit uncertainty, so this just returns the
@@ -138,24 +184,27 @@ namespace SIMPLE_SIR_NAMESPACE {
 //
 // ```
 // struct MyLikelihood {
-//    double operator () (const MyState& s, const MyMeasure& m) {
-//        double d = m.x - s.x;
-//        return std::exp(d*/2.0);
+//    void operator () (const MySamples& s, const MyMeasure& m,
+//                      double* likelihood) {
+//        for (std::size_t i = 0; i < s.size(); ++i) {
+//            double d = m.x - s[0][i];
+//            likelihood[i] = std::exp(-d*d/2.0);
+//        }
 //    }
 // };
 // ```
 //
 // The propagator needs to advance the state to the new time, and then add the
-// effect of noise to the propagation.  This should always return 1.0!
+// effect of noise to the propagation.
 //
 // ```
 // struct MyPropagator {
-//     double operator () (MyState& s,
-//                         const MyMeasure& m) {
-//         s.x = s.x + 1.0*(m.t - s.t);        /* Update the state */
-//         s.x = s.x + gRandom->Gaus(0.0,0.1); /* Add the noise */
-//         s.t = m.t;
-//         return 1.0;
+//     void operator () (MySamples& s, const MyMeasure& m) {
+//         for (std::size_t i = 0; i < s.size(); ++i) {
+//             s[0][i] += 1.0*(m.t - s[1][i]);      /* Update the state */
+//             s[0][i] += gRandom->Gaus(0.0,0.1);  /* Add the noise */
+//             s[1][i] = m.t;
+//         }
 //     }
 // };
 // ```
@@ -163,8 +212,7 @@ namespace SIMPLE_SIR_NAMESPACE {
 // Declare a typedef for the template!
 //
 // ```
-// typedef SimpleSIR<MyState, MyPropagator,
-//                   MyMeasurement, MyLikelihood> MySIR;
+// typedef SimpleSIR<2, MyPropagator, MyMeasure, MyLikelihood> MySIR;
 // ```
 //
 // Assume that you've got a vector of measurements from someplace
@@ -173,19 +221,16 @@ namespace SIMPLE_SIR_NAMESPACE {
 // std::vector<MyMeasure> MeasurementVector;
 // ```
 //
-// You will need to make a vector of states that describes your prior
-// knowledge.
+// You will need to fill the samples to describe your prior knowledge.
 //
 // ```
 // double t0 = MeasurementVector.front().t;
 // double x0 = MeasurementVector.front().x;
-// MySIR::SampleVector samples;
-// for (int i=0; i<1000; ++i) {
-//    MySIR::SamplePair sample;
-//    sample.first = 1.0;    /* "Always" 1.0 */
-//    sample.second.x = gRandom(x0,1.0);
-//    sample.second.t = t0;
-//    samples.push_back(sample);
+// MySIR::Samples samples(1000);
+// for (std::size_t i=0; i<samples.size(); ++i) {
+//    samples.Weight[i] = 1.0;    /* "Always" 1.0 */
+//    samples[0][i] = gRandom->Gaus(x0,1.0);
+//    samples[1][i] = t0;
 // };
 // ```
 //
@@ -205,133 +250,118 @@ namespace SIMPLE_SIR_NAMESPACE {
 // ```
 // double avgX = 0.0;
 // for (std::size_t i = 0; i<samples.size(); ++i) {
-//     avgX += samples[i].first * samples[i].second.x;
+//     avgX += samples.Weight[i] * samples[0][i];
 // }
 // ```
-template<typename UserState, typename UserStatePropagator,
-         typename UserMeasurement, typename UserLikelihood>
+template<int Dimension, typename UserPropagator,
+         typename UserMeasurement, typename UserLikelihood,
+         typename UserRandom = SimpleSIRDefaultRandom>
 class SimpleSIR {
 public:
-    // Add a typedef for the UserState.  It makes the template code a little
-    // easier, but external user code probably wants to use the real class
-    // name.
-    typedef UserState State;
+    // The samples that describe the PDF.  The mean of the PDF is the sum of
+    // Weight[s] times the state for sample s.  See the main comment above
+    // for an example.
+    typedef SimpleSIRSamples<Dimension> Samples;
 
     // Add a typedef for the UserMeasurement.  It makes the template code a
     // little easier, but external user code probably wants to use the real
     // class name.
     typedef UserMeasurement Measurement;
 
-    // Create a field holding the class to propagate the state forward in
+    // Create a field holding the class to propagate the samples forward in
     // "time".  The class must provide a public method:
     //
     // ```C++
-    // double operator () (UserState& s, const UserMeasurement& m);
+    // void operator () (Samples& samples, const UserMeasurement& m);
     // ```
     //
-    // The state, s, is modified to correspond to the measurement, m,
+    // The samples are modified to correspond to the measurement, m,
     // (i.e. moved to the closest position or updated to the time of the
-    // measurement).  The return value is a weight adjustment to be applied to
-    // the state (if you don't understand what this is for, return 1.0).  See
-    // the example in the main documentation.
-    UserStatePropagator Propagator;
+    // measurement).  See the example in the main documentation.
+    UserPropagator Propagator;
 
     // Create a field holding the class to calculate the likelihood.  The
     // class must provide a public method:
     //
     // ```C++
-    // double operator() (const UserState& state,
-    //                    const UserMeasurement& measurement);
+    // void operator() (const Samples& samples,
+    //                  const UserMeasurement& measurement,
+    //                  double* likelihood);
     // ```
     //
-    // The return value is the likelihood of the measurement given the state,
-    // and must be between 0.0 and 1.0.
+    // The likelihood of the measurement for each sample is returned in
+    // likelihood, and must be between 0.0 and 1.0.
     UserLikelihood Likelihood;
 
-    // Each sample is a pair that consists of the weight for the state, and
-    // the state.  The first element of the pair is the weight.  The second
-    // element is the state.
-    typedef std::pair<double,State> SamplePair;
-
-    // A vector of all of the samples that represent the PDF for the state.
-    // This is a cloud of states where the density and weights represent the
-    // PDF, and the user will need to provide a vector of this type to the
-    // UpdateSamples method.  The mean of the PDF is the sum of
-    // SamplePair::first times SamplePair::second.  See the main comment above
-    // for an example.
-    typedef std::vector<SamplePair> SampleVector;
-
-    // An iterator through the sample.  User code probably wants to directly
-    // use "SampleVector::iterator", but this prevents the template from
-    // needed typename every time the iterator is used.
-    typedef typename SampleVector::iterator SampleIterator;
+    // Create a field holding the class to generate uniform random numbers
+    // for the resampling.  Only one random number is needed per
+    // resampling.  The class must provide a public method:
+    //
+    // ```C++
+    // double operator() ();
+    // ```
+    //
+    // The return value must be between 0.0 and 1.0.
+    UserRandom Random;
 
     // The constructor will set some default values.  It doesn't do much.
     SimpleSIR() {SetResampleFraction(0.5);}
 
-    // Update the sample vector of states based on the provided measurement.
-    // This will be called once by the user as each new measurement is added
-    // to the fit.  Since the vector of states is modified, the user should
-    // record any information before moving to the next measurement.  That
-    // usually means that the user will want to record the sample mean and
-    // variance, or possibly even copy the states to another vector.
+    // Update the samples based on the provided measurement.  This will be
+    // called once by the user as each new measurement is added to the fit.
+    // Since the samples are modified, the user should record any
+    // information before moving to the next measurement.  That usually means
+    // that the user will want to record the sample mean and variance, or
+    // possibly even copy the samples.
     //
     // This returns false if there was no resampling, and true if there was a
     // resampling.  This will be called by the user for each step
-    bool UpdateSamples(SampleVector& samples,
-                       const Measurement& measurement) {
-
-        // PROPAGATE: This propagates each sample to the measurement.  It
-        // usually adds "noise" or multiple scattering.  The propagator should
-        // return a weight adjustment (almost always 1.0).  This can be used
-        // if the propagator is applying some excess variability so that the
-        // states don't get "stuck".  The weight adjustment may be larger than
-        // 1.0.
-        for (SampleIterator s = samples.begin();
-             s != samples.end(); ++s) {
-            s->first *= Propagator(s->second, measurement);
-        }
+    bool UpdateSamples(Samples& samples, const Measurement& measurement) {
+        std::size_t n = samples.size();
+        if (n < 1) return false;
+
+        // PROPAGATE: This propagates every sample to the measurement.  It
+        // usually adds "noise" or multiple scattering.
+        Propagator(samples, measurement);
 
-        // MEASURE: The finds the likelihood for each state given the
+        // MEASURE: The finds the likelihood for each sample given the
         // measurement.
+        if (LikelihoodWorkArea.size() != n) LikelihoodWorkArea.resize(n);
+        Likelihood(samples, measurement, LikelihoodWorkArea.data());
+
+        double* weight = samples.Weight.data();
+        const double* likelihood = LikelihoodWorkArea.data();
         double norm = 0.0;
-        for (SampleIterator s = samples.begin();
-             s != samples.end(); ++s) {
-            s->first *= Likelihood(s->second, measurement);
-            norm += s->first;  // Find the normalization sum for later.
+        for (std::size_t s = 0; s < n; ++s) {
+            weight[s] *= likelihood[s];
+            norm += weight[s];  // Find the normalization sum for later.
         }
 
-        // RENORMALIZE: Everything to sums to 1
-        for (SampleIterator s = samples.begin(); s != samples.end(); ++s) {
-            s->first /= norm;
+        // RENORMALIZE: Everything to sums to 1.  If the measurement isn't
+        // compatible with any sample (or the weights aren't valid) the
+        // information is lost, so start again with uniform weights.
+        if (!(norm > 0.0)) {
+            for (std::size_t s = 0; s < n; ++s) weight[s] = 1.0/n;
+        }
+        else {
+            double scale = 1.0/norm;
+            for (std::size_t s = 0; s < n; ++s) weight[s] *= scale;
         }
 
         // EFFECTIVE SAMPLE SIZE: This checks if effective number of samples
         // is still large enough, and then might resample.  The effective
         // number of samples is 1.0/(variance of the weights).
-        double effective = GetEffectiveSamples(samples.begin(), samples.end());
+        double effective = GetEffectiveSamples(samples);
 
         // RESAMPLE: Resample if the effective sample size is too small.
-        if (effective > ResampleFraction*samples.size()) return false;
-
-        // If necessary, resize the work area.  This should only happen once.
-        if (ResampleWorkArea.size() != samples.size()) {
-            ResampleWorkArea.resize(samples.size());
-        }
-
-        // Sort the samples by weight.  This makes the resampler more
-        // efficient since it checks the high weight samples first.
-        std::sort(samples.begin(),samples.end());
+        if (effective > ResampleFraction*n) return false;
 
         // And apply the resampling.
-        for (SampleIterator s = ResampleWorkArea.begin();
-             s != ResampleWorkArea.end(); ++s) {
-            *s = Resample(samples.begin(),samples.end());
-            s->first = 1.0/samples.size(); // uniform weight after resampling
-        }
+        Resample(samples, ResampleWorkArea);
 
-        // Replace with the new sample.
-        samples = ResampleWorkArea;
+        // Replace with the new samples.  The old samples are left in the
+        // work area so their storage is reused by the next resampling.
+        samples.swap(ResampleWorkArea);
 
         return true;
     }
@@ -341,18 +371,18 @@ public:
     // fraction, the filter will resample.  Set this to 1.0 to resample every
     // time, or 0.0 to never resample.
     void SetResampleFraction(double r) {
+        ResampleFraction = r;
         if (r > 1.0) ResampleFraction = 1.0;
         if (r < 0.0) ResampleFraction = 0.0;
-        ResampleFraction = r;
     }
 
     // Calculate the effective number of samples. The effective number of
     // samples is 1.0/(variance of the weights).
-    double GetEffectiveSamples(SampleIterator begin, SampleIterator end) {
+    double GetEffectiveSamples(const Samples& samples) const {
+        const double* weight = samples.Weight.data();
         double weightVariance = 0.0;
-        while (begin != end) {
-            weightVariance += begin->first * begin->first;
-            ++begin;
+        for (std::size_t s = 0; s < samples.size(); ++s) {
+            weightVariance += weight[s]*weight[s];
         }
         return 1.0 / weightVariance;
     }
@@ -362,25 +392,45 @@ private:
     // of the real number of samples, then resample.
     double ResampleFraction;
 
-    // Pull one sample from the sample vector based on the sample weights.
-    // The input samples will be sorted by weight so that the high weight
-    // samples are at the end.  If this is to slow, it could be implemented
-    // with a binary search (but the weights would need to be summed first).
-    SamplePair Resample(SampleIterator begin,
-                        SampleIterator end) {
-        double norm = gRandom->Uniform(0.0,1.0);
-        while (begin < end && norm > 0) {
-            --end;
-            norm -= end->first;
+    // Fill the output with samples drawn from the input based on the sample
+    // weights using systematic resampling.  A single random offset picks
+    // equally spaced points along the cumulative weight, and the input is
+    // walked once, so this is O(N) and doesn't need the samples to be
+    // sorted.  The chosen samples are found first, and then each state
+    // element is gathered in a separate loop.  The weights must already be
+    // normalized to one.  The output samples all have a uniform weight.
+    void Resample(const Samples& input, Samples& output) {
+        std::size_t n = input.size();
+        if (output.size() != n) output.resize(n);
+        if (IndexWorkArea.size() != n) IndexWorkArea.resize(n);
+        const double* weight = input.Weight.data();
+        double step = 1.0/n;
+        double target = step*Random();
+        double cumulative = weight[0];
+        std::size_t source = 0;
+        for (std::size_t s = 0; s < n; ++s) {
+            while (cumulative < target && source+1 < n) {
+                cumulative += weight[++source];
+            }
+            IndexWorkArea[s] = source;
+            target += step;
+        }
+        const std::size_t* index = IndexWorkArea.data();
+        for (int i = 0; i < Dimension; ++i) {
+            const float* in = input[i];
+            float* out = output[i];
+            for (std::size_t s = 0; s < n; ++s) out[s] = in[index[s]];
         }
-        return *end;
+        double* outWeight = output.Weight.data();
+        for (std::size_t s = 0; s < n; ++s) outWeight[s] = step;
     }
 
-    // Provide a work area vector for resampling.  This prevents it from being
-    // constructed and deconstructed on each resampling.  It will be resized
-    // (hopefully, only once) during the first resampling.
-    SampleVector ResampleWorkArea;
-
+    // Provide work areas so that vectors are not constructed and
+    // deconstructed on each update.  They will be resized (hopefully, only
+    // once) during the first update.
+    std::vector<double> LikelihoodWorkArea;
+    std::vector<std::size_t> IndexWorkArea;
+    Samples ResampleWorkArea;
 };
 
 // MIT License
@@ -443,7 +493,7 @@ private:
 #include <TMatrixD.h>
 
 // State 0: x, 1: y, 2: z, 3: dx, 4: dy, 5: dz
-typedef std::vector<float> ExampleState;
+typedef SimpleSIRSamples<6> ExampleSamples;
 
 // Measurement 0: x, 1: y, 2: z
 typedef std::vector<float> ExampleMeasurement;
@@ -451,98 +501,101 @@ typedef std::vector<float> ExampleMeasurement;
 // Calculate the likelihood for the measurement given the state.  Provided by
 // the user.
 struct ExampleLikelihood {
-    double operator() (const ExampleState& state,
-                       const ExampleMeasurement& measurement) {
+    void operator() (const ExampleSamples& samples,
+                     const ExampleMeasurement& measurement,
+                     double* likelihood) {
+        for (std::size_t s = 0; s < samples.size(); ++s) {
 #ifdef NON_GAUSSIAN_LIKELIHOOD
-        double maxpos = 0.0;
-        for (int i=0; i<3; ++i) {
-            double r = state[i] - measurement[i];
-            if (r < 0.0) r = -r;
-            if (maxpos < r) maxpos = r;
-        }
-        if (maxpos < 0.5) return 0.99;
-        return 0.01;
+            double maxpos = 0.0;
+            for (int i=0; i<3; ++i) {
+                double r = samples[i][s] - measurement[i];
+                if (r < 0.0) r = -r;
+                if (maxpos < r) maxpos = r;
+            }
+            likelihood[s] = (maxpos < 0.5) ? 0.99 : 0.01;
+            continue;
 #endif
-        // GAUSSIAN (A fallback for the test).
-        double r1 = 0.0;
-        for(int i=0; i<3; ++i) {
-            double r = state[i] - measurement[i];
-            r1 += r*r;
+            // GAUSSIAN (A fallback for the test).
+            double r1 = 0.0;
+            for(int i=0; i<3; ++i) {
+                double r = samples[i][s] - measurement[i];
+                r1 += r*r;
+            }
+            likelihood[s] = std::exp(-r1/2.0);
         }
-        return std::exp(-r1/2.0);
     }
 };
 
-// Update the state to a new measurement.  The measurement can be ignored, but
-// is provided in case it's needed.  Provided by the user.  This example
+// Update the samples to a new measurement.  The measurement can be ignored,
+// but is provided in case it's needed.  Provided by the user.  This example
 // assumes 0) x, 1) y, 2) z, 3) dx, 4) dy, 5) dz
 struct ExamplePropagate {
-    double operator () (ExampleState& state,
-                        const ExampleMeasurement& measurement) {
-        // Make an initial estimate of the distance to closest approach.
-        double dist = 0.0;
-        for (int i=0; i<3; ++i) {
-            dist += state[i+3]*(measurement[i]-state[i]);
-        }
-        // Add scattering to the direction and then normalize.
-        double norm = 0.0;
-        for (int i=3; i<6; ++i) {
-            state[i] += dist*gRandom->Gaus(0.0,0.05);
-            norm += state[i]*state[i];
-        }
-        norm = std::sqrt(norm);
-        for (int i=3; i<6; ++i) {
-            state[i] /= norm;
-        }
-        // Update the estimate of the distance to closest approach.
-        dist = 0.0;
-        for (int i=0; i<3; ++i) {
-            dist += state[i+3]*(measurement[i]-state[i]);
-        }
-        // Update the position.
-        for (int i=0; i<3; ++i) {
-            state[i] += dist*state[i+3] + dist*gRandom->Gaus(0.0,0.1);
+    void operator () (ExampleSamples& samples,
+                      const ExampleMeasurement& measurement) {
+        for (std::size_t s = 0; s < samples.size(); ++s) {
+            // Make an initial estimate of the distance to closest approach.
+            double dist = 0.0;
+            for (int i=0; i<3; ++i) {
+                dist += samples[i+3][s]*(measurement[i]-samples[i][s]);
+            }
+            // Add scattering to the direction and then normalize.
+            double norm = 0.0;
+            for (int i=3; i<6; ++i) {
+                samples[i][s] += dist*gRandom->Gaus(0.0,0.05);
+                norm += samples[i][s]*samples[i][s];
+            }
+            norm = std::sqrt(norm);
+            for (int i=3; i<6; ++i) {
+                samples[i][s] /= norm;
+            }
+            // Update the estimate of the distance to closest approach.
+            dist = 0.0;
+            for (int i=0; i<3; ++i) {
+                dist += samples[i+3][s]*(measurement[i]-samples[i][s]);
+            }
+            // Update the position.
+            for (int i=0; i<3; ++i) {
+                samples[i][s] += dist*samples[i+3][s]
+                    + dist*gRandom->Gaus(0.0,0.1);
+            }
         }
-        return 1.0;
     }
 };
 
 // Declare the filter.
-typedef SimpleSIR<ExampleState, ExamplePropagate,
+typedef SimpleSIR<6, ExamplePropagate,
                   ExampleMeasurement, ExampleLikelihood> ExampleSIR;
 
-// Calculate the average and covariance for the current state vector.  This is
+// Calculate the average and covariance for the current samples.  This is
 // convenience function the user might want to write.
-void ExampleMakeAverage(const ExampleSIR::SampleVector& samples,
-                        ExampleState& stateAverage,
+void ExampleMakeAverage(const ExampleSIR::Samples& samples,
+                        std::vector<double>& stateAverage,
                         TMatrixD& stateCov) {
-    std::size_t dim = samples[0].second.size();
-    if (stateAverage.size() != dim) {
+    const int dim = ExampleSIR::Samples::kDimension;
+    if ((int) stateAverage.size() != dim) {
         std::cout << "Resize!!!" << std::endl;
         stateAverage.resize(dim);
         stateCov.ResizeTo(dim,dim);
     }
-    for (std::size_t i=0; i<dim; ++i) {
+    for (int i=0; i<dim; ++i) {
         stateAverage[i] = 0.0;
-        for (std::size_t j=0; j<dim; ++j) {
+        for (int j=0; j<dim; ++j) {
             stateCov(i,j) = 0.0;
         }
     }
     // Find the averages.
-    for (ExampleSIR::SampleVector::const_iterator s = samples.begin();
-             s != samples.end(); ++s) {
-        for (std::size_t i=0; i<dim; ++i) {
-            stateAverage[i] += s->first*s->second[i];
+    for (std::size_t s = 0; s < samples.size(); ++s) {
+        for (int i=0; i<dim; ++i) {
+            stateAverage[i] += samples.Weight[s]*samples[i][s];
         }
     }
     // Find the covariance (brute force!)
-    for (ExampleSIR::SampleVector::const_iterator s = samples.begin();
-             s != samples.end(); ++s) {
-        for (std::size_t i=0; i<dim; ++i) {
-            double a = s->second[i]-stateAverage[i];
-            for (std::size_t j=0; j<dim; ++j) {
-                double b = s->second[j]-stateAverage[j];
-                stateCov(i,j) += s->first*a*b;
+    for (std::size_t s = 0; s < samples.size(); ++s) {
+        for (int i=0; i<dim; ++i) {
+            double a = samples[i][s]-stateAverage[i];
+            for (int j=0; j<dim; ++j) {
+                double b = samples[j][s]-stateAverage[j];
+                stateCov(i,j) += samples.Weight[s]*a*b;
             }
         }
     }
@@ -570,24 +623,21 @@ void RunSimpleSIRExample() {
         measurements.push_back(m);
     }
 
-    // Fill the sample vector with a prior distribution.  This needs to be
-    // provided by the user.
-    ExampleSIR::SampleVector samples;
-    samples.clear();
-    for (int i=0; i < sampSize; ++i) {
-        ExampleState s(6);
-        s[0] = measurements[0][0] + gRandom->Gaus(); // prior for x
-        s[1] = measurements[0][1] + gRandom->Gaus(); // prior for y
-        s[2] = measurements[0][2];                   // prior for z
-        s[3] = measurements[1][0] + gRandom->Gaus(); // next x
-        s[4] = measurements[1][1] + gRandom->Gaus(); // next y
-        s[5] = measurements[1][2];                   // next z
-        for (int j = 0; j<3; ++j) s[j+3] = s[j+3] - s[j];
+    // Fill the samples with a prior distribution.  This needs to be provided
+    // by the user.
+    ExampleSIR::Samples samples(sampSize);
+    for (int s=0; s < sampSize; ++s) {
+        samples[0][s] = measurements[0][0] + gRandom->Gaus(); // prior for x
+        samples[1][s] = measurements[0][1] + gRandom->Gaus(); // prior for y
+        samples[2][s] = measurements[0][2];                   // prior for z
+        samples[3][s] = measurements[1][0] + gRandom->Gaus(); // next x
+        samples[4][s] = measurements[1][1] + gRandom->Gaus(); // next y
+        samples[5][s] = measurements[1][2];                   // next z
+        for (int j = 0; j<3; ++j) samples[j+3][s] -= samples[j][s];
         double r = 0.0;
-        for (int j = 3; j<6; ++j) r += s[j]*s[j];
-        for (int j = 3; j<6; ++j) s[j] /= r;
-        ExampleSIR::SamplePair sample(1.0,s);
-        samples.push_back(sample);
+        for (int j = 3; j<6; ++j) r += samples[j][s]*samples[j][s];
+        for (int j = 3; j<6; ++j) samples[j][s] /= r;
+        samples.Weight[s] = 1.0;
     }
 
 #ifdef AllowInitialImportanceSampling
@@ -595,9 +645,8 @@ void RunSimpleSIRExample() {
     // state weights are not all 1.0.  This almost certainly shouldn't be
     // done, but if you need it, here it is.  Don't do this unless you KNOW
     // what your are doing.
-    for (ExampleSIR::SampleIterator s = samples.begin();
-         s != samples.end(); ++s) {
-        s->first = 1.0/s->first;
+    for (std::size_t s = 0; s < samples.size(); ++s) {
+        samples.Weight[s] = 1.0/samples.Weight[s];
     }
 #endif
 
@@ -609,13 +658,13 @@ void RunSimpleSIRExample() {
     // Declare the filter.
     ExampleSIR Filter;
     // Update the PDF described by the samples to the next measurement.
-    ExampleState stateAverage;
+    std::vector<double> stateAverage;
     TMatrixD stateCovariance;
     for (std::size_t i = 1; i < measurements.size(); ++i) {
         Filter.UpdateSamples(samples,measurements[i]);
         // Calculate and print the averages.
         ExampleMakeAverage(samples,stateAverage,stateCovariance);
-        for (ExampleState::iterator s = stateAverage.begin();
+        for (std::vector<double>::iterator s = stateAverage.begin();
              s != stateAverage.end(); ++s) {
             std::cout << *s << " ";
         }
@@ -629,9 +678,8 @@ void RunSimpleSIRExample() {
 
     // The final posterior is described by a cloud of weighted points.
     std::cout << "Fill histogram" << std::endl;
-    for (ExampleSIR::SampleVector::iterator s = samples.begin();
-             s != samples.end(); ++s) {
-        hist1->Fill(s->second[0], s->second[1], s->first);
+    for (std::size_t s = 0; s < samples.size(); ++s) {
+        hist1->Fill(samples[0][s], samples[1][s], samples.Weight[s]);
     }
 
     hist1->Draw("colz");